@@ -0,0 +1,66 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "arena.h"
+
+struct ZyArenaBlock {
+  ZyArenaBlock *next;
+  size_t size;
+  char data[]; /* 前面两个字段之后正好 8 字节对齐 */
+};
+
+void zy_initArena(ZyArena *arena) {
+  arena->blocks = NULL;
+  arena->next = NULL;
+  arena->limit = NULL;
+}
+
+void zy_freeArena(ZyArena *arena) {
+  ZyArenaBlock *block = arena->blocks;
+  while (block != NULL) {
+    ZyArenaBlock *next = block->next;
+    free(block);
+    block = next;
+  }
+  zy_initArena(arena);
+}
+
+void *zy_arenaAllocSlow(ZyArena *arena, size_t size) {
+  size_t blockSize = size > ZY_ARENA_BLOCK ? size : ZY_ARENA_BLOCK;
+  ZyArenaBlock *block =
+      (ZyArenaBlock *)malloc(sizeof(ZyArenaBlock) + blockSize);
+  if (block == NULL) {
+    fprintf(stderr, "Not enough memory to grow the arena.");
+    exit(1);
+  }
+  block->size = blockSize;
+  if (size > ZY_ARENA_BLOCK / 4 && arena->blocks != NULL) {
+    /* 大对象放进单独的块，不浪费当前块剩下的空间 */
+    block->next = arena->blocks->next;
+    arena->blocks->next = block;
+    return block->data;
+  }
+  block->next = arena->blocks;
+  arena->blocks = block;
+  arena->next = block->data + size;
+  arena->limit = block->data + blockSize;
+  return block->data;
+}
+
+/* 把 from 的所有块交给 into，之后一起释放；from 变成空的 */
+void zy_mergeArena(ZyArena *into, ZyArena *from) {
+  if (from->blocks == NULL)
+    return;
+  if (into->blocks == NULL) {
+    *into = *from;
+    zy_initArena(from);
+    return;
+  }
+  /* into 还要接着在第一块里分配，from 的块都接在它后面 */
+  ZyArenaBlock *tail = from->blocks;
+  while (tail->next != NULL)
+    tail = tail->next;
+  tail->next = into->blocks->next;
+  into->blocks->next = from->blocks;
+  zy_initArena(from);
+}
@@ -0,0 +1,36 @@
+#pragma once
+
+#include <stddef.h>
+
+/* 每块至少这么大；更大的请求单独分配一块 */
+#define ZY_ARENA_BLOCK ((size_t)64 << 10)
+
+typedef struct ZyArenaBlock ZyArenaBlock;
+
+/**
+ * @brief Bump allocator for objects that all die together.
+ *
+ * Allocation is a pointer increment inside the current block;
+ * nothing is freed individually, @ref zy_freeArena releases
+ * every block at once.
+ */
+typedef struct {
+  ZyArenaBlock *blocks; /**< @brief Newest block first. */
+  char *next;           /**< @brief Free space in the newest block. */
+  char *limit;
+} ZyArena;
+
+extern void zy_initArena(ZyArena *arena);
+extern void zy_freeArena(ZyArena *arena);
+extern void *zy_arenaAllocSlow(ZyArena *arena, size_t size);
+extern void zy_mergeArena(ZyArena *into, ZyArena *from);
+
+/* 分配 size 个字节，按 8 字节对齐 */
+static inline void *zy_arenaAlloc(ZyArena *arena, size_t size) {
+  size = (size + 7) & ~(size_t)7;
+  if ((size_t)(arena->limit - arena->next) < size)
+    return zy_arenaAllocSlow(arena, size);
+  void *p = arena->next;
+  arena->next += size;
+  return p;
+}
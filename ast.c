@@ -2,37 +2,17 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <unistd.h>
 
 #include "ast.h"
+#include "flatast.h"
 #include "scanner.h"
+#include "visitor.h"
 
 static inline int bufferGrowCapacity(int capacity) {
   return capacity < 8 ? 8 : capacity * 2;
 }
 
-static inline char *bufferNewCString(size_t length) {
-  char *buffer = (char *)malloc(length + 1);
-  if (buffer == NULL) {
-    fprintf(stderr, "Not enough memory to allocate string of length %zu.",
-            length);
-    exit(1);
-  }
-  return buffer;
-}
-
-char *tokenToCString(ZyToken token) {
-  char *buffer = bufferNewCString((size_t)token.length);
-  if (buffer != NULL) {
-    if (token.length > 0)
-      memcpy(buffer, token.start, token.length);
-    buffer[token.length] = '\0';
-    return buffer;
-  } else {
-    fprintf(stderr, "Not enough memory to convert token to string.");
-    return NULL;
-  }
-}
-
 void AstArrayInit(AstArray *buffer) {
   buffer->capacity = 0;
   buffer->count = 0;
@@ -92,20 +72,63 @@ Ast *AstArrayDelete(AstArray *buffer, int index) {
   return element;
 }
 
+/* 每个线程各自选择的 arena，NULL 时用 malloc */
+static __thread AstArena *currentArena = NULL;
+
+void astInitArena(AstArena *arena) {
+  zy_initArena(&arena->arena);
+  arena->nodes = 0;
+}
+
+void astFreeArena(AstArena *arena) {
+  zy_freeArena(&arena->arena);
+  arena->nodes = 0;
+}
+
+/* from 里的节点交给 into 管理，用于把各个线程的结果合在一起 */
+void astMergeArena(AstArena *into, AstArena *from) {
+  zy_mergeArena(&into->arena, &from->arena);
+  into->nodes += from->nodes;
+  from->nodes = 0;
+}
+
+/* 选择本线程之后分配节点用的 arena，返回原来的 */
+AstArena *astUseArena(AstArena *arena) {
+  AstArena *old = currentArena;
+  currentArena = arena;
+  return old;
+}
+
+AstArena *astCurrentArena(void) { return currentArena; }
+
+static inline void initAst(Ast *ast, AstNodeKind kind, ZyToken token) {
+  ast->category = astNodeCategory(kind);
+  ast->kind = kind;
+  ast->modifier = astInitModifier();
+  ast->token = token;
+  ast->parent = NULL;
+  ast->sibling = NULL;
+  ast->children.capacity = AST_INLINE_CHILDREN;
+  ast->children.count = 0;
+  ast->children.elements = ast->inlineChildren;
+}
+
 Ast *emptyAst(AstNodeKind kind, ZyToken token) {
+  if (currentArena != NULL) {
+    Ast *ast = (Ast *)zy_arenaAlloc(&currentArena->arena, sizeof(Ast));
+    initAst(ast, kind, token);
+    ast->inArena = true;
+    currentArena->nodes++;
+    return ast;
+  }
+
   Ast *ast = (Ast *)malloc(sizeof(Ast));
-  if (ast != NULL) {
-    ast->category = astNodeCategory(kind);
-    ast->kind = kind;
-    ast->modifier = astInitModifier();
-    ast->token = token;
-
-    ast->parent = NULL;
-    ast->sibling = NULL;
-    ast->children = (AstArray *)malloc(sizeof(AstArray));
-    if (ast->children != NULL)
-      AstArrayInit(ast->children);
+  if (ast == NULL) {
+    fprintf(stderr, "Not enough memory to allocate AST node.");
+    exit(1);
   }
+  initAst(ast, kind, token);
+  ast->inArena = false;
   return ast;
 }
 
@@ -129,776 +152,1213 @@ static void freeAstChildren(AstArray *children, bool freeChildren) {
 }
 
 void freeAst(Ast *ast, bool freeChildren) {
-  if (ast->children != NULL) {
-    if (freeChildren)
-      freeAstChildren(ast->children, freeChildren);
-    AstArrayFree(ast->children);
-    free(ast->children);
-  }
+  /* 随 arena 一起释放 */
+  if (ast->inArena)
+    return;
+  if (freeChildren)
+    freeAstChildren(&ast->children, freeChildren);
+  if (ast->children.elements != ast->inlineChildren)
+    free(ast->children.elements);
 
   free(ast);
 }
 
-void astAppendChild(Ast *ast, Ast *child) {
-  if (ast->children == NULL) {
+/*
+ * 节点里放不下时把子节点搬到一个两倍大的数组：arena 节点的数组
+ * 也在 arena 里，旧的留在那里；其它的第一次用 malloc，之后 realloc。
+ */
+static void growChildren(Ast *ast) {
+  AstArray *children = &ast->children;
+  int capacity = children->capacity * 2;
+  Ast **elements;
+  if (ast->inArena) {
+    if (currentArena == NULL) {
+      fprintf(stderr, "Adding a child to an arena node needs its arena.");
+      exit(1);
+    }
+    elements = (Ast **)zy_arenaAlloc(&currentArena->arena,
+                                     sizeof(Ast *) * capacity);
+    memcpy(elements, children->elements, sizeof(Ast *) * children->count);
+  } else if (children->elements == ast->inlineChildren) {
+    elements = (Ast **)malloc(sizeof(Ast *) * capacity);
+    if (elements != NULL)
+      memcpy(elements, children->elements, sizeof(Ast *) * children->count);
+  } else {
+    elements =
+        (Ast **)realloc(children->elements, sizeof(Ast *) * capacity);
+  }
+  if (elements == NULL) {
     fprintf(stderr, "Not enough memory to add child AST node to parent.");
     exit(1);
   }
+  children->elements = elements;
+  children->capacity = capacity;
+}
 
+void astAppendChild(Ast *ast, Ast *child) {
   if (child != NULL)
     child->parent = ast;
   Ast *sibling = astLastChild(ast);
   if (sibling != NULL)
     sibling->sibling = child;
-  AstArrayAdd(ast->children, child);
+  if (ast->children.count == ast->children.capacity)
+    growChildren(ast);
+  ast->children.elements[ast->children.count++] = child;
+}
+
+/* 换掉第 index 个子节点，返回原来的节点 */
+Ast *astReplaceChild(Ast *ast, int index, Ast *child) {
+  Ast *old = astGetChild(ast, index);
+  child->parent = ast;
+  child->sibling = old->sibling;
+  if (index > 0 && ast->children.elements[index - 1] != NULL)
+    ast->children.elements[index - 1]->sibling = child;
+  ast->children.elements[index] = child;
+  old->parent = NULL;
+  old->sibling = NULL;
+  return old;
 }
 
 Ast *astFirstChild(Ast *ast) {
   if (!astHasChild(ast))
     return NULL;
-  return ast->children->elements[0];
+  return ast->children.elements[0];
 }
 
 Ast *astGetChild(Ast *ast, int index) {
-  if (ast->children == NULL || ast->children->count < index) {
+  if (ast->children.count < index) {
     fprintf(stderr, "Ast has no children or invalid child index specified.");
     exit(1);
   }
-  return ast->children->elements[index];
+  return ast->children.elements[index];
 }
 
-bool astHasChild(Ast *ast) {
-  return (ast->children != NULL && ast->children->count > 0);
-}
+bool astHasChild(Ast *ast) { return ast->children.count > 0; }
 
 Ast *astLastChild(Ast *ast) {
   if (!astHasChild(ast))
     return NULL;
-  return ast->children->elements[ast->children->count - 1];
+  return ast->children.elements[ast->children.count - 1];
 }
 
-int astNumChild(Ast *ast) {
-  return (ast->children != NULL) ? ast->children->count : 0;
+int astNumChild(Ast *ast) { return ast->children.count; }
+
+/*
+ * 要输出的节点：指针形式的 ast，或者扁平树 flat 里的第 index 个。
+ * 两种树用同一套输出函数，缓存里映射进来的树不用先还原成 Ast。
+ */
+typedef struct {
+  const ZyFlatAst *flat; /* NULL 时是指针形式 */
+  union {
+    Ast *ast;
+    uint32_t index;
+  };
+} AstNodeRef;
+
+static inline AstNodeRef nodeOfAst(Ast *ast) {
+  AstNodeRef node;
+  node.flat = NULL;
+  node.ast = ast;
+  return node;
 }
 
-static void astOutputIndent(int indentLevel) {
-  printf("%*s", indentLevel * 2, "");
+static inline AstNodeRef nodeOfFlat(const ZyFlatAst *flat, uint32_t index) {
+  AstNodeRef node;
+  node.flat = flat;
+  node.index = index;
+  return node;
 }
 
-static void astOutputChild(Ast *ast, int indentLevel, int index) {
-  if (ast->children == NULL || ast->children->count <= index) {
-    fprintf(stderr, "Ast has no children or invalid child index specified.");
-    exit(1);
-  }
+static inline bool nodeIsNull(AstNodeRef node) {
+  return node.flat != NULL ? node.index == ZY_FLAT_NONE : node.ast == NULL;
+}
 
-  Ast *expr = ast->children->elements[index];
-  astOutput(expr, indentLevel);
+static inline bool nodeIsSame(AstNodeRef a, AstNodeRef b) {
+  return a.flat != NULL ? a.index == b.index : a.ast == b.ast;
 }
 
-static void astOutputExprAnd(Ast *ast, int indentLevel) {
-  astOutputIndent(indentLevel);
-  printf("and\n");
-  astOutputChild(ast, indentLevel + 1, 0);
-  astOutputChild(ast, indentLevel + 1, 1);
+static inline AstNodeKind nodeKind(AstNodeRef node) {
+  return node.flat != NULL ? (AstNodeKind)node.flat->nodes[node.index].kind
+                           : node.ast->kind;
 }
 
-static void astOutputExprArray(Ast *ast, int indentLevel) {
-  astOutputIndent(indentLevel);
-  printf("array\n");
-  if (astHasChild(ast))
-    astOutputChild(ast, indentLevel + 1, 0);
+static inline ZyToken nodeToken(AstNodeRef node) {
+  return node.flat != NULL ? zy_flatToken(node.flat, node.index)
+                           : node.ast->token;
 }
 
-static void astOutputExprAssign(Ast *ast, int indentLevel) {
-  astOutputIndent(indentLevel);
-  char *name = tokenToCString(ast->token);
-  printf("assign %s\n", name);
-  astOutputChild(ast, indentLevel + 1, 0);
-  free(name);
+/* 修饰符按 ZyFlatModifier 的位取出 */
+static inline int nodeModifiers(AstNodeRef node) {
+  return node.flat != NULL ? node.flat->nodes[node.index].modifiers
+                           : zy_packModifier(node.ast->modifier);
 }
 
-static void astOutputExprAwait(Ast *ast, int indentLevel) {
-  astOutputIndent(indentLevel);
-  printf("await\n");
-  astOutputChild(ast, indentLevel + 1, 0);
-  ;
+static inline bool nodeHas(AstNodeRef node, ZyFlatModifier modifier) {
+  return (nodeModifiers(node) & modifier) != 0;
 }
 
-static void astOutputExprBinary(Ast *ast, int indentLevel) {
-  astOutputIndent(indentLevel);
-  char *op = tokenToCString(ast->token);
-  printf("binary %s\n", op);
-  astOutputChild(ast, indentLevel + 1, 0);
-  astOutputChild(ast, indentLevel + 1, 1);
-  free(op);
+static inline int nodeNumChild(AstNodeRef node) {
+  return node.flat != NULL ? (int)zy_flatNumChild(node.flat, node.index)
+                           : node.ast->children.count;
 }
 
-static void astOutputExprCall(Ast *ast, int indentLevel) {
-  astOutputIndent(indentLevel);
-  char *modifier = ast->modifier.isOptional ? "?" : "";
-  printf("call%s\n", modifier);
-  astOutputChild(ast, indentLevel + 1, 0);
-  astOutputChild(ast, indentLevel + 1, 1);
+static inline AstNodeRef nodeChild(AstNodeRef node, int index) {
+  if (node.flat != NULL)
+    return nodeOfFlat(node.flat,
+                      zy_flatChild(node.flat, node.index, (uint32_t)index));
+  return nodeOfAst(node.ast->children.elements[index]);
 }
 
-static void astOutputExprClass(Ast *ast, int indentLevel) {
-  astOutputIndent(indentLevel);
-  printf("class\n");
-  astOutputChild(ast, indentLevel + 1, 0);
-  astOutputChild(ast, indentLevel + 1, 1);
-  astOutputChild(ast, indentLevel + 1, 2);
+/* 输出时的状态，是各个输出函数的 context */
+typedef struct {
+  AstNodeRef node;
+  int next; /* 下一个要输出的子节点 */
+} AstOpenNode;
+
+typedef struct {
+  ZyOutput *out;
+  const char *src; /* token 的偏移从这里算起，NULL 时不输出偏移 */
+  int indentLevel;
+  /* JSON 和 S 表达式：每一层正在输出的节点 */
+  AstOpenNode *open;
+  int capacity;
+} AstWriter;
+
+static inline void put(ZyOutput *out, const char *text) {
+  zy_writeBytes(out, text, strlen(text));
 }
 
-static void astOutputExprDictionary(Ast *ast, int indentLevel) {
-  astOutputIndent(indentLevel);
-  printf("dictionary\n");
-  astOutputChild(ast, indentLevel + 1, 0);
-  astOutputChild(ast, indentLevel + 1, 1);
+/* token 的文本直接从源码复制，不另外生成字符串 */
+static inline void putToken(ZyOutput *out, ZyToken token) {
+  if (token.length > 0)
+    zy_writeBytes(out, token.start, token.length);
 }
 
-static void astOutputExprFunction(Ast *ast, int indentLevel) {
-  astOutputIndent(indentLevel);
-  printf("function\n");
-  astOutputChild(ast, indentLevel + 1, 0);
-  astOutputChild(ast, indentLevel + 1, 1);
+static void putIndent(ZyOutput *out, int indentLevel) {
+  static const char spaces[] = "                                ";
+  size_t width = (size_t)indentLevel * 2;
+  while (width > 0) {
+    size_t n = width < sizeof(spaces) - 1 ? width : sizeof(spaces) - 1;
+    zy_writeBytes(out, spaces, n);
+    width -= n;
+  }
 }
 
-static void astOutputExprGrouping(Ast *ast, int indentLevel) {
-  astOutputIndent(indentLevel);
-  printf("grouping\n");
-  astOutputChild(ast, indentLevel + 1, 0);
+/* human 格式：缩进到这一层，返回要写的 ZyOutput */
+static ZyOutput *astOutputIndent(int depth, void *context) {
+  AstWriter *writer = (AstWriter *)context;
+  putIndent(writer->out, writer->indentLevel + depth);
+  return writer->out;
 }
 
-static void astOutputExprInvoke(Ast *ast, int indentLevel) {
-  astOutputIndent(indentLevel);
-  char *modifier = ast->modifier.isOptional ? "?" : "";
-  char *method = tokenToCString(ast->token);
-  printf("invoke %s.%s\n", modifier, method);
-  astOutputChild(ast, indentLevel + 1, 0);
-  astOutputChild(ast, indentLevel + 1, 1);
-  free(method);
+static AstVisitResult astOutputExprAnd(AstNodeRef node, int depth,
+                                       void *context) {
+  ZyOutput *out = astOutputIndent(depth, context);
+  put(out, "and\n");
+  return AST_VISIT_CONTINUE;
 }
 
-static void astOutputExprInterpolation(Ast *ast, int indentLevel) {
-  astOutputIndent(indentLevel);
-  printf("interpolation\n");
-  astOutputChild(ast, indentLevel + 1, 0);
+static AstVisitResult astOutputExprArray(AstNodeRef node, int depth,
+                                         void *context) {
+  ZyOutput *out = astOutputIndent(depth, context);
+  put(out, nodeHas(node, ZY_FLAT_MUTABLE) ? "array" : "tuple");
+  put(out, "\n");
+  return AST_VISIT_CONTINUE;
 }
 
-static void astOutputExprLiteral(Ast *ast, int indentLevel) {
-  astOutputIndent(indentLevel);
-  char *token = tokenToCString(ast->token);
-  switch (ast->token.type) {
+static AstVisitResult astOutputExprAssign(AstNodeRef node, int depth,
+                                          void *context) {
+  ZyOutput *out = astOutputIndent(depth, context);
+  put(out, "assign ");
+  putToken(out, nodeToken(node));
+  put(out, "\n");
+  return AST_VISIT_CONTINUE;
+}
+
+static AstVisitResult astOutputExprAwait(AstNodeRef node, int depth,
+                                         void *context) {
+  ZyOutput *out = astOutputIndent(depth, context);
+  put(out, "await\n");
+  return AST_VISIT_CONTINUE;
+}
+
+static AstVisitResult astOutputExprBinary(AstNodeRef node, int depth,
+                                          void *context) {
+  ZyOutput *out = astOutputIndent(depth, context);
+  put(out, "binary ");
+  putToken(out, nodeToken(node));
+  put(out, "\n");
+  return AST_VISIT_CONTINUE;
+}
+
+static AstVisitResult astOutputExprCall(AstNodeRef node, int depth,
+                                        void *context) {
+  ZyOutput *out = astOutputIndent(depth, context);
+  char *modifier = nodeHas(node, ZY_FLAT_OPTIONAL) ? "?" : "";
+  put(out, "call");
+  put(out, modifier);
+  put(out, "\n");
+  return AST_VISIT_CONTINUE;
+}
+
+static AstVisitResult astOutputExprClass(AstNodeRef node, int depth,
+                                         void *context) {
+  ZyOutput *out = astOutputIndent(depth, context);
+  put(out, "class\n");
+  return AST_VISIT_CONTINUE;
+}
+
+static AstVisitResult astOutputExprComprehension(AstNodeRef node, int depth,
+                                                 void *context) {
+  ZyOutput *out = astOutputIndent(depth, context);
+  put(out, "comprehension ");
+  putToken(out, nodeToken(node));
+  put(out, "\n");
+  return AST_VISIT_CONTINUE;
+}
+
+static AstVisitResult astOutputExprDictionary(AstNodeRef node, int depth,
+                                              void *context) {
+  ZyOutput *out = astOutputIndent(depth, context);
+  put(out, "dictionary\n");
+  return AST_VISIT_CONTINUE;
+}
+
+static AstVisitResult astOutputExprFunction(AstNodeRef node, int depth,
+                                            void *context) {
+  ZyOutput *out = astOutputIndent(depth, context);
+  put(out, nodeHas(node, ZY_FLAT_LAMBDA) ? "lambda" : "function");
+  put(out, "\n");
+  return AST_VISIT_CONTINUE;
+}
+
+static AstVisitResult astOutputExprGrouping(AstNodeRef node, int depth,
+                                            void *context) {
+  ZyOutput *out = astOutputIndent(depth, context);
+  put(out, "grouping\n");
+  return AST_VISIT_CONTINUE;
+}
+
+static AstVisitResult astOutputExprInvoke(AstNodeRef node, int depth,
+                                          void *context) {
+  ZyOutput *out = astOutputIndent(depth, context);
+  char *modifier = nodeHas(node, ZY_FLAT_OPTIONAL) ? "?" : "";
+  put(out, "invoke ");
+  put(out, modifier);
+  put(out, ".");
+  putToken(out, nodeToken(node));
+  put(out, "\n");
+  return AST_VISIT_CONTINUE;
+}
+
+static AstVisitResult astOutputExprInterpolation(AstNodeRef node, int depth,
+                                                 void *context) {
+  ZyOutput *out = astOutputIndent(depth, context);
+  put(out, "interpolation\n");
+  return AST_VISIT_CONTINUE;
+}
+
+/* 带转义的字符串解码到这里，其余的直接引用源码 */
+static ZyArena literalArena;
+
+/* 字符串 token 可能从前缀字母开始（`rb"..."`），返回前缀的长度 */
+static size_t literalPrefix(ZyToken token, int *flags) {
+  size_t length = 0;
+  *flags = 0;
+  for (; length < token.length; length++) {
+    switch (token.start[length]) {
+    case 'r':
+    case 'R':
+      *flags |= ZY_STRING_RAW;
+      continue;
+    case 'b':
+    case 'B':
+      *flags |= ZY_STRING_BYTES;
+      continue;
+    case 'f':
+    case 'F':
+      *flags |= ZY_STRING_FORMAT;
+      continue;
+    case 'u':
+    case 'U':
+      continue;
+    default:
+      break;
+    }
+    break;
+  }
+  return length;
+}
+
+static AstVisitResult astOutputExprLiteral(AstNodeRef node, int depth,
+                                           void *context) {
+  ZyOutput *out = astOutputIndent(depth, context);
+  ZyToken token = nodeToken(node);
+  switch (token.type) {
   case TOKEN_TRUE:
   case TOKEN_FALSE:
   case TOKEN_NUMBER: {
-    printf("%s\n", token);
+    putToken(out, token);
+    put(out, "\n");
     break;
   }
-  case TOKEN_STRING: {
-    printf("\"%s\"\n", token);
+  case TOKEN_NONE:
+    /* 也用来填补切片、`**` 展开等处省略的部分，这时 token 是空的 */
+    put(out, "None\n");
+    break;
+  case TOKEN_ELLIPSIS:
+    put(out, "...\n");
+    break;
+  case TOKEN_STRING:
+  case TOKEN_BIG_STRING: {
+    int flags;
+    size_t prefix = literalPrefix(token, &flags);
+    ZyString string = zy_decodeString(token.start + prefix,
+                                      token.length - prefix, flags,
+                                      &literalArena);
+    zy_writeBytes(out, token.start, prefix);
+    put(out, "\"");
+    zy_writeBytes(out, string.chars, string.length);
+    put(out, "\"\n");
     break;
   }
   default:
+    put(out, "\n");
     break;
   }
-  free(token);
+  /* 相邻的字符串拼接在一起，后面的几段是子节点，接着输出 */
+  return AST_VISIT_CONTINUE;
+}
+
+static AstVisitResult astOutputExprNil(AstNodeRef node, int depth,
+                                       void *context) {
+  ZyOutput *out = astOutputIndent(depth, context);
+  put(out, "nil ?");
+  putToken(out, nodeToken(node));
+  put(out, "\n");
+  return AST_VISIT_CONTINUE;
+}
+
+static AstVisitResult astOutputExprOr(AstNodeRef node, int depth,
+                                      void *context) {
+  ZyOutput *out = astOutputIndent(depth, context);
+  put(out, "or\n");
+  return AST_VISIT_CONTINUE;
 }
 
-static void astOutputExprNil(Ast *ast, int indentLevel) {
-  astOutputIndent(indentLevel);
-  char *op = tokenToCString(ast->token);
-  printf("nil ?%s\n", op);
-  astOutputChild(ast, indentLevel + 1, 0);
-  astOutputChild(ast, indentLevel + 1, 1);
-  free(op);
-}
+static AstVisitResult astOutputExprParam(AstNodeRef node, int depth,
+                                         void *context) {
+  ZyOutput *out = astOutputIndent(depth, context);
+  char *mutable = nodeHas(node, ZY_FLAT_MUTABLE) ? "var " : "";
+  char *optional = nodeHas(node, ZY_FLAT_OPTIONAL) ? "?" : "";
+
+  /* `*args` 和 `**kwargs` 的 token 包括前面的星号 */
+  put(out, "param ");
+  put(out, mutable);
+  putToken(out, nodeToken(node));
+  put(out, optional);
+  put(out, "\n");
+  return AST_VISIT_CONTINUE;
+}
 
-static void astOutputExprOr(Ast *ast, int indentLevel) {
-  astOutputIndent(indentLevel);
-  printf("or\n");
-  astOutputChild(ast, indentLevel + 1, 0);
-  astOutputChild(ast, indentLevel + 1, 1);
+static AstVisitResult astOutputExprPropertyGet(AstNodeRef node, int depth,
+                                               void *context) {
+  ZyOutput *out = astOutputIndent(depth, context);
+  char *modifier = nodeHas(node, ZY_FLAT_OPTIONAL) ? "?" : "";
+  put(out, "propertyGet ");
+  put(out, modifier);
+  put(out, ".");
+  putToken(out, nodeToken(node));
+  put(out, "\n");
+  return AST_VISIT_CONTINUE;
+}
+
+static AstVisitResult astOutputExprPropertySet(AstNodeRef node, int depth,
+                                               void *context) {
+  ZyOutput *out = astOutputIndent(depth, context);
+  put(out, "propertySet ");
+  putToken(out, nodeToken(node));
+  put(out, "\n");
+  return AST_VISIT_CONTINUE;
+}
+
+static AstVisitResult astOutputExprSet(AstNodeRef node, int depth,
+                                       void *context) {
+  ZyOutput *out = astOutputIndent(depth, context);
+  put(out, "set\n");
+  return AST_VISIT_CONTINUE;
+}
+
+static AstVisitResult astOutputExprSlice(AstNodeRef node, int depth,
+                                         void *context) {
+  ZyOutput *out = astOutputIndent(depth, context);
+  put(out, "slice\n");
+  return AST_VISIT_CONTINUE;
+}
+
+static AstVisitResult astOutputExprSubscriptGet(AstNodeRef node, int depth,
+                                                void *context) {
+  ZyOutput *out = astOutputIndent(depth, context);
+  char *modifier = nodeHas(node, ZY_FLAT_OPTIONAL) ? "?" : "";
+  put(out, "subscriptGet");
+  put(out, modifier);
+  put(out, "\n");
+  return AST_VISIT_CONTINUE;
+}
+
+static AstVisitResult astOutputExprSubscriptSet(AstNodeRef node, int depth,
+                                                void *context) {
+  ZyOutput *out = astOutputIndent(depth, context);
+  put(out, "subscriptSet\n");
+  return AST_VISIT_CONTINUE;
+}
+
+static AstVisitResult astOutputExprSuperGet(AstNodeRef node, int depth,
+                                            void *context) {
+  ZyOutput *out = astOutputIndent(depth, context);
+  put(out, "superGet ");
+  putToken(out, nodeToken(node));
+  put(out, "\n");
+  return AST_VISIT_SKIP;
+}
+
+static AstVisitResult astOutputExprSuperInvoke(AstNodeRef node, int depth,
+                                               void *context) {
+  ZyOutput *out = astOutputIndent(depth, context);
+  put(out, "superInvoke ");
+  putToken(out, nodeToken(node));
+  put(out, "\n");
+  return AST_VISIT_CONTINUE;
+}
+
+static AstVisitResult astOutputExprTernary(AstNodeRef node, int depth,
+                                           void *context) {
+  ZyOutput *out = astOutputIndent(depth, context);
+  put(out, "ternary\n");
+  return AST_VISIT_CONTINUE;
+}
+
+static AstVisitResult astOutputExprThis(AstNodeRef node, int depth,
+                                        void *context) {
+  ZyOutput *out = astOutputIndent(depth, context);
+  put(out, "this\n");
+  return AST_VISIT_CONTINUE;
+}
+
+static AstVisitResult astOutputExprTrait(AstNodeRef node, int depth,
+                                         void *context) {
+  ZyOutput *out = astOutputIndent(depth, context);
+  put(out, "trait\n");
+  return AST_VISIT_CONTINUE;
+}
+
+static AstVisitResult astOutputExprUnary(AstNodeRef node, int depth,
+                                         void *context) {
+  ZyOutput *out = astOutputIndent(depth, context);
+  put(out, "unary ");
+  putToken(out, nodeToken(node));
+  put(out, "\n");
+  return AST_VISIT_CONTINUE;
+}
+
+static AstVisitResult astOutputExprVariable(AstNodeRef node, int depth,
+                                            void *context) {
+  ZyOutput *out = astOutputIndent(depth, context);
+  char *modifier = nodeHas(node, ZY_FLAT_MUTABLE) ? "var " : "";
+  put(out, modifier);
+  putToken(out, nodeToken(node));
+  put(out, "\n");
+  return AST_VISIT_CONTINUE;
+}
+
+static AstVisitResult astOutputExprYield(AstNodeRef node, int depth,
+                                         void *context) {
+  ZyOutput *out = astOutputIndent(depth, context);
+  char *modifier = nodeHas(node, ZY_FLAT_YIELD_FROM) ? " from" : "";
+  put(out, "yield");
+  put(out, modifier);
+  put(out, "\n");
+  return AST_VISIT_CONTINUE;
 }
 
-static void astOutputExprParam(Ast *ast, int indentLevel) {
-  astOutputIndent(indentLevel);
-  char *mutable = ast->modifier.isMutable ? "var " : "";
-  char *variadic = ast->modifier.isVariadic ? ".." : "";
-  char *name = tokenToCString(ast->token);
+static AstVisitResult astOutputStmtAssert(AstNodeRef node, int depth,
+                                          void *context) {
+  ZyOutput *out = astOutputIndent(depth, context);
+  put(out, "assertStmt\n");
+  return AST_VISIT_CONTINUE;
+}
 
-  printf("param %s%s%s\n", mutable, variadic, name);
-  if (astNumChild(ast) > 0) {
-    astOutputChild(ast, indentLevel + 1, 0);
+static AstVisitResult astOutputStmtAwait(AstNodeRef node, int depth,
+                                         void *context) {
+  ZyOutput *out = astOutputIndent(depth, context);
+  put(out, "awaitStmt\n");
+  return AST_VISIT_CONTINUE;
+}
+
+static AstVisitResult astOutputStmtBlock(AstNodeRef node, int depth,
+                                         void *context) {
+  ZyOutput *out = astOutputIndent(depth, context);
+  if (nodeHas(node, ZY_FLAT_LAZY)) {
+    /* 还没有解析的函数体，token 覆盖整个函数体 */
+    put(out, "blockStmt lazy\n");
+    return AST_VISIT_SKIP;
   }
-  free(name);
-}
-
-static void astOutputExprPropertyGet(Ast *ast, int indentLevel) {
-  astOutputIndent(indentLevel);
-  char *modifier = ast->modifier.isOptional ? "?" : "";
-  char *prop = tokenToCString(ast->token);
-  printf("propertyGet %s.%s\n", modifier, prop);
-  astOutputChild(ast, indentLevel + 1, 0);
-  free(prop);
+  put(out, "blockStmt\n");
+  return AST_VISIT_CONTINUE;
 }
 
-static void astOutputExprPropertySet(Ast *ast, int indentLevel) {
-  astOutputIndent(indentLevel);
-  char *prop = tokenToCString(ast->token);
-  printf("propertySet %s\n", prop);
-  astOutputChild(ast, indentLevel + 1, 0);
-  astOutputChild(ast, indentLevel + 1, 1);
-  free(prop);
+static AstVisitResult astOutputStmtBreak(AstNodeRef node, int depth,
+                                         void *context) {
+  ZyOutput *out = astOutputIndent(depth, context);
+  put(out, "breakStmt\n");
+  return AST_VISIT_CONTINUE;
 }
 
-static void astOutputExprSubscriptGet(Ast *ast, int indentLevel) {
-  astOutputIndent(indentLevel);
-  char *modifier = ast->modifier.isOptional ? "?" : "";
-  printf("subscriptGet%s\n", modifier);
-  astOutputChild(ast, indentLevel + 1, 0);
-  astOutputChild(ast, indentLevel + 1, 1);
+static AstVisitResult astOutputStmtCase(AstNodeRef node, int depth,
+                                        void *context) {
+  ZyOutput *out = astOutputIndent(depth, context);
+  put(out, "caseStmt\n");
+  return AST_VISIT_CONTINUE;
 }
 
-static void astOutputExprSubscriptSet(Ast *ast, int indentLevel) {
-  astOutputIndent(indentLevel);
-  printf("subscriptSet\n");
-  astOutputChild(ast, indentLevel + 1, 0);
-  astOutputChild(ast, indentLevel + 1, 1);
-  astOutputChild(ast, indentLevel + 1, 2);
+static AstVisitResult astOutputStmtCatch(AstNodeRef node, int depth,
+                                         void *context) {
+  ZyOutput *out = astOutputIndent(depth, context);
+  put(out, "catchStmt ");
+  putToken(out, nodeToken(node));
+  put(out, "\n");
+  return AST_VISIT_CONTINUE;
 }
 
-static void astOutputExprSuperGet(Ast *ast, int indentLevel) {
-  astOutputIndent(indentLevel);
-  char *prop = tokenToCString(ast->token);
-  printf("superGet %s\n", prop);
-  free(prop);
+static AstVisitResult astOutputStmtContinue(AstNodeRef node, int depth,
+                                            void *context) {
+  ZyOutput *out = astOutputIndent(depth, context);
+  put(out, "continueStmt\n");
+  return AST_VISIT_CONTINUE;
 }
 
-static void astOutputExprSuperInvoke(Ast *ast, int indentLevel) {
-  astOutputIndent(indentLevel);
-  char *method = tokenToCString(ast->token);
-  printf("superInvoke %s\n", method);
-  astOutputChild(ast, indentLevel + 1, 0);
-  free(method);
+static AstVisitResult astOutputStmtDefault(AstNodeRef node, int depth,
+                                           void *context) {
+  ZyOutput *out = astOutputIndent(depth, context);
+  put(out, "defaultStmt\n");
+  return AST_VISIT_CONTINUE;
 }
 
-static void astOutputExprThis(Ast *ast, int indentLevel) {
-  astOutputIndent(indentLevel);
-  printf("this\n");
+static AstVisitResult astOutputStmtDel(AstNodeRef node, int depth,
+                                       void *context) {
+  ZyOutput *out = astOutputIndent(depth, context);
+  put(out, "delStmt\n");
+  return AST_VISIT_CONTINUE;
 }
 
-static void astOutputExprTrait(Ast *ast, int indentLevel) {
-  astOutputIndent(indentLevel);
-  printf("trait\n");
-  astOutputChild(ast, indentLevel + 1, 0);
-  astOutputChild(ast, indentLevel + 1, 1);
+static AstVisitResult astOutputStmtExpression(AstNodeRef node, int depth,
+                                              void *context) {
+  ZyOutput *out = astOutputIndent(depth, context);
+  put(out, "exprStmt\n");
+  return AST_VISIT_CONTINUE;
 }
 
-static void astOutputExprUnary(Ast *ast, int indentLevel) {
-  astOutputIndent(indentLevel);
-  char *op = tokenToCString(ast->token);
-  printf("unary %s\n", op);
-  astOutputChild(ast, indentLevel + 1, 0);
-  free(op);
+static AstVisitResult astOutputStmtFinally(AstNodeRef node, int depth,
+                                           void *context) {
+  ZyOutput *out = astOutputIndent(depth, context);
+  put(out, "finallyStmt\n");
+  return AST_VISIT_CONTINUE;
 }
 
-static void astOutputExprVariable(Ast *ast, int indentLevel) {
-  astOutputIndent(indentLevel);
-  char *modifier = ast->modifier.isMutable ? "var " : "";
-  char *name = tokenToCString(ast->token);
-  printf("%s%s\n", modifier, name);
-  free(name);
+static AstVisitResult astOutputStmtFor(AstNodeRef node, int depth,
+                                       void *context) {
+  ZyOutput *out = astOutputIndent(depth, context);
+  char *async = nodeHas(node, ZY_FLAT_ASYNC) ? " async" : "";
+  put(out, "forStmt");
+  put(out, async);
+  put(out, "\n");
+  return AST_VISIT_CONTINUE;
 }
 
-static void astOutputExprYield(Ast *ast, int indentLevel) {
-  astOutputIndent(indentLevel);
-  char *modifier = ast->modifier.isYieldFrom ? " from" : "";
-  printf("yield%s\n", modifier);
-  if (astHasChild(ast)) {
-    astOutputChild(ast, indentLevel + 1, 0);
-  }
+static AstVisitResult astOutputStmtGlobal(AstNodeRef node, int depth,
+                                          void *context) {
+  ZyOutput *out = astOutputIndent(depth, context);
+  put(out, "globalStmt ");
+  putToken(out, nodeToken(node));
+  put(out, "\n");
+  return AST_VISIT_CONTINUE;
 }
 
-static void astOutputStmtAwait(Ast *ast, int indentLevel) {
-  astOutputIndent(indentLevel);
-  printf("awaitStmt\n");
-  astOutputChild(ast, indentLevel + 1, 0);
+static AstVisitResult astOutputStmtIf(AstNodeRef node, int depth,
+                                      void *context) {
+  ZyOutput *out = astOutputIndent(depth, context);
+  put(out, "ifStmt\n");
+  return AST_VISIT_CONTINUE;
 }
 
-static void astOutputStmtBlock(Ast *ast, int indentLevel) {
-  astOutputIndent(indentLevel);
-  printf("blockStmt\n");
-  Ast *stmtList = astGetChild(ast, 0);
-  astOutput(stmtList, indentLevel + 1);
+static AstVisitResult astOutputStmtPass(AstNodeRef node, int depth,
+                                        void *context) {
+  ZyOutput *out = astOutputIndent(depth, context);
+  put(out, "passStmt\n");
+  return AST_VISIT_CONTINUE;
 }
 
-static void astOutputStmtBreak(Ast *ast, int indentLevel) {
-  astOutputIndent(indentLevel);
-  printf("breakStmt\n");
+static AstVisitResult astOutputStmtRequire(AstNodeRef node, int depth,
+                                           void *context) {
+  ZyOutput *out = astOutputIndent(depth, context);
+  put(out, "requireStmt ");
+  putToken(out, nodeToken(node));
+  put(out, "\n");
+  return AST_VISIT_CONTINUE;
 }
 
-static void astOutputStmtCase(Ast *ast, int indentLevel) {
-  astOutputIndent(indentLevel);
-  printf("caseStmt\n");
-  astOutputChild(ast, indentLevel + 1, 0);
-  astOutputChild(ast, indentLevel + 1, 1);
+static AstVisitResult astOutputStmtReturn(AstNodeRef node, int depth,
+                                          void *context) {
+  ZyOutput *out = astOutputIndent(depth, context);
+  put(out, "returnStmt\n");
+  return AST_VISIT_CONTINUE;
 }
 
-static void astOutputStmtCatch(Ast *ast, int indentLevel) {
-  astOutputIndent(indentLevel);
-  char *type = tokenToCString(ast->token);
-  printf("catchStmt %s\n", type);
-  astOutputChild(ast, indentLevel + 1, 0);
-  astOutputChild(ast, indentLevel + 1, 1);
-  free(type);
+static AstVisitResult astOutputStmtSwitch(AstNodeRef node, int depth,
+                                          void *context) {
+  ZyOutput *out = astOutputIndent(depth, context);
+  put(out, "switchStmt\n");
+  return AST_VISIT_CONTINUE;
 }
 
-static void astOutputStmtContinue(Ast *ast, int indentLevel) {
-  astOutputIndent(indentLevel);
-  printf("continueStmt\n");
+static AstVisitResult astOutputStmtThrow(AstNodeRef node, int depth,
+                                         void *context) {
+  ZyOutput *out = astOutputIndent(depth, context);
+  put(out, "throwStmt\n");
+  return AST_VISIT_CONTINUE;
 }
 
-static void astOutputStmtDefault(Ast *ast, int indentLevel) {
-  astOutputIndent(indentLevel);
-  printf("defaultStmt\n");
-  astOutputChild(ast, indentLevel + 1, 0);
+static AstVisitResult astOutputStmtTry(AstNodeRef node, int depth,
+                                       void *context) {
+  ZyOutput *out = astOutputIndent(depth, context);
+  put(out, "tryStmt\n");
+  return AST_VISIT_CONTINUE;
 }
 
-static void astOutputStmtExpression(Ast *ast, int indentLevel) {
-  astOutputIndent(indentLevel);
-  printf("exprStmt\n");
-  Ast *expr = astGetChild(ast, 0);
-  astOutput(expr, indentLevel + 1);
-}
+static AstVisitResult astOutputStmtUsing(AstNodeRef node, int depth,
+                                         void *context) {
+  ZyOutput *out = astOutputIndent(depth, context);
+  AstNodeRef identifiers = nodeChild(node, 0);
+  put(out, "usingStmt ");
 
-static void astOutputStmtFinally(Ast *ast, int indentLevel) {
-  astOutputIndent(indentLevel);
-  printf("finallyStmt\n");
-  astOutputChild(ast, indentLevel + 1, 0);
-}
-
-static void astOutputStmtFor(Ast *ast, int indentLevel) {
-  astOutputIndent(indentLevel);
-  printf("forStmt\n");
-  astOutputChild(ast, indentLevel + 1, 0);
-  astOutputChild(ast, indentLevel + 1, 1);
-  astOutputChild(ast, indentLevel + 1, 2);
-}
-
-static void astOutputStmtIf(Ast *ast, int indentLevel) {
-  astOutputIndent(indentLevel);
-  printf("ifStmt\n");
-  astOutputChild(ast, indentLevel + 1, 0);
-  astOutputChild(ast, indentLevel + 1, 1);
-  if (astNumChild(ast) > 2) {
-    astOutputChild(ast, indentLevel + 1, 2);
+  /* 相对导入开头的`.`和`...`本身就是分隔符 */
+  int dotted = 1;
+  for (int i = 0; i < nodeNumChild(identifiers); i++) {
+    ZyToken identifier = nodeToken(nodeChild(identifiers, i));
+    int isDot =
+        identifier.type == TOKEN_DOT || identifier.type == TOKEN_ELLIPSIS;
+    if (!dotted && !isDot)
+      put(out, ".");
+    putToken(out, identifier);
+    dotted = isDot;
   }
-}
 
-static void astOutputStmtRequire(Ast *ast, int indentLevel) {
-  astOutputIndent(indentLevel);
-  printf("requireStmt\n");
-  astOutputChild(ast, indentLevel + 1, 0);
-}
-
-static void astOutputStmtReturn(Ast *ast, int indentLevel) {
-  astOutputIndent(indentLevel);
-  printf("returnStmt\n");
-  if (astHasChild(ast))
-    astOutputChild(ast, indentLevel + 1, 0);
-}
-
-static void astOutputStmtSwitch(Ast *ast, int indentLevel) {
-  astOutputIndent(indentLevel);
-  printf("switchStmt\n");
-  astOutputChild(ast, indentLevel + 1, 0);
-  astOutputChild(ast, indentLevel + 1, 1);
-
-  if (astNumChild(ast) > 2) {
-    astOutputChild(ast, indentLevel + 1, 2);
+  if (nodeNumChild(node) > 1) {
+    put(out, " as ");
+    putToken(out, nodeToken(nodeChild(node, 1)));
+  }
+  put(out, "\n");
+  return AST_VISIT_SKIP;
+}
+
+static AstVisitResult astOutputStmtWhile(AstNodeRef node, int depth,
+                                         void *context) {
+  ZyOutput *out = astOutputIndent(depth, context);
+  put(out, "whileStmt\n");
+  return AST_VISIT_CONTINUE;
+}
+
+static AstVisitResult astOutputStmtWith(AstNodeRef node, int depth,
+                                        void *context) {
+  ZyOutput *out = astOutputIndent(depth, context);
+  char *async = nodeHas(node, ZY_FLAT_ASYNC) ? " async" : "";
+  put(out, "withStmt");
+  put(out, async);
+  put(out, "\n");
+  return AST_VISIT_CONTINUE;
+}
+
+static AstVisitResult astOutputStmtYield(AstNodeRef node, int depth,
+                                         void *context) {
+  ZyOutput *out = astOutputIndent(depth, context);
+  char *modifier = nodeHas(node, ZY_FLAT_YIELD_FROM) ? " from" : "";
+  put(out, "yieldStmt");
+  put(out, modifier);
+  put(out, "\n");
+
+  return AST_VISIT_CONTINUE;
+}
+
+static AstVisitResult astOutputDeclClass(AstNodeRef node, int depth,
+                                         void *context) {
+  ZyOutput *out = astOutputIndent(depth, context);
+  put(out, "classDecl ");
+  putToken(out, nodeToken(node));
+  put(out, "\n");
+  return AST_VISIT_CONTINUE;
+}
+
+static AstVisitResult astOutputDeclFun(AstNodeRef node, int depth,
+                                       void *context) {
+  ZyOutput *out = astOutputIndent(depth, context);
+  char *async = nodeHas(node, ZY_FLAT_ASYNC) ? "async " : "";
+  char *_void = nodeHas(node, ZY_FLAT_VOID) ? "void " : "";
+  put(out, "funDecl ");
+  put(out, async);
+  put(out, _void);
+  putToken(out, nodeToken(node));
+  put(out, "\n");
+  /* 子节点是 function，然后是可能有的装饰器 */
+  return AST_VISIT_CONTINUE;
+}
+
+static AstVisitResult astOutputDeclMethod(AstNodeRef node, int depth,
+                                          void *context) {
+  ZyOutput *out = astOutputIndent(depth, context);
+  char *async = nodeHas(node, ZY_FLAT_ASYNC) ? "async " : "";
+  char *_class = nodeHas(node, ZY_FLAT_CLASS) ? "class " : "";
+  char *_void = nodeHas(node, ZY_FLAT_VOID) ? "void " : "";
+  put(out, "methodDecl ");
+  put(out, async);
+  put(out, _class);
+  put(out, _void);
+  putToken(out, nodeToken(node));
+  put(out, "\n");
+  return AST_VISIT_CONTINUE;
+}
+
+static AstVisitResult astOutputDeclNamespace(AstNodeRef node, int depth,
+                                             void *context) {
+  ZyOutput *out = astOutputIndent(depth, context);
+  AstNodeRef identifiers = nodeChild(node, 0);
+  put(out, "namespaceDecl ");
+  putToken(out, nodeToken(nodeChild(identifiers, 0)));
+
+  for (int i = 1; i < nodeNumChild(identifiers); i++) {
+    put(out, ".");
+    putToken(out, nodeToken(nodeChild(identifiers, i)));
+  }
+  put(out, "\n");
+  return AST_VISIT_SKIP;
+}
+
+static AstVisitResult astOutputDeclTrait(AstNodeRef node, int depth,
+                                         void *context) {
+  ZyOutput *out = astOutputIndent(depth, context);
+  put(out, "traitDecl ");
+  putToken(out, nodeToken(node));
+  put(out, "\n");
+  return AST_VISIT_CONTINUE;
+}
+
+static AstVisitResult astOutputDeclVar(AstNodeRef node, int depth,
+                                       void *context) {
+  ZyOutput *out = astOutputIndent(depth, context);
+  char *modifier = nodeHas(node, ZY_FLAT_MUTABLE) ? "var" : "val";
+  put(out, "varDecl ");
+  put(out, modifier);
+  put(out, " ");
+  putToken(out, nodeToken(node));
+  put(out, "\n");
+  /* 子节点是目标、类型标注和可能有的初值 */
+  return AST_VISIT_CONTINUE;
+}
+
+static AstVisitResult astOutputListExpr(AstNodeRef node, int depth,
+                                        void *context) {
+  ZyOutput *out = astOutputIndent(depth, context);
+  put(out, "listExpr(");
+  zy_writeDecimal(out, (uint64_t)nodeNumChild(node));
+  put(out, ")\n");
+  return AST_VISIT_CONTINUE;
+}
+
+static AstVisitResult astOutputListMethod(AstNodeRef node, int depth,
+                                          void *context) {
+  ZyOutput *out = astOutputIndent(depth, context);
+  put(out, "listMethod(");
+  zy_writeDecimal(out, (uint64_t)nodeNumChild(node));
+  put(out, ")\n");
+  return AST_VISIT_CONTINUE;
+}
+
+static AstVisitResult astOutputListStmt(AstNodeRef node, int depth,
+                                        void *context) {
+  ZyOutput *out = astOutputIndent(depth, context);
+  put(out, "listStmt(");
+  zy_writeDecimal(out, (uint64_t)nodeNumChild(node));
+  put(out, ")\n");
+  return AST_VISIT_CONTINUE;
+}
+
+static AstVisitResult astOutputListVar(AstNodeRef node, int depth,
+                                       void *context) {
+  ZyOutput *out = astOutputIndent(depth, context);
+  put(out, "listVar(");
+  zy_writeDecimal(out, (uint64_t)nodeNumChild(node));
+  put(out, ")\n");
+  return AST_VISIT_CONTINUE;
+}
+
+static AstVisitResult astOutputScript(AstNodeRef node, int depth,
+                                      void *context) {
+  put(((AstWriter *)context)->out, "script\n");
+  return AST_VISIT_CONTINUE;
+}
+
+static AstVisitResult astOutputError(AstNodeRef node, int depth,
+                                     void *context) {
+  /* 语法错误处留下的占位节点 */
+  ZyOutput *out = astOutputIndent(depth, context);
+  put(out, "error\n");
+  return AST_VISIT_CONTINUE;
+}
+
+typedef AstVisitResult (*AstOutputFn)(AstNodeRef node, int depth,
+                                      void *context);
+
+/* 每种节点只输出自己这一行，子节点由访问者按顺序进入 */
+static const AstOutputFn astOutputters[AST_KIND_ERROR + 1] = {
+    [AST_KIND_NONE] = astOutputScript,
+    [AST_EXPR_AND] = astOutputExprAnd,
+    [AST_EXPR_ARRAY] = astOutputExprArray,
+    [AST_EXPR_ASSIGN] = astOutputExprAssign,
+    [AST_EXPR_AWAIT] = astOutputExprAwait,
+    [AST_EXPR_BINARY] = astOutputExprBinary,
+    [AST_EXPR_CALL] = astOutputExprCall,
+    [AST_EXPR_CLASS] = astOutputExprClass,
+    [AST_EXPR_COMPREHENSION] = astOutputExprComprehension,
+    [AST_EXPR_DICTIONARY] = astOutputExprDictionary,
+    [AST_EXPR_FUNCTION] = astOutputExprFunction,
+    [AST_EXPR_GROUPING] = astOutputExprGrouping,
+    [AST_EXPR_INVOKE] = astOutputExprInvoke,
+    [AST_EXPR_INTERPOLATION] = astOutputExprInterpolation,
+    [AST_EXPR_LITERAL] = astOutputExprLiteral,
+    [AST_EXPR_NIL] = astOutputExprNil,
+    [AST_EXPR_OR] = astOutputExprOr,
+    [AST_EXPR_PARAM] = astOutputExprParam,
+    [AST_EXPR_PROPERTY_GET] = astOutputExprPropertyGet,
+    [AST_EXPR_PROPERTY_SET] = astOutputExprPropertySet,
+    [AST_EXPR_SET] = astOutputExprSet,
+    [AST_EXPR_SLICE] = astOutputExprSlice,
+    [AST_EXPR_SUBSCRIPT_GET] = astOutputExprSubscriptGet,
+    [AST_EXPR_SUBSCRIPT_SET] = astOutputExprSubscriptSet,
+    [AST_EXPR_SUPER_GET] = astOutputExprSuperGet,
+    [AST_EXPR_SUPER_INVOKE] = astOutputExprSuperInvoke,
+    [AST_EXPR_TERNARY] = astOutputExprTernary,
+    [AST_EXPR_THIS] = astOutputExprThis,
+    [AST_EXPR_TRAIT] = astOutputExprTrait,
+    [AST_EXPR_UNARY] = astOutputExprUnary,
+    [AST_EXPR_VARIABLE] = astOutputExprVariable,
+    [AST_EXPR_YIELD] = astOutputExprYield,
+    [AST_STMT_ASSERT] = astOutputStmtAssert,
+    [AST_STMT_AWAIT] = astOutputStmtAwait,
+    [AST_STMT_BLOCK] = astOutputStmtBlock,
+    [AST_STMT_BREAK] = astOutputStmtBreak,
+    [AST_STMT_CASE] = astOutputStmtCase,
+    [AST_STMT_CATCH] = astOutputStmtCatch,
+    [AST_STMT_CONTINUE] = astOutputStmtContinue,
+    [AST_STMT_DEFAULT] = astOutputStmtDefault,
+    [AST_STMT_DEL] = astOutputStmtDel,
+    [AST_STMT_EXPRESSION] = astOutputStmtExpression,
+    [AST_STMT_FINALLY] = astOutputStmtFinally,
+    [AST_STMT_FOR] = astOutputStmtFor,
+    [AST_STMT_GLOBAL] = astOutputStmtGlobal,
+    [AST_STMT_IF] = astOutputStmtIf,
+    [AST_STMT_PASS] = astOutputStmtPass,
+    [AST_STMT_REQUIRE] = astOutputStmtRequire,
+    [AST_STMT_RETURN] = astOutputStmtReturn,
+    [AST_STMT_SWITCH] = astOutputStmtSwitch,
+    [AST_STMT_THROW] = astOutputStmtThrow,
+    [AST_STMT_TRY] = astOutputStmtTry,
+    [AST_STMT_USING] = astOutputStmtUsing,
+    [AST_STMT_WHILE] = astOutputStmtWhile,
+    [AST_STMT_WITH] = astOutputStmtWith,
+    [AST_STMT_YIELD] = astOutputStmtYield,
+    [AST_DECL_CLASS] = astOutputDeclClass,
+    [AST_DECL_FUN] = astOutputDeclFun,
+    [AST_DECL_METHOD] = astOutputDeclMethod,
+    [AST_DECL_NAMESPACE] = astOutputDeclNamespace,
+    [AST_DECL_TRAIT] = astOutputDeclTrait,
+    [AST_DECL_VAR] = astOutputDeclVar,
+    [AST_LIST_EXPR] = astOutputListExpr,
+    [AST_LIST_METHOD] = astOutputListMethod,
+    [AST_LIST_STMT] = astOutputListStmt,
+    [AST_LIST_VAR] = astOutputListVar,
+    [AST_KIND_ERROR] = astOutputError,
+};
+
+/* JSON 和 S 表达式里节点种类的名字 */
+static const char *const kindNames[AST_KIND_ERROR + 1] = {
+    [AST_KIND_NONE] = "SCRIPT",
+    [AST_EXPR_AND] = "EXPR_AND",
+    [AST_EXPR_ARRAY] = "EXPR_ARRAY",
+    [AST_EXPR_ASSIGN] = "EXPR_ASSIGN",
+    [AST_EXPR_AWAIT] = "EXPR_AWAIT",
+    [AST_EXPR_BINARY] = "EXPR_BINARY",
+    [AST_EXPR_CALL] = "EXPR_CALL",
+    [AST_EXPR_CLASS] = "EXPR_CLASS",
+    [AST_EXPR_COMPREHENSION] = "EXPR_COMPREHENSION",
+    [AST_EXPR_DICTIONARY] = "EXPR_DICTIONARY",
+    [AST_EXPR_FUNCTION] = "EXPR_FUNCTION",
+    [AST_EXPR_GROUPING] = "EXPR_GROUPING",
+    [AST_EXPR_INVOKE] = "EXPR_INVOKE",
+    [AST_EXPR_INTERPOLATION] = "EXPR_INTERPOLATION",
+    [AST_EXPR_LITERAL] = "EXPR_LITERAL",
+    [AST_EXPR_NIL] = "EXPR_NIL",
+    [AST_EXPR_OR] = "EXPR_OR",
+    [AST_EXPR_PARAM] = "EXPR_PARAM",
+    [AST_EXPR_PROPERTY_GET] = "EXPR_PROPERTY_GET",
+    [AST_EXPR_PROPERTY_SET] = "EXPR_PROPERTY_SET",
+    [AST_EXPR_SET] = "EXPR_SET",
+    [AST_EXPR_SLICE] = "EXPR_SLICE",
+    [AST_EXPR_SUBSCRIPT_GET] = "EXPR_SUBSCRIPT_GET",
+    [AST_EXPR_SUBSCRIPT_SET] = "EXPR_SUBSCRIPT_SET",
+    [AST_EXPR_SUPER_GET] = "EXPR_SUPER_GET",
+    [AST_EXPR_SUPER_INVOKE] = "EXPR_SUPER_INVOKE",
+    [AST_EXPR_TERNARY] = "EXPR_TERNARY",
+    [AST_EXPR_THIS] = "EXPR_THIS",
+    [AST_EXPR_TRAIT] = "EXPR_TRAIT",
+    [AST_EXPR_UNARY] = "EXPR_UNARY",
+    [AST_EXPR_VARIABLE] = "EXPR_VARIABLE",
+    [AST_EXPR_YIELD] = "EXPR_YIELD",
+    [AST_STMT_ASSERT] = "STMT_ASSERT",
+    [AST_STMT_AWAIT] = "STMT_AWAIT",
+    [AST_STMT_BLOCK] = "STMT_BLOCK",
+    [AST_STMT_BREAK] = "STMT_BREAK",
+    [AST_STMT_CASE] = "STMT_CASE",
+    [AST_STMT_CATCH] = "STMT_CATCH",
+    [AST_STMT_CONTINUE] = "STMT_CONTINUE",
+    [AST_STMT_DEFAULT] = "STMT_DEFAULT",
+    [AST_STMT_DEL] = "STMT_DEL",
+    [AST_STMT_EXPRESSION] = "STMT_EXPRESSION",
+    [AST_STMT_FINALLY] = "STMT_FINALLY",
+    [AST_STMT_FOR] = "STMT_FOR",
+    [AST_STMT_GLOBAL] = "STMT_GLOBAL",
+    [AST_STMT_IF] = "STMT_IF",
+    [AST_STMT_PASS] = "STMT_PASS",
+    [AST_STMT_REQUIRE] = "STMT_REQUIRE",
+    [AST_STMT_RETURN] = "STMT_RETURN",
+    [AST_STMT_SWITCH] = "STMT_SWITCH",
+    [AST_STMT_THROW] = "STMT_THROW",
+    [AST_STMT_TRY] = "STMT_TRY",
+    [AST_STMT_USING] = "STMT_USING",
+    [AST_STMT_WHILE] = "STMT_WHILE",
+    [AST_STMT_WITH] = "STMT_WITH",
+    [AST_STMT_YIELD] = "STMT_YIELD",
+    [AST_DECL_CLASS] = "DECL_CLASS",
+    [AST_DECL_FUN] = "DECL_FUN",
+    [AST_DECL_METHOD] = "DECL_METHOD",
+    [AST_DECL_NAMESPACE] = "DECL_NAMESPACE",
+    [AST_DECL_TRAIT] = "DECL_TRAIT",
+    [AST_DECL_VAR] = "DECL_VAR",
+    [AST_LIST_EXPR] = "LIST_EXPR",
+    [AST_LIST_METHOD] = "LIST_METHOD",
+    [AST_LIST_STMT] = "LIST_STMT",
+    [AST_LIST_VAR] = "LIST_VAR",
+    [AST_KIND_ERROR] = "ERROR",
+};
+
+/* 与 AstModifier 的字段同名，按 ZyFlatModifier 的位排列 */
+static const char *modifierNames[] = {
+    "async",   "class",    "initializer", "lambda", "lazy",
+    "mutable", "optional", "variadic",    "void",   "yieldFrom",
+};
+
+/*
+ * 子节点之间的分隔：JSON 是逗号，S 表达式换行缩进。first 表示是
+ * 父节点的第一个子节点。
+ */
+static void putSeparator(AstWriter *writer, int depth, bool first) {
+  if (writer->out->format == ZY_FORMAT_JSON) {
+    if (!first)
+      put(writer->out, ",");
+  } else {
+    put(writer->out, "\n");
+    putIndent(writer->out, depth);
   }
 }
 
-static void astOutputStmtThrow(Ast *ast, int indentLevel) {
-  astOutputIndent(indentLevel);
-  printf("throwStmt\n");
-  astOutputChild(ast, indentLevel + 1, 0);
+static void putNull(AstWriter *writer, int depth, bool first) {
+  putSeparator(writer, depth, first);
+  put(writer->out, writer->out->format == ZY_FORMAT_JSON ? "null" : "nil");
 }
 
-static void astOutputStmtTry(Ast *ast, int indentLevel) {
-  astOutputIndent(indentLevel);
-  printf("tryStmt\n");
-  astOutputChild(ast, indentLevel + 1, 0);
-  astOutputChild(ast, indentLevel + 1, 1);
-
-  if (astNumChild(ast) > 2) {
-    astOutputChild(ast, indentLevel + 1, 2);
+/* visitor 不进入为 NULL 的子节点，输出子节点之前先把它们补上 */
+static void putSkippedChildren(AstWriter *writer, int depth, AstNodeRef upTo) {
+  AstOpenNode *parent = &writer->open[depth - 1];
+  int numChild = nodeNumChild(parent->node);
+  while (parent->next < numChild &&
+         !nodeIsSame(nodeChild(parent->node, parent->next), upTo)) {
+    putNull(writer, depth, parent->next == 0);
+    parent->next++;
   }
 }
 
-static void astOutputStmtUsing(Ast *ast, int indentLevel) {
-  astOutputIndent(indentLevel);
-  Ast *identifiers = astGetChild(ast, 0);
-  Ast *identifier = astGetChild(identifiers, 0);
-  char *name = tokenToCString(identifier->token);
-  printf("usingStmt %s", name);
-  free(name);
-
-  for (int i = 1; i < identifiers->children->count; i++) {
-    identifier = astGetChild(identifiers, i);
-    name = tokenToCString(identifier->token);
-    printf(".%s", name);
-    free(name);
+/* JSON 和 S 表达式对所有种类的节点都一样 */
+static AstVisitResult enterTree(AstNodeRef node, int depth, void *context) {
+  AstWriter *writer = (AstWriter *)context;
+  ZyOutput *out = writer->out;
+  if (depth >= writer->capacity) {
+    writer->capacity = writer->capacity < 64 ? 64 : writer->capacity * 2;
+    writer->open = (AstOpenNode *)realloc(
+        writer->open, sizeof(AstOpenNode) * writer->capacity);
+    if (writer->open == NULL) {
+      fprintf(stderr, "Not enough memory to write the AST.");
+      exit(1);
+    }
   }
-
-  if (astNumChild(ast) > 1) {
-    Ast *alias = astGetChild(ast, 1);
-    name = tokenToCString(alias->token);
-    printf(" as %s", name);
-    free(name);
+  if (depth > 0) {
+    putSkippedChildren(writer, depth, node);
+    putSeparator(writer, depth, writer->open[depth - 1].next++ == 0);
+  }
+  writer->open[depth].node = node;
+  writer->open[depth].next = 0;
+
+  bool json = out->format == ZY_FORMAT_JSON;
+  ZyToken token = nodeToken(node);
+  put(out, json ? "{\"kind\":\"" : "(");
+  put(out, kindNames[nodeKind(node)]);
+  if (token.start != NULL) {
+    if (json) {
+      put(out, "\",\"token\":{\"type\":\"");
+      put(out, zy_tokenTypeName(token.type));
+      if (writer->src != NULL) {
+        put(out, "\",\"offset\":");
+        zy_writeDecimal(out, (uint64_t)(token.start - writer->src));
+        put(out, ",\"text\":");
+      } else {
+        put(out, "\",\"text\":");
+      }
+      zy_writeJsonString(out, token.start, token.length);
+      put(out, "}");
+    } else {
+      put(out, " ");
+      zy_writeJsonString(out, token.start, token.length);
+    }
+  } else if (json) {
+    put(out, "\"");
   }
-  printf("\n");
-}
-
-static void astOutputStmtWhile(Ast *ast, int indentLevel) {
-  astOutputIndent(indentLevel);
-  printf("whileStmt\n");
-  astOutputChild(ast, indentLevel + 1, 0);
-  astOutputChild(ast, indentLevel + 1, 1);
-}
-
-static void astOutputStmtYield(Ast *ast, int indentLevel) {
-  astOutputIndent(indentLevel);
-  char *modifier = ast->modifier.isYieldFrom ? " from" : "";
-  printf("yieldStmt%s\n", modifier);
 
-  if (astHasChild(ast)) {
-    astOutputChild(ast, indentLevel + 1, 0);
+  int bits = nodeModifiers(node);
+  if (bits != 0) {
+    bool first = true;
+    if (json)
+      put(out, ",\"modifiers\":[");
+    for (int i = 0; bits != 0; i++, bits >>= 1) {
+      if (!(bits & 1))
+        continue;
+      put(out, json ? (first ? "\"" : ",\"") : " :");
+      put(out, modifierNames[i]);
+      if (json)
+        put(out, "\"");
+      first = false;
+    }
+    if (json)
+      put(out, "]");
   }
+  if (json && nodeNumChild(node) > 0)
+    put(out, ",\"children\":[");
+  return AST_VISIT_CONTINUE;
+}
+
+static AstVisitResult leaveTree(AstNodeRef node, int depth, void *context) {
+  AstWriter *writer = (AstWriter *)context;
+  AstOpenNode *open = &writer->open[depth];
+  int numChild = nodeNumChild(node);
+  while (open->next < numChild) {
+    putNull(writer, depth + 1, open->next == 0);
+    open->next++;
+  }
+  if (writer->out->format == ZY_FORMAT_JSON)
+    put(writer->out, numChild > 0 ? "]}" : "}");
+  else
+    put(writer->out, ")");
+  if (depth == 0)
+    put(writer->out, "\n");
+  return AST_VISIT_CONTINUE;
 }
 
-static void astOutputDeclClass(Ast *ast, int indentLevel) {
-  astOutputIndent(indentLevel);
-  char *className = tokenToCString(ast->token);
-  printf("classDecl %s\n", className);
-  astOutputChild(ast, indentLevel + 1, 0);
-  free(className);
+/* 两种树各有自己的访问者，取出节点后交给同一套输出函数 */
+static AstVisitResult enterHumanAst(Ast *ast, int depth, void *context) {
+  return astOutputters[ast->kind](nodeOfAst(ast), depth, context);
 }
 
-static void astOutputDeclFun(Ast *ast, int indentLevel) {
-  astOutputIndent(indentLevel);
-  char *async = ast->modifier.isAsync ? "async " : "";
-  char *_void = ast->modifier.isVoid ? "void " : "";
-  char *funName = tokenToCString(ast->token);
-  printf("funDecl %s%s%s", async, _void, funName);
-
-  if (astNumChild(ast) > 1) {
-    Ast *returnType = astGetChild(ast, 1);
-    char *returnTypeName = tokenToCString(returnType->token);
-    printf("(%s)", returnTypeName);
-    free(returnTypeName);
-  }
-
-  printf("\n");
-  astOutputChild(ast, indentLevel + 1, 0);
-  free(funName);
+static AstVisitResult enterTreeAst(Ast *ast, int depth, void *context) {
+  return enterTree(nodeOfAst(ast), depth, context);
 }
 
-static void astOutputDeclMethod(Ast *ast, int indentLevel) {
-  astOutputIndent(indentLevel);
-  char *async = ast->modifier.isAsync ? "async " : "";
-  char *_class = ast->modifier.isClass ? "class " : "";
-  char *_void = ast->modifier.isVoid ? "void " : "";
-  char *methodName = tokenToCString(ast->token);
-  printf("methodDecl %s%s%s%s", async, _class, _void, methodName);
-
-  if (astNumChild(ast) > 2) {
-    Ast *returnType = astGetChild(ast, 2);
-    char *returnTypeName = tokenToCString(returnType->token);
-    printf("(%s)", returnTypeName);
-    free(returnTypeName);
-  }
-
-  printf("\n");
-  astOutputChild(ast, indentLevel + 1, 0);
-  astOutputChild(ast, indentLevel + 1, 1);
-  free(methodName);
-}
-
-static void astOutputDeclNamespace(Ast *ast, int indentLevel) {
-  astOutputIndent(indentLevel);
-  Ast *identifiers = astGetChild(ast, 0);
-  Ast *identifier = astGetChild(identifiers, 0);
-  char *name = tokenToCString(identifier->token);
-  printf("namespaceDecl %s", name);
-  free(name);
-
-  for (int i = 1; i < identifiers->children->count; i++) {
-    identifier = astGetChild(identifiers, i);
-    name = tokenToCString(identifier->token);
-    printf(".%s", name);
-    free(name);
-  }
-  printf("\n");
+static AstVisitResult leaveTreeAst(Ast *ast, int depth, void *context) {
+  return leaveTree(nodeOfAst(ast), depth, context);
 }
 
-static void astOutputDeclTrait(Ast *ast, int indentLevel) {
-  astOutputIndent(indentLevel);
-  char *traitName = tokenToCString(ast->token);
-  printf("traitDecl %s\n", traitName);
-  astOutputChild(ast, indentLevel + 1, 0);
-  free(traitName);
+static AstVisitResult enterHumanFlat(const ZyFlatAst *tree, uint32_t node,
+                                     int depth, void *context) {
+  return astOutputters[tree->nodes[node].kind](nodeOfFlat(tree, node), depth,
+                                               context);
 }
 
-static void astOutputDeclVar(Ast *ast, int indentLevel) {
-  astOutputIndent(indentLevel);
-  char *modifier = ast->modifier.isMutable ? "var" : "val";
-  char *varName = tokenToCString(ast->token);
-  printf("varDecl %s %s\n", modifier, varName);
-
-  if (astHasChild(ast)) {
-    astOutputChild(ast, indentLevel + 1, 0);
-  }
-  free(varName);
+static AstVisitResult enterTreeFlat(const ZyFlatAst *tree, uint32_t node,
+                                    int depth, void *context) {
+  return enterTree(nodeOfFlat(tree, node), depth, context);
 }
 
-static void astOutputListExpr(Ast *ast, int indentLevel) {
-  astOutputIndent(indentLevel);
-  printf("listExpr(%d)\n", astNumChild(ast));
-  for (int i = 0; i < ast->children->count; i++) {
-    astOutput(astGetChild(ast, i), indentLevel + 1);
-  }
+static AstVisitResult leaveTreeFlat(const ZyFlatAst *tree, uint32_t node,
+                                    int depth, void *context) {
+  return leaveTree(nodeOfFlat(tree, node), depth, context);
 }
 
-static void astOutputListMethod(Ast *ast, int indentLevel) {
-  astOutputIndent(indentLevel);
-  printf("listMethod(%d)\n", astNumChild(ast));
-  for (int i = 0; i < ast->children->count; i++) {
-    astOutput(astGetChild(ast, i), indentLevel + 1);
-  }
+static bool isTreeFormat(ZyOutput *out) {
+  return out->format == ZY_FORMAT_JSON || out->format == ZY_FORMAT_SEXP;
 }
 
-static void astOutputListStmt(Ast *ast, int indentLevel) {
-  astOutputIndent(indentLevel);
-  printf("listStmt(%d)\n", astNumChild(ast));
-  for (int i = 0; i < ast->children->count; i++) {
-    astOutput(ast->children->elements[i], indentLevel + 1);
-  }
+static void writeAst(ZyOutput *out, Ast *ast, const char *src,
+                     int indentLevel) {
+  AstWriter writer = {};
+  writer.out = out;
+  writer.src = src;
+  writer.indentLevel = indentLevel;
+  AstVisitor visitor;
+  astInitVisitor(&visitor, &writer);
+  if (isTreeFormat(out))
+    astVisitEvery(&visitor, enterTreeAst, leaveTreeAst);
+  else
+    astVisitEvery(&visitor, enterHumanAst, NULL);
+  astVisit(ast, &visitor);
+  free(writer.open);
+  /* 解码出来的字符串只在输出时用到 */
+  zy_freeArena(&literalArena);
 }
 
-static void astOutputListVar(Ast *ast, int indentLevel) {
-  astOutputIndent(indentLevel);
-  printf("listVar(%d)\n", astNumChild(ast));
-  for (int i = 0; i < ast->children->count; i++) {
-    astOutput(ast->children->elements[i], indentLevel + 1);
-  }
+/*
+ * JSON 是一个嵌套的对象：种类、token（类型、偏移和文本）、修饰符和
+ * 子节点，空的子节点是 null。S 表达式每个节点一行：
+ * `(种类 "token" :修饰符 子节点...)`，空的子节点是 nil。
+ */
+void astWrite(ZyOutput *out, Ast *ast, const char *src) {
+  writeAst(out, ast, src, 0);
 }
 
-static void astOutputScript(Ast *ast, int indentLevel) {
-  printf("script\n");
-  if (astHasChild(ast)) {
-    for (int i = 0; i < ast->children->count; i++) {
-      astOutput(ast->children->elements[i], indentLevel + 1);
-    }
-  }
+void astWriteFlat(ZyOutput *out, const ZyFlatAst *tree, uint32_t root) {
+  AstWriter writer = {};
+  writer.out = out;
+  writer.src = tree->src;
+  AstFlatVisitor visitor;
+  astInitFlatVisitor(&visitor, &writer);
+  if (isTreeFormat(out))
+    astVisitFlatEvery(&visitor, enterTreeFlat, leaveTreeFlat);
+  else
+    astVisitFlatEvery(&visitor, enterHumanFlat, NULL);
+  astVisitFlat(tree, root, &visitor);
+  free(writer.open);
+  zy_freeArena(&literalArena);
 }
 
+/* 调试用：按 human 格式输出到标准输出 */
 void astOutput(Ast *ast, int indentLevel) {
-  switch (ast->category) {
-  case AST_CATEGORY_SCRIPT:
-    astOutputScript(ast, indentLevel);
-    break;
-  case AST_CATEGORY_EXPR: {
-    switch (ast->kind) {
-    case AST_EXPR_AND:
-      astOutputExprAnd(ast, indentLevel);
-      break;
-    case AST_EXPR_ARRAY:
-      astOutputExprArray(ast, indentLevel);
-      break;
-    case AST_EXPR_ASSIGN:
-      astOutputExprAssign(ast, indentLevel);
-      break;
-    case AST_EXPR_AWAIT:
-      astOutputExprAwait(ast, indentLevel);
-      break;
-    case AST_EXPR_BINARY:
-      astOutputExprBinary(ast, indentLevel);
-      break;
-    case AST_EXPR_CALL:
-      astOutputExprCall(ast, indentLevel);
-      break;
-    case AST_EXPR_CLASS:
-      astOutputExprClass(ast, indentLevel);
-      break;
-    case AST_EXPR_DICTIONARY:
-      astOutputExprDictionary(ast, indentLevel);
-      break;
-    case AST_EXPR_FUNCTION:
-      astOutputExprFunction(ast, indentLevel);
-      break;
-    case AST_EXPR_GROUPING:
-      astOutputExprGrouping(ast, indentLevel);
-      break;
-    case AST_EXPR_INVOKE:
-      astOutputExprInvoke(ast, indentLevel);
-      break;
-    case AST_EXPR_INTERPOLATION:
-      astOutputExprInterpolation(ast, indentLevel);
-      break;
-    case AST_EXPR_LITERAL:
-      astOutputExprLiteral(ast, indentLevel);
-      break;
-    case AST_EXPR_NIL:
-      astOutputExprNil(ast, indentLevel);
-      break;
-    case AST_EXPR_OR:
-      astOutputExprOr(ast, indentLevel);
-      break;
-    case AST_EXPR_PARAM:
-      astOutputExprParam(ast, indentLevel);
-      break;
-    case AST_EXPR_PROPERTY_GET:
-      astOutputExprPropertyGet(ast, indentLevel);
-      break;
-    case AST_EXPR_PROPERTY_SET:
-      astOutputExprPropertySet(ast, indentLevel);
-      break;
-    case AST_EXPR_SUBSCRIPT_GET:
-      astOutputExprSubscriptGet(ast, indentLevel);
-      break;
-    case AST_EXPR_SUBSCRIPT_SET:
-      astOutputExprSubscriptSet(ast, indentLevel);
-      break;
-    case AST_EXPR_SUPER_GET:
-      astOutputExprSuperGet(ast, indentLevel);
-      break;
-    case AST_EXPR_SUPER_INVOKE:
-      astOutputExprSuperInvoke(ast, indentLevel);
-      break;
-    case AST_EXPR_THIS:
-      astOutputExprThis(ast, indentLevel);
-      break;
-    case AST_EXPR_TRAIT:
-      astOutputExprTrait(ast, indentLevel);
-      break;
-    case AST_EXPR_UNARY:
-      astOutputExprUnary(ast, indentLevel);
-      break;
-    case AST_EXPR_VARIABLE:
-      astOutputExprVariable(ast, indentLevel);
-      break;
-    case AST_EXPR_YIELD:
-      astOutputExprYield(ast, indentLevel);
-      break;
-    default:
-      return;
-    }
-  }
-  case AST_CATEGORY_STMT: {
-    switch (ast->kind) {
-    case AST_STMT_AWAIT:
-      astOutputStmtAwait(ast, indentLevel);
-      break;
-    case AST_STMT_BLOCK:
-      astOutputStmtBlock(ast, indentLevel);
-      break;
-    case AST_STMT_BREAK:
-      astOutputStmtBreak(ast, indentLevel);
-      break;
-    case AST_STMT_CASE:
-      astOutputStmtCase(ast, indentLevel);
-      break;
-    case AST_STMT_CATCH:
-      astOutputStmtCatch(ast, indentLevel);
-      break;
-    case AST_STMT_CONTINUE:
-      astOutputStmtContinue(ast, indentLevel);
-      break;
-    case AST_STMT_DEFAULT:
-      astOutputStmtDefault(ast, indentLevel);
-      break;
-    case AST_STMT_EXPRESSION:
-      astOutputStmtExpression(ast, indentLevel);
-      break;
-    case AST_STMT_FOR:
-      astOutputStmtFor(ast, indentLevel);
-      break;
-    case AST_STMT_IF:
-      astOutputStmtIf(ast, indentLevel);
-      break;
-    case AST_STMT_REQUIRE:
-      astOutputStmtRequire(ast, indentLevel);
-      break;
-    case AST_STMT_RETURN:
-      astOutputStmtReturn(ast, indentLevel);
-      break;
-    case AST_STMT_SWITCH:
-      astOutputStmtSwitch(ast, indentLevel);
-      break;
-    case AST_STMT_THROW:
-      astOutputStmtThrow(ast, indentLevel);
-      break;
-    case AST_STMT_TRY:
-      astOutputStmtTry(ast, indentLevel);
-      break;
-    case AST_STMT_USING:
-      astOutputStmtUsing(ast, indentLevel);
-      break;
-    case AST_STMT_WHILE:
-      astOutputStmtWhile(ast, indentLevel);
-      break;
-    case AST_STMT_YIELD:
-      astOutputStmtYield(ast, indentLevel);
-      break;
-    default:
-      return;
-    }
-  }
-  case AST_CATEGORY_DECL: {
-    switch (ast->kind) {
-    case AST_DECL_CLASS:
-      astOutputDeclClass(ast, indentLevel);
-      break;
-    case AST_DECL_FUN:
-      astOutputDeclFun(ast, indentLevel);
-      break;
-    case AST_DECL_METHOD:
-      astOutputDeclMethod(ast, indentLevel);
-      break;
-    case AST_DECL_NAMESPACE:
-      astOutputDeclNamespace(ast, indentLevel);
-      break;
-    case AST_DECL_TRAIT:
-      astOutputDeclTrait(ast, indentLevel);
-      break;
-    case AST_DECL_VAR:
-      astOutputDeclVar(ast, indentLevel);
-      break;
-    default:
-      return;
-    }
-  }
-  case AST_CATEGORY_OTHER: {
-    switch (ast->kind) {
-    case AST_LIST_EXPR:
-      astOutputListExpr(ast, indentLevel);
-      break;
-    case AST_LIST_METHOD:
-      astOutputListMethod(ast, indentLevel);
-      break;
-    case AST_LIST_STMT:
-      astOutputListStmt(ast, indentLevel);
-      break;
-    case AST_LIST_VAR:
-      astOutputListVar(ast, indentLevel);
-      break;
-    default:
-      return;
-    }
-  }
-  default:
-    return;
-  }
-}
\ No newline at end of file
+  ZyOutput out;
+  fflush(stdout);
+  zy_openOutput(&out, STDOUT_FILENO, ZY_FORMAT_HUMAN);
+  writeAst(&out, ast, NULL, indentLevel);
+  zy_closeOutput(&out);
+}
@@ -1,3 +1,7 @@
+#pragma once
+
+#include "arena.h"
+#include "output.h"
 #include "scanner.h"
 #include "stdbool.h"
 
@@ -33,6 +37,7 @@ typedef enum {
   AST_EXPR_BINARY,
   AST_EXPR_CALL,
   AST_EXPR_CLASS,
+  AST_EXPR_COMPREHENSION,
   AST_EXPR_DICTIONARY,
   AST_EXPR_FUNCTION,
   AST_EXPR_GROUPING,
@@ -44,15 +49,19 @@ typedef enum {
   AST_EXPR_PARAM,
   AST_EXPR_PROPERTY_GET,
   AST_EXPR_PROPERTY_SET,
+  AST_EXPR_SET,
+  AST_EXPR_SLICE,
   AST_EXPR_SUBSCRIPT_GET,
   AST_EXPR_SUBSCRIPT_SET,
   AST_EXPR_SUPER_GET,
   AST_EXPR_SUPER_INVOKE,
+  AST_EXPR_TERNARY,
   AST_EXPR_THIS,
   AST_EXPR_TRAIT,
   AST_EXPR_UNARY,
   AST_EXPR_VARIABLE,
   AST_EXPR_YIELD,
+  AST_STMT_ASSERT,
   AST_STMT_AWAIT,
   AST_STMT_BLOCK,
   AST_STMT_BREAK,
@@ -60,10 +69,13 @@ typedef enum {
   AST_STMT_CATCH,
   AST_STMT_CONTINUE,
   AST_STMT_DEFAULT,
+  AST_STMT_DEL,
   AST_STMT_EXPRESSION,
   AST_STMT_FINALLY,
   AST_STMT_FOR,
+  AST_STMT_GLOBAL,
   AST_STMT_IF,
+  AST_STMT_PASS,
   AST_STMT_REQUIRE,
   AST_STMT_RETURN,
   AST_STMT_SWITCH,
@@ -71,6 +83,7 @@ typedef enum {
   AST_STMT_TRY,
   AST_STMT_USING,
   AST_STMT_WHILE,
+  AST_STMT_WITH,
   AST_STMT_YIELD,
   AST_DECL_CLASS,
   AST_DECL_FUN,
@@ -90,6 +103,7 @@ typedef struct {
   bool isClass;
   bool isInitializer;
   bool isLambda;
+  bool isLazy; /* 还没有解析的函数体，见 zy_functionBody */
   bool isMutable;
   bool isOptional;
   bool isVariadic;
@@ -97,14 +111,20 @@ typedef struct {
   bool isYieldFrom;
 } AstModifier;
 
+/* 子节点不超过这么多个时直接放在节点里，不另外分配 */
+#define AST_INLINE_CHILDREN 3
+
 struct Ast {
   AstNodeCategory category;
   AstNodeKind kind;
   AstModifier modifier;
+  bool inArena; /* 在 AstArena 里分配的，freeAst 不管它 */
   ZyToken token;
   Ast *parent;
   Ast *sibling;
-  AstArray *children;
+  /* elements 指向下面的 inlineChildren，放不下时才换成堆上的数组 */
+  AstArray children;
+  Ast *inlineChildren[AST_INLINE_CHILDREN];
 };
 
 static inline AstModifier astInitModifier() {
@@ -113,6 +133,7 @@ static inline AstModifier astInitModifier() {
   m.isClass = false;
   m.isInitializer = false;
   m.isLambda = false;
+  m.isLazy = false;
   m.isMutable = false;
   m.isOptional = false;
   m.isVariadic = false;
@@ -121,23 +142,47 @@ static inline AstModifier astInitModifier() {
   return m;
 }
 
+/**
+ * @brief Bump allocator for all the nodes of one compilation unit.
+ *
+ * While an arena is selected with @ref astUseArena, emptyAst takes
+ * the node from it, and child arrays that outgrow the node go there
+ * too. freeAst leaves such nodes alone; @ref astFreeArena releases
+ * the whole tree with a handful of free calls. A tree must not mix
+ * arena and malloc nodes, and its arena must be selected whenever
+ * children are added to it.
+ */
+typedef struct {
+  ZyArena arena;
+  size_t nodes; /**< @brief Nodes allocated so far. */
+} AstArena;
+
+void astInitArena(AstArena *arena);
+void astFreeArena(AstArena *arena);
+void astMergeArena(AstArena *into, AstArena *from);
+AstArena *astUseArena(AstArena *arena);
+AstArena *astCurrentArena(void);
+
 Ast *emptyAst(AstNodeKind kind, ZyToken token);
 Ast *newAst(AstNodeKind kind, ZyToken token, int numChildren, ...);
 void freeAst(Ast *node, bool freeChildren);
 void astAppendChild(Ast *ast, Ast *child);
+Ast *astReplaceChild(Ast *ast, int index, Ast *child);
 Ast *astFirstChild(Ast *ast);
 Ast *astGetChild(Ast *ast, int index);
 bool astHasChild(Ast *ast);
 Ast *astLastChild(Ast *ast);
 int astNumChild(Ast *ast);
 void astOutput(Ast *ast, int indentLevel);
+/* 按 out->format（human、json、sexp）输出整棵树，token 的偏移从 src 算起 */
+void astWrite(ZyOutput *out, Ast *ast, const char *src);
 
 static inline AstNodeCategory astNodeCategory(AstNodeKind kind) {
   if (kind == AST_KIND_NONE)
     return AST_CATEGORY_SCRIPT;
   else if (kind >= AST_EXPR_AND && kind <= AST_EXPR_YIELD)
     return AST_CATEGORY_EXPR;
-  else if (kind >= AST_STMT_AWAIT && kind <= AST_STMT_YIELD)
+  else if (kind >= AST_STMT_ASSERT && kind <= AST_STMT_YIELD)
     return AST_CATEGORY_STMT;
   else if (kind >= AST_DECL_CLASS && kind <= AST_DECL_VAR)
     return AST_CATEGORY_DECL;
@@ -0,0 +1,304 @@
+#pragma once
+
+/*
+ * 基准测试的公共工具：计时、读文件和生成测试语料。
+ * 每个 bench_*.c 都是一个独立的程序，由 `make bench` 构建。
+ */
+
+#include <stdarg.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "ast.h"
+
+typedef struct {
+  char *data;
+  size_t length;
+  size_t capacity;
+} BenchBuffer;
+
+static inline double benchNow(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+}
+
+/* 把 body 跑 repeat 次，best 取其中最快的一次 */
+#define BEST_OF(best, repeat, body)                                            \
+  for (int i_ = 0; i_ < (repeat); i_++) {                                      \
+    double start_ = benchNow();                                                \
+    body;                                                                      \
+    double elapsed_ = benchNow() - start_;                                     \
+    if (elapsed_ < (best))                                                     \
+      (best) = elapsed_;                                                       \
+  }
+
+static inline void benchReserve(BenchBuffer *buffer, size_t extra) {
+  if (buffer->length + extra + 1 <= buffer->capacity)
+    return;
+  size_t capacity = buffer->capacity < 4096 ? 4096 : buffer->capacity;
+  while (capacity < buffer->length + extra + 1)
+    capacity *= 2;
+  buffer->data = (char *)realloc(buffer->data, capacity);
+  if (buffer->data == NULL) {
+    fprintf(stderr, "Out of memory while building benchmark corpus.\n");
+    exit(1);
+  }
+  buffer->capacity = capacity;
+}
+
+static inline void benchAppend(BenchBuffer *buffer, const char *text) {
+  size_t length = strlen(text);
+  benchReserve(buffer, length);
+  memcpy(buffer->data + buffer->length, text, length);
+  buffer->length += length;
+  buffer->data[buffer->length] = '\0';
+}
+
+static inline void benchAppendf(BenchBuffer *buffer, const char *fmt, ...) {
+  char line[512];
+  va_list args;
+  va_start(args, fmt);
+  vsnprintf(line, sizeof(line), fmt, args);
+  va_end(args);
+  benchAppend(buffer, line);
+}
+
+static inline void benchFree(BenchBuffer *buffer) {
+  free(buffer->data);
+  buffer->data = NULL;
+  buffer->length = buffer->capacity = 0;
+}
+
+/* 读入整个文件并以`\0`结尾，失败时退出 */
+static inline BenchBuffer benchReadFile(const char *filename) {
+  BenchBuffer buffer = {};
+  FILE *file = fopen(filename, "rb");
+  if (file == NULL) {
+    perror("Error opening file");
+    exit(1);
+  }
+  char chunk[65536];
+  size_t n;
+  while ((n = fread(chunk, 1, sizeof(chunk), file)) > 0) {
+    benchReserve(&buffer, n);
+    memcpy(buffer.data + buffer.length, chunk, n);
+    buffer.length += n;
+    buffer.data[buffer.length] = '\0';
+  }
+  fclose(file);
+  return buffer;
+}
+
+/*
+ * 生成一份模仿机器生成代码的语料：长注释横幅、深缩进、
+ * 多 KB 的三引号字符串，以及普通的语句。
+ */
+static inline BenchBuffer benchGeneratedCorpus(size_t targetBytes) {
+  BenchBuffer buffer = {};
+  for (int block = 0; buffer.length < targetBytes; block++) {
+    benchAppend(&buffer, "#############################################"
+                         "###################################\n");
+    benchAppendf(&buffer, "# Generated section %d -- do not edit by hand\n",
+                 block);
+    benchAppend(&buffer, "#############################################"
+                         "###################################\n");
+    benchAppendf(&buffer, "class Generated%d:\n", block);
+    benchAppend(&buffer, "    \"\"\"\n");
+    for (int i = 0; i < 48; i++)
+      benchAppend(&buffer, "    Lorem ipsum dolor sit amet, consectetur "
+                           "adipiscing elit, sed do eiusmod tempor.\n");
+    benchAppend(&buffer, "    \"\"\"\n");
+    benchAppendf(&buffer, "    def method_%d(self, value, other=None):\n",
+                 block);
+    for (int i = 0; i < 16; i++) {
+      benchAppendf(&buffer,
+                   "                        result_%d = value + %d * other"
+                   "  # trailing comment %d\n",
+                   i, i, i);
+      benchAppendf(&buffer,
+                   "                        label_%d = \"item %d of the "
+                   "generated table\"\n",
+                   i, i);
+    }
+    benchAppend(&buffer, "        return result_0\n\n");
+  }
+  return buffer;
+}
+
+/*
+ * 生成一份以普通代码为主的语料：函数、类、条件、循环、
+ * 各种运算符、调用和下标，内容都是合法的 zython 代码。
+ */
+static inline BenchBuffer benchCodeCorpus(size_t targetBytes) {
+  BenchBuffer buffer = {};
+  for (int block = 0; buffer.length < targetBytes; block++) {
+    benchAppendf(&buffer, "def compute_%d(values, scale=2, *args):\n", block);
+    benchAppend(&buffer, "    total = 0\n");
+    benchAppend(&buffer, "    for i in range(len(values)):\n");
+    benchAppend(&buffer, "        x = values[i] * scale + (i << 2) - 7\n");
+    benchAppend(&buffer, "        if x >= 10 and not (x % 3 == 0):\n");
+    benchAppend(&buffer, "            total += x ** 2 // 5\n");
+    benchAppend(&buffer, "        elif x != 4 or i <= 1:\n");
+    benchAppend(&buffer, "            total -= x & 0xff | 0b1010\n");
+    benchAppend(&buffer, "        else:\n");
+    benchAppend(&buffer, "            total = total if total > 0 else -x\n");
+    benchAppend(&buffer, "    return total\n\n");
+    benchAppendf(&buffer, "class Shape%d(Base):\n", block);
+    benchAppend(&buffer, "    def __init__(self, width, height):\n");
+    benchAppend(&buffer, "        self.width = width\n");
+    benchAppend(&buffer, "        self.height = height\n");
+    benchAppend(&buffer, "        self.items = [1, 2.5, 3e10, 'name', \"x\"]\n\n");
+    benchAppend(&buffer, "    def area(self):\n");
+    benchAppend(&buffer, "        return self.width * self.height / 2.0\n\n");
+    benchAppend(&buffer, "    def describe(self, other):\n");
+    benchAppend(&buffer, "        data = {'w': self.width, 'h': self.height}\n");
+    benchAppend(&buffer, "        while other is not None:\n");
+    benchAppend(&buffer, "            other = other.next\n");
+    benchAppend(&buffer, "        return lambda k: data[k] + compute_0([k])\n\n");
+    benchAppendf(&buffer, "result_%d = compute_%d([1, 2, 3], scale=4)\n\n",
+                 block, block);
+  }
+  return buffer;
+}
+
+/*
+ * 生成一份数据文件式的语料：大量的数值表，包括可往返的浮点数、
+ * 短小数、科学记数法、整数、带下划线的整数和十六进制数。
+ */
+static inline BenchBuffer benchNumericCorpus(size_t targetBytes) {
+  BenchBuffer buffer = {};
+  uint64_t state = 0x9E3779B97F4A7C15ULL;
+  for (int block = 0; buffer.length < targetBytes; block++) {
+    benchAppendf(&buffer, "table_%d = [\n", block);
+    for (int row = 0; row < 64; row++) {
+      benchAppend(&buffer, "   ");
+      for (int column = 0; column < 6; column++) {
+        state = state * 6364136223846793005ULL + 1442695040888963407ULL;
+        uint64_t r = state >> 11;
+        double unit = (double)r / (double)(1ULL << 53);
+        switch ((row + column) % 6) {
+        case 0:
+          benchAppendf(&buffer, " %.17g,", unit * 1000.0);
+          break;
+        case 1:
+          benchAppendf(&buffer, " %.3f,", unit * 100.0);
+          break;
+        case 2:
+          benchAppendf(&buffer, " %.6e,", unit * 1e-5);
+          break;
+        case 3:
+          benchAppendf(&buffer, " %llu,", (unsigned long long)(r % 100000));
+          break;
+        case 4:
+          benchAppendf(&buffer, " %llu_%03llu_%03llu,",
+                       (unsigned long long)(r % 1000),
+                       (unsigned long long)(r / 1000 % 1000),
+                       (unsigned long long)(r / 1000000 % 1000));
+          break;
+        default:
+          benchAppendf(&buffer, " 0x%llx,", (unsigned long long)(r >> 20));
+          break;
+        }
+      }
+      benchAppend(&buffer, "\n");
+    }
+    benchAppend(&buffer, "]\n\n");
+  }
+  return buffer;
+}
+
+/*
+ * 生成一份嵌入大量字符串的数据文件式语料。每行是一对内容相同的
+ * 字符串：前一个不带转义（多行时用三引号），后一个把其中一些字符
+ * 写成 `\x`、`\u`、`\n` 之类的转义，解码后两者应当完全一样。
+ */
+static inline BenchBuffer benchStringCorpus(size_t targetBytes) {
+  static const char *words[] = {
+      "alpha", "beta",  "gamma", "delta",   "config", "value", "path",
+      "/usr",  "local", "share", "message", "error",  "ok",    "42",
+  };
+  BenchBuffer buffer = {};
+  uint64_t state = 0x2545F4914F6CDD1DULL;
+  for (int block = 0; buffer.length < targetBytes; block++) {
+    benchAppendf(&buffer, "strings_%d = [\n", block);
+    for (int row = 0; row < 64; row++) {
+      char plain[4096], escaped[8192];
+      size_t p = 0, e = 0;
+      int multiline = row % 16 == 0;
+      int count = multiline ? 200 : 4 + row % 12;
+      for (int w = 0; w < count; w++) {
+        state = state * 6364136223846793005ULL + 1442695040888963407ULL;
+        const char *word = words[(state >> 33) % 14];
+        int escapeWord = (state >> 20) % 4 == 0;
+        for (const char *c = word; *c != '\0'; c++) {
+          plain[p++] = *c;
+          if (escapeWord && c == word)
+            e += (size_t)sprintf(escaped + e, "\\x%02x", *c);
+          else if (escapeWord && c[1] == '\0')
+            e += (size_t)sprintf(escaped + e, "\\u%04x", *c);
+          else
+            escaped[e++] = *c;
+        }
+        char separator = (multiline && w % 10 == 9) ? '\n' : ' ';
+        plain[p++] = separator;
+        if (separator == '\n')
+          e += (size_t)sprintf(escaped + e, "\\n");
+        else
+          escaped[e++] = ' ';
+      }
+      plain[p] = escaped[e] = '\0';
+      benchAppend(&buffer, multiline ? "    (\"\"\"" : "    (\"");
+      benchAppend(&buffer, plain);
+      benchAppend(&buffer, multiline ? "\"\"\", \"" : "\", \"");
+      benchAppend(&buffer, escaped);
+      benchAppend(&buffer, "\"),\n");
+    }
+    benchAppend(&buffer, "]\n\n");
+  }
+  return buffer;
+}
+
+/*
+ * 生成一份非 ASCII 内容较多的语料：中文注释、希腊字母和带重音的
+ * 标识符、各种文字的字符串，都是合法的 UTF-8。
+ */
+static inline BenchBuffer benchUnicodeCorpus(size_t targetBytes) {
+  BenchBuffer buffer = {};
+  for (int block = 0; buffer.length < targetBytes; block++) {
+    benchAppendf(&buffer, "# 第 %d 节：计算面积和周长\n", block);
+    benchAppendf(&buffer, "def fläche_%d(breite, höhe):\n", block);
+    benchAppend(&buffer, "    \"\"\"返回矩形的面积。Возвращает площадь.\"\"\"\n");
+    benchAppend(&buffer, "    π = 3.14159  # 圆周率\n");
+    benchAppend(&buffer, "    résultat = breite * höhe\n");
+    benchAppend(&buffer, "    if résultat > 0:\n");
+    benchAppend(&buffer, "        名字 = 'größe' + \"🙂\" + '寸法'\n");
+    benchAppend(&buffer, "        return résultat, 名字, π\n");
+    benchAppend(&buffer, "    return 0\n\n");
+    benchAppendf(&buffer, "class Форма%d:\n", block);
+    benchAppend(&buffer, "    def __init__(self, α, β):\n");
+    benchAppend(&buffer, "        self.α = α  # première valeur\n");
+    benchAppend(&buffer, "        self.β = β\n");
+    benchAppend(&buffer, "        self.label = \"Δ = α − β, ∑ ≠ ∞\"\n\n");
+  }
+  return buffer;
+}
+
+/* 两棵语法树是否相同：节点种类、修饰符、token 和子节点 */
+static inline int benchSameAst(Ast *a, Ast *b) {
+  if (a == NULL || b == NULL)
+    return a == b;
+  if (a->kind != b->kind || a->token.type != b->token.type ||
+      a->token.start != b->token.start ||
+      a->token.length != b->token.length ||
+      memcmp(&a->modifier, &b->modifier, sizeof(AstModifier)) != 0 ||
+      astNumChild(a) != astNumChild(b))
+    return 0;
+  for (int i = 0; i < astNumChild(a); i++)
+    if (!benchSameAst(astGetChild(a, i), astGetChild(b, i)))
+      return 0;
+  return 1;
+}
@@ -0,0 +1,123 @@
+/*
+ * 语法树的 arena：先确认在 AstArena 里解析出的树与用 malloc 的
+ * 完全相同，再比较两种方式的 malloc 次数、占用的内存、解析时间
+ * 和释放整棵树的时间。
+ *
+ * 用法: bench_arena [file] [repeat]
+ */
+#include <malloc.h>
+
+#include "bench.h"
+#include "parser.h"
+
+/*
+ * 按 emptyAst 和 astAppendChild 的做法，一棵树一共调用几次 malloc
+ * 或 realloc：每个节点一次，子节点放不下时每次扩容一次。解析时
+ * 丢掉的节点不算在内。
+ */
+static size_t mallocCalls(Ast *ast) {
+  if (ast == NULL)
+    return 0;
+  size_t calls = 1;
+  for (int capacity = AST_INLINE_CHILDREN; capacity < astNumChild(ast);
+       capacity *= 2)
+    calls++;
+  for (int i = 0; i < astNumChild(ast); i++)
+    calls += mallocCalls(astGetChild(ast, i));
+  return calls;
+}
+
+static size_t heapInUse(void) { return mallinfo2().uordblks; }
+
+static int verify(const char *name, const BenchBuffer *corpus) {
+  const char *begin = corpus->data, *end = corpus->data + corpus->length;
+  int hadError;
+  Ast *plain = zy_parse(begin, end, &hadError);
+  AstArena arena;
+  astInitArena(&arena);
+  astUseArena(&arena);
+  int arenaError;
+  Ast *script = zy_parse(begin, end, &arenaError);
+  astUseArena(NULL);
+  int same = hadError == arenaError && benchSameAst(plain, script);
+  freeAst(plain, true);
+  astFreeArena(&arena);
+  if (!same) {
+    fprintf(stderr, "%s: arena tree differs\n", name);
+    return 1;
+  }
+  return 0;
+}
+
+static void run(const char *name, const BenchBuffer *corpus, int repeat) {
+  const char *begin = corpus->data, *end = corpus->data + corpus->length;
+  double megabytes = (double)corpus->length / (1 << 20);
+  double parse = 1e30, release = 1e30, arenaParse = 1e30, arenaRelease = 1e30;
+  size_t calls = 0, bytes = 0, nodes = 0, arenaBytes = 0;
+  /* 两种方式分开循环，各自重复使用自己释放的内存 */
+  for (int i = 0; i < repeat; i++) {
+    int hadError;
+    size_t before = heapInUse();
+    double start = benchNow();
+    Ast *script = zy_parse(begin, end, &hadError);
+    double elapsed = benchNow() - start;
+    if (elapsed < parse)
+      parse = elapsed;
+    bytes = heapInUse() - before;
+    calls = mallocCalls(script);
+    start = benchNow();
+    freeAst(script, true);
+    elapsed = benchNow() - start;
+    if (elapsed < release)
+      release = elapsed;
+  }
+  for (int i = 0; i < repeat; i++) {
+    int hadError;
+    AstArena arena;
+    astInitArena(&arena);
+    size_t before = heapInUse();
+    double start = benchNow();
+    astUseArena(&arena);
+    zy_parse(begin, end, &hadError);
+    astUseArena(NULL);
+    double elapsed = benchNow() - start;
+    if (elapsed < arenaParse)
+      arenaParse = elapsed;
+    arenaBytes = heapInUse() - before;
+    nodes = arena.nodes;
+    start = benchNow();
+    astFreeArena(&arena);
+    elapsed = benchNow() - start;
+    if (elapsed < arenaRelease)
+      arenaRelease = elapsed;
+  }
+  printf("%s corpus: %.1f MB, %zu nodes allocated\n", name, megabytes, nodes);
+  printf("  malloc %8.1f MB/s  free %7.1f ms  %10zu allocations %8.1f MB\n",
+         megabytes / parse, release * 1e3, calls,
+         (double)bytes / (1 << 20));
+  printf("  arena  %8.1f MB/s  free %7.1f ms  %10zu blocks      %8.1f MB\n",
+         megabytes / arenaParse, arenaRelease * 1e3,
+         (arenaBytes + ZY_ARENA_BLOCK - 1) / ZY_ARENA_BLOCK,
+         (double)arenaBytes / (1 << 20));
+}
+
+int main(int argc, char *argv[]) {
+  int repeat = (argc > 2) ? atoi(argv[2]) : 5;
+  /* 释放的内存留在进程里，不把缺页的时间算进解析 */
+  mallopt(M_TRIM_THRESHOLD, INT32_MAX);
+  if (argc > 1 && argv[1][0] != '\0') {
+    BenchBuffer corpus = benchReadFile(argv[1]);
+    if (verify(argv[1], &corpus))
+      return 1;
+    run(argv[1], &corpus, repeat);
+    benchFree(&corpus);
+    return 0;
+  }
+
+  BenchBuffer code = benchCodeCorpus(16 << 20);
+  if (verify("code", &code))
+    return 1;
+  run("code", &code, repeat);
+  benchFree(&code);
+  return 0;
+}
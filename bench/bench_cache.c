@@ -0,0 +1,176 @@
+/*
+ * 语法树缓存：把解析出的树用 zy_writeFlatAst 写进临时文件，先确认
+ * 映射回来的树展开后与原来的完全相同，直接从映射输出的内容也与
+ * astWrite 一样，再比较没有缓存（解析后输出）与缓存命中（映射后
+ * 直接输出）的时间。载入单独再看两步：源码散列加映射和检查、
+ * 读遍所有节点。输出是 S 表达式，写到一个临时文件。
+ *
+ * 用法: bench_cache [file] [repeat]
+ */
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "bench.h"
+#include "flatast.h"
+#include "parser.h"
+
+/* 按种类计数，再把 token 长度加起来，映射的每一页都要读到 */
+static size_t scanFlat(const ZyFlatAst *tree) {
+  size_t sum = 0;
+  for (size_t i = 0; i < tree->count; i++)
+    sum += tree->nodes[i].kind + tree->nodes[i].length;
+  for (size_t i = 0; i < tree->edgeCount; i++)
+    sum += tree->edges[i];
+  return sum;
+}
+
+static int mapCache(int fd, const char *begin, const char *end,
+                    ZyMappedAst *mapped) {
+  return zy_mapFlatAst(fd, begin, end, zy_hashSource(begin, end), mapped);
+}
+
+/* 清空 sink，之后的输出从头写起 */
+static ZyOutput *openSink(ZyOutput *out, int fd, ZyOutputFormat format) {
+  ftruncate(fd, 0);
+  lseek(fd, 0, SEEK_SET);
+  zy_openOutput(out, fd, format);
+  return out;
+}
+
+static char *readSink(int fd, size_t *length) {
+  *length = (size_t)lseek(fd, 0, SEEK_END);
+  char *data = (char *)malloc(*length + 1);
+  if (data == NULL || pread(fd, data, *length, 0) != (ssize_t)*length) {
+    perror("readSink");
+    exit(1);
+  }
+  return data;
+}
+
+/* 同一棵树从指针形式和映射的文件输出，内容要完全一样 */
+static int sameOutput(Ast *script, const ZyMappedAst *mapped,
+                      ZyOutputFormat format, int sink) {
+  ZyOutput out;
+  astWrite(openSink(&out, sink, format), script, mapped->tree.src);
+  zy_closeOutput(&out);
+  size_t parsedLength, mappedLength;
+  char *parsed = readSink(sink, &parsedLength);
+  astWriteFlat(openSink(&out, sink, format), &mapped->tree, mapped->root);
+  zy_closeOutput(&out);
+  char *fromMap = readSink(sink, &mappedLength);
+  int same = parsedLength == mappedLength &&
+             memcmp(parsed, fromMap, parsedLength) == 0;
+  free(parsed);
+  free(fromMap);
+  return same;
+}
+
+static int run(const char *name, const BenchBuffer *corpus, int repeat) {
+  const char *begin = corpus->data, *end = corpus->data + corpus->length;
+  FILE *file = tmpfile(), *sinkFile = tmpfile();
+  if (file == NULL || sinkFile == NULL) {
+    perror("tmpfile");
+    return 1;
+  }
+  int fd = fileno(file), sink = fileno(sinkFile);
+
+  AstArena arena;
+  astInitArena(&arena);
+  astUseArena(&arena);
+  int hadError;
+  Ast *script = zy_parse(begin, end, &hadError);
+  ZyFlatAst tree;
+  zy_initFlatAst(&tree, begin);
+  uint32_t root = zy_flattenAst(&tree, script);
+  double write = benchNow();
+  if (!zy_writeFlatAst(fd, &tree, root, end, zy_hashSource(begin, end))) {
+    perror("zy_writeFlatAst");
+    return 1;
+  }
+  write = benchNow() - write;
+
+  ZyMappedAst mapped;
+  if (!mapCache(fd, begin, end, &mapped)) {
+    fprintf(stderr, "%s: cache was not accepted\n", name);
+    return 1;
+  }
+  Ast *expanded = zy_expandFlatAst(&mapped.tree, mapped.root);
+  int same = benchSameAst(script, expanded) &&
+             scanFlat(&mapped.tree) == scanFlat(&tree) &&
+             sameOutput(script, &mapped, ZY_FORMAT_HUMAN, sink) &&
+             sameOutput(script, &mapped, ZY_FORMAT_SEXP, sink);
+  zy_unmapFlatAst(&mapped);
+  /* 换一份源码时缓存不能用 */
+  int rejected = !mapCache(fd, begin, end - 1, &mapped);
+  if (!same || !rejected) {
+    fprintf(stderr, "%s: cached tree differs\n", name);
+    return 1;
+  }
+  double nodes = (double)tree.count;
+  zy_freeFlatAst(&tree);
+  astUseArena(NULL);
+  astFreeArena(&arena);
+
+  ZyOutput out;
+  double parse = 1e30, load = 1e30, scan = 1e30, cold = 1e30, warm = 1e30;
+  BEST_OF(parse, repeat, {
+    astInitArena(&arena);
+    astUseArena(&arena);
+    zy_parse(begin, end, &hadError);
+    astUseArena(NULL);
+    astFreeArena(&arena);
+  });
+  BEST_OF(load, repeat, {
+    mapCache(fd, begin, end, &mapped);
+    zy_unmapFlatAst(&mapped);
+  });
+  size_t sum = 0;
+  BEST_OF(scan, repeat, {
+    mapCache(fd, begin, end, &mapped);
+    sum += scanFlat(&mapped.tree);
+    zy_unmapFlatAst(&mapped);
+  });
+  BEST_OF(cold, repeat, {
+    astInitArena(&arena);
+    astUseArena(&arena);
+    astWrite(openSink(&out, sink, ZY_FORMAT_SEXP),
+             zy_parse(begin, end, &hadError), begin);
+    zy_closeOutput(&out);
+    astUseArena(NULL);
+    astFreeArena(&arena);
+  });
+  BEST_OF(warm, repeat, {
+    mapCache(fd, begin, end, &mapped);
+    astWriteFlat(openSink(&out, sink, ZY_FORMAT_SEXP), &mapped.tree,
+                 mapped.root);
+    zy_closeOutput(&out);
+    zy_unmapFlatAst(&mapped);
+  });
+
+  printf("%s corpus: %.1f MB, %.0f nodes, cache %.1f MB written in %.1f ms\n",
+         name, (double)corpus->length / (1 << 20), nodes,
+         (double)lseek(fd, 0, SEEK_END) / (1 << 20), write * 1e3);
+  printf("  parse                %8.1f ms\n", parse * 1e3);
+  printf("  hash + map + check   %8.1f ms\n", load * 1e3);
+  printf("  ... + scan           %8.1f ms\n", scan * 1e3);
+  printf("  parse + print        %8.1f ms\n", cold * 1e3);
+  printf("  map + print          %8.1f ms\n", warm * 1e3);
+  fclose(file);
+  fclose(sinkFile);
+  return sum == 0;
+}
+
+int main(int argc, char *argv[]) {
+  int repeat = (argc > 2) ? atoi(argv[2]) : 5;
+  if (argc > 1 && argv[1][0] != '\0') {
+    BenchBuffer corpus = benchReadFile(argv[1]);
+    int status = run(argv[1], &corpus, repeat);
+    benchFree(&corpus);
+    return status;
+  }
+
+  BenchBuffer code = benchCodeCorpus(16 << 20);
+  int status = run("code", &code, repeat);
+  benchFree(&code);
+  return status;
+}
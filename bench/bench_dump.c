@@ -0,0 +1,178 @@
+/*
+ * token 输出：先确认 human 格式与 printToken 的输出逐字节相同、
+ * 二进制格式能还原出每个 token，再比较只扫描、用 printToken
+ * 逐个打印，以及三种缓冲输出格式写到 /dev/null 的速度。
+ *
+ * 用法: bench_dump [file] [repeat]
+ */
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "bench.h"
+#include "output.h"
+#include "scanner.h"
+
+enum { MODE_LEX_ONLY = -2, MODE_PRINT_TOKEN = -1 };
+
+/* mode 是一种 ZyOutputFormat，或者上面两种之一 */
+static size_t dumpAll(const BenchBuffer *corpus, int mode, int fd) {
+  ZyScanner scanner =
+      zy_initScanner(corpus->data, corpus->data + corpus->length);
+  size_t count = 0;
+  if (mode == MODE_LEX_ONLY) {
+    while (1) {
+      ZyToken t = zy_scanToken(&scanner);
+      count++;
+      if (t.type == TOKEN_EOF)
+        break;
+    }
+  } else if (mode == MODE_PRINT_TOKEN) {
+    while (1) {
+      ZyToken t = zy_scanToken(&scanner);
+      printToken(t);
+      count++;
+      if (t.type == TOKEN_EOF)
+        break;
+    }
+    fflush(stdout);
+  } else {
+    ZyOutput out;
+    zy_openOutput(&out, fd, (ZyOutputFormat)mode);
+    while (1) {
+      ZyToken t = zy_scanToken(&scanner);
+      zy_writeToken(&out, &t, (uint64_t)(t.start - corpus->data));
+      count++;
+      if (t.type == TOKEN_EOF)
+        break;
+    }
+    zy_closeOutput(&out);
+  }
+  return count;
+}
+
+/* 把 fd 的内容读回内存 */
+static BenchBuffer readBack(int fd) {
+  BenchBuffer buffer = {};
+  char chunk[65536];
+  ssize_t n;
+  lseek(fd, 0, SEEK_SET);
+  while ((n = read(fd, chunk, sizeof(chunk))) > 0) {
+    benchReserve(&buffer, (size_t)n);
+    memcpy(buffer.data + buffer.length, chunk, (size_t)n);
+    buffer.length += (size_t)n;
+  }
+  return buffer;
+}
+
+static int captureFile(void) {
+  FILE *file = tmpfile();
+  if (file == NULL) {
+    perror("Error creating temporary file");
+    exit(1);
+  }
+  return dup(fileno(file));
+}
+
+static int verify(const BenchBuffer *corpus) {
+  /* printToken 写的是 stdout，临时把它换成一个文件 */
+  int expectedFd = captureFile();
+  int savedStdout = dup(STDOUT_FILENO);
+  fflush(stdout);
+  dup2(expectedFd, STDOUT_FILENO);
+  dumpAll(corpus, MODE_PRINT_TOKEN, -1);
+  dup2(savedStdout, STDOUT_FILENO);
+  close(savedStdout);
+
+  int humanFd = captureFile();
+  dumpAll(corpus, ZY_FORMAT_HUMAN, humanFd);
+  BenchBuffer expected = readBack(expectedFd);
+  BenchBuffer human = readBack(humanFd);
+  if (expected.length != human.length ||
+      memcmp(expected.data, human.data, human.length) != 0) {
+    fprintf(stderr, "human format differs from printToken\n");
+    return 1;
+  }
+
+  int binaryFd = captureFile();
+  dumpAll(corpus, ZY_FORMAT_BINARY, binaryFd);
+  BenchBuffer binary = readBack(binaryFd);
+  size_t header = sizeof(ZY_TOKEN_MAGIC) - 1;
+  if (binary.length < header ||
+      memcmp(binary.data, ZY_TOKEN_MAGIC, header) != 0) {
+    fprintf(stderr, "binary dump has no header\n");
+    return 1;
+  }
+  ZyScanner scanner =
+      zy_initScanner(corpus->data, corpus->data + corpus->length);
+  for (size_t at = header; at < binary.length; at += sizeof(ZyTokenRecord)) {
+    ZyTokenRecord record;
+    memcpy(&record, binary.data + at, sizeof(record));
+    ZyToken t = zy_scanToken(&scanner);
+    if (record.type != t.type || record.length != t.length ||
+        record.offset != (uint64_t)(t.start - corpus->data) ||
+        (t.type == TOKEN_ERROR && record.error != t.symbol)) {
+      fprintf(stderr, "binary record at %zu does not match its token\n", at);
+      return 1;
+    }
+  }
+
+  close(expectedFd);
+  close(humanFd);
+  close(binaryFd);
+  benchFree(&expected);
+  benchFree(&human);
+  benchFree(&binary);
+  return 0;
+}
+
+int main(int argc, char *argv[]) {
+  BenchBuffer corpus = (argc > 1 && argv[1][0] != '\0')
+                           ? benchReadFile(argv[1])
+                           : benchCodeCorpus(64 << 20);
+  int repeat = (argc > 2) ? atoi(argv[2]) : 3;
+  if (verify(&corpus))
+    return 1;
+
+  int devNull = open("/dev/null", O_WRONLY);
+  if (devNull < 0) {
+    perror("Error opening /dev/null");
+    return 1;
+  }
+  static const struct {
+    int mode;
+    const char *name;
+  } modes[] = {
+      {MODE_LEX_ONLY, "lex only"},   {MODE_PRINT_TOKEN, "printToken"},
+      {ZY_FORMAT_HUMAN, "human"},    {ZY_FORMAT_BINARY, "binary"},
+      {ZY_FORMAT_JSONL, "jsonl"},
+  };
+  enum { MODE_COUNT = sizeof(modes) / sizeof(modes[0]) };
+  double times[MODE_COUNT];
+  size_t tokens = 0;
+  for (int m = 0; m < MODE_COUNT; m++)
+    times[m] = 1e30;
+
+  int savedStdout = dup(STDOUT_FILENO);
+  for (int i = 0; i < repeat; i++) {
+    for (int m = 0; m < MODE_COUNT; m++) {
+      fflush(stdout);
+      dup2(devNull, STDOUT_FILENO);
+      double start = benchNow();
+      tokens = dumpAll(&corpus, modes[m].mode, devNull);
+      double elapsed = benchNow() - start;
+      fflush(stdout);
+      dup2(savedStdout, STDOUT_FILENO);
+      if (elapsed < times[m])
+        times[m] = elapsed;
+    }
+  }
+
+  double megabytes = (double)corpus.length / (1 << 20);
+  printf("corpus: %.1f MB, %zu tokens\n", megabytes, tokens);
+  for (int m = 0; m < MODE_COUNT; m++)
+    printf("%-12s %8.1f MB/s  %6.1f%% of lex only\n", modes[m].name,
+           megabytes / times[m], times[0] / times[m] * 100);
+  close(devNull);
+  benchFree(&corpus);
+  return 0;
+}
@@ -0,0 +1,148 @@
+/*
+ * 扁平语法树：先确认 zy_flattenAst 再 zy_expandFlatAst 得到的树与
+ * 原来的完全相同，再比较指针形式（malloc 和 arena）与扁平形式
+ * 每个节点占用的内存，以及遍历整棵树的时间。
+ *
+ * 用法: bench_flat [file] [repeat]
+ */
+#include <malloc.h>
+
+#include "bench.h"
+#include "flatast.h"
+#include "parser.h"
+
+/* 遍历时做的事：按种类计数，再把 token 长度加起来，每个节点都要读到 */
+typedef struct {
+  size_t kinds[AST_KIND_ERROR + 1];
+  size_t length;
+} Tally;
+
+static void walkAst(Ast *ast, Tally *tally) {
+  if (ast == NULL)
+    return;
+  tally->kinds[ast->kind]++;
+  tally->length += ast->token.length;
+  for (int i = 0; i < astNumChild(ast); i++)
+    walkAst(astGetChild(ast, i), tally);
+}
+
+static void walkFlat(const ZyFlatAst *tree, uint32_t node, Tally *tally) {
+  if (node == ZY_FLAT_NONE)
+    return;
+  tally->kinds[tree->nodes[node].kind]++;
+  tally->length += tree->nodes[node].length;
+  uint32_t numChild = zy_flatNumChild(tree, node);
+  for (uint32_t i = 0; i < numChild; i++)
+    walkFlat(tree, zy_flatChild(tree, node, i), tally);
+}
+
+/* 不关心形状的遍历直接按先序扫一遍 */
+static void scanFlat(const ZyFlatAst *tree, Tally *tally) {
+  for (size_t i = 0; i < tree->count; i++) {
+    tally->kinds[tree->nodes[i].kind]++;
+    tally->length += tree->nodes[i].length;
+  }
+}
+
+static size_t heapInUse(void) { return mallinfo2().uordblks; }
+
+static int verify(const char *name, const BenchBuffer *corpus) {
+  const char *begin = corpus->data, *end = corpus->data + corpus->length;
+  int hadError;
+  Ast *script = zy_parse(begin, end, &hadError);
+  ZyFlatAst tree;
+  zy_initFlatAst(&tree, begin);
+  uint32_t root = zy_flattenAst(&tree, script);
+  Ast *expanded = zy_expandFlatAst(&tree, root);
+  Tally walked = {}, flat = {};
+  walkAst(script, &walked);
+  scanFlat(&tree, &flat);
+  int same = root == 0 && benchSameAst(script, expanded) &&
+             memcmp(&walked, &flat, sizeof(Tally)) == 0;
+  freeAst(script, true);
+  freeAst(expanded, true);
+  zy_freeFlatAst(&tree);
+  if (!same) {
+    fprintf(stderr, "%s: flat tree differs\n", name);
+    return 1;
+  }
+  return 0;
+}
+
+static void run(const char *name, const BenchBuffer *corpus, int repeat) {
+  const char *begin = corpus->data, *end = corpus->data + corpus->length;
+  int hadError;
+  size_t before = heapInUse();
+  Ast *script = zy_parse(begin, end, &hadError);
+  size_t mallocBytes = heapInUse() - before;
+
+  AstArena arena;
+  astInitArena(&arena);
+  before = heapInUse();
+  astUseArena(&arena);
+  Ast *arenaScript = zy_parse(begin, end, &hadError);
+  astUseArena(NULL);
+  size_t arenaBytes = heapInUse() - before;
+
+  ZyFlatAst tree;
+  zy_initFlatAst(&tree, begin);
+  double flatten = 1e30;
+  BEST_OF(flatten, repeat, {
+    zy_freeFlatAst(&tree);
+    zy_flattenAst(&tree, script);
+  });
+  double nodes = (double)tree.count;
+
+  Tally tally;
+  double mallocWalk = 1e30, arenaWalk = 1e30, flatWalk = 1e30, flatScan = 1e30;
+  BEST_OF(mallocWalk, repeat, {
+    memset(&tally, 0, sizeof(tally));
+    walkAst(script, &tally);
+  });
+  BEST_OF(arenaWalk, repeat, {
+    memset(&tally, 0, sizeof(tally));
+    walkAst(arenaScript, &tally);
+  });
+  BEST_OF(flatWalk, repeat, {
+    memset(&tally, 0, sizeof(tally));
+    walkFlat(&tree, 0, &tally);
+  });
+  BEST_OF(flatScan, repeat, {
+    memset(&tally, 0, sizeof(tally));
+    scanFlat(&tree, &tally);
+  });
+
+  printf("%s corpus: %.1f MB, %.0f nodes, flatten %.1f ms\n", name,
+         (double)corpus->length / (1 << 20), nodes, flatten * 1e3);
+  printf("  %-10s %10s %14s\n", "", "bytes/node", "walk Mnodes/s");
+  printf("  %-10s %10.1f %14.1f\n", "malloc", mallocBytes / nodes,
+         nodes / mallocWalk / 1e6);
+  printf("  %-10s %10.1f %14.1f\n", "arena", arenaBytes / nodes,
+         nodes / arenaWalk / 1e6);
+  printf("  %-10s %10.1f %14.1f\n", "flat",
+         zy_flatAstBytes(&tree) / nodes, nodes / flatWalk / 1e6);
+  printf("  %-10s %10s %14.1f\n", "flat scan", "", nodes / flatScan / 1e6);
+
+  freeAst(script, true);
+  astFreeArena(&arena);
+  zy_freeFlatAst(&tree);
+}
+
+int main(int argc, char *argv[]) {
+  int repeat = (argc > 2) ? atoi(argv[2]) : 5;
+  if (argc > 1 && argv[1][0] != '\0') {
+    BenchBuffer corpus = benchReadFile(argv[1]);
+    if (verify(argv[1], &corpus))
+      return 1;
+    run(argv[1], &corpus, repeat);
+    benchFree(&corpus);
+    return 0;
+  }
+
+  BenchBuffer code = benchCodeCorpus(16 << 20);
+  if (verify("code", &code))
+    return 1;
+  run("code", &code, repeat);
+  benchFree(&code);
+  return 0;
+}
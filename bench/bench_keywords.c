@@ -0,0 +1,141 @@
+/*
+ * 关键字识别：先确认每个关键字和与之相近的标识符都被正确分类，
+ * 然后在以标识符为主的语料上测量 zy_scanToken 的速度。
+ *
+ * 用法: bench_keywords [repeat]
+ */
+#include <stdint.h>
+
+#include "bench.h"
+#include "scanner.h"
+
+typedef struct {
+  const char *word;
+  ZyTokenType type;
+} Expected;
+
+static const Expected keywords[] = {
+    {"and", TOKEN_AND},         {"class", TOKEN_CLASS},
+    {"def", TOKEN_DEF},         {"del", TOKEN_DEL},
+    {"else", TOKEN_ELSE},       {"False", TOKEN_FALSE},
+    {"finally", TOKEN_FINALLY}, {"for", TOKEN_FOR},
+    {"if", TOKEN_IF},           {"import", TOKEN_IMPORT},
+    {"in", TOKEN_IN},           {"is", TOKEN_IS},
+    {"None", TOKEN_NONE},       {"not", TOKEN_NOT},
+    {"or", TOKEN_OR},           {"elif", TOKEN_ELIF},
+    {"pass", TOKEN_PASS},       {"return", TOKEN_RETURN},
+    {"super", TOKEN_SUPER},     {"True", TOKEN_TRUE},
+    {"while", TOKEN_WHILE},     {"try", TOKEN_TRY},
+    {"except", TOKEN_EXCEPT},   {"raise", TOKEN_RAISE},
+    {"break", TOKEN_BREAK},     {"continue", TOKEN_CONTINUE},
+    {"as", TOKEN_AS},           {"from", TOKEN_FROM},
+    {"lambda", TOKEN_LAMBDA},   {"assert", TOKEN_ASSERT},
+    {"yield", TOKEN_YIELD},     {"async", TOKEN_ASYNC},
+    {"await", TOKEN_AWAIT},     {"with", TOKEN_WITH},
+    {"global", TOKEN_GLOBAL},   {"nonlocal", TOKEN_NONLOCAL},
+};
+#define NUM_KEYWORDS (sizeof(keywords) / sizeof(keywords[0]))
+
+static ZyTokenType classify(const char *text) {
+  ZyScanner scanner = zy_initScanner(text, text + strlen(text));
+  return zy_scanToken(&scanner).type;
+}
+
+static ZyTokenType expectedType(const char *word) {
+  for (size_t i = 0; i < NUM_KEYWORDS; i++) {
+    if (strcmp(keywords[i].word, word) == 0)
+      return keywords[i].type;
+  }
+  return TOKEN_IDENTIFIER;
+}
+
+static int check(const char *word) {
+  ZyTokenType got = classify(word);
+  ZyTokenType want = expectedType(word);
+  if (got != want) {
+    fprintf(stderr, "'%s' scanned as %d, expected %d\n", word, got, want);
+    return 1;
+  }
+  return 0;
+}
+
+/* 每个关键字本身，以及删掉、替换、追加一个字符和改变大小写后的变体 */
+static int checkKeywords(void) {
+  int failures = 0;
+  char word[32];
+  for (size_t i = 0; i < NUM_KEYWORDS; i++) {
+    const char *keyword = keywords[i].word;
+    size_t length = strlen(keyword);
+    failures += check(keyword);
+    for (size_t j = 0; j < length; j++) {
+      memcpy(word, keyword, j);
+      strcpy(word + j, keyword + j + 1);
+      failures += check(word);
+
+      strcpy(word, keyword);
+      word[j] = (word[j] == 'z') ? 'y' : 'z';
+      failures += check(word);
+
+      strcpy(word, keyword);
+      word[j] ^= 0x20;
+      failures += check(word);
+    }
+    snprintf(word, sizeof(word), "%s_", keyword);
+    failures += check(word);
+    snprintf(word, sizeof(word), "%sx", keyword);
+    failures += check(word);
+    snprintf(word, sizeof(word), "x%s", keyword);
+    failures += check(word);
+  }
+  /* 旧的前缀树会错误地落入下一个 case */
+  const char *nearMisses[] = {"eor",   "eFalse", "efinally", "iglobal",
+                              "nnot",  "rsuper", "fFalse",   "bx",
+                              "nonlo", "b",      "f",        "r"};
+  for (size_t i = 0; i < sizeof(nearMisses) / sizeof(nearMisses[0]); i++)
+    failures += check(nearMisses[i]);
+  return failures;
+}
+
+int main(int argc, char *argv[]) {
+  int repeat = (argc > 1) ? atoi(argv[1]) : 5;
+  if (checkKeywords() != 0) {
+    fprintf(stderr, "keyword classification is wrong\n");
+    return 1;
+  }
+  printf("keyword classification ok\n");
+
+  /* 以标识符和关键字为主的语料，用伪随机顺序避免分支预测记住模式 */
+  static const char *words[] = {
+      "self",  "value",    "result", "if",     "return", "index",
+      "None",  "for",      "in",     "range",  "length", "not",
+      "and",   "items",    "lambda", "continue", "data", "while",
+      "True",  "count",    "x",      "elements", "defaults", "is_ok",
+      "async", "nonlocal", "key",    "assert_", "classes", "tryhard"};
+  size_t numWords = sizeof(words) / sizeof(words[0]);
+  BenchBuffer corpus = {};
+  uint32_t seed = 12345;
+  for (size_t i = 0; corpus.length < (32u << 20); i++) {
+    seed = seed * 1103515245u + 12345u;
+    benchAppend(&corpus, words[(seed >> 16) % numWords]);
+    benchAppend(&corpus, (i % 12 == 11) ? "\n" : " ");
+  }
+
+  double best = 1e30;
+  size_t tokens = 0;
+  for (int r = 0; r < repeat; r++) {
+    ZyScanner scanner =
+        zy_initScanner(corpus.data, corpus.data + corpus.length);
+    tokens = 0;
+    double begin = benchNow();
+    while (zy_scanToken(&scanner).type != TOKEN_EOF)
+      tokens++;
+    double elapsed = benchNow() - begin;
+    if (elapsed < best)
+      best = elapsed;
+  }
+  printf("%zu tokens  %.1f Mtokens/s  %.1f MB/s\n", tokens,
+         tokens / best / 1e6, corpus.length / best / (1 << 20));
+
+  benchFree(&corpus);
+  return 0;
+}
@@ -0,0 +1,120 @@
+/*
+ * 缩进整理：先确认 ZyLayout 的输出里没有 RETRY 和 INDENTATION，
+ * INDENT 与 DEDENT 成对、EOL 不会连续出现，再比较直接扫描和
+ * 经过 ZyLayout 的吞吐量。
+ *
+ * 用法: bench_layout [file] [repeat]
+ */
+#include "bench.h"
+#include "layout.h"
+#include "scanner.h"
+
+static int verify(const char *name, const BenchBuffer *corpus) {
+  ZyScanner scanner =
+      zy_initScanner(corpus->data, corpus->data + corpus->length);
+  ZyLayout layout;
+  zy_initLayout(&layout);
+  long depth = 0;
+  int afterEol = 1;
+  size_t count = 0;
+  while (1) {
+    ZyToken t = zy_layoutToken(&layout, &scanner);
+    count++;
+    if (t.type == TOKEN_RETRY || t.type == TOKEN_INDENTATION) {
+      fprintf(stderr, "%s: raw token %d at %td\n", name, t.type,
+              t.start - corpus->data);
+      return 1;
+    }
+    if (t.type == TOKEN_EOL && afterEol) {
+      fprintf(stderr, "%s: empty line at %td\n", name,
+              t.start - corpus->data);
+      return 1;
+    }
+    afterEol = t.type == TOKEN_EOL;
+    if (t.type == TOKEN_INDENT)
+      depth++;
+    else if (t.type == TOKEN_DEDENT && --depth < 0)
+      break;
+    if (t.type == TOKEN_EOF)
+      break;
+  }
+  if (depth != 0) {
+    fprintf(stderr, "%s: %ld unbalanced INDENT\n", name, depth);
+    return 1;
+  }
+  printf("%s corpus: %zu tokens after layout\n", name, count);
+  return 0;
+}
+
+static size_t lexRaw(const BenchBuffer *corpus) {
+  ZyScanner scanner =
+      zy_initScanner(corpus->data, corpus->data + corpus->length);
+  size_t count = 0;
+  while (1) {
+    ZyToken t = zy_scanToken(&scanner);
+    count++;
+    if (t.type == TOKEN_EOF)
+      break;
+  }
+  return count;
+}
+
+static size_t lexLayout(const BenchBuffer *corpus) {
+  ZyScanner scanner =
+      zy_initScanner(corpus->data, corpus->data + corpus->length);
+  ZyLayout layout;
+  zy_initLayout(&layout);
+  size_t count = 0;
+  while (1) {
+    ZyToken t = zy_layoutToken(&layout, &scanner);
+    count++;
+    if (t.type == TOKEN_EOF)
+      break;
+  }
+  return count;
+}
+
+static void run(const char *name, const BenchBuffer *corpus, int repeat) {
+  double megabytes = (double)corpus->length / (1 << 20);
+  double raw = 1e30, layout = 1e30;
+  for (int i = 0; i < repeat; i++) {
+    double start = benchNow();
+    lexRaw(corpus);
+    double elapsed = benchNow() - start;
+    if (elapsed < raw)
+      raw = elapsed;
+
+    start = benchNow();
+    lexLayout(corpus);
+    elapsed = benchNow() - start;
+    if (elapsed < layout)
+      layout = elapsed;
+  }
+  printf("  raw %8.1f MB/s   layout %8.1f MB/s\n", megabytes / raw,
+         megabytes / layout);
+}
+
+int main(int argc, char *argv[]) {
+  int repeat = (argc > 2) ? atoi(argv[2]) : 5;
+  if (argc > 1 && argv[1][0] != '\0') {
+    BenchBuffer corpus = benchReadFile(argv[1]);
+    if (verify(argv[1], &corpus))
+      return 1;
+    run(argv[1], &corpus, repeat);
+    benchFree(&corpus);
+    return 0;
+  }
+
+  BenchBuffer generated = benchGeneratedCorpus(64 << 20);
+  if (verify("generated", &generated))
+    return 1;
+  run("generated", &generated, repeat);
+  benchFree(&generated);
+
+  BenchBuffer code = benchCodeCorpus(64 << 20);
+  if (verify("code", &code))
+    return 1;
+  run("code", &code, repeat);
+  benchFree(&code);
+  return 0;
+}
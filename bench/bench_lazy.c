@@ -0,0 +1,118 @@
+/*
+ * 延迟解析函数体：先确认预解析之后逐个展开所有函数体，得到的
+ * 语法树与直接完整解析的相同；再比较完整解析和预解析的时间、
+ * 节点数和占用的内存，以及之后展开全部函数体的时间。
+ *
+ * 用法: bench_lazy [file] [repeat]
+ */
+#include <malloc.h>
+
+#include "bench.h"
+#include "parser.h"
+
+static size_t countNodes(Ast *ast) {
+  if (ast == NULL)
+    return 0;
+  size_t count = 1;
+  for (int i = 0; i < astNumChild(ast); i++)
+    count += countNodes(astGetChild(ast, i));
+  return count;
+}
+
+/* 展开所有函数体，包括展开之后才出现的嵌套函数 */
+static void forceBodies(ZyModule *module, Ast *ast) {
+  if (ast == NULL)
+    return;
+  if (ast->kind == AST_DECL_FUN || ast->kind == AST_DECL_METHOD)
+    zy_functionBody(module, ast);
+  for (int i = 0; i < astNumChild(ast); i++)
+    forceBodies(module, astGetChild(ast, i));
+}
+
+static size_t heapInUse(void) { return mallinfo2().uordblks; }
+
+static int verify(const char *name, const BenchBuffer *corpus) {
+  const char *begin = corpus->data, *end = corpus->data + corpus->length;
+  int hadError;
+  Ast *eager = zy_parse(begin, end, &hadError);
+  if (hadError) {
+    fprintf(stderr, "%s: parse errors\n", name);
+    return 1;
+  }
+  ZyModule module;
+  zy_parseLazy(begin, end, &module);
+  forceBodies(&module, module.script);
+  int same = !module.hadError && benchSameAst(eager, module.script);
+  freeAst(eager, true);
+  zy_freeModule(&module);
+  if (!same) {
+    fprintf(stderr, "%s: expanded tree differs from a full parse\n", name);
+    return 1;
+  }
+  return 0;
+}
+
+static void run(const char *name, const BenchBuffer *corpus, int repeat) {
+  const char *begin = corpus->data, *end = corpus->data + corpus->length;
+  double megabytes = (double)corpus->length / (1 << 20);
+  double full = 1e30, lazy = 1e30, force = 1e30;
+  size_t fullNodes = 0, lazyNodes = 0, fullBytes = 0, lazyBytes = 0;
+  for (int i = 0; i < repeat; i++) {
+    int hadError;
+    size_t before = heapInUse();
+    double start = benchNow();
+    Ast *script = zy_parse(begin, end, &hadError);
+    double elapsed = benchNow() - start;
+    if (elapsed < full)
+      full = elapsed;
+    fullBytes = heapInUse() - before;
+    fullNodes = countNodes(script);
+    freeAst(script, true);
+  }
+  /* 分开循环，各自重复使用自己释放的内存 */
+  for (int i = 0; i < repeat; i++) {
+    ZyModule module;
+    size_t before = heapInUse();
+    double start = benchNow();
+    zy_parseLazy(begin, end, &module);
+    double elapsed = benchNow() - start;
+    if (elapsed < lazy)
+      lazy = elapsed;
+    lazyBytes = heapInUse() - before;
+    lazyNodes = countNodes(module.script);
+
+    start = benchNow();
+    forceBodies(&module, module.script);
+    elapsed = benchNow() - start;
+    if (elapsed < force)
+      force = elapsed;
+    zy_freeModule(&module);
+  }
+  printf("%s corpus: %.1f MB\n", name, megabytes);
+  printf("  full     %8.1f MB/s %10zu nodes %8.1f MB heap\n", megabytes / full,
+         fullNodes, (double)fullBytes / (1 << 20));
+  printf("  lazy     %8.1f MB/s %10zu nodes %8.1f MB heap (incl. tokens)\n",
+         megabytes / lazy, lazyNodes, (double)lazyBytes / (1 << 20));
+  printf("  expand all bodies afterwards: %.1f ms\n", force * 1e3);
+}
+
+int main(int argc, char *argv[]) {
+  int repeat = (argc > 2) ? atoi(argv[2]) : 5;
+  /* 释放的内存留在进程里，不把缺页的时间算进解析 */
+  mallopt(M_TRIM_THRESHOLD, INT32_MAX);
+  if (argc > 1 && argv[1][0] != '\0') {
+    BenchBuffer corpus = benchReadFile(argv[1]);
+    if (verify(argv[1], &corpus))
+      return 1;
+    run(argv[1], &corpus, repeat);
+    benchFree(&corpus);
+    return 0;
+  }
+
+  BenchBuffer code = benchCodeCorpus(16 << 20);
+  if (verify("code", &code))
+    return 1;
+  run("code", &code, repeat);
+  benchFree(&code);
+  return 0;
+}
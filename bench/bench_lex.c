@@ -0,0 +1,120 @@
+/*
+ * 词法分析吞吐量：对同一份语料分别用标量和向量化的
+ * 扫描内核跑 zy_scanToken 和建立行索引，输出 MB/s。
+ * 不指定文件时分别测量生成代码语料和普通代码语料。
+ * 开始前先检查几段短代码扫描出的 token 序列。
+ *
+ * 用法: bench_lex [file] [repeat]
+ */
+#include "bench.h"
+#include "scanner.h"
+#include "simd.h"
+
+static size_t lexAll(const BenchBuffer *corpus) {
+  ZyScanner scanner =
+      zy_initScanner(corpus->data, corpus->data + corpus->length);
+  size_t count = 0;
+  while (1) {
+    ZyToken t = zy_scanToken(&scanner);
+    count++;
+    if (t.type == TOKEN_EOF)
+      break;
+  }
+  return count;
+}
+
+/* 扫描 source，token 类型要依次是 expected，以 TOKEN_EOF 结束 */
+static int checkTokens(const char *source, const ZyTokenType *expected) {
+  ZyScanner scanner = zy_initScanner(source, source + strlen(source));
+  for (int i = 0;; i++) {
+    ZyToken t = zy_scanToken(&scanner);
+    if (t.type != expected[i]) {
+      fprintf(stderr, "lexing \"%s\": token %d is %d, expected %d\n", source,
+              i, t.type, expected[i]);
+      return 0;
+    }
+    if (t.type == TOKEN_EOF)
+      return 1;
+  }
+}
+
+/* Python 没有 `--` 和 `++`，要扫描成两个运算符 */
+static int checkLexing(void) {
+  static const ZyTokenType minusMinus[] = {TOKEN_IDENTIFIER, TOKEN_MINUS,
+                                           TOKEN_MINUS, TOKEN_IDENTIFIER,
+                                           TOKEN_EOF};
+  static const ZyTokenType plusPlus[] = {TOKEN_IDENTIFIER, TOKEN_PLUS,
+                                         TOKEN_PLUS, TOKEN_IDENTIFIER,
+                                         TOKEN_EOF};
+  static const ZyTokenType leading[] = {TOKEN_MINUS, TOKEN_MINUS,
+                                        TOKEN_IDENTIFIER, TOKEN_EOF};
+  static const ZyTokenType arrow[] = {TOKEN_MINUS, TOKEN_ARROW,
+                                      TOKEN_MINUS_EQUAL, TOKEN_EOF};
+  return checkTokens("a--b", minusMinus) & checkTokens("a++b", plusPlus) &
+         checkTokens("--x", leading) & checkTokens("-->-=", arrow);
+}
+
+static double indexLines(const BenchBuffer *corpus, int repeat) {
+  double best = 1e30;
+  for (int i = 0; i < repeat; i++) {
+    ZyLineIndex index;
+    double begin = benchNow();
+    zy_initLineIndex(&index, corpus->data, corpus->data + corpus->length);
+    double elapsed = benchNow() - begin;
+    zy_freeLineIndex(&index);
+    if (elapsed < best)
+      best = elapsed;
+  }
+  return best;
+}
+
+static void run(const char *name, BenchBuffer *corpus, int repeat) {
+  double megabytes = (double)corpus->length / (1 << 20);
+
+  printf("%s corpus: %.1f MB\n", name, megabytes);
+  size_t expected = 0;
+  for (ZySimdLevel level = ZY_SIMD_SCALAR; level <= ZY_SIMD_AVX2; level++) {
+    if (zy_setSimdLevel(level) != level)
+      continue;
+    double best = 1e30;
+    size_t tokens = 0;
+    for (int i = 0; i < repeat; i++) {
+      double begin = benchNow();
+      tokens = lexAll(corpus);
+      double elapsed = benchNow() - begin;
+      if (elapsed < best)
+        best = elapsed;
+    }
+    if (expected == 0)
+      expected = tokens;
+    if (tokens != expected) {
+      fprintf(stderr, "%s produced %zu tokens, expected %zu\n",
+              zy_simdLevelName(level), tokens, expected);
+      exit(1);
+    }
+    printf("  %-8s %10zu tokens  %8.1f MB/s   line index %8.1f MB/s\n",
+           zy_simdLevelName(level), tokens, megabytes / best,
+           megabytes / indexLines(corpus, repeat));
+  }
+}
+
+int main(int argc, char *argv[]) {
+  int repeat = (argc > 2) ? atoi(argv[2]) : 5;
+  if (!checkLexing())
+    return 1;
+  if (argc > 1) {
+    BenchBuffer corpus = benchReadFile(argv[1]);
+    run(argv[1], &corpus, repeat);
+    benchFree(&corpus);
+    return 0;
+  }
+
+  BenchBuffer generated = benchGeneratedCorpus(64 << 20);
+  run("generated", &generated, repeat);
+  benchFree(&generated);
+
+  BenchBuffer code = benchCodeCorpus(64 << 20);
+  run("code", &code, repeat);
+  benchFree(&code);
+  return 0;
+}
@@ -0,0 +1,148 @@
+/*
+ * 数值字面量解码：先检查几个下划线放在不同位置的字面量，再确认
+ * 扫描时解码出的每个值都与 strtod/strtoull 的结果完全一致，然后
+ * 比较只扫描、扫描并解码、扫描后复制成 C 字符串再调用
+ * strtod/strtoull 三种做法的速度。
+ *
+ * 用法: bench_numbers [file] [repeat]
+ */
+#include "bench.h"
+#include "literals.h"
+#include "scanner.h"
+
+/* 每个数值 token 都复制成去掉下划线的 C 字符串再转换，这是没有解码时的做法 */
+static double naiveValue(ZyToken t) {
+  char text[512];
+  size_t n = 0;
+  for (size_t i = 0; i < t.length && n + 1 < sizeof(text); i++) {
+    if (t.start[i] != '_')
+      text[n++] = t.start[i];
+  }
+  text[n] = '\0';
+  if (strpbrk(text, ".eE") != NULL && strpbrk(text, "xX") == NULL)
+    return strtod(text, NULL);
+  return (double)strtoull(text, NULL, 0);
+}
+
+static size_t lexAll(const BenchBuffer *corpus, ZyLiteralTable *literals,
+                     int naive, double *checksum) {
+  ZyScanner scanner =
+      zy_initScanner(corpus->data, corpus->data + corpus->length);
+  scanner.literals = literals;
+  size_t numbers = 0;
+  for (ZyToken t = zy_scanToken(&scanner); t.type != TOKEN_EOF;
+       t = zy_scanToken(&scanner)) {
+    if (t.type != TOKEN_NUMBER)
+      continue;
+    numbers++;
+    if (naive)
+      *checksum += naiveValue(t);
+  }
+  return numbers;
+}
+
+static int verify(const BenchBuffer *corpus) {
+  ZyLiteralTable literals;
+  zy_initLiteralTable(&literals);
+  ZyScanner scanner =
+      zy_initScanner(corpus->data, corpus->data + corpus->length);
+  scanner.literals = &literals;
+  for (ZyToken t = zy_scanToken(&scanner); t.type != TOKEN_EOF;
+       t = zy_scanToken(&scanner)) {
+    if (t.type != TOKEN_NUMBER)
+      continue;
+    const ZyLiteral *literal = zy_literal(&literals, t.symbol);
+    int same = 1;
+    if (literal->kind == ZY_LITERAL_FLOAT) {
+      double expected = naiveValue(t);
+      same = memcmp(&expected, &literal->as.number, sizeof(double)) == 0;
+    } else if (literal->kind == ZY_LITERAL_INT) {
+      same = (double)literal->as.integer == naiveValue(t);
+    }
+    if (!same) {
+      fprintf(stderr, "'%.*s' decoded wrongly\n", (int)t.length, t.start);
+      return 1;
+    }
+  }
+  zy_freeLiteralTable(&literals);
+  return 0;
+}
+
+/* text 要扫描成一个数，解码成 kind；合法的浮点数还要等于 value */
+static int checkLiteral(const char *text, ZyLiteralKind kind, double value) {
+  ZyLiteralTable literals;
+  zy_initLiteralTable(&literals);
+  ZyScanner scanner = zy_initScanner(text, text + strlen(text));
+  scanner.literals = &literals;
+  ZyToken t = zy_scanToken(&scanner);
+  int same = t.type == TOKEN_NUMBER && t.length == strlen(text);
+  if (same) {
+    const ZyLiteral *literal = zy_literal(&literals, t.symbol);
+    same = literal->kind == kind &&
+           (kind != ZY_LITERAL_FLOAT || literal->as.number == value);
+  }
+  zy_freeLiteralTable(&literals);
+  if (!same)
+    fprintf(stderr, "'%s' was not scanned or decoded as expected\n", text);
+  return same;
+}
+
+static int checkUnderscores(void) {
+  return checkLiteral("1_000.000_5", ZY_LITERAL_FLOAT, 1000.0005) &
+         checkLiteral("1e1_0", ZY_LITERAL_FLOAT, 1e10) &
+         checkLiteral("1_0.2_5e-0_1", ZY_LITERAL_FLOAT, 1.025) &
+         checkLiteral("0.123_456_789_012_345_678_9", ZY_LITERAL_FLOAT,
+                      0.1234567890123456789) &
+         checkLiteral("1._5", ZY_LITERAL_INVALID, 0) &
+         checkLiteral("1_.5", ZY_LITERAL_INVALID, 0) &
+         checkLiteral("1e_1", ZY_LITERAL_INVALID, 0) &
+         checkLiteral("1.5_", ZY_LITERAL_INVALID, 0) &
+         checkLiteral("1.5__5", ZY_LITERAL_INVALID, 0) &
+         checkLiteral("1e1_", ZY_LITERAL_INVALID, 0) &
+         checkLiteral("1e+_1", ZY_LITERAL_INVALID, 0);
+}
+
+int main(int argc, char *argv[]) {
+  BenchBuffer corpus = (argc > 1 && argv[1][0] != '\0')
+                           ? benchReadFile(argv[1])
+                           : benchNumericCorpus(64 << 20);
+  int repeat = (argc > 2) ? atoi(argv[2]) : 3;
+  if (!checkUnderscores() || verify(&corpus))
+    return 1;
+
+  double lexOnly = 1e30, decoded = 1e30, naive = 1e30, checksum = 0;
+  size_t numbers = 0;
+  for (int i = 0; i < repeat; i++) {
+    double start = benchNow();
+    numbers = lexAll(&corpus, NULL, 0, &checksum);
+    double elapsed = benchNow() - start;
+    if (elapsed < lexOnly)
+      lexOnly = elapsed;
+
+    ZyLiteralTable literals;
+    zy_initLiteralTable(&literals);
+    start = benchNow();
+    lexAll(&corpus, &literals, 0, &checksum);
+    elapsed = benchNow() - start;
+    if (elapsed < decoded)
+      decoded = elapsed;
+    zy_freeLiteralTable(&literals);
+
+    start = benchNow();
+    lexAll(&corpus, NULL, 1, &checksum);
+    elapsed = benchNow() - start;
+    if (elapsed < naive)
+      naive = elapsed;
+  }
+
+  double megabytes = (double)corpus.length / (1 << 20);
+  printf("corpus: %.1f MB, %zu numbers (checksum %g)\n", megabytes, numbers,
+         checksum);
+  printf("lex only          %8.1f MB/s\n", megabytes / lexOnly);
+  printf("lex + decode      %8.1f MB/s  %6.1f ns/number\n",
+         megabytes / decoded, (decoded - lexOnly) / numbers * 1e9);
+  printf("lex + strtod      %8.1f MB/s  %6.1f ns/number\n",
+         megabytes / naive, (naive - lexOnly) / numbers * 1e9);
+  benchFree(&corpus);
+  return 0;
+}
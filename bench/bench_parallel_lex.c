@@ -0,0 +1,71 @@
+/*
+ * 并行词法分析：用 1 到 N 个线程把语料扫描成 token 表，
+ * 确认结果与串行完全一致，并输出吞吐量。N 默认是核数，但至少
+ * 是 4，单核机器上也要检查分块拼接；线程数超过核数时只检查
+ * 结果，不计时。
+ *
+ * 用法: bench_parallel_lex [file] [maxThreads] [repeat]
+ */
+#include <unistd.h>
+
+#include "bench.h"
+#include "tokens.h"
+
+static int sameTokens(const ZyTokenBuffer *a, const ZyTokenBuffer *b) {
+  return a->count == b->count && a->errorCount == b->errorCount &&
+         memcmp(a->types, b->types, a->count) == 0 &&
+         memcmp(a->offsets, b->offsets, a->count * sizeof(uint32_t)) == 0 &&
+         memcmp(a->lengths, b->lengths, a->count * sizeof(uint32_t)) == 0;
+}
+
+int main(int argc, char *argv[]) {
+  BenchBuffer corpus = (argc > 1 && argv[1][0] != '\0')
+                           ? benchReadFile(argv[1])
+                           : benchCodeCorpus(256 << 20);
+  int cores = (int)sysconf(_SC_NPROCESSORS_ONLN);
+  int maxThreads = (argc > 2) ? atoi(argv[2]) : (cores > 4 ? cores : 4);
+  int repeat = (argc > 3) ? atoi(argv[3]) : 3;
+  const char *begin = corpus.data;
+  const char *end = corpus.data + corpus.length;
+  double megabytes = (double)corpus.length / (1 << 20);
+  if (maxThreads < 1)
+    maxThreads = 1;
+
+  ZyTokenBuffer serial;
+  zy_scanTokens(begin, end, &serial);
+  printf("corpus: %.1f MB, %zu tokens, %d cores\n", megabytes, serial.count,
+         cores);
+
+  double baseline = 0;
+  for (int threads = 1; threads <= maxThreads; threads *= 2) {
+    /* 核不够时计时没有意义，只跑一遍检查结果 */
+    int timed = threads == 1 || threads <= cores;
+    double best = 1e30;
+    for (int i = 0; i < (timed ? repeat : 1); i++) {
+      ZyTokenBuffer tokens;
+      double start = benchNow();
+      zy_scanTokensParallel(begin, end, threads, &tokens);
+      double elapsed = benchNow() - start;
+      if (!sameTokens(&serial, &tokens)) {
+        fprintf(stderr, "%d threads produced different tokens\n", threads);
+        return 1;
+      }
+      zy_freeTokenBuffer(&tokens);
+      if (elapsed < best)
+        best = elapsed;
+    }
+    if (threads == 1)
+      baseline = best;
+    if (timed)
+      printf("%3d threads  %8.1f MB/s  speedup %.2fx\n", threads,
+             megabytes / best, baseline / best);
+    else
+      printf("%3d threads  same tokens as serial (more threads than cores, "
+             "not timed)\n",
+             threads);
+  }
+
+  zy_freeTokenBuffer(&serial);
+  benchFree(&corpus);
+  return 0;
+}
@@ -0,0 +1,64 @@
+/*
+ * 并行语法分析：用 1 到 N 个线程解析语料，确认语法树与串行
+ * 解析完全一致（节点种类、修饰符、token 和子节点），并输出
+ * 吞吐量。N 默认是核数，但至少是 4，单核机器上也要检查分段
+ * 拼接；线程数超过核数时只检查结果，不计时。
+ *
+ * 用法: bench_parallel_parse [file] [maxThreads] [repeat]
+ */
+#include <unistd.h>
+
+#include "bench.h"
+#include "parser.h"
+
+int main(int argc, char *argv[]) {
+  BenchBuffer corpus = (argc > 1 && argv[1][0] != '\0')
+                           ? benchReadFile(argv[1])
+                           : benchCodeCorpus(32 << 20);
+  int cores = (int)sysconf(_SC_NPROCESSORS_ONLN);
+  int maxThreads = (argc > 2) ? atoi(argv[2]) : (cores > 4 ? cores : 4);
+  int repeat = (argc > 3) ? atoi(argv[3]) : 3;
+  const char *begin = corpus.data;
+  const char *end = corpus.data + corpus.length;
+  double megabytes = (double)corpus.length / (1 << 20);
+  if (maxThreads < 1)
+    maxThreads = 1;
+
+  int serialError;
+  Ast *serial = zy_parse(begin, end, &serialError);
+  printf("corpus: %.1f MB, %d statements, %d cores\n", megabytes,
+         astNumChild(serial), cores);
+
+  double baseline = 0;
+  for (int threads = 1; threads <= maxThreads; threads *= 2) {
+    /* 核不够时计时没有意义，只跑一遍检查结果 */
+    int timed = threads == 1 || threads <= cores;
+    double best = 1e30;
+    for (int i = 0; i < (timed ? repeat : 1); i++) {
+      int hadError;
+      double start = benchNow();
+      Ast *script = zy_parseParallel(begin, end, threads, &hadError);
+      double elapsed = benchNow() - start;
+      if (hadError != serialError || !benchSameAst(serial, script)) {
+        fprintf(stderr, "%d threads produced a different tree\n", threads);
+        return 1;
+      }
+      freeAst(script, true);
+      if (elapsed < best)
+        best = elapsed;
+    }
+    if (threads == 1)
+      baseline = best;
+    if (timed)
+      printf("%3d threads  %8.1f MB/s  speedup %.2fx\n", threads,
+             megabytes / best, baseline / best);
+    else
+      printf("%3d threads  same tree as serial (more threads than cores, "
+             "not timed)\n",
+             threads);
+  }
+
+  freeAst(serial, true);
+  benchFree(&corpus);
+  return 0;
+}
@@ -0,0 +1,163 @@
+/*
+ * 语法分析：先检查几个短表达式解析出的树，确认整份语料能无错误地
+ * 解析，再测量 zy_parse 的吞吐量（行/秒、节点/秒）和释放整棵语法树
+ * 的时间。
+ *
+ * 用法: bench_parse [file] [repeat]
+ */
+#include "bench.h"
+#include "parser.h"
+
+/*
+ * 扫描器基准的 generated 语料缩进不一致，这里另外生成一份覆盖
+ * 各种语句和表达式的语料。
+ */
+static BenchBuffer statementCorpus(size_t targetBytes) {
+  BenchBuffer buffer = {};
+  for (int block = 0; buffer.length < targetBytes; block++) {
+    benchAppend(&buffer, "@dataclass(frozen=True)\n");
+    benchAppendf(&buffer, "class Record%d(Base, metaclass=Meta):\n", block);
+    benchAppend(&buffer, "    name: str = ''\n");
+    benchAppend(&buffer, "    async def load(self, *paths, **options):\n");
+    benchAppend(&buffer, "        async with open(paths[0]) as f, lock:\n");
+    benchAppend(&buffer, "            data = await f.read()\n");
+    benchAppend(&buffer, "        try:\n");
+    benchAppend(&buffer, "            rows = [r.split(',') for r in data "
+                         "if r and not r.startswith('#')]\n");
+    benchAppend(&buffer, "        except (KeyError, ValueError) as e:\n");
+    benchAppend(&buffer, "            raise LoadError(str(e)) from e\n");
+    benchAppend(&buffer, "        finally:\n");
+    benchAppend(&buffer, "            del data\n");
+    benchAppend(&buffer, "        index = {k: v for k, v in enumerate(rows)}\n");
+    benchAppend(&buffer, "        first, *rest = rows or [None]\n");
+    benchAppend(&buffer, "        self.rows[1:-1], total = rest, "
+                         "sum(x[0] for x in rest)\n");
+    benchAppend(&buffer, "        assert total >= 0, f'negative {total}'\n");
+    benchAppend(&buffer, "        return index if options.get('raw') "
+                         "else (first, total)\n\n");
+    benchAppendf(&buffer, "def handle_%d(event, /, *, retries=3):\n", block);
+    benchAppend(&buffer, "    global counter\n");
+    benchAppend(&buffer, "    from .util import (retry as r, log)\n");
+    benchAppend(&buffer, "    while (n := retries) > 0:\n");
+    benchAppend(&buffer, "        counter += 1; retries -= 1\n");
+    benchAppend(&buffer, "        yield lambda x=n: x ** 2 % 7\n\n");
+  }
+  return buffer;
+}
+
+static size_t countNodes(Ast *ast) {
+  if (ast == NULL)
+    return 0;
+  size_t count = 1;
+  for (int i = 0; i < astNumChild(ast); i++)
+    count += countNodes(astGetChild(ast, i));
+  return count;
+}
+
+static size_t countLines(const BenchBuffer *corpus) {
+  size_t lines = 0;
+  for (size_t i = 0; i < corpus->length; i++)
+    lines += corpus->data[i] == '\n';
+  return lines;
+}
+
+/* ast 是种类为 kind、token 为 text 的节点 */
+static int isNode(Ast *ast, AstNodeKind kind, const char *text) {
+  return ast != NULL && ast->kind == kind &&
+         ast->token.length == strlen(text) &&
+         memcmp(ast->token.start, text, ast->token.length) == 0;
+}
+
+/* `a--b` 是 a - (-b)，`--x` 是 -(-x)，Python 没有 `--` 运算符 */
+static int checkExpressions(void) {
+  const char *source = "a--b\n--x\n";
+  int hadError;
+  Ast *script = zy_parse(source, source + strlen(source), &hadError);
+  if (hadError || astNumChild(script) != 2) {
+    fprintf(stderr, "`a--b` or `--x` did not parse\n");
+    return 0;
+  }
+  Ast *binary = astFirstChild(astGetChild(script, 0));
+  Ast *negated = astFirstChild(astGetChild(script, 1));
+  int same = isNode(binary, AST_EXPR_BINARY, "-") &&
+             isNode(astGetChild(binary, 0), AST_EXPR_VARIABLE, "a") &&
+             isNode(astGetChild(binary, 1), AST_EXPR_UNARY, "-") &&
+             isNode(astFirstChild(astGetChild(binary, 1)), AST_EXPR_VARIABLE,
+                    "b") &&
+             isNode(negated, AST_EXPR_UNARY, "-") &&
+             isNode(astFirstChild(negated), AST_EXPR_UNARY, "-") &&
+             isNode(astFirstChild(astFirstChild(negated)), AST_EXPR_VARIABLE,
+                    "x");
+  freeAst(script, true);
+  if (!same)
+    fprintf(stderr, "`a--b` or `--x` was parsed wrongly\n");
+  return same;
+}
+
+static int verify(const char *name, const BenchBuffer *corpus) {
+  int hadError;
+  Ast *ast = zy_parse(corpus->data, corpus->data + corpus->length, &hadError);
+  if (hadError) {
+    fprintf(stderr, "%s: parse errors\n", name);
+    return 1;
+  }
+  printf("%s corpus: %.1f MB, %zu lines, %zu nodes\n", name,
+         (double)corpus->length / (1 << 20), countLines(corpus),
+         countNodes(ast));
+  freeAst(ast, true);
+  return 0;
+}
+
+static void run(const BenchBuffer *corpus, int repeat) {
+  double megabytes = (double)corpus->length / (1 << 20);
+  double lines = (double)countLines(corpus);
+  double nodes = 0;
+  double parse = 1e30, release = 1e30;
+  for (int i = 0; i < repeat; i++) {
+    int hadError;
+    double start = benchNow();
+    Ast *ast =
+        zy_parse(corpus->data, corpus->data + corpus->length, &hadError);
+    double elapsed = benchNow() - start;
+    if (elapsed < parse)
+      parse = elapsed;
+    nodes = (double)countNodes(ast);
+
+    start = benchNow();
+    freeAst(ast, true);
+    elapsed = benchNow() - start;
+    if (elapsed < release)
+      release = elapsed;
+  }
+  printf("  parse %8.2f Mlines/s %8.2f Mnodes/s %8.1f MB/s   free %8.1f ms\n",
+         lines / parse / 1e6, nodes / parse / 1e6, megabytes / parse,
+         release * 1e3);
+}
+
+int main(int argc, char *argv[]) {
+  int repeat = (argc > 2) ? atoi(argv[2]) : 5;
+  if (!checkExpressions())
+    return 1;
+  if (argc > 1 && argv[1][0] != '\0') {
+    BenchBuffer corpus = benchReadFile(argv[1]);
+    if (verify(argv[1], &corpus))
+      return 1;
+    run(&corpus, repeat);
+    benchFree(&corpus);
+    return 0;
+  }
+
+  /* 每个节点约 200 字节的 malloc，语料比扫描器的基准小 */
+  BenchBuffer statements = statementCorpus(16 << 20);
+  if (verify("statements", &statements))
+    return 1;
+  run(&statements, repeat);
+  benchFree(&statements);
+
+  BenchBuffer code = benchCodeCorpus(16 << 20);
+  if (verify("code", &code))
+    return 1;
+  run(&code, repeat);
+  benchFree(&code);
+  return 0;
+}
@@ -0,0 +1,130 @@
+/*
+ * 输出语法树：先确认 JSON 输出的节点数与语法树一致，再比较解析
+ * 的时间和用 human、JSON、S 表达式三种格式输出整棵树的时间。
+ * 输出写到一个临时文件。
+ *
+ * 用法: bench_print [file] [repeat]
+ */
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "bench.h"
+#include "parser.h"
+
+static size_t countNodes(Ast *ast) {
+  if (ast == NULL)
+    return 0;
+  size_t count = 1;
+  for (int i = 0; i < astNumChild(ast); i++)
+    count += countNodes(astGetChild(ast, i));
+  return count;
+}
+
+/* 把 JSON 输出写到临时文件，数一数有多少个 "kind" */
+static int verify(const char *name, Ast *script, const char *src) {
+  FILE *file = tmpfile();
+  if (file == NULL) {
+    perror("tmpfile");
+    return 1;
+  }
+  ZyOutput out;
+  zy_openOutput(&out, fileno(file), ZY_FORMAT_JSON);
+  astWrite(&out, script, src);
+  zy_closeOutput(&out);
+  rewind(file);
+  size_t kinds = 0, matched = 0;
+  const char *key = "\"kind\":";
+  int c;
+  while ((c = getc(file)) != EOF) {
+    matched = (c == key[matched]) ? matched + 1 : (c == key[0]);
+    if (key[matched] == '\0') {
+      kinds++;
+      matched = 0;
+    }
+  }
+  fclose(file);
+  if (kinds != countNodes(script)) {
+    fprintf(stderr, "%s: JSON has %zu nodes, tree has %zu\n", name, kinds,
+            countNodes(script));
+    return 1;
+  }
+  return 0;
+}
+
+static double timeWrite(Ast *script, const char *src, ZyOutputFormat format,
+                        int fd, int repeat, size_t *bytes) {
+  double best = 1e30;
+  for (int i = 0; i < repeat; i++) {
+    ZyOutput out;
+    off_t before = lseek(fd, 0, SEEK_CUR);
+    double start = benchNow();
+    zy_openOutput(&out, fd, format);
+    astWrite(&out, script, src);
+    zy_closeOutput(&out);
+    double elapsed = benchNow() - start;
+    if (elapsed < best)
+      best = elapsed;
+    *bytes = (size_t)(lseek(fd, 0, SEEK_CUR) - before);
+  }
+  return best;
+}
+
+static int run(const char *name, const BenchBuffer *corpus, int repeat) {
+  const char *begin = corpus->data, *end = corpus->data + corpus->length;
+  AstArena arena;
+  astInitArena(&arena);
+  astUseArena(&arena);
+  double parse = 1e30;
+  Ast *script = NULL;
+  for (int i = 0; i < repeat; i++) {
+    int hadError;
+    astFreeArena(&arena);
+    double start = benchNow();
+    script = zy_parse(begin, end, &hadError);
+    double elapsed = benchNow() - start;
+    if (elapsed < parse)
+      parse = elapsed;
+  }
+  astUseArena(NULL);
+  if (verify(name, script, begin))
+    return 1;
+
+  /* 不用 /dev/null 是为了拿到写出的字节数 */
+  FILE *sink = tmpfile();
+  if (sink == NULL) {
+    perror("tmpfile");
+    return 1;
+  }
+  int fd = fileno(sink);
+  printf("%s corpus: %.1f MB, %zu nodes, parse %.1f ms\n", name,
+         (double)corpus->length / (1 << 20), countNodes(script), parse * 1e3);
+  static const struct {
+    const char *name;
+    ZyOutputFormat format;
+  } formats[] = {{"human", ZY_FORMAT_HUMAN},
+                 {"json", ZY_FORMAT_JSON},
+                 {"sexp", ZY_FORMAT_SEXP}};
+  for (size_t i = 0; i < sizeof(formats) / sizeof(formats[0]); i++) {
+    size_t bytes;
+    double elapsed =
+        timeWrite(script, begin, formats[i].format, fd, repeat, &bytes);
+    printf("  %-6s %8.1f ms %8.1f MB  %.2fx parse\n", formats[i].name,
+           elapsed * 1e3, (double)bytes / (1 << 20), elapsed / parse);
+    ftruncate(fd, 0);
+    lseek(fd, 0, SEEK_SET);
+  }
+  fclose(sink);
+  astFreeArena(&arena);
+  return 0;
+}
+
+int main(int argc, char *argv[]) {
+  int repeat = (argc > 2) ? atoi(argv[2]) : 5;
+  BenchBuffer corpus = (argc > 1 && argv[1][0] != '\0')
+                           ? benchReadFile(argv[1])
+                           : benchCodeCorpus(16 << 20);
+  int status = run(argc > 1 && argv[1][0] != '\0' ? argv[1] : "code", &corpus,
+                   repeat);
+  benchFree(&corpus);
+  return status;
+}
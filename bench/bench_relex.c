@@ -0,0 +1,93 @@
+/*
+ * 增量词法分析：对语料做一连串随机编辑，每次用 zy_relexTokens
+ * 更新 token 表，确认结果与整个重新扫描完全一致，并比较两者的耗时。
+ *
+ * 用法: bench_relex [file] [edits]
+ */
+#include "bench.h"
+#include "tokens.h"
+
+static int sameTokens(const ZyTokenBuffer *a, const ZyTokenBuffer *b) {
+  if (a->count != b->count || a->errorCount != b->errorCount ||
+      memcmp(a->types, b->types, a->count) != 0 ||
+      memcmp(a->offsets, b->offsets, a->count * sizeof(uint32_t)) != 0 ||
+      memcmp(a->lengths, b->lengths, a->count * sizeof(uint32_t)) != 0)
+    return 0;
+  for (size_t i = 0; i < a->errorCount; i++) {
+    if (a->errors[i].index != b->errors[i].index ||
+        a->errors[i].error != b->errors[i].error)
+      return 0;
+  }
+  return 1;
+}
+
+static uint64_t lcg = 0x2545F4914F6CDD1DULL;
+
+static size_t randomBelow(size_t n) {
+  lcg = lcg * 6364136223846793005ULL + 1442695040888963407ULL;
+  return n == 0 ? 0 : (size_t)(lcg >> 33) % n;
+}
+
+/* 编辑时插入的片段，包括会改变后面很多 token 的引号和续行符 */
+static const char *snippets[] = {
+    "x",     " ",       "\n",      "    ", "\t",   "foo(bar, 1)",
+    "'",     "\"\"\"",  "#",       "\\\n", "0x1f", "if a:\n    b = 2\n",
+    " ** ",  "\"abc\"", ":=",      ".",    "",     "def f():\n",
+};
+
+int main(int argc, char *argv[]) {
+  BenchBuffer corpus = (argc > 1 && argv[1][0] != '\0')
+                           ? benchReadFile(argv[1])
+                           : benchCodeCorpus(8 << 20);
+  int edits = (argc > 2) ? atoi(argv[2]) : 2000;
+
+  ZyTokenBuffer tokens;
+  zy_scanTokens(corpus.data, corpus.data + corpus.length, &tokens);
+  printf("corpus: %.1f MB, %zu tokens\n", (double)corpus.length / (1 << 20),
+         tokens.count);
+
+  double relexTime = 0, fullTime = 0;
+  for (int i = 0; i < edits; i++) {
+    const char *text = snippets[randomBelow(sizeof(snippets) /
+                                            sizeof(snippets[0]))];
+    ZyEdit edit;
+    edit.offset = (uint32_t)randomBelow(corpus.length + 1);
+    edit.removed = (uint32_t)randomBelow(
+        corpus.length - edit.offset < 8 ? corpus.length - edit.offset + 1
+                                        : 8);
+    edit.inserted = (uint32_t)strlen(text);
+
+    /* 原地修改源码 */
+    size_t tail = corpus.length - edit.offset - edit.removed;
+    benchReserve(&corpus, edit.inserted);
+    memmove(corpus.data + edit.offset + edit.inserted,
+            corpus.data + edit.offset + edit.removed, tail);
+    memcpy(corpus.data + edit.offset, text, edit.inserted);
+    corpus.length = corpus.length - edit.removed + edit.inserted;
+    corpus.data[corpus.length] = '\0';
+    const char *end = corpus.data + corpus.length;
+
+    double start = benchNow();
+    zy_relexTokens(&tokens, corpus.data, end, edit);
+    relexTime += benchNow() - start;
+
+    ZyTokenBuffer full;
+    start = benchNow();
+    zy_scanTokens(corpus.data, end, &full);
+    fullTime += benchNow() - start;
+
+    if (!sameTokens(&tokens, &full)) {
+      fprintf(stderr, "edit %d at offset %u produced different tokens\n", i,
+              edit.offset);
+      return 1;
+    }
+    zy_freeTokenBuffer(&full);
+  }
+
+  printf("%d edits: relex %.1f us/edit, full rescan %.1f us/edit (%.0fx)\n",
+         edits, relexTime / edits * 1e6, fullTime / edits * 1e6,
+         fullTime / relexTime);
+  zy_freeTokenBuffer(&tokens);
+  benchFree(&corpus);
+  return 0;
+}
@@ -0,0 +1,113 @@
+/*
+ * 解析器回退：赋值语句要先按表达式解析，看到`=`才回到开头按
+ * 赋值目标重新解析；每个表达式语句和关键字参数都要记录回退点。
+ * 先确认赋值和条件表达式的节点个数与生成的语料一致，再测量
+ * 这两种语料的解析吞吐量。
+ *
+ * 用法: bench_rewind [repeat]
+ */
+#include "bench.h"
+#include "parser.h"
+
+/* 每一块里的赋值和条件表达式个数，与下面生成的文本一致 */
+#define ASSIGNS_PER_BLOCK 8
+#define TERNARY_ASSIGNS_PER_BLOCK 2
+#define TERNARIES_PER_BLOCK 6
+
+/* 多目标和解包赋值：都要回退一次 */
+static BenchBuffer assignmentCorpus(size_t targetBytes, size_t *blocks) {
+  BenchBuffer buffer = {};
+  size_t block = 0;
+  for (; buffer.length < targetBytes; block++) {
+    benchAppendf(&buffer, "a%zu, b = b, a\n", block);
+    benchAppend(&buffer, "self.x, self.y = point[0], point[1]\n");
+    benchAppend(&buffer, "(first, *rest), last = items, items[-1]\n");
+    benchAppend(&buffer, "table[key], count = value, count + 1\n");
+    benchAppend(&buffer, "x = y = z = compute(a, b, scale=2)\n");
+    benchAppend(&buffer, "obj.attr.inner, [p, q] = f(x)(y), (1, 2)\n");
+  }
+  *blocks = block;
+  return buffer;
+}
+
+/* 表达式语句和关键字参数里的条件表达式 */
+static BenchBuffer ternaryCorpus(size_t targetBytes, size_t *blocks) {
+  BenchBuffer buffer = {};
+  size_t block = 0;
+  for (; buffer.length < targetBytes; block++) {
+    benchAppendf(&buffer, "v%zu = a if a > b else b\n", block);
+    benchAppend(&buffer, "call(x if x else y, key=p if q else r)\n");
+    benchAppend(&buffer, "w = (n if n < limit else limit) if ok else 0\n");
+    benchAppend(&buffer, "values[i] if i < len(values) else default\n");
+  }
+  *blocks = block;
+  return buffer;
+}
+
+static void countKinds(Ast *ast, size_t *assigns, size_t *ternaries) {
+  if (ast == NULL)
+    return;
+  if (ast->kind == AST_EXPR_ASSIGN)
+    (*assigns)++;
+  else if (ast->kind == AST_EXPR_TERNARY)
+    (*ternaries)++;
+  for (int i = 0; i < astNumChild(ast); i++)
+    countKinds(astGetChild(ast, i), assigns, ternaries);
+}
+
+static int verify(const char *name, const BenchBuffer *corpus,
+                  size_t assigns, size_t ternaries) {
+  int hadError;
+  Ast *ast = zy_parse(corpus->data, corpus->data + corpus->length, &hadError);
+  size_t foundAssigns = 0, foundTernaries = 0;
+  countKinds(ast, &foundAssigns, &foundTernaries);
+  freeAst(ast, true);
+  if (hadError || foundAssigns != assigns || foundTernaries != ternaries) {
+    fprintf(stderr,
+            "%s: %zu assignments and %zu ternaries, expected %zu and %zu\n",
+            name, foundAssigns, foundTernaries, assigns, ternaries);
+    return 1;
+  }
+  printf("%s corpus: %.1f MB, %zu assignments, %zu ternaries\n", name,
+         (double)corpus->length / (1 << 20), assigns, ternaries);
+  return 0;
+}
+
+static void run(const BenchBuffer *corpus, int repeat) {
+  double megabytes = (double)corpus->length / (1 << 20);
+  size_t lines = 0;
+  for (size_t i = 0; i < corpus->length; i++)
+    lines += corpus->data[i] == '\n';
+  double best = 1e30;
+  for (int i = 0; i < repeat; i++) {
+    int hadError;
+    double start = benchNow();
+    Ast *ast =
+        zy_parse(corpus->data, corpus->data + corpus->length, &hadError);
+    double elapsed = benchNow() - start;
+    if (elapsed < best)
+      best = elapsed;
+    freeAst(ast, true);
+  }
+  printf("  parse %8.2f Mlines/s %8.1f MB/s\n", (double)lines / best / 1e6,
+         megabytes / best);
+}
+
+int main(int argc, char *argv[]) {
+  int repeat = (argc > 1) ? atoi(argv[1]) : 5;
+  size_t blocks;
+
+  BenchBuffer assignments = assignmentCorpus(16 << 20, &blocks);
+  if (verify("assignment", &assignments, blocks * ASSIGNS_PER_BLOCK, 0))
+    return 1;
+  run(&assignments, repeat);
+  benchFree(&assignments);
+
+  BenchBuffer ternaries = ternaryCorpus(16 << 20, &blocks);
+  if (verify("ternary", &ternaries, blocks * TERNARY_ASSIGNS_PER_BLOCK,
+             blocks * TERNARIES_PER_BLOCK))
+    return 1;
+  run(&ternaries, repeat);
+  benchFree(&ternaries);
+  return 0;
+}
@@ -0,0 +1,114 @@
+/*
+ * 字符串字面量解码：先确认语料中每对字符串（一个不带转义、一个
+ * 带转义）解码出的内容完全一样，而且不带转义的直接引用源码，
+ * 再比较只扫描、扫描并解码、扫描后逐个 malloc 复制三种做法的速度。
+ *
+ * 用法: bench_strings [file] [repeat]
+ */
+#include "bench.h"
+#include "literals.h"
+#include "scanner.h"
+
+static int isString(ZyTokenType type) {
+  return type == TOKEN_STRING || type == TOKEN_BIG_STRING;
+}
+
+/* mode 0 只扫描，1 解码到 arena，2 像以前那样 malloc 一份再释放 */
+static size_t lexAll(const BenchBuffer *corpus, int mode, size_t *checksum) {
+  ZyArena arena;
+  zy_initArena(&arena);
+  ZyScanner scanner =
+      zy_initScanner(corpus->data, corpus->data + corpus->length);
+  size_t strings = 0;
+  ZyTokenType previous = TOKEN_EOF;
+  for (ZyToken t = zy_scanToken(&scanner); t.type != TOKEN_EOF;
+       previous = t.type, t = zy_scanToken(&scanner)) {
+    if (!isString(t.type))
+      continue;
+    strings++;
+    if (mode == 1) {
+      ZyString string = zy_decodeString(t.start, t.length,
+                                        zy_stringFlags(previous), &arena);
+      *checksum += string.length;
+    } else if (mode == 2) {
+      char *copy = (char *)malloc(t.length + 1);
+      memcpy(copy, t.start, t.length);
+      copy[t.length] = '\0';
+      *checksum += strlen(copy);
+      free(copy);
+    }
+  }
+  zy_freeArena(&arena);
+  return strings;
+}
+
+static int verify(const BenchBuffer *corpus) {
+  ZyArena arena;
+  zy_initArena(&arena);
+  ZyScanner scanner =
+      zy_initScanner(corpus->data, corpus->data + corpus->length);
+  ZyString plain = {};
+  int havePlain = 0;
+  for (ZyToken t = zy_scanToken(&scanner); t.type != TOKEN_EOF;
+       t = zy_scanToken(&scanner)) {
+    if (!isString(t.type))
+      continue;
+    ZyString string = zy_decodeString(t.start, t.length, 0, &arena);
+    if (!string.valid) {
+      fprintf(stderr, "'%.*s' failed to decode\n", (int)t.length, t.start);
+      return 1;
+    }
+    if (!havePlain) {
+      if (memchr(t.start, '\\', t.length) == NULL &&
+          (string.chars < t.start || string.chars >= t.start + t.length)) {
+        fprintf(stderr, "'%.*s' was copied\n", (int)t.length, t.start);
+        return 1;
+      }
+      plain = string;
+      havePlain = 1;
+      continue;
+    }
+    if (string.length != plain.length ||
+        memcmp(string.chars, plain.chars, plain.length) != 0) {
+      fprintf(stderr, "'%.*s' decoded to '%.*s'\n", (int)t.length, t.start,
+              (int)string.length, string.chars);
+      return 1;
+    }
+    havePlain = 0;
+  }
+  zy_freeArena(&arena);
+  return 0;
+}
+
+int main(int argc, char *argv[]) {
+  int fromFile = argc > 1 && argv[1][0] != '\0';
+  BenchBuffer corpus =
+      fromFile ? benchReadFile(argv[1]) : benchStringCorpus(64 << 20);
+  int repeat = (argc > 2) ? atoi(argv[2]) : 3;
+  /* 任意文件里的字符串不是成对出现的，只检查生成的语料 */
+  if (!fromFile && verify(&corpus))
+    return 1;
+
+  double times[3] = {1e30, 1e30, 1e30};
+  size_t strings = 0, checksum = 0;
+  for (int i = 0; i < repeat; i++) {
+    for (int mode = 0; mode < 3; mode++) {
+      double start = benchNow();
+      strings = lexAll(&corpus, mode, &checksum);
+      double elapsed = benchNow() - start;
+      if (elapsed < times[mode])
+        times[mode] = elapsed;
+    }
+  }
+
+  double megabytes = (double)corpus.length / (1 << 20);
+  printf("corpus: %.1f MB, %zu strings (checksum %zu)\n", megabytes, strings,
+         checksum);
+  printf("lex only          %8.1f MB/s\n", megabytes / times[0]);
+  printf("lex + decode      %8.1f MB/s  %6.1f ns/string\n",
+         megabytes / times[1], (times[1] - times[0]) / strings * 1e9);
+  printf("lex + malloc copy %8.1f MB/s  %6.1f ns/string\n",
+         megabytes / times[2], (times[2] - times[0]) / strings * 1e9);
+  benchFree(&corpus);
+  return 0;
+}
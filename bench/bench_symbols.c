@@ -0,0 +1,96 @@
+/*
+ * 符号表：扫描时驻留标识符和不带转义的字符串，确认相同的名字
+ * 得到相同的 ID、不同的名字得到不同的 ID，并测量驻留的额外开销。
+ *
+ * 用法: bench_symbols [file] [repeat]
+ */
+#include "bench.h"
+#include "scanner.h"
+#include "symbols.h"
+
+static size_t lexAll(const BenchBuffer *corpus, ZySymbolTable *symbols) {
+  ZyScanner scanner =
+      zy_initScanner(corpus->data, corpus->data + corpus->length);
+  scanner.symbols = symbols;
+  size_t count = 0;
+  for (ZyToken t = zy_scanToken(&scanner); t.type != TOKEN_EOF;
+       t = zy_scanToken(&scanner))
+    count++;
+  return count;
+}
+
+static int verify(const BenchBuffer *corpus, ZySymbolTable *symbols) {
+  ZyScanner scanner =
+      zy_initScanner(corpus->data, corpus->data + corpus->length);
+  scanner.symbols = symbols;
+  for (ZyToken t = zy_scanToken(&scanner); t.type != TOKEN_EOF;
+       t = zy_scanToken(&scanner)) {
+    const char *text = t.start;
+    size_t length = t.length;
+    if (t.type == TOKEN_STRING) {
+      text++;
+      length -= 2;
+    }
+    if (t.symbol == ZY_NO_SYMBOL) {
+      if (t.type == TOKEN_IDENTIFIER) {
+        fprintf(stderr, "identifier '%.*s' was not interned\n", (int)length,
+                text);
+        return 1;
+      }
+      continue;
+    }
+    const ZySymbol *symbol = zy_symbol(symbols, t.symbol);
+    if (symbol->length != length || memcmp(symbol->name, text, length) != 0 ||
+        zy_intern(symbols, text, length) != t.symbol) {
+      fprintf(stderr, "'%.*s' has symbol %u ('%s')\n", (int)length, text,
+              t.symbol, symbol->name);
+      return 1;
+    }
+  }
+  /* 每个 ID 的名字都不同 */
+  for (uint32_t id = 1; id < symbols->count; id++) {
+    const ZySymbol *symbol = zy_symbol(symbols, id);
+    if (zy_intern(symbols, symbol->name, symbol->length) != id) {
+      fprintf(stderr, "symbol %u ('%s') is a duplicate\n", id, symbol->name);
+      return 1;
+    }
+  }
+  return 0;
+}
+
+int main(int argc, char *argv[]) {
+  BenchBuffer corpus = (argc > 1 && argv[1][0] != '\0')
+                           ? benchReadFile(argv[1])
+                           : benchCodeCorpus(64 << 20);
+  int repeat = (argc > 2) ? atoi(argv[2]) : 3;
+
+  ZySymbolTable symbols;
+  zy_initSymbolTable(&symbols);
+  if (verify(&corpus, &symbols))
+    return 1;
+  printf("corpus: %.1f MB, %u distinct symbols\n",
+         (double)corpus.length / (1 << 20), symbols.count - 1);
+
+  double plain = 1e30, interned = 1e30;
+  size_t tokens = 0;
+  for (int i = 0; i < repeat; i++) {
+    double start = benchNow();
+    tokens = lexAll(&corpus, NULL);
+    double elapsed = benchNow() - start;
+    if (elapsed < plain)
+      plain = elapsed;
+
+    start = benchNow();
+    lexAll(&corpus, &symbols);
+    elapsed = benchNow() - start;
+    if (elapsed < interned)
+      interned = elapsed;
+  }
+  printf("plain     %8.1f Mtok/s\n", tokens / plain / 1e6);
+  printf("interned  %8.1f Mtok/s  (%+.1f%%)\n", tokens / interned / 1e6,
+         (plain / interned - 1) * 100);
+
+  zy_freeSymbolTable(&symbols);
+  benchFree(&corpus);
+  return 0;
+}
@@ -0,0 +1,175 @@
+/*
+ * UTF-8 校验：先确认各级 SIMD 内核找到的第一个不合法位置与逐个
+ * 解码的结果一致，随机破坏语料之后扫描器能在对应的位置报错，
+ * 合法的非 ASCII 标识符整个作为一个 token；再测量校验内核本身
+ * 和扫描非 ASCII 语料的吞吐量。
+ *
+ * 用法: bench_utf8 [file] [repeat]
+ */
+#include "bench.h"
+#include "scanner.h"
+#include "simd.h"
+#include "unicode.h"
+
+static uint64_t lcg = 0x2545F4914F6CDD1DULL;
+
+static size_t randomBelow(size_t n) {
+  lcg = lcg * 6364136223846793005ULL + 1442695040888963407ULL;
+  return n == 0 ? 0 : (size_t)(lcg >> 33) % n;
+}
+
+/* 参照实现：逐个字符解码 */
+static const char *referenceInvalid(const char *p, const char *end) {
+  uint32_t c;
+  while (p < end) {
+    size_t length = zy_decodeUtf8(p, end, &c);
+    if (length == 0)
+      return p;
+    p += length;
+  }
+  return p;
+}
+
+static int checkKernels(const char *p, const char *end, const char *what) {
+  const char *expected = referenceInvalid(p, end);
+  for (ZySimdLevel level = ZY_SIMD_SCALAR; level <= ZY_SIMD_AVX2; level++) {
+    if (zy_setSimdLevel(level) != level)
+      continue;
+    const char *found = zy_findInvalidUtf8(p, end);
+    if (found != expected) {
+      fprintf(stderr, "%s: %s found offset %td, expected %td\n", what,
+              zy_simdLevelName(level), found - p, expected - p);
+      return 1;
+    }
+  }
+  zy_setSimdLevel(ZY_SIMD_AVX2);
+  return 0;
+}
+
+/*
+ * 扫描 [p, end)，返回覆盖 bad 的错误 token 个数（比如没结束的字符串
+ * 已经是错误了，不会再报告其中的 UTF-8）。bad 为 NULL 时返回 UTF-8
+ * 错误的总数。
+ */
+static size_t errorsAt(const char *p, const char *end, const char *bad) {
+  ZyScanner scanner = zy_initScanner(p, end);
+  size_t count = 0;
+  while (1) {
+    ZyToken t = zy_scanToken(&scanner);
+    if (t.type == TOKEN_ERROR &&
+        (bad == NULL ? t.symbol == ZY_ERROR_INVALID_UTF8
+                     : bad >= t.start && bad < t.start + t.length))
+      count++;
+    if (t.type == TOKEN_EOF)
+      break;
+  }
+  return count;
+}
+
+static int verify(const BenchBuffer *corpus) {
+  const char *end = corpus->data + corpus->length;
+  if (checkKernels(corpus->data, end, "corpus"))
+    return 1;
+  if (referenceInvalid(corpus->data, end) == end &&
+      errorsAt(corpus->data, end, NULL) != 0) {
+    fprintf(stderr, "valid corpus produced UTF-8 errors\n");
+    return 1;
+  }
+
+  /* 在一小段上做随机破坏，覆盖各种截断、过长编码和代理区 */
+  static const unsigned char damage[] = {0x80, 0xBF, 0xC0, 0xC1, 0xC2, 0xDF,
+                                         0xE0, 0xED, 0xEF, 0xF0, 0xF4, 0xF5,
+                                         0xFF, 0x9F, 0xA0, 0x8F, 0x90, '\n'};
+  size_t window = corpus->length < 4096 ? corpus->length : 4096;
+  char *copy = (char *)malloc(window + 1);
+  for (int i = 0; i < 20000; i++) {
+    size_t offset = randomBelow(corpus->length - window + 1);
+    memcpy(copy, corpus->data + offset, window);
+    for (int n = 1 + (int)randomBelow(3); n > 0; n--)
+      copy[randomBelow(window)] = (char)damage[randomBelow(sizeof(damage))];
+    size_t length = window - randomBelow(8);
+    if (checkKernels(copy, copy + length, "damaged copy"))
+      return 1;
+    const char *bad = referenceInvalid(copy, copy + length);
+    if (bad != copy + length && errorsAt(copy, copy + length, bad) == 0) {
+      fprintf(stderr, "no error reported at offset %td\n", bad - copy);
+      return 1;
+    }
+  }
+  free(copy);
+
+  /* 非 ASCII 标识符不会被拆开 */
+  static const char *names[] = {"naïve_π2", "=", "Форма_1", "+", "名字"};
+  const char *text = "naïve_π2 = Форма_1 + 名字\n";
+  ZyScanner scanner = zy_initScanner(text, text + strlen(text));
+  for (size_t i = 0; i < sizeof(names) / sizeof(names[0]); i++) {
+    ZyToken t = zy_scanToken(&scanner);
+    if (t.length != strlen(names[i]) ||
+        memcmp(t.start, names[i], t.length) != 0) {
+      fprintf(stderr, "token %zu is '%.*s'\n", i, (int)t.length, t.start);
+      return 1;
+    }
+  }
+  return 0;
+}
+
+static size_t lexAll(const BenchBuffer *corpus) {
+  ZyScanner scanner =
+      zy_initScanner(corpus->data, corpus->data + corpus->length);
+  size_t count = 0;
+  while (1) {
+    ZyToken t = zy_scanToken(&scanner);
+    count++;
+    if (t.type == TOKEN_EOF)
+      break;
+  }
+  return count;
+}
+
+static void run(const char *name, const BenchBuffer *corpus, int repeat) {
+  double megabytes = (double)corpus->length / (1 << 20);
+  printf("%s corpus: %.1f MB\n", name, megabytes);
+  for (ZySimdLevel level = ZY_SIMD_SCALAR; level <= ZY_SIMD_AVX2; level++) {
+    if (zy_setSimdLevel(level) != level)
+      continue;
+    double validate = 1e30, lex = 1e30;
+    for (int i = 0; i < repeat; i++) {
+      double start = benchNow();
+      zy_findInvalidUtf8(corpus->data, corpus->data + corpus->length);
+      double elapsed = benchNow() - start;
+      if (elapsed < validate)
+        validate = elapsed;
+
+      start = benchNow();
+      lexAll(corpus);
+      elapsed = benchNow() - start;
+      if (elapsed < lex)
+        lex = elapsed;
+    }
+    printf("  %-8s validate %8.1f MB/s   lex %8.1f MB/s\n",
+           zy_simdLevelName(level), megabytes / validate, megabytes / lex);
+  }
+}
+
+int main(int argc, char *argv[]) {
+  int repeat = (argc > 2) ? atoi(argv[2]) : 5;
+  if (argc > 1 && argv[1][0] != '\0') {
+    BenchBuffer corpus = benchReadFile(argv[1]);
+    if (verify(&corpus))
+      return 1;
+    run(argv[1], &corpus, repeat);
+    benchFree(&corpus);
+    return 0;
+  }
+
+  BenchBuffer unicode = benchUnicodeCorpus(64 << 20);
+  if (verify(&unicode))
+    return 1;
+  run("unicode", &unicode, repeat);
+  benchFree(&unicode);
+
+  BenchBuffer code = benchCodeCorpus(64 << 20);
+  run("code", &code, repeat);
+  benchFree(&code);
+  return 0;
+}
@@ -0,0 +1,224 @@
+/*
+ * 访问者：在解析出的代码、很深的树和很宽的树上，比较四个分析
+ * （按种类计数、token 长度之和、最大深度、代码块的最大嵌套）
+ * 分别用递归函数、分别用 astVisit 和合并成一次 astVisitFused 的
+ * 时间，先确认三种方式的结果相同。最后在一条递归会耗尽 C 栈的
+ * 长链上只跑访问者。
+ *
+ * 用法: bench_visit [file] [repeat]
+ */
+#include "bench.h"
+#include "parser.h"
+#include "visitor.h"
+
+/* 很深的树：CHAINS 条一元表达式链，每条 CHAIN_DEPTH 层 */
+#define CHAINS 64
+#define CHAIN_DEPTH 50000
+/* 很宽的树：根下直接挂这么多个叶子 */
+#define WIDE_LEAVES 4000000
+/* 只给访问者跑的长链 */
+#define ABYSS_DEPTH 4000000
+
+typedef struct {
+  size_t kinds[AST_KIND_ERROR + 1];
+  size_t length;
+  int maxDepth;
+  int blocks;
+  int maxBlocks;
+} Results;
+
+/* 递归的写法，每个分析各走一遍 */
+static void countKinds(Ast *ast, Results *r) {
+  r->kinds[ast->kind]++;
+  for (int i = 0; i < astNumChild(ast); i++)
+    if (astGetChild(ast, i) != NULL)
+      countKinds(astGetChild(ast, i), r);
+}
+
+static void sumLengths(Ast *ast, Results *r) {
+  r->length += ast->token.length;
+  for (int i = 0; i < astNumChild(ast); i++)
+    if (astGetChild(ast, i) != NULL)
+      sumLengths(astGetChild(ast, i), r);
+}
+
+static void measureDepth(Ast *ast, int depth, Results *r) {
+  if (depth > r->maxDepth)
+    r->maxDepth = depth;
+  for (int i = 0; i < astNumChild(ast); i++)
+    if (astGetChild(ast, i) != NULL)
+      measureDepth(astGetChild(ast, i), depth + 1, r);
+}
+
+static void nestBlocks(Ast *ast, Results *r) {
+  if (ast->kind == AST_STMT_BLOCK && ++r->blocks > r->maxBlocks)
+    r->maxBlocks = r->blocks;
+  for (int i = 0; i < astNumChild(ast); i++)
+    if (astGetChild(ast, i) != NULL)
+      nestBlocks(astGetChild(ast, i), r);
+  if (ast->kind == AST_STMT_BLOCK)
+    r->blocks--;
+}
+
+static void recursive(Ast *ast, Results *r) {
+  countKinds(ast, r);
+  sumLengths(ast, r);
+  measureDepth(ast, 0, r);
+  nestBlocks(ast, r);
+}
+
+/* 同样的四个分析写成访问者 */
+static AstVisitResult enterKind(Ast *ast, int depth, void *context) {
+  ((Results *)context)->kinds[ast->kind]++;
+  return AST_VISIT_CONTINUE;
+}
+
+static AstVisitResult enterLength(Ast *ast, int depth, void *context) {
+  ((Results *)context)->length += ast->token.length;
+  return AST_VISIT_CONTINUE;
+}
+
+static AstVisitResult enterDepth(Ast *ast, int depth, void *context) {
+  Results *r = (Results *)context;
+  if (depth > r->maxDepth)
+    r->maxDepth = depth;
+  return AST_VISIT_CONTINUE;
+}
+
+static AstVisitResult enterBlock(Ast *ast, int depth, void *context) {
+  Results *r = (Results *)context;
+  if (++r->blocks > r->maxBlocks)
+    r->maxBlocks = r->blocks;
+  return AST_VISIT_CONTINUE;
+}
+
+static AstVisitResult leaveBlock(Ast *ast, int depth, void *context) {
+  ((Results *)context)->blocks--;
+  return AST_VISIT_CONTINUE;
+}
+
+typedef struct {
+  AstVisitor kinds, lengths, depth, blocks;
+  AstVisitor *all[4];
+} Passes;
+
+static void initPasses(Passes *passes, Results *r) {
+  astInitVisitor(&passes->kinds, r);
+  astVisitEvery(&passes->kinds, enterKind, NULL);
+  astInitVisitor(&passes->lengths, r);
+  astVisitEvery(&passes->lengths, enterLength, NULL);
+  astInitVisitor(&passes->depth, r);
+  astVisitEvery(&passes->depth, enterDepth, NULL);
+  /* 只关心代码块，其余种类不回调 */
+  astInitVisitor(&passes->blocks, r);
+  passes->blocks.enter[AST_STMT_BLOCK] = enterBlock;
+  passes->blocks.leave[AST_STMT_BLOCK] = leaveBlock;
+  passes->all[0] = &passes->kinds;
+  passes->all[1] = &passes->lengths;
+  passes->all[2] = &passes->depth;
+  passes->all[3] = &passes->blocks;
+}
+
+static void separate(Ast *ast, Results *r) {
+  Passes passes;
+  initPasses(&passes, r);
+  for (int i = 0; i < 4; i++)
+    astVisit(ast, passes.all[i]);
+}
+
+static void fused(Ast *ast, Results *r) {
+  Passes passes;
+  initPasses(&passes, r);
+  astVisitFused(ast, passes.all, 4);
+}
+
+static double timeWalk(void (*walk)(Ast *, Results *), Ast *ast, int repeat,
+                       Results *r) {
+  double best = 1e30;
+  for (int i = 0; i < repeat; i++) {
+    memset(r, 0, sizeof(*r));
+    double start = benchNow();
+    walk(ast, r);
+    double elapsed = benchNow() - start;
+    if (elapsed < best)
+      best = elapsed;
+  }
+  return best;
+}
+
+static int run(const char *name, Ast *ast, int repeat) {
+  Results byRecursion, bySeparate, byFused;
+  double recursion = timeWalk(recursive, ast, repeat, &byRecursion);
+  double apart = timeWalk(separate, ast, repeat, &bySeparate);
+  double together = timeWalk(fused, ast, repeat, &byFused);
+  if (memcmp(&byRecursion, &bySeparate, sizeof(Results)) != 0 ||
+      memcmp(&byRecursion, &byFused, sizeof(Results)) != 0) {
+    fprintf(stderr, "%s: visitors disagree with the recursive passes\n", name);
+    return 1;
+  }
+  size_t nodes = 0;
+  for (int kind = 0; kind <= AST_KIND_ERROR; kind++)
+    nodes += byFused.kinds[kind];
+  printf("%s tree: %zu nodes, depth %d\n", name, nodes, byFused.maxDepth);
+  printf("  4 recursive passes %8.1f ms\n", recursion * 1e3);
+  printf("  4 astVisit passes  %8.1f ms\n", apart * 1e3);
+  printf("  1 fused pass       %8.1f ms\n", together * 1e3);
+  return 0;
+}
+
+static Ast *chain(int depth) {
+  ZyToken minus = {};
+  minus.type = TOKEN_MINUS;
+  minus.start = "-";
+  minus.length = 1;
+  Ast *ast = emptyAst(AST_EXPR_VARIABLE, minus);
+  for (int i = 0; i < depth; i++)
+    ast = newAst(AST_EXPR_UNARY, minus, 1, ast);
+  return ast;
+}
+
+int main(int argc, char *argv[]) {
+  int repeat = (argc > 2) ? atoi(argv[2]) : 5;
+  AstArena arena;
+  astInitArena(&arena);
+  astUseArena(&arena);
+
+  BenchBuffer corpus = (argc > 1 && argv[1][0] != '\0')
+                           ? benchReadFile(argv[1])
+                           : benchCodeCorpus(16 << 20);
+  int hadError;
+  Ast *script =
+      zy_parse(corpus.data, corpus.data + corpus.length, &hadError);
+  if (run("code", script, repeat))
+    return 1;
+
+  ZyToken none = {};
+  Ast *deep = emptyAst(AST_KIND_NONE, none);
+  for (int i = 0; i < CHAINS; i++)
+    astAppendChild(deep, chain(CHAIN_DEPTH));
+  if (run("deep", deep, repeat))
+    return 1;
+
+  Ast *wide = emptyAst(AST_KIND_NONE, none);
+  for (int i = 0; i < WIDE_LEAVES; i++)
+    astAppendChild(wide, emptyAst(AST_EXPR_VARIABLE, none));
+  if (run("wide", wide, repeat))
+    return 1;
+
+  Ast *abyss = chain(ABYSS_DEPTH);
+  Results r;
+  double together = timeWalk(fused, abyss, repeat, &r);
+  if (r.maxDepth != ABYSS_DEPTH ||
+      r.kinds[AST_EXPR_UNARY] != (size_t)ABYSS_DEPTH) {
+    fprintf(stderr, "abyss: wrong depth %d\n", r.maxDepth);
+    return 1;
+  }
+  printf("abyss chain: depth %d, recursion would overflow the stack\n",
+         r.maxDepth);
+  printf("  1 fused pass       %8.1f ms\n", together * 1e3);
+
+  astUseArena(NULL);
+  astFreeArena(&arena);
+  benchFree(&corpus);
+  return 0;
+}
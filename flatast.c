@@ -0,0 +1,324 @@
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "flatast.h"
+
+/* 节点里存的是这几个枚举的原始值，个数变了旧的文件就不能再用 */
+#define FLAT_SCHEMA                                                            \
+  ((uint64_t)AST_KIND_ERROR << 32 | (uint64_t)TOKEN_DEDENT << 16 |             \
+   ZY_FLAT_MODIFIERS)
+
+static void *growArray(void *array, size_t elementSize, size_t capacity) {
+  void *grown = realloc(array, elementSize * capacity);
+  if (grown == NULL) {
+    fprintf(stderr, "Not enough memory to grow the flat AST.");
+    exit(1);
+  }
+  return grown;
+}
+
+void zy_initFlatAst(ZyFlatAst *tree, const char *src) {
+  tree->src = src;
+  tree->nodes = NULL;
+  tree->count = 0;
+  tree->capacity = 0;
+  tree->edges = NULL;
+  tree->edgeCount = 0;
+  tree->edgeCapacity = 0;
+}
+
+void zy_freeFlatAst(ZyFlatAst *tree) {
+  free(tree->nodes);
+  free(tree->edges);
+  zy_initFlatAst(tree, tree->src);
+}
+
+size_t zy_flatAstBytes(const ZyFlatAst *tree) {
+  return tree->count * sizeof(ZyFlatNode) + tree->edgeCount * sizeof(uint32_t);
+}
+
+static AstModifier unpackModifier(uint16_t bits) {
+  AstModifier m = astInitModifier();
+  m.isAsync = (bits & ZY_FLAT_ASYNC) != 0;
+  m.isClass = (bits & ZY_FLAT_CLASS) != 0;
+  m.isInitializer = (bits & ZY_FLAT_INITIALIZER) != 0;
+  m.isLambda = (bits & ZY_FLAT_LAMBDA) != 0;
+  m.isLazy = (bits & ZY_FLAT_LAZY) != 0;
+  m.isMutable = (bits & ZY_FLAT_MUTABLE) != 0;
+  m.isOptional = (bits & ZY_FLAT_OPTIONAL) != 0;
+  m.isVariadic = (bits & ZY_FLAT_VARIADIC) != 0;
+  m.isVoid = (bits & ZY_FLAT_VOID) != 0;
+  m.isYieldFrom = (bits & ZY_FLAT_YIELD_FROM) != 0;
+  return m;
+}
+
+/* 等着追加的节点，edge 是要写入它的下标的那条边 */
+typedef struct {
+  Ast *ast;
+  uint32_t edge;
+} FlattenItem;
+
+/* 等着还原的节点，还原后接到 parent 的子节点末尾 */
+typedef struct {
+  uint32_t node;
+  Ast *parent;
+} ExpandItem;
+
+/* 保证栈能放下 needed 项，两个方向共用 */
+static void *reserveStack(void *stack, size_t itemSize, size_t needed,
+                          size_t *capacity) {
+  if (needed <= *capacity)
+    return stack;
+  while (*capacity < needed)
+    *capacity *= 2;
+  return growArray(stack, itemSize, *capacity);
+}
+
+/* 追加一个节点，并为它的子节点占好一段边，返回它的下标 */
+static uint32_t appendFlatNode(ZyFlatAst *tree, Ast *ast) {
+  if (tree->count + 1 > tree->capacity) {
+    tree->capacity = tree->capacity < 64 ? 64 : tree->capacity * 2;
+    tree->nodes = (ZyFlatNode *)growArray(tree->nodes, sizeof(ZyFlatNode),
+                                          tree->capacity);
+  }
+  size_t numChild = (size_t)astNumChild(ast);
+  if (tree->edgeCount + numChild > tree->edgeCapacity) {
+    size_t capacity = tree->edgeCapacity < 64 ? 64 : tree->edgeCapacity;
+    while (capacity < tree->edgeCount + numChild)
+      capacity *= 2;
+    tree->edges =
+        (uint32_t *)growArray(tree->edges, sizeof(uint32_t), capacity);
+    tree->edgeCapacity = capacity;
+  }
+
+  uint32_t index = (uint32_t)tree->count++;
+  ZyFlatNode *node = &tree->nodes[index];
+  node->kind = (uint8_t)ast->kind;
+  node->tokenType = (uint8_t)ast->token.type;
+  node->modifiers = zy_packModifier(ast->modifier);
+  node->offset = ast->token.start == NULL
+                     ? ZY_FLAT_NONE
+                     : (uint32_t)(ast->token.start - tree->src);
+  node->length = (uint32_t)ast->token.length;
+  node->symbol = ast->token.symbol;
+  node->firstEdge = (uint32_t)tree->edgeCount;
+  tree->edgeCount += numChild;
+  return index;
+}
+
+/*
+ * 先序追加节点：访问到一个节点时就为它的子节点占好一段边，所以
+ * 各个节点的边也按先序排列，不用另外记子节点个数。子节点倒着
+ * 压进显式的栈，弹出的顺序就是先序，再深的树也不会耗尽 C 栈。
+ */
+uint32_t zy_flattenAst(ZyFlatAst *tree, Ast *ast) {
+  if (ast == NULL)
+    return ZY_FLAT_NONE;
+  size_t capacity = 64;
+  FlattenItem *stack =
+      (FlattenItem *)growArray(NULL, sizeof(FlattenItem), capacity);
+  size_t count = 0;
+  uint32_t root = (uint32_t)tree->count;
+  stack[count++] = (FlattenItem){ast, ZY_FLAT_NONE};
+  while (count > 0) {
+    FlattenItem item = stack[--count];
+    uint32_t index = appendFlatNode(tree, item.ast);
+    /* 追加节点时 nodes 和 edges 都可能搬家，只能按下标写 */
+    if (item.edge != ZY_FLAT_NONE)
+      tree->edges[item.edge] = index;
+    int numChild = item.ast->children.count;
+    uint32_t firstEdge = tree->nodes[index].firstEdge;
+    stack = (FlattenItem *)reserveStack(stack, sizeof(FlattenItem),
+                                        count + (size_t)numChild, &capacity);
+    for (int i = numChild - 1; i >= 0; i--) {
+      Ast *child = item.ast->children.elements[i];
+      if (child == NULL)
+        tree->edges[firstEdge + i] = ZY_FLAT_NONE;
+      else
+        stack[count++] = (FlattenItem){child, firstEdge + (uint32_t)i};
+    }
+  }
+  free(stack);
+  return root;
+}
+
+/*
+ * 还原成指针形式的树，节点照常由 emptyAst 分配（包括当前的 arena）。
+ * 与 zy_flattenAst 一样用显式的栈，空的子节点也要进栈，才能按原来
+ * 的位置接上。
+ */
+Ast *zy_expandFlatAst(const ZyFlatAst *tree, uint32_t node) {
+  if (node == ZY_FLAT_NONE)
+    return NULL;
+  size_t capacity = 64;
+  ExpandItem *stack =
+      (ExpandItem *)growArray(NULL, sizeof(ExpandItem), capacity);
+  size_t count = 0;
+  Ast *root = NULL;
+  stack[count++] = (ExpandItem){node, NULL};
+  while (count > 0) {
+    ExpandItem item = stack[--count];
+    if (item.node == ZY_FLAT_NONE) {
+      astAppendChild(item.parent, NULL);
+      continue;
+    }
+    const ZyFlatNode *n = &tree->nodes[item.node];
+    Ast *ast = emptyAst((AstNodeKind)n->kind, zy_flatToken(tree, item.node));
+    ast->modifier = unpackModifier(n->modifiers);
+    if (item.parent == NULL)
+      root = ast;
+    else
+      astAppendChild(item.parent, ast);
+
+    uint32_t numChild = zy_flatNumChild(tree, item.node);
+    stack = (ExpandItem *)reserveStack(stack, sizeof(ExpandItem),
+                                       count + numChild, &capacity);
+    for (uint32_t i = numChild; i > 0; i--)
+      stack[count++] = (ExpandItem){zy_flatChild(tree, item.node, i - 1), ast};
+  }
+  free(stack);
+  return root;
+}
+
+/*
+ * 整个源码的 64 位散列，用来认出缓存的语法树是不是这份源码的。
+ * 每次 8 个字节，与符号表的散列同一个做法。
+ */
+uint64_t zy_hashSource(const char *begin, const char *end) {
+  size_t length = (size_t)(end - begin);
+  uint64_t h = UINT64_C(0x9e3779b97f4a7c15) ^ length;
+  uint64_t word;
+  for (; end - begin >= 8; begin += 8) {
+    memcpy(&word, begin, 8);
+    h = (h ^ word) * UINT64_C(0xbf58476d1ce4e5b9);
+    h ^= h >> 31;
+  }
+  word = 0;
+  memcpy(&word, begin, (size_t)(end - begin));
+  h = (h ^ word) * UINT64_C(0x94d049bb133111eb);
+  return h ^ (h >> 29);
+}
+
+static int writeAll(int fd, const void *data, size_t length) {
+  const char *p = (const char *)data;
+  while (length > 0) {
+    ssize_t n = write(fd, p, length);
+    if (n < 0 && errno == EINTR)
+      continue;
+    if (n < 0)
+      return 0;
+    p += n;
+    length -= (size_t)n;
+  }
+  return 1;
+}
+
+/* 写出文件头和两个数组，成功时返回 1，失败时 errno 说明原因 */
+int zy_writeFlatAst(int fd, const ZyFlatAst *tree, uint32_t root,
+                    const char *end, uint64_t sourceHash) {
+  ZyFlatHeader header;
+  memset(&header, 0, sizeof(header));
+  memcpy(header.magic, ZY_FLAT_MAGIC, sizeof(header.magic));
+  header.nodeSize = sizeof(ZyFlatNode);
+  header.root = root;
+  header.schema = FLAT_SCHEMA;
+  header.sourceLength = (uint64_t)(end - tree->src);
+  header.sourceHash = sourceHash;
+  header.count = tree->count;
+  header.edgeCount = tree->edgeCount;
+  return writeAll(fd, &header, sizeof(header)) &&
+         writeAll(fd, tree->nodes, tree->count * sizeof(ZyFlatNode)) &&
+         writeAll(fd, tree->edges, tree->edgeCount * sizeof(uint32_t));
+}
+
+/*
+ * 检查映射进来的节点和边：种类和类型在枚举范围内，token 不超出源码，
+ * 每个节点的边不减且不越界，子节点排在父节点之后，也不会有两个
+ * 父节点。这样从根出发是一棵树，遍历时不用再检查下标。
+ */
+static int validFlatBody(const ZyFlatAst *tree, uint64_t sourceLength) {
+  uint32_t count = (uint32_t)tree->count;
+  uint32_t edgeCount = (uint32_t)tree->edgeCount;
+  uint8_t *seen = (uint8_t *)calloc(count / 8 + 1, 1);
+  if (seen == NULL) {
+    fprintf(stderr, "Not enough memory to check the flat AST.");
+    exit(1);
+  }
+  int valid = tree->nodes[0].firstEdge == 0;
+  for (uint32_t i = 0; i < count && valid; i++) {
+    const ZyFlatNode *n = &tree->nodes[i];
+    uint32_t last = i + 1 < count ? tree->nodes[i + 1].firstEdge : edgeCount;
+    valid = n->kind <= AST_KIND_ERROR && n->tokenType <= TOKEN_DEDENT &&
+            n->modifiers >> ZY_FLAT_MODIFIERS == 0 &&
+            (n->offset != ZY_FLAT_NONE
+                 ? (uint64_t)n->offset + n->length <= sourceLength
+                 : n->length == 0) &&
+            n->firstEdge <= last && last <= edgeCount;
+    for (uint32_t edge = n->firstEdge; edge < last && valid; edge++) {
+      uint32_t child = tree->edges[edge];
+      if (child == ZY_FLAT_NONE)
+        continue;
+      valid = child > i && child < count &&
+              !(seen[child / 8] & (1 << child % 8));
+      if (valid)
+        seen[child / 8] |= 1 << child % 8;
+    }
+  }
+  free(seen);
+  return valid;
+}
+
+/*
+ * 把写出的文件映射进来直接当作 src 的扁平树用，不逐个节点转换。
+ * 文件头不对（格式、枚举、不是这份源码）或者内容越界时返回 0。
+ */
+int zy_mapFlatAst(int fd, const char *src, const char *end,
+                  uint64_t sourceHash, ZyMappedAst *mapped) {
+  struct stat st;
+  if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(ZyFlatHeader))
+    return 0;
+  size_t length = (size_t)st.st_size;
+  void *data = mmap(NULL, length, PROT_READ, MAP_PRIVATE, fd, 0);
+  if (data == MAP_FAILED)
+    return 0;
+  const ZyFlatHeader *header = (const ZyFlatHeader *)data;
+  if (memcmp(header->magic, ZY_FLAT_MAGIC, sizeof(header->magic)) != 0 ||
+      header->nodeSize != sizeof(ZyFlatNode) ||
+      header->schema != FLAT_SCHEMA ||
+      header->sourceLength != (uint64_t)(end - src) ||
+      header->sourceHash != sourceHash || header->count == 0 ||
+      header->count > UINT32_MAX || header->edgeCount > UINT32_MAX ||
+      header->root >= header->count ||
+      length != sizeof(ZyFlatHeader) + header->count * sizeof(ZyFlatNode) +
+                    header->edgeCount * sizeof(uint32_t)) {
+    munmap(data, length);
+    return 0;
+  }
+
+  char *body = (char *)data + sizeof(ZyFlatHeader);
+  zy_initFlatAst(&mapped->tree, src);
+  mapped->tree.nodes = (ZyFlatNode *)body;
+  mapped->tree.count = header->count;
+  mapped->tree.edges = (uint32_t *)(body + header->count * sizeof(ZyFlatNode));
+  mapped->tree.edgeCount = header->edgeCount;
+  if (!validFlatBody(&mapped->tree, header->sourceLength)) {
+    munmap(data, length);
+    return 0;
+  }
+  mapped->root = header->root;
+  mapped->mapping = data;
+  mapped->mappedLength = length;
+  return 1;
+}
+
+void zy_unmapFlatAst(ZyMappedAst *mapped) {
+  munmap(mapped->mapping, mapped->mappedLength);
+  zy_initFlatAst(&mapped->tree, mapped->tree.src);
+  mapped->mapping = NULL;
+  mapped->mappedLength = 0;
+}
@@ -0,0 +1,160 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "ast.h"
+
+/* 空的子节点，也用于没有位置的 token */
+#define ZY_FLAT_NONE UINT32_MAX
+
+/*
+ * 二进制格式的文件头开头。格式变了，或者节点种类、token 类型只是
+ * 换了顺序（个数没变，文件头里的 schema 认不出来）时，换版本号。
+ */
+#define ZY_FLAT_MAGIC "ZYASTv2\n"
+
+/**
+ * @brief Bits of @ref ZyFlatNode::modifiers, one per @ref AstModifier field.
+ */
+typedef enum {
+  ZY_FLAT_ASYNC = 1 << 0,
+  ZY_FLAT_CLASS = 1 << 1,
+  ZY_FLAT_INITIALIZER = 1 << 2,
+  ZY_FLAT_LAMBDA = 1 << 3,
+  ZY_FLAT_LAZY = 1 << 4,
+  ZY_FLAT_MUTABLE = 1 << 5,
+  ZY_FLAT_OPTIONAL = 1 << 6,
+  ZY_FLAT_VARIADIC = 1 << 7,
+  ZY_FLAT_VOID = 1 << 8,
+  ZY_FLAT_YIELD_FROM = 1 << 9
+} ZyFlatModifier;
+
+/* ZyFlatModifier 的位数 */
+#define ZY_FLAT_MODIFIERS 10
+
+static inline uint16_t zy_packModifier(AstModifier m) {
+  return (m.isAsync ? ZY_FLAT_ASYNC : 0) | (m.isClass ? ZY_FLAT_CLASS : 0) |
+         (m.isInitializer ? ZY_FLAT_INITIALIZER : 0) |
+         (m.isLambda ? ZY_FLAT_LAMBDA : 0) | (m.isLazy ? ZY_FLAT_LAZY : 0) |
+         (m.isMutable ? ZY_FLAT_MUTABLE : 0) |
+         (m.isOptional ? ZY_FLAT_OPTIONAL : 0) |
+         (m.isVariadic ? ZY_FLAT_VARIADIC : 0) | (m.isVoid ? ZY_FLAT_VOID : 0) |
+         (m.isYieldFrom ? ZY_FLAT_YIELD_FROM : 0);
+}
+
+/**
+ * @brief One node of a @ref ZyFlatAst, 20 bytes.
+ *
+ * The category is not stored, it follows from the kind. The token is
+ * kept as an offset into the source; its symbol is kept too since
+ * error tokens carry their @ref ZyScanError there.
+ */
+typedef struct {
+  uint8_t kind;       /**< @brief @ref AstNodeKind. */
+  uint8_t tokenType;  /**< @brief @ref ZyTokenType. */
+  uint16_t modifiers; /**< @brief Bits of @ref ZyFlatModifier. */
+  uint32_t offset;    /**< @brief Token start in the source, or ZY_FLAT_NONE. */
+  uint32_t length;
+  uint32_t symbol;
+  /**
+   * @brief Children are edges[firstEdge] up to the next node's
+   * firstEdge, see @ref zy_flatNumChild.
+   */
+  uint32_t firstEdge;
+} ZyFlatNode;
+
+/**
+ * @brief A syntax tree stored as two arrays instead of linked nodes.
+ *
+ * Nodes are in pre-order and refer to each other by 32-bit index.
+ * Each node's children are a contiguous run of the edge array, laid
+ * out in the same order as the nodes, so the child count is the
+ * difference to the next node's run. A pass that does not care about
+ * the tree shape is a plain loop over the nodes.
+ *
+ * Built from the pointer form with @ref zy_flattenAst and turned back
+ * into it with @ref zy_expandFlatAst; the flat form is read-only.
+ */
+typedef struct {
+  const char *src; /**< @brief Source that token offsets are relative to. */
+  ZyFlatNode *nodes;
+  size_t count;
+  size_t capacity;
+  uint32_t *edges; /**< @brief Child node indices, ZY_FLAT_NONE for NULL. */
+  size_t edgeCount;
+  size_t edgeCapacity;
+} ZyFlatAst;
+
+/**
+ * @brief Header of a serialized @ref ZyFlatAst, in host byte order.
+ *
+ * It is followed directly by the `count` nodes and `edgeCount` edges,
+ * so a mapped file is used in place after one pass that checks every
+ * index stays in bounds. The source is not stored; its
+ * length and @ref zy_hashSource tie the file to the text it was
+ * parsed from.
+ */
+typedef struct {
+  char magic[8];     /**< @brief @ref ZY_FLAT_MAGIC. */
+  uint32_t nodeSize; /**< @brief sizeof(ZyFlatNode) of the writer. */
+  uint32_t root;
+  /**
+   * @brief Number of node kinds, token types and modifiers of the
+   * writer, since nodes store their raw values.
+   */
+  uint64_t schema;
+  uint64_t sourceLength;
+  uint64_t sourceHash;
+  uint64_t count;
+  uint64_t edgeCount;
+} ZyFlatHeader;
+
+/**
+ * @brief A @ref ZyFlatAst read in place from a mapped file.
+ *
+ * `tree.nodes` and `tree.edges` point into the mapping; release it
+ * with @ref zy_unmapFlatAst, not @ref zy_freeFlatAst.
+ */
+typedef struct {
+  ZyFlatAst tree;
+  uint32_t root;
+  void *mapping;
+  size_t mappedLength;
+} ZyMappedAst;
+
+extern void zy_initFlatAst(ZyFlatAst *tree, const char *src);
+extern void zy_freeFlatAst(ZyFlatAst *tree);
+extern uint32_t zy_flattenAst(ZyFlatAst *tree, Ast *ast);
+extern Ast *zy_expandFlatAst(const ZyFlatAst *tree, uint32_t node);
+extern size_t zy_flatAstBytes(const ZyFlatAst *tree);
+extern uint64_t zy_hashSource(const char *begin, const char *end);
+extern int zy_writeFlatAst(int fd, const ZyFlatAst *tree, uint32_t root,
+                           const char *end, uint64_t sourceHash);
+extern int zy_mapFlatAst(int fd, const char *src, const char *end,
+                         uint64_t sourceHash, ZyMappedAst *mapped);
+extern void zy_unmapFlatAst(ZyMappedAst *mapped);
+/* 与 astWrite 相同的输出，直接读扁平树，和其它输出函数一起在 ast.c 里 */
+extern void astWriteFlat(ZyOutput *out, const ZyFlatAst *tree, uint32_t root);
+
+static inline uint32_t zy_flatNumChild(const ZyFlatAst *tree, uint32_t node) {
+  uint32_t end = node + 1 < tree->count ? tree->nodes[node + 1].firstEdge
+                                        : (uint32_t)tree->edgeCount;
+  return end - tree->nodes[node].firstEdge;
+}
+
+/* 第 index 个子节点，没有时是 ZY_FLAT_NONE */
+static inline uint32_t zy_flatChild(const ZyFlatAst *tree, uint32_t node,
+                                    uint32_t index) {
+  return tree->edges[tree->nodes[node].firstEdge + index];
+}
+
+static inline ZyToken zy_flatToken(const ZyFlatAst *tree, uint32_t node) {
+  const ZyFlatNode *n = &tree->nodes[node];
+  ZyToken token = {};
+  token.type = (ZyTokenType)n->tokenType;
+  token.symbol = n->symbol;
+  token.start = n->offset == ZY_FLAT_NONE ? NULL : tree->src + n->offset;
+  token.length = n->length;
+  return token;
+}
@@ -0,0 +1,173 @@
+#include <string.h>
+
+#include "layout.h"
+
+void zy_initLayout(ZyLayout *layout) {
+  memset(layout, 0, sizeof(*layout));
+  layout->atLineStart = 1;
+}
+
+/* 长度为 0 的 token，放在 at 的位置 */
+static inline ZyToken emptyToken(ZyTokenType type, const ZyToken *at) {
+  ZyToken t = {};
+  t.type = type;
+  t.start = at->start;
+  return t;
+}
+
+/*
+ * 逻辑行的第一个 token：与上一行的缩进比较，决定要输出 INDENT 还是
+ * 若干个 DEDENT。宽度与任何一层都对不上时报错，并留在外面的那一层。
+ */
+static void changeLevel(ZyLayout *layout, uint32_t width,
+                        const ZyToken *first) {
+  if (width > layout->widths[layout->depth]) {
+    if (layout->depth == ZY_MAX_INDENT) {
+      layout->error = emptyToken(TOKEN_ERROR, first);
+      layout->error.symbol = ZY_ERROR_TOO_DEEP;
+      layout->hasError = 1;
+      return;
+    }
+    layout->widths[++layout->depth] = width;
+    layout->pendingIndent = 1;
+    return;
+  }
+  while (width < layout->widths[layout->depth]) {
+    layout->depth--;
+    layout->pendingDedents++;
+  }
+  if (width != layout->widths[layout->depth]) {
+    layout->error = emptyToken(TOKEN_ERROR, first);
+    layout->error.symbol = ZY_ERROR_INCONSISTENT_DEDENT;
+    layout->hasError = 1;
+  }
+}
+
+/* 更新状态，返回 raw 本身要不要输出（排在要补的 token 后面） */
+static inline int feed(ZyLayout *layout, const ZyToken *raw) {
+  switch (raw->type) {
+  case TOKEN_RETRY:
+    /* 空行的换行：这一行的缩进不算数 */
+    if (layout->atLineStart && *raw->start == '\n')
+      layout->width = 0;
+    return 0;
+  case TOKEN_INDENTATION:
+    /* 行中间的`\t`和括号里的缩进都没有意义 */
+    if (layout->atLineStart && layout->brackets == 0)
+      layout->width = (uint32_t)raw->length;
+    return 0;
+  case TOKEN_EOL:
+    if (layout->atLineStart || layout->brackets > 0)
+      return 0;
+    layout->atLineStart = 1;
+    return 1;
+  case TOKEN_EOF:
+    /* 补上最后一行的 EOL，再关闭所有的块 */
+    layout->pendingEol = !layout->atLineStart;
+    layout->pendingDedents = layout->depth;
+    layout->depth = 0;
+    layout->brackets = 0;
+    layout->atLineStart = 1;
+    layout->width = 0;
+    return 1;
+  case TOKEN_ERROR:
+    /* 错误不开始一行；混用空格和`\t`的缩进算不出宽度，保持原来的层次 */
+    if (layout->atLineStart && raw->symbol == ZY_ERROR_MIXED_INDENTATION)
+      layout->width = layout->widths[layout->depth];
+    return 1;
+  case TOKEN_LEFT_PAREN:
+  case TOKEN_LEFT_SQUARE:
+  case TOKEN_LEFT_BRACE:
+    layout->brackets++;
+    break;
+  case TOKEN_RIGHT_PAREN:
+  case TOKEN_RIGHT_SQUARE:
+  case TOKEN_RIGHT_BRACE:
+    if (layout->brackets > 0)
+      layout->brackets--;
+    break;
+  default:
+    break;
+  }
+  if (layout->atLineStart) {
+    layout->atLineStart = 0;
+    /* 与上一行同样的缩进最常见 */
+    if (layout->width != layout->widths[layout->depth])
+      changeLevel(layout, layout->width, raw);
+    layout->width = 0;
+  }
+  return 1;
+}
+
+static inline int hasPending(const ZyLayout *layout) {
+  return layout->pendingEol | layout->pendingIndent | layout->pendingDedents |
+         layout->hasError;
+}
+
+void zy_layoutFeed(ZyLayout *layout, ZyToken raw) {
+  if (feed(layout, &raw)) {
+    layout->held = raw;
+    layout->hasHeld = 1;
+  }
+}
+
+int zy_layoutNext(ZyLayout *layout, ZyToken *out) {
+  if (layout->pendingEol) {
+    layout->pendingEol = 0;
+    *out = emptyToken(TOKEN_EOL, &layout->held);
+    return 1;
+  }
+  if (layout->pendingIndent) {
+    layout->pendingIndent = 0;
+    *out = emptyToken(TOKEN_INDENT, &layout->held);
+    return 1;
+  }
+  if (layout->pendingDedents > 0) {
+    layout->pendingDedents--;
+    *out = emptyToken(TOKEN_DEDENT, &layout->held);
+    return 1;
+  }
+  if (layout->hasError) {
+    layout->hasError = 0;
+    *out = layout->error;
+    return 1;
+  }
+  if (layout->hasHeld) {
+    layout->hasHeld = 0;
+    *out = layout->held;
+    return 1;
+  }
+  return 0;
+}
+
+/* 取出下一个要补的 token，或者 held 本身 */
+__attribute__((noinline)) static ZyToken takePending(ZyLayout *layout) {
+  ZyToken t;
+  zy_layoutNext(layout, &t);
+  return t;
+}
+
+/*
+ * zy_layoutToken 的其余情况：raw 是已经扫描出来、还没交给 layout
+ * 的 token，可以为 NULL。要补的 token 总是排在 held 前面，没有 held
+ * 就说明什么都不欠，raw 可以直接交出去。
+ */
+ZyToken zy_layoutTokenSlow(ZyLayout *layout, ZyScanner *scanner,
+                           const ZyToken *raw) {
+  ZyToken t;
+  if (raw != NULL)
+    t = *raw;
+  while (1) {
+    if (layout->hasHeld)
+      return takePending(layout);
+    if (raw == NULL)
+      t = zy_scanToken(scanner);
+    raw = NULL;
+    if (!feed(layout, &t))
+      continue;
+    if (!hasPending(layout))
+      return t;
+    layout->held = t;
+    layout->hasHeld = 1;
+  }
+}
@@ -0,0 +1,69 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "scanner.h"
+
+/* 最多嵌套的缩进层数，与 CPython 相同 */
+#define ZY_MAX_INDENT 100
+
+/**
+ * @brief Turns raw scanner tokens into the block structure a parser
+ * wants.
+ *
+ * Feed it raw tokens one at a time and drain what comes out:
+ * - indentation becomes INDENT/DEDENT tokens, checked against a
+ *   stack of the enclosing widths;
+ * - blank and comment-only lines, and line breaks and indentation
+ *   inside brackets, are dropped;
+ * - a missing EOL at the end of the input is added, and every open
+ *   block is closed before EOF.
+ *
+ * So TOKEN_RETRY and TOKEN_INDENTATION never come out, and every
+ * EOL ends a non-empty logical line. The tokens it adds are empty
+ * and placed at the raw token that follows them, so it never keeps
+ * a pointer past the next raw token and works the same on top of a
+ * scanner, a stream or a @ref ZyTokenBuffer.
+ */
+typedef struct {
+  uint32_t widths[ZY_MAX_INDENT + 1]; /**< @brief widths[0] is always 0. */
+  int depth;    /**< @brief Open blocks: widths[depth] is the current one. */
+  int brackets; /**< @brief Open (, [ and { in the current line. */
+  int atLineStart; /**< @brief The next real token starts a logical line. */
+  uint32_t width; /**< @brief Indentation of the current line, `\t` as 8. */
+
+  /* 下面是 zy_layoutNext 还没交出去的 token，按这个顺序输出 */
+  int pendingEol;
+  ZyToken error;
+  int hasError;
+  int pendingIndent;
+  int pendingDedents;
+  ZyToken held; /**< @brief The raw token itself, after the above. */
+  int hasHeld;
+} ZyLayout;
+
+extern void zy_initLayout(ZyLayout *layout);
+extern void zy_layoutFeed(ZyLayout *layout, ZyToken raw);
+extern int zy_layoutNext(ZyLayout *layout, ZyToken *out);
+extern ZyToken zy_layoutTokenSlow(ZyLayout *layout, ZyScanner *scanner,
+                                  const ZyToken *raw);
+
+/* 既不是括号，也不是 TOKEN_INDENTATION 到 TOKEN_EOF 之间的特殊 token */
+static inline int zy_isPlainToken(ZyTokenType type) {
+  return (type > TOKEN_RIGHT_SQUARE && type < TOKEN_INDENTATION) ||
+         type > TOKEN_EOF;
+}
+
+/*
+ * 从扫描器取下一个整理过的 token。行中间的普通 token 占绝大多数，
+ * 直接交出去，不经过 zy_layoutFeed，也不复制。
+ */
+static inline ZyToken zy_layoutToken(ZyLayout *layout, ZyScanner *scanner) {
+  if (layout->hasHeld || layout->atLineStart)
+    return zy_layoutTokenSlow(layout, scanner, NULL);
+  ZyToken t = zy_scanToken(scanner);
+  if (zy_isPlainToken(t.type))
+    return t;
+  return zy_layoutTokenSlow(layout, scanner, &t);
+}
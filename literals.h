@@ -0,0 +1,90 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "arena.h"
+
+typedef enum {
+  ZY_LITERAL_INT,     /**< Fits in 64 bits: `as.integer`. */
+  ZY_LITERAL_BIGINT,  /**< Wider integer: `as.limbs`. */
+  ZY_LITERAL_FLOAT,   /**< `as.number`, correctly rounded. */
+  ZY_LITERAL_INVALID, /**< Malformed, e.g. `0x`, `1__0`, `1e` or `012`. */
+} ZyLiteralKind;
+
+/**
+ * @brief Decoded value of one TOKEN_NUMBER.
+ *
+ * Literals are never negative; a leading `-` is a separate token.
+ */
+typedef struct {
+  ZyLiteralKind kind;
+  uint32_t limbCount; /**< @brief Number of limbs of a BIGINT. */
+  union {
+    uint64_t integer;
+    double number;
+    /**
+     * @brief Little-endian base 2^32 digits of a BIGINT, allocated
+     * in the table's arena.
+     */
+    const uint32_t *limbs;
+  } as;
+} ZyLiteral;
+
+/**
+ * @brief Side table of decoded numeric literals.
+ *
+ * Tokens refer to entries by index (starting at 1, like symbol IDs),
+ * so the token itself does not grow.
+ */
+typedef struct {
+  ZyArena arena;
+  ZyLiteral *values; /**< @brief values[id]; entry 0 is unused. */
+  uint32_t count;    /**< @brief Number of IDs handed out, plus one. */
+  uint32_t capacity;
+} ZyLiteralTable;
+
+extern void zy_initLiteralTable(ZyLiteralTable *table);
+extern void zy_freeLiteralTable(ZyLiteralTable *table);
+extern uint32_t zy_addNumber(ZyLiteralTable *table, const char *start,
+                             size_t length);
+/*
+ * [start, start + length) 必须是扫描器给出的一个 NUMBER token：
+ * 前缀之后只有该进制的数字和下划线。
+ */
+extern ZyLiteral zy_decodeNumber(const char *start, size_t length,
+                                 ZyArena *arena);
+
+static inline const ZyLiteral *zy_literal(const ZyLiteralTable *table,
+                                          uint32_t id) {
+  return &table->values[id];
+}
+
+/**
+ * @brief String prefixes understood by @ref zy_decodeString.
+ */
+enum {
+  ZY_STRING_RAW = 1 << 0,    /**< `r`: backslashes are ordinary characters. */
+  ZY_STRING_BYTES = 1 << 1,  /**< `b`: `\x` is a byte, no `\u`/`\U`/`\N`. */
+  ZY_STRING_FORMAT = 1 << 2, /**< `f`: `{`/`}` are left to the parser. */
+};
+
+/**
+ * @brief Contents of one TOKEN_STRING or TOKEN_BIG_STRING.
+ *
+ * When the literal has no escapes, `chars` points into the source
+ * between the quotes and nothing is allocated. Otherwise the decoded
+ * bytes (UTF-8 for text) live in the arena. Never NUL terminated.
+ */
+typedef struct {
+  const char *chars;
+  size_t length;
+  int valid; /**< @brief 0 for a malformed escape such as `\x4`. */
+} ZyString;
+
+/*
+ * [start, start + length) 是包括引号在内的整个字符串 token，
+ * 前缀是前面单独的 token，由 flags 给出。
+ */
+extern ZyString zy_decodeString(const char *start, size_t length, int flags,
+                                ZyArena *arena);
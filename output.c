@@ -0,0 +1,359 @@
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "output.h"
+#include "scanner.h"
+
+/* JSONL 中的 token 类型名，每个都补齐到 16 字节，可以整块复制 */
+static const char tokenNames[][16] = {
+    [TOKEN_LEFT_PAREN] = "LEFT_PAREN",
+    [TOKEN_RIGHT_PAREN] = "RIGHT_PAREN",
+    [TOKEN_LEFT_BRACE] = "LEFT_BRACE",
+    [TOKEN_RIGHT_BRACE] = "RIGHT_BRACE",
+    [TOKEN_LEFT_SQUARE] = "LEFT_SQUARE",
+    [TOKEN_RIGHT_SQUARE] = "RIGHT_SQUARE",
+    [TOKEN_COLON] = "COLON",
+    [TOKEN_COMMA] = "COMMA",
+    [TOKEN_DOT] = "DOT",
+    [TOKEN_MINUS] = "MINUS",
+    [TOKEN_PLUS] = "PLUS",
+    [TOKEN_SEMICOLON] = "SEMICOLON",
+    [TOKEN_SOLIDUS] = "SOLIDUS",
+    [TOKEN_DOUBLE_SOLIDUS] = "DOUBLE_SOLIDUS",
+    [TOKEN_ASTERISK] = "ASTERISK",
+    [TOKEN_POW] = "POW",
+    [TOKEN_MODULO] = "MODULO",
+    [TOKEN_AT] = "AT",
+    [TOKEN_CARET] = "CARET",
+    [TOKEN_AMPERSAND] = "AMPERSAND",
+    [TOKEN_PIPE] = "PIPE",
+    [TOKEN_TILDE] = "TILDE",
+    [TOKEN_LEFT_SHIFT] = "LEFT_SHIFT",
+    [TOKEN_RIGHT_SHIFT] = "RIGHT_SHIFT",
+    [TOKEN_BANG] = "BANG",
+    [TOKEN_GREATER] = "GREATER",
+    [TOKEN_LESS] = "LESS",
+    [TOKEN_ARROW] = "ARROW",
+    [TOKEN_WALRUS] = "WALRUS",
+    [TOKEN_GREATER_EQUAL] = "GREATER_EQUAL",
+    [TOKEN_LESS_EQUAL] = "LESS_EQUAL",
+    [TOKEN_BANG_EQUAL] = "BANG_EQUAL",
+    [TOKEN_EQUAL_EQUAL] = "EQUAL_EQUAL",
+    [TOKEN_EQUAL] = "EQUAL",
+    [TOKEN_LSHIFT_EQUAL] = "LSHIFT_EQUAL",
+    [TOKEN_RSHIFT_EQUAL] = "RSHIFT_EQUAL",
+    [TOKEN_PLUS_EQUAL] = "PLUS_EQUAL",
+    [TOKEN_MINUS_EQUAL] = "MINUS_EQUAL",
+    [TOKEN_PLUS_PLUS] = "PLUS_PLUS",
+    [TOKEN_MINUS_MINUS] = "MINUS_MINUS",
+    [TOKEN_CARET_EQUAL] = "CARET_EQUAL",
+    [TOKEN_PIPE_EQUAL] = "PIPE_EQUAL",
+    [TOKEN_AMP_EQUAL] = "AMP_EQUAL",
+    [TOKEN_SOLIDUS_EQUAL] = "SOLIDUS_EQUAL",
+    [TOKEN_ASTERISK_EQUAL] = "ASTERISK_EQUAL",
+    [TOKEN_POW_EQUAL] = "POW_EQUAL",
+    [TOKEN_DSOLIDUS_EQUAL] = "DSOLIDUS_EQUAL",
+    [TOKEN_AT_EQUAL] = "AT_EQUAL",
+    [TOKEN_MODULO_EQUAL] = "MODULO_EQUAL",
+    [TOKEN_STRING] = "STRING",
+    [TOKEN_BIG_STRING] = "BIG_STRING",
+    [TOKEN_NUMBER] = "NUMBER",
+    [TOKEN_IDENTIFIER] = "IDENTIFIER",
+    [TOKEN_AND] = "AND",
+    [TOKEN_CLASS] = "CLASS",
+    [TOKEN_DEF] = "DEF",
+    [TOKEN_DEL] = "DEL",
+    [TOKEN_ELSE] = "ELSE",
+    [TOKEN_FALSE] = "FALSE",
+    [TOKEN_FINALLY] = "FINALLY",
+    [TOKEN_FOR] = "FOR",
+    [TOKEN_IF] = "IF",
+    [TOKEN_IMPORT] = "IMPORT",
+    [TOKEN_IN] = "IN",
+    [TOKEN_IS] = "IS",
+    [TOKEN_NONE] = "NONE",
+    [TOKEN_NOT] = "NOT",
+    [TOKEN_OR] = "OR",
+    [TOKEN_ELIF] = "ELIF",
+    [TOKEN_PASS] = "PASS",
+    [TOKEN_RETURN] = "RETURN",
+    [TOKEN_SUPER] = "SUPER",
+    [TOKEN_TRUE] = "TRUE",
+    [TOKEN_WHILE] = "WHILE",
+    [TOKEN_TRY] = "TRY",
+    [TOKEN_EXCEPT] = "EXCEPT",
+    [TOKEN_RAISE] = "RAISE",
+    [TOKEN_BREAK] = "BREAK",
+    [TOKEN_CONTINUE] = "CONTINUE",
+    [TOKEN_AS] = "AS",
+    [TOKEN_FROM] = "FROM",
+    [TOKEN_LAMBDA] = "LAMBDA",
+    [TOKEN_ASSERT] = "ASSERT",
+    [TOKEN_YIELD] = "YIELD",
+    [TOKEN_ASYNC] = "ASYNC",
+    [TOKEN_AWAIT] = "AWAIT",
+    [TOKEN_WITH] = "WITH",
+    [TOKEN_GLOBAL] = "GLOBAL",
+    [TOKEN_NONLOCAL] = "NONLOCAL",
+    [TOKEN_PREFIX_B] = "PREFIX_B",
+    [TOKEN_PREFIX_F] = "PREFIX_F",
+    [TOKEN_PREFIX_R] = "PREFIX_R",
+    [TOKEN_INDENTATION] = "INDENTATION",
+    [TOKEN_EOL] = "EOL",
+    [TOKEN_RETRY] = "RETRY",
+    [TOKEN_ERROR] = "ERROR",
+    [TOKEN_EOF] = "EOF",
+    [TOKEN_ELLIPSIS] = "ELLIPSIS",
+    [TOKEN_INDENT] = "INDENT",
+    [TOKEN_DEDENT] = "DEDENT",
+};
+
+int zy_parseOutputFormat(const char *name, ZyOutputFormat *format) {
+  if (strcmp(name, "human") == 0)
+    *format = ZY_FORMAT_HUMAN;
+  else if (strcmp(name, "binary") == 0)
+    *format = ZY_FORMAT_BINARY;
+  else if (strcmp(name, "jsonl") == 0)
+    *format = ZY_FORMAT_JSONL;
+  else if (strcmp(name, "json") == 0)
+    *format = ZY_FORMAT_JSON;
+  else if (strcmp(name, "sexp") == 0)
+    *format = ZY_FORMAT_SEXP;
+  else
+    return 0;
+  return 1;
+}
+
+void zy_openOutput(ZyOutput *out, int fd, ZyOutputFormat format) {
+  out->fd = fd;
+  out->format = format;
+  out->buffer = (char *)malloc(ZY_OUTPUT_BUFFER);
+  if (out->buffer == NULL) {
+    fprintf(stderr, "Not enough memory for the output buffer.");
+    exit(1);
+  }
+  out->length = 0;
+  out->error = 0;
+  if (format == ZY_FORMAT_BINARY)
+    zy_writeBytes(out, ZY_TOKEN_MAGIC, sizeof(ZY_TOKEN_MAGIC) - 1);
+}
+
+/* 写出 [data, data + length)，写失败之后的内容都丢掉 */
+static void writeAll(ZyOutput *out, const char *data, size_t length) {
+  while (length > 0 && out->error == 0) {
+    ssize_t n = write(out->fd, data, length);
+    if (n < 0 && errno == EINTR)
+      continue;
+    if (n < 0) {
+      out->error = errno;
+      break;
+    }
+    data += n;
+    length -= (size_t)n;
+  }
+}
+
+void zy_flushOutput(ZyOutput *out) {
+  writeAll(out, out->buffer, out->length);
+  out->length = 0;
+}
+
+int zy_closeOutput(ZyOutput *out) {
+  zy_flushOutput(out);
+  free(out->buffer);
+  out->buffer = NULL;
+  return out->error;
+}
+
+/* 保证缓冲区里还有 size 个字节的空间（size 不超过缓冲区大小） */
+static inline char *reserve(ZyOutput *out, size_t size) {
+  if (ZY_OUTPUT_BUFFER - out->length < size)
+    zy_flushOutput(out);
+  return out->buffer + out->length;
+}
+
+void zy_writeBytesSlow(ZyOutput *out, const void *data, size_t length) {
+  if (length >= ZY_OUTPUT_BUFFER / 2) {
+    /* 很大的内容不必先复制到缓冲区里 */
+    zy_flushOutput(out);
+    writeAll(out, (const char *)data, length);
+    return;
+  }
+  char *p = reserve(out, length);
+  memcpy(p, data, length);
+  out->length += length;
+}
+
+static inline char *appendString(char *p, const char *text) {
+  size_t length = strlen(text);
+  memcpy(p, text, length);
+  return p + length;
+}
+
+/* 先数出位数，再从后往前两位一组地写，除法次数减半 */
+static inline char *appendDecimal(char *p, uint64_t value) {
+  static const char pairs[] = "00010203040506070809"
+                              "10111213141516171819"
+                              "20212223242526272829"
+                              "30313233343536373839"
+                              "40414243444546474849"
+                              "50515253545556575859"
+                              "60616263646566676869"
+                              "70717273747576777879"
+                              "80818283848586878889"
+                              "90919293949596979899";
+  int digits = 1;
+  for (uint64_t v = value; v >= 10; v /= 10)
+    digits++;
+  char *q = p + digits;
+  while (value >= 100) {
+    q -= 2;
+    memcpy(q, pairs + value % 100 * 2, 2);
+    value /= 100;
+  }
+  if (value >= 10)
+    memcpy(q - 2, pairs + value * 2, 2);
+  else
+    q[-1] = (char)('0' + value);
+  return p + digits;
+}
+
+void zy_writeDecimal(ZyOutput *out, uint64_t value) {
+  char *p = reserve(out, 20);
+  out->length = (size_t)(appendDecimal(p, value) - out->buffer);
+}
+
+const char *zy_tokenTypeName(ZyTokenType type) { return tokenNames[type]; }
+
+/* human 格式的标签，第一次用到时从 zy_tokenLabel 取出并记下长度 */
+static struct {
+  const char *text;
+  size_t length;
+} labels[TOKEN_DEDENT + 1];
+
+__attribute__((noinline)) static void writeHuman(ZyOutput *out,
+                                                 const ZyToken *t) {
+  if (t->type == TOKEN_ERROR) {
+    const char *message = zy_errorMessage((ZyScanError)t->symbol);
+    zy_writeBytes(out, "错误：", strlen("错误："));
+    zy_writeBytes(out, message, strlen(message));
+    zy_writeBytes(out, "\r\n", 2);
+    return;
+  }
+  if (labels[t->type].text == NULL) {
+    labels[t->type].text = zy_tokenLabel(t->type);
+    labels[t->type].length = strlen(labels[t->type].text);
+  }
+  const char *label = labels[t->type].text;
+  size_t labelLength = labels[t->type].length;
+  if (t->length >= ZY_OUTPUT_BUFFER / 4) {
+    zy_writeBytes(out, label, labelLength);
+    zy_writeBytes(out, t->start, t->length);
+    zy_writeBytes(out, "\r\n", 2);
+    return;
+  }
+  /* 大多数 token 很短，一次预留好整行的空间 */
+  char *p = reserve(out, labelLength + t->length + 2);
+  memcpy(p, label, labelLength);
+  memcpy(p + labelLength, t->start, t->length);
+  memcpy(p + labelLength + t->length, "\r\n", 2);
+  out->length += labelLength + t->length + 2;
+}
+
+/* 0 表示原样输出，其余是`\\`后面的字符，'u' 表示写成 \u00XX */
+static const char jsonEscapes[256] = {
+    [0x00 ... 0x07] = 'u', ['\b'] = 'b', ['\t'] = 't', ['\n'] = 'n',
+    [0x0B] = 'u',          ['\f'] = 'f', ['\r'] = 'r', [0x0E ... 0x1F] = 'u',
+    ['"'] = '"',           ['\\'] = '\\',
+};
+
+/* 把 token 的文本写成 JSON 字符串，每次处理一段，每字节最多变成 6 个 */
+void zy_writeJsonString(ZyOutput *out, const char *text, size_t length) {
+  static const char hex[] = "0123456789abcdef";
+  const size_t piece = 4096;
+  char *p = reserve(out, 1);
+  *p++ = '"';
+  out->length++;
+  while (length > 0) {
+    size_t n = length < piece ? length : piece;
+    p = reserve(out, n * 6);
+    const char *end = text + n;
+    while (text < end) {
+      /* 不用转义的一段整个复制 */
+      const char *run = text;
+      while (run < end && jsonEscapes[(unsigned char)*run] == 0)
+        run++;
+      memcpy(p, text, (size_t)(run - text));
+      p += run - text;
+      if (run == end) {
+        text = run;
+        break;
+      }
+      unsigned char c = (unsigned char)*run;
+      char escape = jsonEscapes[c];
+      if (escape != 'u') {
+        *p++ = '\\';
+        *p++ = escape;
+      } else {
+        memcpy(p, "\\u00", 4);
+        p[4] = hex[c >> 4];
+        p[5] = hex[c & 0xF];
+        p += 6;
+      }
+      text = run + 1;
+    }
+    out->length = (size_t)(p - out->buffer);
+    length -= n;
+  }
+  p = reserve(out, 1);
+  *p++ = '"';
+  out->length++;
+}
+
+__attribute__((noinline)) static void
+writeJson(ZyOutput *out, const ZyToken *t, uint64_t offset) {
+  char *p = reserve(out, 160);
+  p = appendString(p, "{\"type\":\"");
+  memcpy(p, tokenNames[t->type], 16);
+  p += strnlen(tokenNames[t->type], 16);
+  p = appendString(p, "\",\"offset\":");
+  p = appendDecimal(p, offset);
+  p = appendString(p, ",\"length\":");
+  p = appendDecimal(p, t->length);
+  if (t->type == TOKEN_ERROR) {
+    p = appendString(p, ",\"error\":\"");
+    p = appendString(p, zy_errorMessage((ZyScanError)t->symbol));
+    p = appendString(p, "\"}\n");
+    out->length = (size_t)(p - out->buffer);
+    return;
+  }
+  /* 缩进的 length 是宽度，不是字节数，不输出文本 */
+  if (t->type != TOKEN_INDENTATION) {
+    p = appendString(p, ",\"text\":");
+    out->length = (size_t)(p - out->buffer);
+    zy_writeJsonString(out, t->start, t->length);
+    p = reserve(out, 2);
+  }
+  p = appendString(p, "}\n");
+  out->length = (size_t)(p - out->buffer);
+}
+
+void zy_writeToken(ZyOutput *out, const ZyToken *t, uint64_t offset) {
+  if (out->format == ZY_FORMAT_BINARY) {
+    ZyTokenRecord record = {};
+    record.type = (uint8_t)t->type;
+    record.error = t->type == TOKEN_ERROR ? (uint8_t)t->symbol : 0;
+    record.length = (uint32_t)t->length;
+    record.offset = offset;
+    char *p = reserve(out, sizeof(record));
+    memcpy(p, &record, sizeof(record));
+    out->length += sizeof(record);
+  } else if (out->format == ZY_FORMAT_HUMAN) {
+    writeHuman(out, t);
+  } else {
+    writeJson(out, t, offset);
+  }
+}
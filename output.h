@@ -0,0 +1,76 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "scanner.h"
+
+/* 攒够这么多字节才调用一次 write() */
+#define ZY_OUTPUT_BUFFER ((size_t)1 << 20)
+
+/* 二进制格式的文件头，后面紧跟着一个个 ZyTokenRecord */
+#define ZY_TOKEN_MAGIC "ZYTOKv1\n"
+
+typedef enum {
+  ZY_FORMAT_HUMAN,  /**< Same text as @ref printToken. */
+  ZY_FORMAT_BINARY, /**< @ref ZY_TOKEN_MAGIC, then fixed-size records. */
+  ZY_FORMAT_JSONL,  /**< One JSON object per token and line. */
+  ZY_FORMAT_JSON,   /**< Syntax trees only: one nested JSON object. */
+  ZY_FORMAT_SEXP,   /**< Syntax trees only: one S-expression per node. */
+} ZyOutputFormat;
+
+/**
+ * @brief One token of the binary format, in host byte order.
+ *
+ * The text is not included; it is `length` bytes at `offset` in the
+ * input that was lexed.
+ */
+typedef struct {
+  uint8_t type;  /**< @brief @ref ZyTokenType. */
+  uint8_t error; /**< @brief @ref ZyScanError of a TOKEN_ERROR, else 0. */
+  uint16_t reserved;
+  uint32_t length; /**< @brief Same as @ref ZyToken::length. */
+  uint64_t offset; /**< @brief Byte offset of the token in the input. */
+} ZyTokenRecord;
+
+/**
+ * @brief Buffered writer for token and syntax tree dumps.
+ *
+ * Output is collected in a large buffer and handed to the kernel in
+ * big write() calls rather than one stdio call per token or node.
+ */
+typedef struct {
+  int fd;
+  ZyOutputFormat format;
+  char *buffer;
+  size_t length;
+  int error; /**< @brief errno of the first failed write, 0 otherwise. */
+} ZyOutput;
+
+/* 按名字（human、binary、jsonl、json、sexp）查找输出格式，不认识时返回 0 */
+extern int zy_parseOutputFormat(const char *name, ZyOutputFormat *format);
+extern void zy_openOutput(ZyOutput *out, int fd, ZyOutputFormat format);
+/* 写出剩下的内容并释放缓冲区，返回第一次写失败时的 errno */
+extern int zy_closeOutput(ZyOutput *out);
+extern void zy_flushOutput(ZyOutput *out);
+extern void zy_writeBytesSlow(ZyOutput *out, const void *data, size_t length);
+/* offset 是 token 在整个输入中的位置，只有二进制和 JSONL 格式用到 */
+extern void zy_writeToken(ZyOutput *out, const ZyToken *t, uint64_t offset);
+extern void zy_writeDecimal(ZyOutput *out, uint64_t value);
+/* 写成带引号的 JSON 字符串，S 表达式也用它 */
+extern void zy_writeJsonString(ZyOutput *out, const char *text, size_t length);
+/* token 类型在 JSONL 里的名字，比如 "LEFT_PAREN" */
+extern const char *zy_tokenTypeName(ZyTokenType type);
+
+/* 语法树输出时每个节点要写好几小段，放得下时直接复制 */
+static inline void zy_writeBytes(ZyOutput *out, const void *data,
+                                 size_t length) {
+  if (length <= ZY_OUTPUT_BUFFER - out->length &&
+      length < ZY_OUTPUT_BUFFER / 2) {
+    memcpy(out->buffer + out->length, data, length);
+    out->length += length;
+    return;
+  }
+  zy_writeBytesSlow(out, data, length);
+}
@@ -1,5 +1,11 @@
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
 #include "parser.h"
 #include "scanner.h"
+#include "tokens.h"
 
 /**
  * @brief Token parser state.
@@ -15,8 +21,11 @@ typedef struct {
       previous;  /**< @brief Last token matched, consumed, or advanced over. */
   char hadError; /**< @brief Flag indicating if the parser encountered an error.
                   */
-  unsigned int eatingWhitespace; /**< @brief Depth of whitespace-ignoring parse
-                                    functions. */
+  char panicMode; /**< @brief Errors are not reported until the parser
+                     reaches the next statement. */
+  char speculating; /**< @brief Errors only mark the attempt as failed, see
+                       @ref beginSpeculation. */
+  char speculationFailed; /**< @brief An error occurred while speculating. */
 } Parser;
 
 /**
@@ -73,10 +82,12 @@ struct GlobalState;
  * @brief Subexpression parser function.
  *
  * Used by the parse rule table for infix and prefix expression
- * parser functions. The argument passed is the @ref ExpressionType
- * to compile the expression as.
+ * parser functions. Infix functions get the expression parsed so far
+ * (prefix functions get NULL) and the @ref ExpressionType to parse
+ * the expression as, and return the resulting node.
  */
-typedef void (*ParseFn)(struct GlobalState *, int, struct RewindState *);
+typedef Ast *(*ParseFn)(struct GlobalState *, Ast *, int,
+                        struct RewindState *);
 
 /**
  * @brief Parse rule table entry.
@@ -134,18 +145,28 @@ struct LoopExit {
 };
 
 /**
- * @brief Compiler emit and parse state prior to this expression.
+ * @brief Parse position prior to this expression.
  *
- * Used to rewind the parser for ternary and comma expressions.
+ * Used to rewind the parser for comma expressions and keyword
+ * arguments, where an `=` further on decides what was parsed.
+ * The input is lexed up front, so this is just a token index.
  */
 typedef struct RewindState {
-  ZyScanner oldScanner; /**< @brief Scanner cursor state. */
-  Parser oldParser;     /**< @brief Previous/current tokens. */
+  size_t current; /**< @brief Index of the current token. */
 } RewindState;
 
+/**
+ * @brief Everything one parse needs; each parser thread has its own.
+ */
 typedef struct GlobalState {
-  Parser parser;     /**< @brief Parser state */
-  ZyScanner scanner; /**< @brief Scanner state */
+  Parser parser; /**< @brief Parser state */
+  const ZyTokenBuffer *tokens; /**< @brief The whole input, after ZyLayout;
+                                  shared by all threads. */
+  size_t current; /**< @brief Index of parser.current in tokens. */
+  FunctionType functionType; /**< @brief Innermost def, class or lambda. */
+  FILE *errors;      /**< @brief stderr, or a worker's message buffer. */
+  ZyLineIndex lines; /**< @brief Built at the first error. */
+  int lazyBodies; /**< @brief Skip indented def bodies, see @ref lazyBody. */
 } GlobalState;
 
 static int isMethod(int type) {
@@ -157,3 +178,1816 @@ static int isCoroutine(int type) {
   return type == TYPE_COROUTINE || type == TYPE_COROUTINE_METHOD;
 }
 
+static Ast *expression(GlobalState *state);
+static Ast *parsePrecedence(GlobalState *state, Precedence precedence);
+static const ParseRule *getRule(ZyTokenType type);
+static void statement(GlobalState *state, Ast *statements);
+static Ast *block(GlobalState *state);
+
+static void errorAt(GlobalState *state, const ZyToken *token,
+                    const char *message) {
+  if (state->parser.speculating) {
+    state->parser.speculationFailed = 1;
+    return;
+  }
+  if (state->parser.panicMode)
+    return;
+  state->parser.panicMode = 1;
+  state->parser.hadError = 1;
+
+  /* 行索引在第一次报错时才建立 */
+  const ZyTokenBuffer *tokens = state->tokens;
+  if (state->lines.starts == NULL)
+    zy_initLineIndex(&state->lines, tokens->src, tokens->end);
+  ZyPosition position =
+      zy_positionOf(&state->lines, (size_t)(token->start - tokens->src));
+  fprintf(state->errors, "%zu:%zu: 错误：%s", position.line, position.col,
+          message);
+  if (token->type == TOKEN_EOF) {
+    fprintf(state->errors, " (at end)");
+  } else if (token->type != TOKEN_ERROR && token->length > 0) {
+    /* 长字符串只显示第一行的开头 */
+    const char *newline = memchr(token->start, '\n', token->length);
+    size_t shown = newline ? (size_t)(newline - token->start) : token->length;
+    fprintf(state->errors, " (at '%.*s')", (int)(shown < 40 ? shown : 40),
+            token->start);
+  }
+  fprintf(state->errors, "\n");
+}
+
+static void errorAtCurrent(GlobalState *state, const char *message) {
+  errorAt(state, &state->parser.current, message);
+}
+
+static void errorAtPrevious(GlobalState *state, const char *message) {
+  errorAt(state, &state->parser.previous, message);
+}
+
+/*
+ * 整理过的 token 里没有 INDENTATION，EOL 的长度也已经是 0，只有
+ * 错误要去查 zy_tokenAt。
+ */
+static inline ZyToken tokenAt(GlobalState *state, size_t index) {
+  const ZyTokenBuffer *tokens = state->tokens;
+  if (zy_tokenType(tokens, index) == TOKEN_ERROR)
+    return zy_tokenAt(tokens, index);
+  ZyToken t = {};
+  t.type = zy_tokenType(tokens, index);
+  t.start = tokens->src + tokens->offsets[index];
+  t.length = tokens->lengths[index];
+  return t;
+}
+
+/* 停在最后的 EOF 上 */
+static inline ZyToken nextToken(GlobalState *state) {
+  if (state->current + 1 < state->tokens->count)
+    state->current++;
+  return tokenAt(state, state->current);
+}
+
+static void advance(GlobalState *state) {
+  state->parser.previous = state->parser.current;
+  while (1) {
+    state->parser.current = nextToken(state);
+    if (state->parser.current.type != TOKEN_ERROR)
+      break;
+    errorAtCurrent(state,
+                   zy_errorMessage((ZyScanError)state->parser.current.symbol));
+  }
+}
+
+static inline int check(GlobalState *state, ZyTokenType type) {
+  return state->parser.current.type == type;
+}
+
+static int match(GlobalState *state, ZyTokenType type) {
+  if (!check(state, type))
+    return 0;
+  advance(state);
+  return 1;
+}
+
+static void consume(GlobalState *state, ZyTokenType type,
+                    const char *message) {
+  if (check(state, type)) {
+    advance(state);
+    return;
+  }
+  errorAtCurrent(state, message);
+}
+
+/* `super` 在 Python 里只是普通的名字 */
+static void consumeName(GlobalState *state, const char *message) {
+  if (!match(state, TOKEN_SUPER))
+    consume(state, TOKEN_IDENTIFIER, message);
+}
+
+static inline int startsExpression(GlobalState *state) {
+  return getRule(state->parser.current.type)->prefix != NULL;
+}
+
+static inline void recordRewind(GlobalState *state, RewindState *rewind) {
+  rewind->current = state->current;
+}
+
+/*
+ * 回到记录的位置，不用重新扫描。previous 是前面第一个不是错误的
+ * token，已经报告过的错误不会忘掉。
+ */
+static void rewindTo(GlobalState *state, const RewindState *rewind) {
+  state->current = rewind->current;
+  state->parser.current = tokenAt(state, rewind->current);
+  size_t i = rewind->current;
+  while (i > 0 && zy_tokenType(state->tokens, i - 1) == TOKEN_ERROR)
+    i--;
+  if (i > 0)
+    state->parser.previous = tokenAt(state, i - 1);
+}
+
+/*
+ * 软关键字（`match`）和括起来的 with 项要往后看好几个 token 才能
+ * 确定：先试着解析，出错时不报告，最后由 endSpeculation 决定是
+ * 保留结果还是回到开头。
+ */
+static void beginSpeculation(GlobalState *state, RewindState *rewind) {
+  recordRewind(state, rewind);
+  state->parser.speculating = 1;
+  state->parser.speculationFailed = 0;
+}
+
+static int endSpeculation(GlobalState *state, RewindState *rewind, int ok) {
+  ok = ok && !state->parser.speculationFailed;
+  state->parser.speculating = 0;
+  if (!ok)
+    rewindTo(state, rewind);
+  return ok;
+}
+
+/* 从 from 开始到 to 结束的一个 token，类型与 from 相同 */
+static ZyToken spanTokens(ZyToken from, ZyToken to) {
+  from.length = (size_t)(to.start + to.length - from.start);
+  return from;
+}
+
+/* 省略掉的部分（切片的边界、`**` 展开的值），是一个空的 None */
+static Ast *placeholder(const ZyToken *at) {
+  ZyToken token = {};
+  token.type = TOKEN_NONE;
+  token.start = at->start;
+  return emptyAst(AST_EXPR_LITERAL, token);
+}
+
+static int isAugmentedAssignment(ZyTokenType type) {
+  switch (type) {
+  case TOKEN_LSHIFT_EQUAL:
+  case TOKEN_RSHIFT_EQUAL:
+  case TOKEN_PLUS_EQUAL:
+  case TOKEN_MINUS_EQUAL:
+  case TOKEN_CARET_EQUAL:
+  case TOKEN_PIPE_EQUAL:
+  case TOKEN_AMP_EQUAL:
+  case TOKEN_SOLIDUS_EQUAL:
+  case TOKEN_ASTERISK_EQUAL:
+  case TOKEN_POW_EQUAL:
+  case TOKEN_DSOLIDUS_EQUAL:
+  case TOKEN_AT_EQUAL:
+  case TOKEN_MODULO_EQUAL:
+    return 1;
+  default:
+    return 0;
+  }
+}
+
+/*
+ * 赋值运算符后面的值，没有赋值运算符时返回 NULL。`=` 可以连写，
+ * `+=` 之类的值写成 UNARY(运算符, 值)。
+ */
+static Ast *assignmentValue(GlobalState *state) {
+  if (match(state, TOKEN_EQUAL))
+    return parsePrecedence(state, PREC_ASSIGNMENT);
+  if (!isAugmentedAssignment(state->parser.current.type))
+    return NULL;
+  advance(state);
+  ZyToken op = state->parser.previous;
+  return newAst(AST_EXPR_UNARY, op, 1, parsePrecedence(state, PREC_COMMA));
+}
+
+static inline int isTargetType(int exprType) {
+  return exprType == EXPR_ASSIGN_TARGET || exprType == EXPR_DEL_TARGET;
+}
+
+static inline Precedence targetPrecedence(int exprType) {
+  return exprType == EXPR_DEL_TARGET ? PREC_DEL_TARGET : PREC_MUST_ASSIGN;
+}
+
+/* 赋值目标的`.x`和`[i]`要后面不再跟着`.`、`(`或`[`才是最后一层 */
+static inline int endsTarget(GlobalState *state) {
+  return getRule(state->parser.current.type)->precedence < PREC_PRIMARY;
+}
+
+/* 元组和列表里的元素在解析它们的时候已经检查过了 */
+static int isTarget(Ast *ast, int exprType) {
+  switch (ast->kind) {
+  case AST_EXPR_VARIABLE:
+  case AST_EXPR_ARRAY:
+  case AST_KIND_ERROR:
+    return 1;
+  case AST_EXPR_PROPERTY_SET:
+  case AST_EXPR_SUBSCRIPT_SET:
+    return exprType == EXPR_ASSIGN_TARGET;
+  case AST_EXPR_PROPERTY_GET:
+  case AST_EXPR_SUBSCRIPT_GET:
+    return exprType == EXPR_DEL_TARGET;
+  case AST_EXPR_UNARY:
+    return exprType == EXPR_ASSIGN_TARGET &&
+           ast->token.type == TOKEN_ASTERISK;
+  default:
+    return 0;
+  }
+}
+
+static Ast *target(GlobalState *state, Precedence precedence) {
+  ZyToken start = state->parser.current;
+  Ast *ast = parsePrecedence(state, precedence);
+  int exprType = precedence == PREC_DEL_TARGET ? EXPR_DEL_TARGET
+                                               : EXPR_ASSIGN_TARGET;
+  if (!isTarget(ast, exprType))
+    errorAt(state, &start, "Invalid assignment target.");
+  return ast;
+}
+
+/* 逗号分隔的目标，有逗号时是一个元组 */
+static Ast *targetList(GlobalState *state, Precedence precedence) {
+  Ast *first = target(state, precedence);
+  if (!check(state, TOKEN_COMMA))
+    return first;
+  Ast *targets = newAst(AST_LIST_EXPR, state->parser.current, 1, first);
+  while (match(state, TOKEN_COMMA) && startsExpression(state))
+    astAppendChild(targets, target(state, precedence));
+  return newAst(AST_EXPR_ARRAY, targets->token, 1, targets);
+}
+
+/* 括号里的其余目标，直到 closing（不消耗），允许最后多一个`,` */
+static void appendTargets(GlobalState *state, Ast *targets,
+                          Precedence precedence, ZyTokenType closing) {
+  while (!check(state, closing) && !check(state, TOKEN_EOF)) {
+    astAppendChild(targets, target(state, precedence));
+    if (!match(state, TOKEN_COMMA))
+      break;
+  }
+}
+
+/*
+ * `a, b = ...`、`(a, b) = ...`要看到`=`才知道是赋值，这时已经按
+ * 普通表达式解析过了：扔掉结果，回到开头按赋值目标重新解析。
+ */
+static Ast *reparseAsTargets(GlobalState *state, Ast *expr,
+                             RewindState *rewind) {
+  freeAst(expr, true);
+  rewindTo(state, rewind);
+  Ast *targets = targetList(state, PREC_MUST_ASSIGN);
+  consume(state, TOKEN_EQUAL, "Expected '=' after assignment targets.");
+  ZyToken equal = state->parser.previous;
+  Ast *value = parsePrecedence(state, PREC_ASSIGNMENT);
+  return newAst(AST_EXPR_ASSIGN, equal, 2, targets, value);
+}
+
+/* 已经出错时不回退：重新解析会在同一个位置再失败一次 */
+static inline int canReparse(GlobalState *state, int exprType,
+                             RewindState *rewind) {
+  return exprType == EXPR_CAN_ASSIGN && rewind != NULL &&
+         check(state, TOKEN_EQUAL) && !state->parser.panicMode;
+}
+
+/* 逗号分隔的表达式，直到 closing（不消耗），允许最后多一个`,` */
+static void appendElements(GlobalState *state, Ast *elements,
+                           ZyTokenType closing) {
+  while (!check(state, closing) && !check(state, TOKEN_EOF)) {
+    astAppendChild(elements, expression(state));
+    if (!match(state, TOKEN_COMMA))
+      break;
+  }
+}
+
+static inline int atComprehension(GlobalState *state) {
+  return check(state, TOKEN_FOR) || check(state, TOKEN_ASYNC);
+}
+
+/*
+ * element 后面的 for/if 子句。每个 for 是 FOR(目标, 可迭代对象,
+ * 条件的列表)，依次作为子节点跟在 element 后面。
+ */
+static Ast *comprehension(GlobalState *state, Ast *element, ZyToken open) {
+  Ast *node = newAst(AST_EXPR_COMPREHENSION, open, 1, element);
+  while (atComprehension(state)) {
+    int isAsync = match(state, TOKEN_ASYNC);
+    consume(state, TOKEN_FOR, "Expected 'for' after 'async'.");
+    ZyToken keyword = state->parser.previous;
+    Ast *targets = targetList(state, PREC_MUST_ASSIGN);
+    consume(state, TOKEN_IN, "Expected 'in' after comprehension targets.");
+    Ast *iterable = parsePrecedence(state, PREC_OR);
+    Ast *conditions = emptyAst(AST_LIST_EXPR, keyword);
+    while (match(state, TOKEN_IF))
+      astAppendChild(conditions, parsePrecedence(state, PREC_OR));
+    Ast *clause =
+        newAst(AST_STMT_FOR, keyword, 3, targets, iterable, conditions);
+    clause->modifier.isAsync = isAsync;
+    astAppendChild(node, clause);
+  }
+  return node;
+}
+
+/* 调用的参数，`(` 已经消耗。关键字参数是 PARAM(名字, 值) */
+static Ast *arguments(GlobalState *state) {
+  ZyToken paren = state->parser.previous;
+  Ast *args = emptyAst(AST_LIST_EXPR, paren);
+  while (!check(state, TOKEN_RIGHT_PAREN) && !check(state, TOKEN_EOF)) {
+    Ast *arg;
+    if (check(state, TOKEN_IDENTIFIER) || check(state, TOKEN_SUPER)) {
+      /* 先看名字后面是不是`=`，不是就回到名字按表达式解析 */
+      RewindState rewind;
+      recordRewind(state, &rewind);
+      ZyToken name = state->parser.current;
+      advance(state);
+      if (match(state, TOKEN_EQUAL)) {
+        arg = newAst(AST_EXPR_PARAM, name, 1, expression(state));
+      } else {
+        rewindTo(state, &rewind);
+        arg = expression(state);
+      }
+    } else {
+      arg = expression(state);
+    }
+    if (atComprehension(state))
+      arg = comprehension(state, arg, paren);
+    astAppendChild(args, arg);
+    if (!match(state, TOKEN_COMMA))
+      break;
+  }
+  consume(state, TOKEN_RIGHT_PAREN, "Expected ')' after arguments.");
+  return args;
+}
+
+/*
+ * 形式参数，直到 closing（不消耗）。PARAM 的子节点依次是默认值和
+ * 类型标注，都可以没有；isOptional 表示有默认值。`*args` 和
+ * `**kwargs` 的 token 包括星号，单独的`*`和`/`也是一个 PARAM。
+ */
+static Ast *parameters(GlobalState *state, ZyTokenType closing,
+                       int annotations) {
+  Ast *params = emptyAst(AST_LIST_VAR, state->parser.previous);
+  while (!check(state, closing) && !check(state, TOKEN_EOF)) {
+    if (match(state, TOKEN_SOLIDUS)) {
+      astAppendChild(params, emptyAst(AST_EXPR_PARAM, state->parser.previous));
+      if (!match(state, TOKEN_COMMA))
+        break;
+      continue;
+    }
+
+    ZyToken name;
+    int variadic = 0;
+    if (match(state, TOKEN_ASTERISK) || match(state, TOKEN_POW)) {
+      ZyToken star = state->parser.previous;
+      variadic = 1;
+      if (star.type == TOKEN_ASTERISK &&
+          (check(state, TOKEN_COMMA) || check(state, closing))) {
+        Ast *bare = emptyAst(AST_EXPR_PARAM, star);
+        bare->modifier.isVariadic = true;
+        astAppendChild(params, bare);
+        if (!match(state, TOKEN_COMMA))
+          break;
+        continue;
+      }
+      consumeName(state, "Expected parameter name.");
+      name = spanTokens(star, state->parser.previous);
+    } else {
+      consumeName(state, "Expected parameter name.");
+      name = state->parser.previous;
+    }
+
+    Ast *param = emptyAst(AST_EXPR_PARAM, name);
+    param->modifier.isVariadic = variadic;
+    Ast *annotation = NULL;
+    if (annotations && match(state, TOKEN_COLON))
+      annotation = expression(state);
+    if (match(state, TOKEN_EQUAL)) {
+      astAppendChild(param, expression(state));
+      param->modifier.isOptional = true;
+    }
+    if (annotation != NULL)
+      astAppendChild(param, annotation);
+    astAppendChild(params, param);
+    if (!match(state, TOKEN_COMMA))
+      break;
+  }
+  return params;
+}
+
+/* `rb"..."`、`u'...'` 这样的前缀扫描成标识符，后面紧跟着引号 */
+static int isStringPrefix(GlobalState *state, const ZyToken *token) {
+  if (token->type != TOKEN_IDENTIFIER || token->length > 2)
+    return 0;
+  const char *after = token->start + token->length;
+  if (after >= state->tokens->end || (*after != '"' && *after != '\''))
+    return 0;
+  for (size_t i = 0; i < token->length; i++) {
+    if (strchr("rRbBfFuU", token->start[i]) == NULL)
+      return 0;
+  }
+  return 1;
+}
+
+static int atStringPiece(GlobalState *state) {
+  switch (state->parser.current.type) {
+  case TOKEN_STRING:
+  case TOKEN_BIG_STRING:
+  case TOKEN_PREFIX_B:
+  case TOKEN_PREFIX_F:
+  case TOKEN_PREFIX_R:
+    return 1;
+  default:
+    return isStringPrefix(state, &state->parser.current);
+  }
+}
+
+/* 刚消耗的一段字符串；有前缀时接上后面的字符串，token 从前缀开始 */
+static ZyToken stringPiece(GlobalState *state) {
+  ZyToken piece = state->parser.previous;
+  if (piece.type == TOKEN_STRING || piece.type == TOKEN_BIG_STRING)
+    return piece;
+  if (!match(state, TOKEN_STRING) && !match(state, TOKEN_BIG_STRING)) {
+    errorAtCurrent(state, "Expected string after prefix.");
+    return piece;
+  }
+  ZyToken string = spanTokens(piece, state->parser.previous);
+  string.type = state->parser.previous.type;
+  return string;
+}
+
+/* 相邻的字符串拼接在一起：第一段是节点本身，其余的是子节点 */
+static Ast *string(GlobalState *state, Ast *left, int exprType,
+                   RewindState *rewind) {
+  Ast *literal = emptyAst(AST_EXPR_LITERAL, stringPiece(state));
+  while (atStringPiece(state)) {
+    advance(state);
+    astAppendChild(literal, emptyAst(AST_EXPR_LITERAL, stringPiece(state)));
+  }
+  return literal;
+}
+
+static Ast *literal(GlobalState *state, Ast *left, int exprType,
+                    RewindState *rewind) {
+  return emptyAst(AST_EXPR_LITERAL, state->parser.previous);
+}
+
+static Ast *variable(GlobalState *state, Ast *left, int exprType,
+                     RewindState *rewind) {
+  ZyToken name = state->parser.previous;
+  if (isStringPrefix(state, &name))
+    return string(state, left, exprType, rewind);
+  if (exprType == EXPR_CAN_ASSIGN) {
+    Ast *value = assignmentValue(state);
+    if (value != NULL)
+      return newAst(AST_EXPR_ASSIGN, name, 1, value);
+  }
+  if (!isTargetType(exprType) && match(state, TOKEN_WALRUS))
+    return newAst(AST_EXPR_ASSIGN, name, 1, expression(state));
+  return emptyAst(AST_EXPR_VARIABLE, name);
+}
+
+static Ast *grouping(GlobalState *state, Ast *left, int exprType,
+                     RewindState *rewind) {
+  ZyToken open = state->parser.previous;
+  if (isTargetType(exprType)) {
+    /* `(a)` 就是 a，有逗号时才是元组 */
+    Precedence precedence = targetPrecedence(exprType);
+    Ast *targets = emptyAst(AST_LIST_EXPR, open);
+    if (!check(state, TOKEN_RIGHT_PAREN)) {
+      Ast *first = target(state, precedence);
+      if (!match(state, TOKEN_COMMA)) {
+        freeAst(targets, true);
+        consume(state, TOKEN_RIGHT_PAREN, "Expected ')' after target.");
+        return first;
+      }
+      astAppendChild(targets, first);
+      appendTargets(state, targets, precedence, TOKEN_RIGHT_PAREN);
+    }
+    consume(state, TOKEN_RIGHT_PAREN, "Expected ')' after targets.");
+    return newAst(AST_EXPR_ARRAY, open, 1, targets);
+  }
+
+  Ast *result;
+  if (check(state, TOKEN_RIGHT_PAREN)) {
+    result = newAst(AST_EXPR_ARRAY, open, 1, emptyAst(AST_LIST_EXPR, open));
+  } else {
+    Ast *first = expression(state);
+    if (atComprehension(state)) {
+      result = comprehension(state, first, open);
+    } else if (match(state, TOKEN_COMMA)) {
+      Ast *elements = newAst(AST_LIST_EXPR, open, 1, first);
+      appendElements(state, elements, TOKEN_RIGHT_PAREN);
+      result = newAst(AST_EXPR_ARRAY, open, 1, elements);
+    } else {
+      result = newAst(AST_EXPR_GROUPING, open, 1, first);
+    }
+  }
+  consume(state, TOKEN_RIGHT_PAREN, "Expected ')' after expression.");
+  if (canReparse(state, exprType, rewind))
+    return reparseAsTargets(state, result, rewind);
+  return result;
+}
+
+static Ast *list(GlobalState *state, Ast *left, int exprType,
+                 RewindState *rewind) {
+  ZyToken open = state->parser.previous;
+  Ast *result;
+  if (isTargetType(exprType)) {
+    Ast *targets = emptyAst(AST_LIST_EXPR, open);
+    appendTargets(state, targets, targetPrecedence(exprType),
+                  TOKEN_RIGHT_SQUARE);
+    result = newAst(AST_EXPR_ARRAY, open, 1, targets);
+    result->modifier.isMutable = true;
+    consume(state, TOKEN_RIGHT_SQUARE, "Expected ']' after targets.");
+    return result;
+  }
+
+  if (check(state, TOKEN_RIGHT_SQUARE)) {
+    result = newAst(AST_EXPR_ARRAY, open, 1, emptyAst(AST_LIST_EXPR, open));
+    result->modifier.isMutable = true;
+  } else {
+    Ast *first = expression(state);
+    if (atComprehension(state)) {
+      result = comprehension(state, first, open);
+    } else {
+      Ast *elements = newAst(AST_LIST_EXPR, open, 1, first);
+      if (match(state, TOKEN_COMMA))
+        appendElements(state, elements, TOKEN_RIGHT_SQUARE);
+      result = newAst(AST_EXPR_ARRAY, open, 1, elements);
+      result->modifier.isMutable = true;
+    }
+  }
+  consume(state, TOKEN_RIGHT_SQUARE, "Expected ']' after list.");
+  if (canReparse(state, exprType, rewind))
+    return reparseAsTargets(state, result, rewind);
+  return result;
+}
+
+static inline int isDoubleStar(Ast *ast) {
+  return ast->kind == AST_EXPR_UNARY && ast->token.type == TOKEN_POW;
+}
+
+/* 字典的一项；`**d` 展开时值是一个占位的 None */
+static void dictionaryEntry(GlobalState *state, Ast *keys, Ast *values,
+                            Ast *key) {
+  Ast *value;
+  if (isDoubleStar(key)) {
+    value = placeholder(&key->token);
+  } else {
+    consume(state, TOKEN_COLON, "Expected ':' after dictionary key.");
+    value = expression(state);
+  }
+  astAppendChild(keys, key);
+  astAppendChild(values, value);
+}
+
+/* `{` 开始的字典、集合以及它们的推导式 */
+static Ast *dictionary(GlobalState *state, Ast *left, int exprType,
+                       RewindState *rewind) {
+  ZyToken open = state->parser.previous;
+  Ast *result;
+  if (check(state, TOKEN_RIGHT_BRACE)) {
+    result = newAst(AST_EXPR_DICTIONARY, open, 2,
+                    emptyAst(AST_LIST_EXPR, open),
+                    emptyAst(AST_LIST_EXPR, open));
+  } else {
+    Ast *first = expression(state);
+    if (isDoubleStar(first) || check(state, TOKEN_COLON)) {
+      Ast *keys = emptyAst(AST_LIST_EXPR, open);
+      Ast *values = emptyAst(AST_LIST_EXPR, open);
+      dictionaryEntry(state, keys, values, first);
+      result = newAst(AST_EXPR_DICTIONARY, open, 2, keys, values);
+      if (atComprehension(state)) {
+        result = comprehension(state, result, open);
+      } else {
+        while (match(state, TOKEN_COMMA) &&
+               !check(state, TOKEN_RIGHT_BRACE))
+          dictionaryEntry(state, keys, values, expression(state));
+      }
+    } else if (atComprehension(state)) {
+      result = comprehension(state, first, open);
+    } else {
+      Ast *elements = newAst(AST_LIST_EXPR, open, 1, first);
+      if (match(state, TOKEN_COMMA))
+        appendElements(state, elements, TOKEN_RIGHT_BRACE);
+      result = newAst(AST_EXPR_SET, open, 1, elements);
+    }
+  }
+  consume(state, TOKEN_RIGHT_BRACE, "Expected '}' after dictionary.");
+  return result;
+}
+
+static Ast *unary(GlobalState *state, Ast *left, int exprType,
+                  RewindState *rewind) {
+  ZyToken op = state->parser.previous;
+  Precedence precedence = op.type == TOKEN_NOT ? PREC_NOT : PREC_FACTOR;
+  return newAst(AST_EXPR_UNARY, op, 1, parsePrecedence(state, precedence));
+}
+
+/* `*x` 和 `**x`：解包、收集剩余元素的目标 */
+static Ast *star(GlobalState *state, Ast *left, int exprType,
+                 RewindState *rewind) {
+  ZyToken op = state->parser.previous;
+  Ast *operand = isTargetType(exprType)
+                     ? target(state, targetPrecedence(exprType))
+                     : parsePrecedence(state, PREC_BITOR);
+  return newAst(AST_EXPR_UNARY, op, 1, operand);
+}
+
+static Ast *binary(GlobalState *state, Ast *left, int exprType,
+                   RewindState *rewind) {
+  ZyToken op = state->parser.previous;
+  Precedence precedence = getRule(op.type)->precedence;
+  /* `not in` 和 `is not` 是一个运算符，token 包括两个词 */
+  if (op.type == TOKEN_NOT) {
+    consume(state, TOKEN_IN, "Expected 'in' after 'not'.");
+    op = spanTokens(op, state->parser.previous);
+  } else if (op.type == TOKEN_IS && match(state, TOKEN_NOT)) {
+    op = spanTokens(op, state->parser.previous);
+  }
+  /* `**` 右结合，右边还可以是一元运算 */
+  Ast *right = parsePrecedence(state, op.type == TOKEN_POW
+                                          ? PREC_FACTOR
+                                          : (Precedence)(precedence + 1));
+  return newAst(AST_EXPR_BINARY, op, 2, left, right);
+}
+
+static Ast *and_(GlobalState *state, Ast *left, int exprType,
+                 RewindState *rewind) {
+  ZyToken op = state->parser.previous;
+  return newAst(AST_EXPR_AND, op, 2, left, parsePrecedence(state, PREC_NOT));
+}
+
+static Ast *or_(GlobalState *state, Ast *left, int exprType,
+                RewindState *rewind) {
+  ZyToken op = state->parser.previous;
+  return newAst(AST_EXPR_OR, op, 2, left, parsePrecedence(state, PREC_AND));
+}
+
+/* TERNARY(`if`: 条件成立时的值, 条件, 否则的值) */
+static Ast *ternary(GlobalState *state, Ast *left, int exprType,
+                    RewindState *rewind) {
+  ZyToken keyword = state->parser.previous;
+  Ast *condition = parsePrecedence(state, PREC_OR);
+  consume(state, TOKEN_ELSE, "Expected 'else' after ternary condition.");
+  Ast *otherwise = parsePrecedence(state, PREC_TERNARY);
+  return newAst(AST_EXPR_TERNARY, keyword, 3, left, condition, otherwise);
+}
+
+/* 不带括号的元组，后面是`=`时其实是一组赋值目标 */
+static Ast *comma(GlobalState *state, Ast *left, int exprType,
+                  RewindState *rewind) {
+  Ast *elements = newAst(AST_LIST_EXPR, state->parser.previous, 1, left);
+  while (startsExpression(state)) {
+    astAppendChild(elements, parsePrecedence(state, PREC_TERNARY));
+    if (!match(state, TOKEN_COMMA))
+      break;
+  }
+  Ast *tuple = newAst(AST_EXPR_ARRAY, elements->token, 1, elements);
+  if (canReparse(state, exprType, rewind))
+    return reparseAsTargets(state, tuple, rewind);
+  return tuple;
+}
+
+static Ast *call(GlobalState *state, Ast *left, int exprType,
+                 RewindState *rewind) {
+  ZyToken paren = state->parser.previous;
+  return newAst(AST_EXPR_CALL, paren, 2, left, arguments(state));
+}
+
+static Ast *dot(GlobalState *state, Ast *left, int exprType,
+                RewindState *rewind) {
+  consumeName(state, "Expected property name after '.'.");
+  ZyToken name = state->parser.previous;
+  if (exprType == EXPR_ASSIGN_TARGET && endsTarget(state))
+    return newAst(AST_EXPR_PROPERTY_SET, name, 1, left);
+  if (exprType == EXPR_CAN_ASSIGN) {
+    Ast *value = assignmentValue(state);
+    if (value != NULL)
+      return newAst(AST_EXPR_PROPERTY_SET, name, 2, left, value);
+  }
+  if (match(state, TOKEN_LEFT_PAREN))
+    return newAst(AST_EXPR_INVOKE, name, 2, left, arguments(state));
+  return newAst(AST_EXPR_PROPERTY_GET, name, 1, left);
+}
+
+static inline int atSliceBound(GlobalState *state) {
+  return !check(state, TOKEN_COLON) && !check(state, TOKEN_COMMA) &&
+         !check(state, TOKEN_RIGHT_SQUARE);
+}
+
+/* 下标里的一项：表达式，或者 SLICE(`:`: 起点, 终点, 步长) */
+static Ast *sliceItem(GlobalState *state) {
+  ZyToken at = state->parser.current;
+  Ast *start = check(state, TOKEN_COLON) ? NULL : expression(state);
+  if (!match(state, TOKEN_COLON))
+    return start;
+  ZyToken colon = state->parser.previous;
+  if (start == NULL)
+    start = placeholder(&at);
+  Ast *stop = atSliceBound(state) ? expression(state)
+                                  : placeholder(&state->parser.current);
+  Ast *step = NULL;
+  if (match(state, TOKEN_COLON) && atSliceBound(state))
+    step = expression(state);
+  if (step == NULL)
+    step = placeholder(&state->parser.current);
+  return newAst(AST_EXPR_SLICE, colon, 3, start, stop, step);
+}
+
+static Ast *subscript(GlobalState *state, Ast *left, int exprType,
+                      RewindState *rewind) {
+  ZyToken bracket = state->parser.previous;
+  Ast *index = sliceItem(state);
+  if (check(state, TOKEN_COMMA)) {
+    Ast *items = newAst(AST_LIST_EXPR, bracket, 1, index);
+    while (match(state, TOKEN_COMMA) && !check(state, TOKEN_RIGHT_SQUARE))
+      astAppendChild(items, sliceItem(state));
+    index = newAst(AST_EXPR_ARRAY, bracket, 1, items);
+  }
+  consume(state, TOKEN_RIGHT_SQUARE, "Expected ']' after subscript.");
+
+  if (exprType == EXPR_ASSIGN_TARGET && endsTarget(state))
+    return newAst(AST_EXPR_SUBSCRIPT_SET, bracket, 2, left, index);
+  if (exprType == EXPR_CAN_ASSIGN) {
+    Ast *value = assignmentValue(state);
+    if (value != NULL)
+      return newAst(AST_EXPR_SUBSCRIPT_SET, bracket, 3, left, index, value);
+  }
+  return newAst(AST_EXPR_SUBSCRIPT_GET, bracket, 2, left, index);
+}
+
+/* FUNCTION(`lambda`: 参数, 作为函数体的表达式) */
+static Ast *lambda(GlobalState *state, Ast *left, int exprType,
+                   RewindState *rewind) {
+  ZyToken keyword = state->parser.previous;
+  Ast *params = parameters(state, TOKEN_COLON, 0);
+  consume(state, TOKEN_COLON, "Expected ':' after lambda parameters.");
+  FunctionType enclosing = state->functionType;
+  state->functionType = TYPE_LAMBDA;
+  Ast *body = expression(state);
+  state->functionType = enclosing;
+  Ast *function = newAst(AST_EXPR_FUNCTION, keyword, 2, params, body);
+  function->modifier.isLambda = true;
+  return function;
+}
+
+static Ast *await_(GlobalState *state, Ast *left, int exprType,
+                   RewindState *rewind) {
+  ZyToken keyword = state->parser.previous;
+  if (!isCoroutine(state->functionType))
+    errorAtPrevious(state, "'await' outside async function.");
+  return newAst(AST_EXPR_AWAIT, keyword, 1,
+                parsePrecedence(state, PREC_PRIMARY));
+}
+
+static Ast *yield_(GlobalState *state, Ast *left, int exprType,
+                   RewindState *rewind) {
+  ZyToken keyword = state->parser.previous;
+  if (state->functionType == TYPE_MODULE ||
+      state->functionType == TYPE_CLASS)
+    errorAtPrevious(state, "'yield' outside function.");
+  Ast *node = emptyAst(AST_EXPR_YIELD, keyword);
+  if (match(state, TOKEN_FROM)) {
+    node->modifier.isYieldFrom = true;
+    astAppendChild(node, expression(state));
+  } else if (startsExpression(state)) {
+    astAppendChild(node, parsePrecedence(state, PREC_COMMA));
+  }
+  return node;
+}
+
+#define RULE(token, a, b, c) [TOKEN_##token] = {a, b, c}
+
+/* 没有列出的 token 既不能开始表达式，也不能跟在表达式后面 */
+static ParseRule rules[TOKEN_DEDENT + 1] = {
+    RULE(LEFT_PAREN, grouping, call, PREC_PRIMARY),
+    RULE(LEFT_SQUARE, list, subscript, PREC_PRIMARY),
+    RULE(LEFT_BRACE, dictionary, NULL, PREC_NONE),
+    RULE(DOT, NULL, dot, PREC_PRIMARY),
+    RULE(COMMA, NULL, comma, PREC_COMMA),
+    RULE(MINUS, unary, binary, PREC_SUM),
+    RULE(PLUS, unary, binary, PREC_SUM),
+    RULE(TILDE, unary, NULL, PREC_NONE),
+    RULE(NOT, unary, binary, PREC_COMPARISON),
+    RULE(ASTERISK, star, binary, PREC_TERM),
+    RULE(POW, star, binary, PREC_EXPONENT),
+    RULE(SOLIDUS, NULL, binary, PREC_TERM),
+    RULE(DOUBLE_SOLIDUS, NULL, binary, PREC_TERM),
+    RULE(MODULO, NULL, binary, PREC_TERM),
+    RULE(AT, NULL, binary, PREC_TERM),
+    RULE(LEFT_SHIFT, NULL, binary, PREC_SHIFT),
+    RULE(RIGHT_SHIFT, NULL, binary, PREC_SHIFT),
+    RULE(AMPERSAND, NULL, binary, PREC_BITAND),
+    RULE(CARET, NULL, binary, PREC_BITXOR),
+    RULE(PIPE, NULL, binary, PREC_BITOR),
+    RULE(GREATER, NULL, binary, PREC_COMPARISON),
+    RULE(LESS, NULL, binary, PREC_COMPARISON),
+    RULE(GREATER_EQUAL, NULL, binary, PREC_COMPARISON),
+    RULE(LESS_EQUAL, NULL, binary, PREC_COMPARISON),
+    RULE(BANG_EQUAL, NULL, binary, PREC_COMPARISON),
+    RULE(EQUAL_EQUAL, NULL, binary, PREC_COMPARISON),
+    RULE(IN, NULL, binary, PREC_COMPARISON),
+    RULE(IS, NULL, binary, PREC_COMPARISON),
+    RULE(AND, NULL, and_, PREC_AND),
+    RULE(OR, NULL, or_, PREC_OR),
+    RULE(IF, NULL, ternary, PREC_TERNARY),
+    RULE(STRING, string, NULL, PREC_NONE),
+    RULE(BIG_STRING, string, NULL, PREC_NONE),
+    RULE(PREFIX_B, string, NULL, PREC_NONE),
+    RULE(PREFIX_F, string, NULL, PREC_NONE),
+    RULE(PREFIX_R, string, NULL, PREC_NONE),
+    RULE(NUMBER, literal, NULL, PREC_NONE),
+    RULE(TRUE, literal, NULL, PREC_NONE),
+    RULE(FALSE, literal, NULL, PREC_NONE),
+    RULE(NONE, literal, NULL, PREC_NONE),
+    RULE(ELLIPSIS, literal, NULL, PREC_NONE),
+    RULE(IDENTIFIER, variable, NULL, PREC_NONE),
+    RULE(SUPER, variable, NULL, PREC_NONE),
+    RULE(LAMBDA, lambda, NULL, PREC_NONE),
+    RULE(AWAIT, await_, NULL, PREC_NONE),
+    RULE(YIELD, yield_, NULL, PREC_NONE),
+};
+
+#undef RULE
+
+static const ParseRule *getRule(ZyTokenType type) { return &rules[type]; }
+
+static Ast *parsePrecedence(GlobalState *state, Precedence precedence) {
+  ParseFn prefixRule = getRule(state->parser.current.type)->prefix;
+  if (prefixRule == NULL) {
+    /* 不消耗这个 token，EOL 和 DEDENT 要留给语句 */
+    errorAtCurrent(state, "Expected expression.");
+    return emptyAst(AST_KIND_ERROR, state->parser.current);
+  }
+
+  int exprType = EXPR_NORMAL;
+  if (precedence <= PREC_ASSIGNMENT || precedence == PREC_CAN_ASSIGN)
+    exprType = EXPR_CAN_ASSIGN;
+  else if (precedence == PREC_MUST_ASSIGN)
+    exprType = EXPR_ASSIGN_TARGET;
+  else if (precedence == PREC_DEL_TARGET)
+    exprType = EXPR_DEL_TARGET;
+
+  /* 只有可能是赋值的表达式才需要回退 */
+  RewindState rewind;
+  RewindState *rewindAt = NULL;
+  if (exprType == EXPR_CAN_ASSIGN) {
+    recordRewind(state, &rewind);
+    rewindAt = &rewind;
+  }
+
+  advance(state);
+  Ast *left = prefixRule(state, NULL, exprType, rewindAt);
+  while (1) {
+    const ParseRule *rule = getRule(state->parser.current.type);
+    if (precedence > rule->precedence)
+      break;
+    /* 赋值目标只能带`.`、调用和下标 */
+    if (isTargetType(exprType) && rule->precedence < PREC_PRIMARY)
+      break;
+    advance(state);
+    left = rule->infix(state, left, exprType, rewindAt);
+  }
+
+  if (exprType == EXPR_CAN_ASSIGN &&
+      (check(state, TOKEN_EQUAL) ||
+       isAugmentedAssignment(state->parser.current.type)))
+    errorAtCurrent(state, "Invalid assignment target.");
+  return left;
+}
+
+static Ast *expression(GlobalState *state) {
+  return parsePrecedence(state, PREC_TERNARY);
+}
+
+/* 出错之后跳到下一条语句；出错的那一行带着的块也一起跳过 */
+static void synchronize(GlobalState *state) {
+  state->parser.panicMode = 0;
+  while (!check(state, TOKEN_EOF)) {
+    if (state->parser.previous.type == TOKEN_EOL)
+      break;
+    if (check(state, TOKEN_DEDENT))
+      return;
+    advance(state);
+  }
+  if (!check(state, TOKEN_INDENT))
+    return;
+  int depth = 0;
+  do {
+    if (check(state, TOKEN_INDENT))
+      depth++;
+    else if (check(state, TOKEN_DEDENT))
+      depth--;
+    advance(state);
+  } while (depth > 0 && !check(state, TOKEN_EOF));
+}
+
+static inline int atEndOfStatement(GlobalState *state) {
+  return check(state, TOKEN_EOL) || check(state, TOKEN_SEMICOLON) ||
+         check(state, TOKEN_EOF);
+}
+
+static int isSoftKeyword(const ZyToken *token, const char *word) {
+  size_t length = strlen(word);
+  return token->type == TOKEN_IDENTIFIER && token->length == length &&
+         memcmp(token->start, word, length) == 0;
+}
+
+/* 标注了类型的变量：DECL_VAR(目标, 类型, 可能有的初值) */
+static Ast *annotatedAssignment(GlobalState *state, Ast *target) {
+  switch (target->kind) {
+  case AST_EXPR_VARIABLE:
+  case AST_EXPR_PROPERTY_GET:
+  case AST_EXPR_SUBSCRIPT_GET:
+  case AST_EXPR_GROUPING:
+    break;
+  default:
+    errorAtPrevious(state, "Illegal target for annotation.");
+    break;
+  }
+  Ast *annotation = expression(state);
+  Ast *decl = newAst(AST_DECL_VAR, target->token, 2, target, annotation);
+  if (match(state, TOKEN_EQUAL))
+    astAppendChild(decl, parsePrecedence(state, PREC_COMMA));
+  return decl;
+}
+
+static Ast *expressionStatement(GlobalState *state) {
+  ZyToken start = state->parser.current;
+  Ast *expr = parsePrecedence(state, PREC_ASSIGNMENT);
+  if (match(state, TOKEN_COLON))
+    return annotatedAssignment(state, expr);
+  return newAst(AST_STMT_EXPRESSION, start, 1, expr);
+}
+
+static Ast *returnStatement(GlobalState *state) {
+  ZyToken keyword = state->parser.previous;
+  if (state->functionType == TYPE_MODULE ||
+      state->functionType == TYPE_CLASS)
+    errorAtPrevious(state, "'return' outside function.");
+  Ast *node = emptyAst(AST_STMT_RETURN, keyword);
+  if (!atEndOfStatement(state))
+    astAppendChild(node, parsePrecedence(state, PREC_COMMA));
+  return node;
+}
+
+/* THROW(异常, `from` 后面的原因)，两者都可以没有 */
+static Ast *raiseStatement(GlobalState *state) {
+  Ast *node = emptyAst(AST_STMT_THROW, state->parser.previous);
+  if (!atEndOfStatement(state)) {
+    astAppendChild(node, expression(state));
+    if (match(state, TOKEN_FROM))
+      astAppendChild(node, expression(state));
+  }
+  return node;
+}
+
+static Ast *globalStatement(GlobalState *state) {
+  Ast *node = emptyAst(AST_STMT_GLOBAL, state->parser.previous);
+  do {
+    consume(state, TOKEN_IDENTIFIER, "Expected variable name.");
+    astAppendChild(node, emptyAst(AST_EXPR_VARIABLE, state->parser.previous));
+  } while (match(state, TOKEN_COMMA));
+  return node;
+}
+
+static Ast *delStatement(GlobalState *state) {
+  Ast *node = emptyAst(AST_STMT_DEL, state->parser.previous);
+  do {
+    if (atEndOfStatement(state) && astHasChild(node))
+      break;
+    astAppendChild(node, target(state, PREC_DEL_TARGET));
+  } while (match(state, TOKEN_COMMA));
+  return node;
+}
+
+static Ast *assertStatement(GlobalState *state) {
+  Ast *node = newAst(AST_STMT_ASSERT, state->parser.previous, 1,
+                     expression(state));
+  if (match(state, TOKEN_COMMA))
+    astAppendChild(node, expression(state));
+  return node;
+}
+
+/* 模块名的各段，相对导入时前面可以有`.`和`...` */
+static Ast *modulePath(GlobalState *state, int relative) {
+  Ast *path = emptyAst(AST_LIST_EXPR, state->parser.current);
+  if (relative) {
+    while (match(state, TOKEN_DOT) || match(state, TOKEN_ELLIPSIS))
+      astAppendChild(path,
+                     emptyAst(AST_EXPR_VARIABLE, state->parser.previous));
+    if (astHasChild(path) && check(state, TOKEN_IMPORT))
+      return path;
+  }
+  do {
+    consume(state, TOKEN_IDENTIFIER, "Expected module name.");
+    astAppendChild(path, emptyAst(AST_EXPR_VARIABLE, state->parser.previous));
+  } while (match(state, TOKEN_DOT));
+  return path;
+}
+
+/* USING(名字的各段, 可能有的别名) */
+static Ast *importItem(GlobalState *state, Ast *path) {
+  Ast *item = newAst(AST_STMT_USING, path->token, 1, path);
+  if (match(state, TOKEN_AS)) {
+    consume(state, TOKEN_IDENTIFIER, "Expected name after 'as'.");
+    astAppendChild(item, emptyAst(AST_EXPR_VARIABLE, state->parser.previous));
+  }
+  return item;
+}
+
+/* REQUIRE(`import`: 每个模块一个 USING) */
+static Ast *importStatement(GlobalState *state) {
+  Ast *node = emptyAst(AST_STMT_REQUIRE, state->parser.previous);
+  do {
+    astAppendChild(node, importItem(state, modulePath(state, 0)));
+  } while (match(state, TOKEN_COMMA));
+  return node;
+}
+
+/* REQUIRE(`from`: 模块的 USING，然后每个导入的名字一个 USING) */
+static Ast *fromStatement(GlobalState *state) {
+  Ast *node = emptyAst(AST_STMT_REQUIRE, state->parser.previous);
+  Ast *path = modulePath(state, 1);
+  astAppendChild(node, newAst(AST_STMT_USING, path->token, 1, path));
+  consume(state, TOKEN_IMPORT, "Expected 'import' after module name.");
+
+  if (match(state, TOKEN_ASTERISK)) {
+    ZyToken all = state->parser.previous;
+    Ast *name = newAst(AST_LIST_EXPR, all, 1, emptyAst(AST_EXPR_VARIABLE, all));
+    astAppendChild(node, newAst(AST_STMT_USING, all, 1, name));
+    return node;
+  }
+  int parens = match(state, TOKEN_LEFT_PAREN);
+  do {
+    if (parens && check(state, TOKEN_RIGHT_PAREN))
+      break;
+    consume(state, TOKEN_IDENTIFIER, "Expected name to import.");
+    ZyToken imported = state->parser.previous;
+    Ast *name = newAst(AST_LIST_EXPR, imported, 1,
+                       emptyAst(AST_EXPR_VARIABLE, imported));
+    astAppendChild(node, importItem(state, name));
+  } while (match(state, TOKEN_COMMA));
+  if (parens)
+    consume(state, TOKEN_RIGHT_PAREN, "Expected ')' after imported names.");
+  return node;
+}
+
+static Ast *simpleStatement(GlobalState *state) {
+  switch (state->parser.current.type) {
+  case TOKEN_PASS:
+    advance(state);
+    return emptyAst(AST_STMT_PASS, state->parser.previous);
+  case TOKEN_BREAK:
+    advance(state);
+    return emptyAst(AST_STMT_BREAK, state->parser.previous);
+  case TOKEN_CONTINUE:
+    advance(state);
+    return emptyAst(AST_STMT_CONTINUE, state->parser.previous);
+  case TOKEN_RETURN:
+    advance(state);
+    return returnStatement(state);
+  case TOKEN_RAISE:
+    advance(state);
+    return raiseStatement(state);
+  case TOKEN_GLOBAL:
+  case TOKEN_NONLOCAL:
+    advance(state);
+    return globalStatement(state);
+  case TOKEN_DEL:
+    advance(state);
+    return delStatement(state);
+  case TOKEN_ASSERT:
+    advance(state);
+    return assertStatement(state);
+  case TOKEN_IMPORT:
+    advance(state);
+    return importStatement(state);
+  case TOKEN_FROM:
+    advance(state);
+    return fromStatement(state);
+  default:
+    return expressionStatement(state);
+  }
+}
+
+/* 一行里用`;`分开的简单语句 */
+static void simpleStatements(GlobalState *state, Ast *statements) {
+  astAppendChild(statements, simpleStatement(state));
+  while (match(state, TOKEN_SEMICOLON) && !check(state, TOKEN_EOL))
+    astAppendChild(statements, simpleStatement(state));
+  consume(state, TOKEN_EOL, "Expected end of line.");
+}
+
+/*
+ * `:` 后面的语句块 BLOCK(语句的列表)：换行之后缩进的若干条语句，
+ * 或者同一行里的简单语句。
+ */
+static Ast *block(GlobalState *state) {
+  ZyToken colon = state->parser.previous;
+  Ast *statements = emptyAst(AST_LIST_STMT, colon);
+  if (!match(state, TOKEN_EOL)) {
+    simpleStatements(state, statements);
+  } else if (!match(state, TOKEN_INDENT)) {
+    errorAtCurrent(state, "Expected an indented block.");
+  } else {
+    while (!check(state, TOKEN_DEDENT) && !check(state, TOKEN_EOF))
+      statement(state, statements);
+    consume(state, TOKEN_DEDENT, "Expected end of block.");
+  }
+  return newAst(AST_STMT_BLOCK, colon, 1, statements);
+}
+
+/* 跟在`:`后面的 else 块，没有时什么也不做 */
+static void elseBlock(GlobalState *state, Ast *node) {
+  if (!match(state, TOKEN_ELSE))
+    return;
+  consume(state, TOKEN_COLON, "Expected ':' after 'else'.");
+  astAppendChild(node, block(state));
+}
+
+/* IF(条件, 语句块, 可能有的 else 块；elif 是嵌套的 IF) */
+static Ast *ifStatement(GlobalState *state) {
+  ZyToken keyword = state->parser.previous;
+  Ast *condition = expression(state);
+  consume(state, TOKEN_COLON, "Expected ':' after condition.");
+  Ast *node = newAst(AST_STMT_IF, keyword, 2, condition, block(state));
+  if (match(state, TOKEN_ELIF))
+    astAppendChild(node, ifStatement(state));
+  else
+    elseBlock(state, node);
+  return node;
+}
+
+static Ast *whileStatement(GlobalState *state) {
+  ZyToken keyword = state->parser.previous;
+  Ast *condition = expression(state);
+  consume(state, TOKEN_COLON, "Expected ':' after condition.");
+  Ast *node = newAst(AST_STMT_WHILE, keyword, 2, condition, block(state));
+  elseBlock(state, node);
+  return node;
+}
+
+/* FOR(目标, 可迭代对象, 语句块, 可能有的 else 块) */
+static Ast *forStatement(GlobalState *state, int isAsync) {
+  ZyToken keyword = state->parser.previous;
+  Ast *targets = targetList(state, PREC_MUST_ASSIGN);
+  consume(state, TOKEN_IN, "Expected 'in' after loop targets.");
+  Ast *iterable = parsePrecedence(state, PREC_COMMA);
+  consume(state, TOKEN_COLON, "Expected ':' after for clause.");
+  Ast *node =
+      newAst(AST_STMT_FOR, keyword, 3, targets, iterable, block(state));
+  node->modifier.isAsync = isAsync;
+  elseBlock(state, node);
+  return node;
+}
+
+/*
+ * TRY(语句块, CATCH 的列表, 可能有的 else 块, 可能有的 FINALLY)。
+ * CATCH 的 token 是`as`后面的名字（没有时是`except`），子节点是
+ * 异常类型的列表和语句块。
+ */
+static Ast *tryStatement(GlobalState *state) {
+  ZyToken keyword = state->parser.previous;
+  consume(state, TOKEN_COLON, "Expected ':' after 'try'.");
+  Ast *body = block(state);
+  Ast *handlers = emptyAst(AST_LIST_STMT, keyword);
+  Ast *node = newAst(AST_STMT_TRY, keyword, 2, body, handlers);
+
+  while (match(state, TOKEN_EXCEPT)) {
+    ZyToken name = state->parser.previous;
+    Ast *types = emptyAst(AST_LIST_EXPR, name);
+    if (!check(state, TOKEN_COLON)) {
+      astAppendChild(types, expression(state));
+      if (match(state, TOKEN_AS)) {
+        consume(state, TOKEN_IDENTIFIER, "Expected name after 'as'.");
+        name = state->parser.previous;
+      }
+    }
+    consume(state, TOKEN_COLON, "Expected ':' after exception type.");
+    astAppendChild(handlers,
+                   newAst(AST_STMT_CATCH, name, 2, types, block(state)));
+  }
+  if (astHasChild(handlers))
+    elseBlock(state, node);
+
+  if (match(state, TOKEN_FINALLY)) {
+    ZyToken finally = state->parser.previous;
+    consume(state, TOKEN_COLON, "Expected ':' after 'finally'.");
+    astAppendChild(node, newAst(AST_STMT_FINALLY, finally, 1, block(state)));
+  } else if (!astHasChild(handlers)) {
+    errorAtCurrent(state, "Expected 'except' or 'finally' block.");
+  }
+  return node;
+}
+
+/* with 的一项：表达式，或者 BINARY(`as`: 表达式, 目标) */
+static Ast *withItem(GlobalState *state) {
+  Ast *item = expression(state);
+  if (match(state, TOKEN_AS)) {
+    ZyToken as = state->parser.previous;
+    item = newAst(AST_EXPR_BINARY, as, 2, item,
+                  target(state, PREC_MUST_ASSIGN));
+  }
+  return item;
+}
+
+/* WITH(各项的列表, 语句块) */
+static Ast *withStatement(GlobalState *state, int isAsync) {
+  ZyToken keyword = state->parser.previous;
+  Ast *items = emptyAst(AST_LIST_EXPR, keyword);
+
+  /* `with (a as b, c as d):` 的括号也可能只是第一项表达式的一部分 */
+  int parenthesized = 0;
+  if (check(state, TOKEN_LEFT_PAREN)) {
+    RewindState rewind;
+    beginSpeculation(state, &rewind);
+    advance(state);
+    Ast *elements = emptyAst(AST_LIST_EXPR, keyword);
+    appendElements(state, elements, TOKEN_RIGHT_PAREN);
+    int closed = match(state, TOKEN_RIGHT_PAREN);
+    /* 里面有`as`而解析不下去，或者整个是`with (a, b):` */
+    parenthesized = !closed || state->parser.speculationFailed ||
+                    (check(state, TOKEN_COLON) && astNumChild(elements) > 1);
+    freeAst(elements, true);
+    endSpeculation(state, &rewind, 0);
+  }
+  if (parenthesized) {
+    advance(state);
+    while (!check(state, TOKEN_RIGHT_PAREN) && !check(state, TOKEN_EOF)) {
+      astAppendChild(items, withItem(state));
+      if (!match(state, TOKEN_COMMA))
+        break;
+    }
+    consume(state, TOKEN_RIGHT_PAREN, "Expected ')' after with items.");
+  } else {
+    do {
+      astAppendChild(items, withItem(state));
+    } while (match(state, TOKEN_COMMA));
+  }
+
+  consume(state, TOKEN_COLON, "Expected ':' after with items.");
+  Ast *node = newAst(AST_STMT_WITH, keyword, 2, items, block(state));
+  node->modifier.isAsync = isAsync;
+  return node;
+}
+
+/* 类里的 def 是哪种方法：看名字和 staticmethod/classmethod 装饰器 */
+static FunctionType methodType(Ast *decorators, ZyToken name, int isAsync) {
+  if (isAsync)
+    return TYPE_COROUTINE_METHOD;
+  if (isSoftKeyword(&name, "__init__"))
+    return TYPE_INIT;
+  for (int i = 0; decorators != NULL && i < astNumChild(decorators); i++) {
+    Ast *decorator = astGetChild(decorators, i);
+    if (isSoftKeyword(&decorator->token, "staticmethod"))
+      return TYPE_STATIC;
+    if (isSoftKeyword(&decorator->token, "classmethod"))
+      return TYPE_CLASSMETHOD;
+  }
+  return TYPE_METHOD;
+}
+
+/*
+ * 预解析时跳过缩进的函数体，只留下一个 isLazy 的 BLOCK，它的
+ * token 从`:`一直到函数体的最后一个 token。靠 INDENT 和 DEDENT
+ * 配对找到结尾，不看里面的 token；函数体里的错误要等到
+ * zy_functionBody 解析它时才会报告。
+ */
+static Ast *lazyBody(GlobalState *state) {
+  ZyToken colon = state->parser.previous;
+  const uint8_t *types = state->tokens->types;
+  size_t last = state->tokens->count - 1;
+  size_t i = state->current + 1; /* current 是 EOL，后面是 INDENT */
+  long depth = 0;
+  for (; i < last; i++) {
+    if (types[i] == TOKEN_INDENT)
+      depth++;
+    else if (types[i] == TOKEN_DEDENT && --depth == 0)
+      break;
+  }
+  Ast *body =
+      emptyAst(AST_STMT_BLOCK, spanTokens(colon, tokenAt(state, i - 1)));
+  body->modifier.isLazy = true;
+  RewindState end = {i};
+  rewindTo(state, &end);
+  consume(state, TOKEN_DEDENT, "Expected end of block.");
+  return body;
+}
+
+static inline int atIndentedBlock(GlobalState *state) {
+  return check(state, TOKEN_EOL) && state->current + 1 < state->tokens->count &&
+         zy_tokenType(state->tokens, state->current + 1) == TOKEN_INDENT;
+}
+
+/*
+ * DECL_FUN 或者 DECL_METHOD(FUNCTION(参数, 语句块, 可能有的返回值
+ * 类型), 可能有的装饰器列表)。
+ */
+static Ast *functionDeclaration(GlobalState *state, Ast *decorators,
+                                int isAsync) {
+  consume(state, TOKEN_IDENTIFIER, "Expected function name.");
+  ZyToken name = state->parser.previous;
+  FunctionType enclosing = state->functionType;
+  FunctionType type;
+  if (enclosing == TYPE_CLASS)
+    type = methodType(decorators, name, isAsync);
+  else
+    type = isAsync ? TYPE_COROUTINE : TYPE_FUNCTION;
+
+  consume(state, TOKEN_LEFT_PAREN, "Expected '(' after function name.");
+  Ast *params = parameters(state, TOKEN_RIGHT_PAREN, 1);
+  consume(state, TOKEN_RIGHT_PAREN, "Expected ')' after parameters.");
+  Ast *returns = NULL;
+  if (match(state, TOKEN_ARROW))
+    returns = expression(state);
+  consume(state, TOKEN_COLON, "Expected ':' after function signature.");
+
+  Ast *body;
+  if (state->lazyBodies && atIndentedBlock(state)) {
+    body = lazyBody(state);
+  } else {
+    state->functionType = type;
+    body = block(state);
+    state->functionType = enclosing;
+  }
+
+  Ast *function = newAst(AST_EXPR_FUNCTION, name, 2, params, body);
+  if (returns != NULL)
+    astAppendChild(function, returns);
+  Ast *decl = newAst(enclosing == TYPE_CLASS ? AST_DECL_METHOD : AST_DECL_FUN,
+                     name, 1, function);
+  decl->modifier.isAsync = isAsync;
+  decl->modifier.isInitializer = type == TYPE_INIT;
+  decl->modifier.isClass = type == TYPE_CLASSMETHOD;
+  if (decorators != NULL)
+    astAppendChild(decl, decorators);
+  return decl;
+}
+
+/* DECL_CLASS(基类和关键字参数的列表, 语句块, 可能有的装饰器列表) */
+static Ast *classDeclaration(GlobalState *state, Ast *decorators) {
+  consume(state, TOKEN_IDENTIFIER, "Expected class name.");
+  ZyToken name = state->parser.previous;
+  Ast *bases;
+  if (match(state, TOKEN_LEFT_PAREN))
+    bases = arguments(state);
+  else
+    bases = emptyAst(AST_LIST_EXPR, name);
+  consume(state, TOKEN_COLON, "Expected ':' after class name.");
+
+  FunctionType enclosing = state->functionType;
+  state->functionType = TYPE_CLASS;
+  Ast *body = block(state);
+  state->functionType = enclosing;
+
+  Ast *decl = newAst(AST_DECL_CLASS, name, 2, bases, body);
+  if (decorators != NULL)
+    astAppendChild(decl, decorators);
+  return decl;
+}
+
+static Ast *decorated(GlobalState *state) {
+  Ast *decorators = emptyAst(AST_LIST_EXPR, state->parser.current);
+  while (match(state, TOKEN_AT)) {
+    astAppendChild(decorators, expression(state));
+    consume(state, TOKEN_EOL, "Expected end of line after decorator.");
+  }
+  if (match(state, TOKEN_DEF))
+    return functionDeclaration(state, decorators, 0);
+  if (match(state, TOKEN_ASYNC)) {
+    consume(state, TOKEN_DEF, "Expected 'def' after 'async'.");
+    return functionDeclaration(state, decorators, 1);
+  }
+  if (match(state, TOKEN_CLASS))
+    return classDeclaration(state, decorators);
+  errorAtCurrent(state, "Expected function or class after decorators.");
+  return decorators;
+}
+
+/* case 后面的模式按表达式解析，`|`、字面量、`Cls(x=...)`都能覆盖 */
+static Ast *pattern(GlobalState *state) {
+  Ast *pattern = parsePrecedence(state, PREC_OR);
+  while (match(state, TOKEN_AS)) {
+    ZyToken as = state->parser.previous;
+    consume(state, TOKEN_IDENTIFIER, "Expected name after 'as'.");
+    pattern = newAst(AST_EXPR_BINARY, as, 2, pattern,
+                     emptyAst(AST_EXPR_VARIABLE, state->parser.previous));
+  }
+  return pattern;
+}
+
+static Ast *patternList(GlobalState *state) {
+  Ast *first = pattern(state);
+  if (!check(state, TOKEN_COMMA))
+    return first;
+  Ast *patterns = newAst(AST_LIST_EXPR, state->parser.current, 1, first);
+  while (match(state, TOKEN_COMMA) && !check(state, TOKEN_COLON) &&
+         !check(state, TOKEN_IF))
+    astAppendChild(patterns, pattern(state));
+  return newAst(AST_EXPR_ARRAY, patterns->token, 1, patterns);
+}
+
+/*
+ * SWITCH(`match`: 对象, CASE 的列表)，CASE 的子节点是模式、语句块和
+ * 可能有的 if 条件。`match` 只是软关键字：后面不像 match 语句时
+ * 返回 NULL，当作普通的表达式语句。
+ */
+static Ast *matchStatement(GlobalState *state) {
+  RewindState rewind;
+  beginSpeculation(state, &rewind);
+  advance(state);
+  ZyToken keyword = state->parser.previous;
+  Ast *subject = parsePrecedence(state, PREC_COMMA);
+  if (!endSpeculation(state, &rewind, check(state, TOKEN_COLON))) {
+    freeAst(subject, true);
+    return NULL;
+  }
+  advance(state);
+
+  Ast *cases = emptyAst(AST_LIST_STMT, keyword);
+  Ast *node = newAst(AST_STMT_SWITCH, keyword, 2, subject, cases);
+  consume(state, TOKEN_EOL, "Expected end of line after 'match'.");
+  if (!match(state, TOKEN_INDENT)) {
+    errorAtCurrent(state, "Expected an indented block.");
+    return node;
+  }
+  while (!check(state, TOKEN_DEDENT) && !check(state, TOKEN_EOF)) {
+    if (!isSoftKeyword(&state->parser.current, "case")) {
+      errorAtCurrent(state, "Expected 'case'.");
+      synchronize(state);
+      continue;
+    }
+    advance(state);
+    ZyToken caseToken = state->parser.previous;
+    Ast *patterns = patternList(state);
+    Ast *guard = NULL;
+    if (match(state, TOKEN_IF))
+      guard = expression(state);
+    consume(state, TOKEN_COLON, "Expected ':' after pattern.");
+    Ast *branch = newAst(AST_STMT_CASE, caseToken, 2, patterns, block(state));
+    if (guard != NULL)
+      astAppendChild(branch, guard);
+    astAppendChild(cases, branch);
+    if (state->parser.panicMode)
+      synchronize(state);
+  }
+  consume(state, TOKEN_DEDENT, "Expected end of block.");
+  return node;
+}
+
+/* 复合语句，不是复合语句时返回 NULL */
+static Ast *compoundStatement(GlobalState *state) {
+  switch (state->parser.current.type) {
+  case TOKEN_IF:
+    advance(state);
+    return ifStatement(state);
+  case TOKEN_WHILE:
+    advance(state);
+    return whileStatement(state);
+  case TOKEN_FOR:
+    advance(state);
+    return forStatement(state, 0);
+  case TOKEN_TRY:
+    advance(state);
+    return tryStatement(state);
+  case TOKEN_WITH:
+    advance(state);
+    return withStatement(state, 0);
+  case TOKEN_DEF:
+    advance(state);
+    return functionDeclaration(state, NULL, 0);
+  case TOKEN_CLASS:
+    advance(state);
+    return classDeclaration(state, NULL);
+  case TOKEN_AT:
+    return decorated(state);
+  case TOKEN_ASYNC:
+    advance(state);
+    if (match(state, TOKEN_DEF))
+      return functionDeclaration(state, NULL, 1);
+    if (match(state, TOKEN_FOR))
+      return forStatement(state, 1);
+    if (match(state, TOKEN_WITH))
+      return withStatement(state, 1);
+    errorAtCurrent(state, "Expected 'def', 'for' or 'with' after 'async'.");
+    return emptyAst(AST_KIND_ERROR, state->parser.previous);
+  case TOKEN_IDENTIFIER:
+    if (isSoftKeyword(&state->parser.current, "match"))
+      return matchStatement(state);
+    return NULL;
+  default:
+    return NULL;
+  }
+}
+
+/* 解析一条语句（一行简单语句可能有好几条），加到 statements 后面 */
+static void statement(GlobalState *state, Ast *statements) {
+  if (match(state, TOKEN_INDENT)) {
+    errorAtPrevious(state, "Unexpected indent.");
+    while (!check(state, TOKEN_DEDENT) && !check(state, TOKEN_EOF))
+      statement(state, statements);
+    match(state, TOKEN_DEDENT);
+    return;
+  }
+
+  size_t start = state->current;
+  Ast *compound = compoundStatement(state);
+  if (compound != NULL)
+    astAppendChild(statements, compound);
+  else
+    simpleStatements(state, statements);
+  if (!state->parser.panicMode)
+    return;
+  /* 语句开头就出错时 previous 还是上一行的 EOL，先跳过这个 token */
+  if (state->current == start)
+    advance(state);
+  synchronize(state);
+}
+
+/*
+ * 从下标 start 开始解析。start 前面的 token 是 EOL 或 DEDENT，与
+ * 从头解析到这里时的 previous 相同。
+ */
+static void initState(GlobalState *state, const ZyTokenBuffer *tokens,
+                      size_t start) {
+  memset(state, 0, sizeof(*state));
+  state->tokens = tokens;
+  state->functionType = TYPE_MODULE;
+  state->errors = stderr;
+  /* start 为 0 时让 advance 从下标 0 开始 */
+  state->current = start - 1;
+  if (start > 0)
+    state->parser.current = tokenAt(state, start - 1);
+  advance(state);
+}
+
+/* 顶层语句，直到下标 stop 或者 EOF */
+static void topLevel(GlobalState *state, Ast *script, size_t stop) {
+  while (state->current < stop && !check(state, TOKEN_EOF)) {
+    /* 错误恢复可能留下多余的 DEDENT */
+    if (match(state, TOKEN_DEDENT))
+      continue;
+    statement(state, script);
+  }
+}
+
+static void freeState(GlobalState *state) {
+  if (state->lines.starts != NULL)
+    zy_freeLineIndex(&state->lines);
+}
+
+static void scanLayoutTokens(const char *begin, const char *end,
+                             ZyTokenBuffer *tokens) {
+  if (!zy_scanLayoutTokens(begin, end, tokens)) {
+    fprintf(stderr, "File is too large to parse.\n");
+    exit(1);
+  }
+}
+
+Ast *zy_parse(const char *begin, const char *end, int *hadError) {
+  ZyTokenBuffer tokens;
+  scanLayoutTokens(begin, end, &tokens);
+  GlobalState state;
+  initState(&state, &tokens, 0);
+  Ast *script = emptyAst(AST_KIND_NONE, state.parser.current);
+  topLevel(&state, script, SIZE_MAX);
+
+  if (hadError != NULL)
+    *hadError = state.parser.hadError;
+  freeState(&state);
+  zy_freeTokenBuffer(&tokens);
+  return script;
+}
+
+/**
+ * @brief A run of top-level statements parsed by one thread.
+ *
+ * The worker parses from `begin` as if everything before it had
+ * been parsed without leaving the parser in panic mode, and stops
+ * at the first statement that starts at or after `end`. Its error
+ * messages are kept until the merge step knows whether the guess
+ * was right.
+ */
+typedef struct {
+  const ZyTokenBuffer *tokens;
+  size_t begin;
+  size_t end; /**< @brief SIZE_MAX for the last region. */
+  GlobalState state;
+  AstArena *arena; /**< @brief NULL when the caller uses malloc. */
+  Ast *statements; /**< @brief A script node holding the statements. */
+  char *messages;
+  size_t messagesLength;
+} ParseRegion;
+
+static void *parseRegion(void *arg) {
+  ParseRegion *region = (ParseRegion *)arg;
+  AstArena *old = astUseArena(region->arena);
+  initState(&region->state, region->tokens, region->begin);
+  region->messages = NULL;
+  region->state.errors =
+      open_memstream(&region->messages, &region->messagesLength);
+  if (region->state.errors == NULL) {
+    fprintf(stderr, "Not enough memory to buffer parse errors.");
+    exit(1);
+  }
+  region->statements = emptyAst(AST_KIND_NONE, region->state.parser.current);
+  topLevel(&region->state, region->statements, region->end);
+  fclose(region->state.errors);
+  astUseArena(old);
+  return NULL;
+}
+
+static inline int startsDefinition(const ZyTokenBuffer *tokens, size_t i) {
+  switch (zy_tokenType(tokens, i)) {
+  case TOKEN_DEF:
+  case TOKEN_CLASS:
+  case TOKEN_AT:
+    return 1;
+  case TOKEN_ASYNC:
+    return i + 1 < tokens->count && zy_tokenType(tokens, i + 1) == TOKEN_DEF;
+  default:
+    return 0;
+  }
+}
+
+/*
+ * 在顶层（不在任何块里）的 def、class、修饰器处切分，每段的
+ * token 数大致相同。返回段数，starts[0] 总是 0。
+ */
+static int findRegions(const ZyTokenBuffer *tokens, int numRegions,
+                       size_t *starts) {
+  int count = 1;
+  starts[0] = 0;
+  size_t next = tokens->count / numRegions;
+  long depth = 0;
+  for (size_t i = 1; i < tokens->count && count < numRegions; i++) {
+    ZyTokenType before = zy_tokenType(tokens, i - 1);
+    if (before == TOKEN_INDENT)
+      depth++;
+    else if (before == TOKEN_DEDENT)
+      depth--;
+    if (i < next || depth != 0 ||
+        (before != TOKEN_EOL && before != TOKEN_DEDENT) ||
+        !startsDefinition(tokens, i))
+      continue;
+    starts[count++] = i;
+    next = tokens->count / numRegions * count;
+  }
+  return count;
+}
+
+Ast *zy_parseParallel(const char *begin, const char *end, int numThreads,
+                      int *hadError) {
+  ZyTokenBuffer tokens;
+  scanLayoutTokens(begin, end, &tokens);
+  if (numThreads > ZY_MAX_PARSE_THREADS)
+    numThreads = ZY_MAX_PARSE_THREADS;
+  if ((size_t)numThreads > tokens.count / ZY_MIN_PARSE_REGION)
+    numThreads = (int)(tokens.count / ZY_MIN_PARSE_REGION);
+  if (numThreads < 1)
+    numThreads = 1;
+
+  size_t starts[ZY_MAX_PARSE_THREADS];
+  int numRegions = findRegions(&tokens, numThreads, starts);
+  ParseRegion regions[ZY_MAX_PARSE_THREADS];
+  pthread_t threads[ZY_MAX_PARSE_THREADS];
+  AstArena arenas[ZY_MAX_PARSE_THREADS];
+  AstArena *callerArena = astCurrentArena();
+  for (int i = 0; i < numRegions; i++) {
+    /* 第一段在调用的线程里解析，直接用它的 arena */
+    regions[i].arena = NULL;
+    if (callerArena != NULL) {
+      regions[i].arena = (i == 0) ? callerArena : &arenas[i];
+      if (i > 0)
+        astInitArena(&arenas[i]);
+    }
+    regions[i].tokens = &tokens;
+    regions[i].begin = starts[i];
+    regions[i].end = (i + 1 < numRegions) ? starts[i + 1] : SIZE_MAX;
+  }
+  for (int i = 1; i < numRegions; i++) {
+    if (pthread_create(&threads[i], NULL, parseRegion, &regions[i]) != 0) {
+      fprintf(stderr, "Failed to start a parser thread.");
+      exit(1);
+    }
+  }
+  parseRegion(&regions[0]);
+
+  /*
+   * 按顺序接起来。前一段恰好停在下一段的开头、并且不在 panic
+   * 模式时，下一段的结果与串行解析相同；否则从前一段停下的
+   * 地方接着串行解析，丢掉后面所有段的结果。
+   */
+  Ast *script = regions[0].statements;
+  GlobalState *last = &regions[0].state;
+  int failed = 0;
+  fwrite(regions[0].messages, 1, regions[0].messagesLength, stderr);
+  free(regions[0].messages);
+  for (int i = 1; i < numRegions; i++) {
+    ParseRegion *region = &regions[i];
+    pthread_join(threads[i], NULL);
+    if (!failed && last->current == region->begin && !last->parser.panicMode) {
+      fwrite(region->messages, 1, region->messagesLength, stderr);
+      Ast *statements = region->statements;
+      for (int j = 0; j < astNumChild(statements); j++)
+        astAppendChild(script, astGetChild(statements, j));
+      freeAst(statements, false);
+      region->state.parser.hadError |= last->parser.hadError;
+      freeState(last);
+      last = &region->state;
+    } else {
+      failed = 1;
+      freeAst(region->statements, true);
+      freeState(&region->state);
+    }
+    free(region->messages);
+    if (region->arena != NULL)
+      astMergeArena(callerArena, region->arena);
+  }
+  if (failed) {
+    last->errors = stderr;
+    topLevel(last, script, SIZE_MAX);
+  }
+
+  if (hadError != NULL)
+    *hadError = last->parser.hadError;
+  freeState(last);
+  zy_freeTokenBuffer(&tokens);
+  return script;
+}
+
+void zy_parseLazy(const char *begin, const char *end, ZyModule *module) {
+  scanLayoutTokens(begin, end, &module->tokens);
+  astInitArena(&module->arena);
+  AstArena *old = astUseArena(&module->arena);
+  GlobalState state;
+  initState(&state, &module->tokens, 0);
+  state.lazyBodies = 1;
+  module->script = emptyAst(AST_KIND_NONE, state.parser.current);
+  topLevel(&state, module->script, SIZE_MAX);
+  module->hadError = state.parser.hadError;
+  freeState(&state);
+  astUseArena(old);
+}
+
+/* 与 functionDeclaration 当时选的 FunctionType 相同 */
+static FunctionType bodyType(Ast *decl) {
+  int isAsync = decl->modifier.isAsync;
+  if (decl->kind == AST_DECL_METHOD) {
+    Ast *decorators = astNumChild(decl) > 1 ? astGetChild(decl, 1) : NULL;
+    return methodType(decorators, decl->token, isAsync);
+  }
+  return isAsync ? TYPE_COROUTINE : TYPE_FUNCTION;
+}
+
+/* 函数体前面那个`:`的下标；补上的空 token 可能与它的偏移量相同 */
+static size_t colonIndex(const ZyTokenBuffer *tokens, const ZyToken *colon) {
+  uint32_t offset = (uint32_t)(colon->start - tokens->src);
+  size_t lo = 0, hi = tokens->count;
+  while (lo < hi) {
+    size_t mid = lo + (hi - lo) / 2;
+    if (tokens->offsets[mid] < offset)
+      lo = mid + 1;
+    else
+      hi = mid;
+  }
+  while (zy_tokenType(tokens, lo) != TOKEN_COLON)
+    lo++;
+  return lo;
+}
+
+Ast *zy_functionBody(ZyModule *module, Ast *decl) {
+  Ast *function = astGetChild(decl, 0);
+  Ast *body = astGetChild(function, 1);
+  if (!body->modifier.isLazy)
+    return body;
+
+  AstArena *old = astUseArena(&module->arena);
+  GlobalState state;
+  initState(&state, &module->tokens, colonIndex(&module->tokens, &body->token));
+  state.lazyBodies = 1;
+  state.functionType = bodyType(decl);
+  advance(&state);
+  Ast *parsed = block(&state);
+  freeAst(astReplaceChild(function, 1, parsed), true);
+  module->hadError |= state.parser.hadError;
+  freeState(&state);
+  astUseArena(old);
+  return parsed;
+}
+
+void zy_freeModule(ZyModule *module) {
+  astFreeArena(&module->arena);
+  zy_freeTokenBuffer(&module->tokens);
+}
@@ -1 +1,72 @@
 #pragma once
+
+#include "ast.h"
+#include "tokens.h"
+
+/* 并行解析最多使用的线程数 */
+#define ZY_MAX_PARSE_THREADS 64
+/* 每个线程至少要分到这么多 token，否则不值得切分 */
+#ifndef ZY_MIN_PARSE_REGION
+#define ZY_MIN_PARSE_REGION ((size_t)1 << 16)
+#endif
+
+/**
+ * @brief Parses a whole module.
+ *
+ * Returns the script node, whose children are the top-level
+ * statements. Syntax errors are reported on stderr with their line
+ * and column, and parsing resumes at the next statement, so the tree
+ * covers everything that could be recognised; *hadError (when not
+ * NULL) tells whether there were any. Tokens in the tree point into
+ * [begin, end), which must outlive it. Release it with freeAst.
+ */
+extern Ast *zy_parse(const char *begin, const char *end, int *hadError);
+
+/**
+ * @brief A module pre-parsed by @ref zy_parseLazy.
+ *
+ * Keeps the tokens of the whole input, which function bodies that
+ * were skipped are parsed from later, and the arena that all of its
+ * nodes, including bodies parsed later, are allocated from.
+ */
+typedef struct {
+  Ast *script;
+  ZyTokenBuffer tokens;
+  AstArena arena;
+  int hadError; /**< @brief Includes bodies parsed so far. */
+} ZyModule;
+
+/**
+ * @brief Parses a module without the bodies of `def`s.
+ *
+ * An indented function body is skipped by matching its INDENT and
+ * DEDENT, and left as an empty BLOCK with isLazy set, whose token
+ * spans the body from the `:`. Errors inside it are reported when
+ * it is parsed by @ref zy_functionBody. Bodies on the same line as
+ * the `def`, and lambdas, are parsed as usual.
+ */
+extern void zy_parseLazy(const char *begin, const char *end,
+                         ZyModule *module);
+
+/**
+ * @brief The body of an AST_DECL_FUN or AST_DECL_METHOD of the
+ * module, parsed (with its own nested bodies left lazy) and put in
+ * the tree the first time it is asked for.
+ */
+extern Ast *zy_functionBody(ZyModule *module, Ast *function);
+extern void zy_freeModule(ZyModule *module);
+
+/**
+ * @brief Same as @ref zy_parse, with the top-level statements split
+ * among up to numThreads threads.
+ *
+ * The input is cut before top-level def and class statements into
+ * regions of about the same number of tokens. When the calling
+ * thread has an AstArena selected, every worker fills an arena of
+ * its own, which is then merged into the caller's. The tree and the error
+ * messages are exactly those of zy_parse: when a region does not stop
+ * cleanly where the next one starts, the rest of the input is parsed
+ * again serially.
+ */
+extern Ast *zy_parseParallel(const char *begin, const char *end,
+                             int numThreads, int *hadError);
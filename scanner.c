@@ -1,27 +1,32 @@
 #include <assert.h>
 #include <stddef.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
 #include "scanner.h"
+#include "simd.h"
+#include "unicode.h"
 
-ZyScanner zy_initScanner(const char *src) {
+/* 每次向前校验这么多字节的 UTF-8 */
+#define UTF8_BLOCK ((size_t)64 << 10)
+
+ZyScanner zy_initScanner(const char *begin, const char *end) {
   ZyScanner scanner;
-  scanner.start = src;
-  scanner.cur = src;
-  scanner.line = 1;
-  scanner.linePtr = src;
+  scanner.start = begin;
+  scanner.cur = begin;
+  scanner.end = end;
   scanner.startOfLine = 1;
   scanner.hasUnget = 0;
+  scanner.symbols = NULL;
+  scanner.literals = NULL;
+  scanner.utf8End = begin;
   return scanner;
 }
 
-static int isAtEnd(const ZyScanner *scanner) { return *scanner->cur == '\0'; }
-
-static void nextLine(ZyScanner *scanner) {
-  scanner->line++;
-  scanner->linePtr = scanner->cur;
+static int isAtEnd(const ZyScanner *scanner) {
+  return scanner->cur >= scanner->end;
 }
 
 static ZyToken makeToken(const ZyScanner *scanner, ZyTokenType type) {
@@ -29,89 +34,127 @@ static ZyToken makeToken(const ZyScanner *scanner, ZyTokenType type) {
   t.type = type;
   t.start = scanner->start;
   t.length = (type == TOKEN_EOL) ? 0 : (size_t)(scanner->cur - scanner->start);
-  t.line = scanner->line;
-  t.linePtr = scanner->linePtr;
-  t.literalWidth =
-      (type == TOKEN_EOL) ? 0 : (size_t)(scanner->cur - scanner->linePtr);
-  t.col = (scanner->cur - scanner->linePtr) + 1;
   return t;
 }
 
-static ZyToken errorToken(const ZyScanner *scanner, const char *errorStr) {
-  ssize_t column = (scanner->linePtr < scanner->start)
-                       ? scanner->start - scanner->linePtr
-                       : 0;
-  ssize_t width =
-      (scanner->start < scanner->cur) ? scanner->cur - scanner->start : 0;
-  ZyToken t = {};
-  t.type = TOKEN_ERROR;
-  t.start = errorStr;
-  t.length = strlen(errorStr);
-  t.line = scanner->line;
-  t.linePtr = scanner->linePtr;
-  t.literalWidth = (size_t)(width);
-  t.col = column + 1;
+/* 错误 token 仍然指向出错的源码，原因记在 symbol 里 */
+static ZyToken errorToken(const ZyScanner *scanner, ZyScanError error) {
+  ZyToken t = makeToken(scanner, TOKEN_ERROR);
+  t.symbol = error;
   return t;
 }
 
-static char advance(ZyScanner *scanner) {
-  return (*scanner->cur == '\0') ? '\0' : *(scanner->cur++);
+/* 不驻留符号时不会走到这里，保持 makeToken 的快速路径不变 */
+static __attribute__((noinline)) ZyToken
+internedToken(ZyScanner *scanner, ZyTokenType type, const char *name,
+              size_t length) {
+  ZyToken t = makeToken(scanner, type);
+  t.symbol = zy_intern(scanner->symbols, name, length);
+  return t;
 }
 
-static int match(ZyScanner *scanner, char expected) {
-  if (isAtEnd(scanner))
+static __attribute__((noinline)) ZyToken decodedToken(ZyScanner *scanner) {
+  ZyToken t = makeToken(scanner, TOKEN_NUMBER);
+  t.symbol = zy_addNumber(scanner->literals, scanner->start, t.length);
+  return t;
+}
+
+/*
+ * 把 UTF-8 的校验推进到 scanner->cur，返回 [from, cur) 中第一个不合法
+ * 序列的位置，没有则返回 NULL。from 之前的不合法字节已经作为单独的
+ * 错误 token 报告过了；报告之后从 cur 重新开始校验，同一个 token 里
+ * 的多个错误只报告一次。
+ */
+static __attribute__((noinline)) const char *checkUtf8(ZyScanner *scanner,
+                                                       const char *from) {
+  while (scanner->utf8End < scanner->cur) {
+    const char *blockEnd = scanner->end;
+    if ((size_t)(blockEnd - scanner->utf8End) > UTF8_BLOCK) {
+      blockEnd = scanner->utf8End + UTF8_BLOCK;
+      /* 不要把一个多字节序列切成两半 */
+      for (int i = 0; i < 3 && ((unsigned char)*blockEnd & 0xC0) == 0x80; i++)
+        blockEnd--;
+    }
+    const char *bad = zy_findInvalidUtf8(scanner->utf8End, blockEnd);
+    if (bad == blockEnd) {
+      scanner->utf8End = blockEnd;
+    } else if (bad < from) {
+      scanner->utf8End = bad + 1;
+    } else if (bad < scanner->cur) {
+      scanner->utf8End = scanner->cur;
+      return bad;
+    } else {
+      /* 错误在后面，等扫描到那里再报告 */
+      scanner->utf8End = bad;
+    }
+  }
+  return NULL;
+}
+
+/*
+ * 标识符、数值和运算符中的非 ASCII 字节都会被逐个解码，只有字符串
+ * 和注释是整段跳过的，所以只在它们结束之后检查 UTF-8。
+ */
+static inline int hasInvalidUtf8(ZyScanner *scanner) {
+  return scanner->cur > scanner->utf8End &&
+         checkUtf8(scanner, scanner->start) != NULL;
+}
+
+/* 跳过注释。其中有不合法的 UTF-8 时返回 1，start 指向出错的位置 */
+static inline int skipComment(ZyScanner *scanner) {
+  const char *comment = scanner->cur;
+  scanner->cur = zy_findNewline(scanner->cur, scanner->end);
+  if (scanner->cur <= scanner->utf8End)
     return 0;
-  if (*scanner->cur != expected)
+  const char *bad = checkUtf8(scanner, comment);
+  if (bad == NULL)
     return 0;
-  scanner->cur++;
+  scanner->start = bad;
   return 1;
 }
 
-static char peek(const ZyScanner *scanner) { return *scanner->cur; }
+/* 读到输入末尾之后，advance、peek 和 peekNext 都返回`\0` */
+static char advance(ZyScanner *scanner) {
+  return isAtEnd(scanner) ? '\0' : *(scanner->cur++);
+}
+
+static char peek(const ZyScanner *scanner) {
+  return isAtEnd(scanner) ? '\0' : *scanner->cur;
+}
 
 static char peekNext(const ZyScanner *scanner, int n) {
-  if (isAtEnd(scanner))
-    return '\0';
-  for (int i = 0; i < n; ++i) {
-    if (scanner->cur[i] == '\0')
-      return '\0';
-  }
-  return scanner->cur[n];
+  return (scanner->end - scanner->cur > n) ? scanner->cur[n] : '\0';
 }
 
 static void skipWhitespace(ZyScanner *scanner) {
-  while (1) {
-    char c = peek(scanner);
-    switch (c) {
-    case ' ':
-    case '\t':
-      advance(scanner);
-      break;
-    default:
-      return;
-    }
-  }
+  if (peek(scanner) != ' ' && peek(scanner) != '\t')
+    return;
+  /* 大多数情况下只有一个空格，不必进入向量化的循环 */
+  advance(scanner);
+  if (peek(scanner) == ' ' || peek(scanner) == '\t')
+    scanner->cur = zy_skipBlanks(scanner->cur, scanner->end);
 }
 
 static ZyToken makeIndentation(ZyScanner *scanner) {
-  // 如果下一个看到的字符时空格，则需要拒绝掉`\t`字符
-  // 否则就拒绝掉空格字符
-  char reject = (peek(scanner) == ' ') ? '\t' : ' ';
-  while (!isAtEnd(scanner) && (peek(scanner) == ' ' || peek(scanner) == '\t'))
-    advance(scanner);
+  /* 缩进只能由第一个字符重复组成，遇到另一种空白就是混用 */
+  char first = *scanner->cur;
+  while (!isAtEnd(scanner) && *scanner->cur == first)
+    scanner->cur++;
+  if (peek(scanner) == ' ' || peek(scanner) == '\t') {
+    scanner->cur = zy_skipBlanks(scanner->cur, scanner->end);
+    if (isAtEnd(scanner))
+      return makeToken(scanner, TOKEN_EOF);
+    return errorToken(scanner, ZY_ERROR_MIXED_INDENTATION);
+  }
   if (isAtEnd(scanner))
     return makeToken(scanner, TOKEN_EOF);
-  for (const char *start = scanner->start; start < scanner->cur; start++) {
-    if (*start == reject)
-      return errorToken(scanner, "Invalid mix of indentation.");
-  }
   ZyToken out = makeToken(scanner, TOKEN_INDENTATION);
-  if (reject == ' ')
+  if (first == '\t')
     out.length *= 8;
   if (peek(scanner) == '#' || peek(scanner) == '\n') {
-    while (!isAtEnd(scanner) && peek(scanner) != '\n')
-      advance(scanner);
     scanner->startOfLine = 1;
+    if (skipComment(scanner))
+      return errorToken(scanner, ZY_ERROR_INVALID_UTF8);
     return makeToken(scanner, TOKEN_RETRY);
   }
 
@@ -124,93 +167,137 @@ static ZyToken string(ZyScanner *scanner, char quoteMark) {
     advance(scanner);
     /* Big string */
     while (!isAtEnd(scanner)) {
+      /* 直接跳到下一个引号、`\\`或者`\n` */
+      scanner->cur = zy_findStringStop(scanner->cur, scanner->end, quoteMark);
+      if (isAtEnd(scanner))
+        break;
       if (peek(scanner) == quoteMark && peekNext(scanner, 1) == quoteMark &&
           peekNext(scanner, 2) == quoteMark) {
         advance(scanner);
         advance(scanner);
         advance(scanner);
+        if (hasInvalidUtf8(scanner))
+          return errorToken(scanner, ZY_ERROR_INVALID_UTF8);
         return makeToken(scanner, TOKEN_BIG_STRING);
       }
 
       if (peek(scanner) == '\\')
         advance(scanner);
-      if (peek(scanner) == '\n') {
-        advance(scanner);
-        nextLine(scanner);
-      } else {
-        advance(scanner);
-      }
+      advance(scanner);
     }
     if (isAtEnd(scanner))
-      return errorToken(scanner, "Unterminated string.");
+      return errorToken(scanner, ZY_ERROR_UNTERMINATED_STRING);
   }
 
-  while (peek(scanner) != quoteMark && !isAtEnd(scanner)) {
+  int escaped = 0;
+  while (1) {
+    scanner->cur = zy_findStringStop(scanner->cur, scanner->end, quoteMark);
+    if (isAtEnd(scanner) || peek(scanner) == quoteMark)
+      break;
     if (peek(scanner) == '\n')
-      return errorToken(scanner, "Unterminated string.");
-    if (peek(scanner) == '\\')
-      advance(scanner);
-    if (peek(scanner) == '\n') {
-      advance(scanner);
-      nextLine(scanner);
-    } else {
-      advance(scanner);
-    }
+      return errorToken(scanner, ZY_ERROR_UNTERMINATED_STRING);
+    /* 转义字符，连同后面的字符一起跳过 */
+    escaped = 1;
+    advance(scanner);
+    advance(scanner);
   }
 
   if (isAtEnd(scanner))
-    return errorToken(scanner, "Unterminated string.");
+    return errorToken(scanner, ZY_ERROR_UNTERMINATED_STRING);
 
   assert(peek(scanner) == quoteMark);
   advance(scanner);
+  if (hasInvalidUtf8(scanner))
+    return errorToken(scanner, ZY_ERROR_INVALID_UTF8);
 
+  /* 没有转义的字符串，内容就是引号之间的字节 */
+  if (scanner->symbols != NULL && !escaped)
+    return internedToken(scanner, TOKEN_STRING, scanner->start + 1,
+                         (size_t)(scanner->cur - scanner->start) - 2);
   return makeToken(scanner, TOKEN_STRING);
 }
 
-static int isDigit(char c) { return c >= '0' && c <= '9'; }
+/**
+ * @brief Character classes used by the scanner's inner loops.
+ */
+enum {
+  CC_ALPHA = 1 << 0, /**< ASCII identifier start: letters and `_`. */
+  CC_DIGIT = 1 << 1,
+  CC_HEX = 1 << 2,
+  CC_OCT = 1 << 3,
+  CC_BIN = 1 << 4,
+  CC_UNDERSCORE = 1 << 5,
+  CC_UTF8 = 1 << 6, /**< Part of a multi-byte UTF-8 sequence. */
+};
+#define CC_IDENT (CC_ALPHA | CC_DIGIT)
+
+static const uint8_t charClass[256] = {
+    ['0' ... '1'] = CC_DIGIT | CC_HEX | CC_OCT | CC_BIN,
+    ['2' ... '7'] = CC_DIGIT | CC_HEX | CC_OCT,
+    ['8' ... '9'] = CC_DIGIT | CC_HEX,
+    ['A' ... 'F'] = CC_ALPHA | CC_HEX,
+    ['G' ... 'Z'] = CC_ALPHA,
+    ['_'] = CC_ALPHA | CC_UNDERSCORE,
+    ['a' ... 'f'] = CC_ALPHA | CC_HEX,
+    ['g' ... 'z'] = CC_ALPHA,
+    [0x80 ... 0xFF] = CC_UTF8,
+};
+
+static inline int hasClass(char c, int classes) {
+  return charClass[(unsigned char)c] & classes;
+}
+
+/* 跳过所有属于 classes 的字符 */
+static inline void skipClass(ZyScanner *scanner, int classes) {
+  const char *p = scanner->cur;
+  while (p < scanner->end && hasClass(*p, classes))
+    p++;
+  scanner->cur = p;
+}
+
+/* 需要时顺便把数值解码到字面量表中 */
+static inline ZyToken numberToken(ZyScanner *scanner) {
+  if (scanner->literals != NULL)
+    return decodedToken(scanner);
+  return makeToken(scanner, TOKEN_NUMBER);
+}
 
 static ZyToken number(ZyScanner *scanner, char c) {
   if (c == '0') {
+    switch (peek(scanner)) {
     /* 16进制 */
-    if (peek(scanner) == 'x' || peek(scanner) == 'X') {
+    case 'x':
+    case 'X':
       advance(scanner);
-      while (isDigit(peek(scanner)) ||
-             (peek(scanner) >= 'a' && peek(scanner) <= 'f') ||
-             (peek(scanner) >= 'A' && peek(scanner) <= 'F') ||
-             (peek(scanner) == '_'))
-        advance(scanner);
-
-      return makeToken(scanner, TOKEN_NUMBER);
-    }
+      skipClass(scanner, CC_HEX | CC_UNDERSCORE);
+      return numberToken(scanner);
     /* 2进制 */
-    else if (peek(scanner) == 'b' || peek(scanner) == 'B') {
+    case 'b':
+    case 'B':
       advance(scanner);
-      while (peek(scanner) == '0' || peek(scanner) == '1' ||
-             peek(scanner) == '_')
-        advance(scanner);
-      return makeToken(scanner, TOKEN_NUMBER);
-    }
-
+      skipClass(scanner, CC_BIN | CC_UNDERSCORE);
+      return numberToken(scanner);
     /* 8进制，必须是0o开头，0123这种不合法 */
-    if (peek(scanner) == 'o' || peek(scanner) == 'O') {
+    case 'o':
+    case 'O':
       advance(scanner);
-      while ((peek(scanner) >= '0' && peek(scanner) <= '7') ||
-             (peek(scanner) == '_'))
-        advance(scanner);
-      return makeToken(scanner, TOKEN_NUMBER);
+      skipClass(scanner, CC_OCT | CC_UNDERSCORE);
+      return numberToken(scanner);
     }
     /* 否则，要不就是十进制，要么就是0.123这种浮点数 */
   }
 
   /* 10进制 */
-  while (isDigit(peek(scanner)) || peek(scanner) == '_')
-    advance(scanner);
-
-  /* 浮点数 */
-  if (peek(scanner) == '.' && isDigit(peekNext(scanner, 1))) {
+  skipClass(scanner, CC_DIGIT | CC_UNDERSCORE);
+
+  /*
+   * 浮点数。小数和指数里也可以有下划线；`1._5` 这样放错位置的也
+   * 扫描成一个数，解码时再判为不合法
+   */
+  if (peek(scanner) == '.' &&
+      hasClass(peekNext(scanner, 1), CC_DIGIT | CC_UNDERSCORE)) {
     advance(scanner);
-    while (isDigit(peek(scanner)))
-      advance(scanner);
+    skipClass(scanner, CC_DIGIT | CC_UNDERSCORE);
   }
 
   /* 科学记数法 */
@@ -218,197 +305,309 @@ static ZyToken number(ZyScanner *scanner, char c) {
     advance(scanner);
     if (peek(scanner) == '+' || peek(scanner) == '-')
       advance(scanner);
-    while (isDigit(peek(scanner))) {
-      advance(scanner);
-    }
+    skipClass(scanner, CC_DIGIT | CC_UNDERSCORE);
   }
 
-  return makeToken(scanner, TOKEN_NUMBER);
-}
-
-static int isAlpha(char c) {
-  return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c == '_');
+  return numberToken(scanner);
 }
 
-static int checkKeyword(ZyScanner *scanner, size_t start, const char *rest,
-                        ZyTokenType type) {
-  size_t length = strlen(rest);
-  if ((size_t)(scanner->cur - scanner->start) == start + length &&
-      memcmp(scanner->start + start, rest, length) == 0)
-    return type;
-  return TOKEN_IDENTIFIER;
+/**
+ * @brief Keyword hash table entry.
+ *
+ * `key` is the keyword's bytes packed little-endian into a 64-bit
+ * integer and zero padded. Identifiers never contain `\0`, so two
+ * different words can never share a key and unused slots (key 0)
+ * never match.
+ */
+typedef struct {
+  uint64_t key;
+  ZyTokenType type;
+} Keyword;
+
+/* 由 tools/gen_keywords.py 生成 */
+#define KEYWORD_HASH_BITS 6
+#define KEYWORD_HASH_MULTIPLIER UINT64_C(0x5caefbd08b474011)
+
+static const Keyword keywordTable[1 << KEYWORD_HASH_BITS] = {
+    [1] = {UINT64_C(0x00796c6c616e6966), TOKEN_FINALLY}, /* finally */
+    [4] = {UINT64_C(0x0000007265707573), TOKEN_SUPER}, /* super */
+    [7] = {UINT64_C(0x000000000000726f), TOKEN_OR}, /* or */
+    [9] = {UINT64_C(0x65756e69746e6f63), TOKEN_CONTINUE}, /* continue */
+    [12] = {UINT64_C(0x0000000000006e69), TOKEN_IN}, /* in */
+    [13] = {UINT64_C(0x000000636e797361), TOKEN_ASYNC}, /* async */
+    [17] = {UINT64_C(0x6c61636f6c6e6f6e), TOKEN_NONLOCAL}, /* nonlocal */
+    [19] = {UINT64_C(0x000000646c656979), TOKEN_YIELD}, /* yield */
+    [20] = {UINT64_C(0x0000007373616c63), TOKEN_CLASS}, /* class */
+    [23] = {UINT64_C(0x00006e7275746572), TOKEN_RETURN}, /* return */
+    [24] = {UINT64_C(0x000000656c696877), TOKEN_WHILE}, /* while */
+    [26] = {UINT64_C(0x000074726f706d69), TOKEN_IMPORT}, /* import */
+    [27] = {UINT64_C(0x0000747265737361), TOKEN_ASSERT}, /* assert */
+    [29] = {UINT64_C(0x0000747065637865), TOKEN_EXCEPT}, /* except */
+    [30] = {UINT64_C(0x00000000006c6564), TOKEN_DEL}, /* del */
+    [31] = {UINT64_C(0x0000006573696172), TOKEN_RAISE}, /* raise */
+    [32] = {UINT64_C(0x00000065736c6146), TOKEN_FALSE}, /* False */
+    [33] = {UINT64_C(0x0000007469617761), TOKEN_AWAIT}, /* await */
+    [36] = {UINT64_C(0x0000000000666564), TOKEN_DEF}, /* def */
+    [37] = {UINT64_C(0x00000000656e6f4e), TOKEN_NONE}, /* None */
+    [39] = {UINT64_C(0x0000000000007369), TOKEN_IS}, /* is */
+    [41] = {UINT64_C(0x0000000073736170), TOKEN_PASS}, /* pass */
+    [42] = {UINT64_C(0x0000000000646e61), TOKEN_AND}, /* and */
+    [43] = {UINT64_C(0x0000000068746977), TOKEN_WITH}, /* with */
+    [44] = {UINT64_C(0x0000000065757254), TOKEN_TRUE}, /* True */
+    [46] = {UINT64_C(0x0000000000007361), TOKEN_AS}, /* as */
+    [47] = {UINT64_C(0x0000000000006669), TOKEN_IF}, /* if */
+    [48] = {UINT64_C(0x0000000066696c65), TOKEN_ELIF}, /* elif */
+    [50] = {UINT64_C(0x0000000065736c65), TOKEN_ELSE}, /* else */
+    [51] = {UINT64_C(0x0000000000746f6e), TOKEN_NOT}, /* not */
+    [53] = {UINT64_C(0x000000006d6f7266), TOKEN_FROM}, /* from */
+    [54] = {UINT64_C(0x00006164626d616c), TOKEN_LAMBDA}, /* lambda */
+    [59] = {UINT64_C(0x0000000000726f66), TOKEN_FOR}, /* for */
+    [60] = {UINT64_C(0x0000000000797274), TOKEN_TRY}, /* try */
+    [61] = {UINT64_C(0x00006c61626f6c67), TOKEN_GLOBAL}, /* global */
+    [62] = {UINT64_C(0x0000006b61657262), TOKEN_BREAK}, /* break */
+};
+
+static inline uint64_t keywordKey(const ZyScanner *scanner, size_t length) {
+  uint64_t key = 0;
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+  /* 后面还有 8 个字节时，一次读入再屏蔽掉多余的部分 */
+  if (scanner->end - scanner->start >= 8) {
+    memcpy(&key, scanner->start, 8);
+    return key & (~UINT64_C(0) >> (64 - 8 * length));
+  }
+#endif
+  for (size_t i = 0; i < length; i++)
+    key |= (uint64_t)(unsigned char)scanner->start[i] << (8 * i);
+  return key;
 }
 
 static ZyTokenType identifierType(ZyScanner *scanner) {
-  switch (*scanner->start) {
-  case 'a':
-    if (scanner->cur - scanner->start > 1) {
-      switch (scanner->start[1]) {
-      case 'n':
-        return checkKeyword(scanner, 2, "d", TOKEN_AND);
-      case 'w':
-        return checkKeyword(scanner, 2, "ait", TOKEN_AWAIT);
-      case 's':
-        if (scanner->cur - scanner->start > 2) {
-          switch (scanner->start[2]) {
-          case 's':
-            return checkKeyword(scanner, 3, "ert", TOKEN_ASSERT);
-          case 'y':
-            return checkKeyword(scanner, 3, "nc", TOKEN_ASYNC);
-          }
-          break;
-        } else {
-          return checkKeyword(scanner, 2, "", TOKEN_AS);
-        }
-      }
-      break;
-    }
-  case 'b':
-    if (scanner->cur - scanner->start > 1) {
-      return checkKeyword(scanner, 1, "reak", TOKEN_BREAK);
-    } else if (scanner->start[1] == '\'' || scanner->start[1] == '"') {
-      return TOKEN_PREFIX_B;
-    }
-    break;
-  case 'c':
-    if (scanner->cur - scanner->start > 1) {
-      switch (scanner->start[1]) {
-      case 'l':
-        return checkKeyword(scanner, 2, "ass", TOKEN_CLASS);
-      case 'o':
-        return checkKeyword(scanner, 2, "ntinue", TOKEN_CONTINUE);
-      }
-    }
-    break;
-  case 'd':
-    if (scanner->cur - scanner->start > 1) {
-      switch (scanner->start[1]) {
-      case 'e':
-        if (scanner->cur - scanner->start > 2) {
-          switch (scanner->start[2]) {
-          case 'f':
-            return checkKeyword(scanner, 3, "", TOKEN_DEF);
-          case 'l':
-            return checkKeyword(scanner, 3, "", TOKEN_DEL);
-          }
-        }
-        break;
-      }
-    }
-    break;
-  case 'e':
-    if (scanner->cur - scanner->start > 1) {
-      switch (scanner->start[1]) {
-      case 'l':
-        if (scanner->cur - scanner->start > 2) {
-          switch (scanner->start[2]) {
-          case 's':
-            return checkKeyword(scanner, 3, "e", TOKEN_ELSE);
-          case 'i':
-            return checkKeyword(scanner, 3, "f", TOKEN_ELIF);
-          }
-        }
-        break;
-      case 'x':
-        return checkKeyword(scanner, 2, "cept", TOKEN_EXCEPT);
-      }
-    }
-  case 'f':
-    if (scanner->cur - scanner->start > 1) {
-      switch (scanner->start[1]) {
-      case 'i':
-        return checkKeyword(scanner, 2, "nally", TOKEN_FINALLY);
-      case 'o':
-        return checkKeyword(scanner, 2, "r", TOKEN_FOR);
-      case 'r':
-        return checkKeyword(scanner, 2, "om", TOKEN_FROM);
-      }
-    } else if (scanner->start[1] == '\'' || scanner->start[1] == '"') {
-      return TOKEN_PREFIX_F;
-    }
-  case 'F':
-    return checkKeyword(scanner, 1, "alse", TOKEN_FALSE);
-  case 'i':
-    if (scanner->cur - scanner->start > 1) {
-      switch (scanner->start[1]) {
+  size_t length = (size_t)(scanner->cur - scanner->start);
+  if (length == 1) {
+    /* 紧跟着引号的单个 b/f/r 是字符串前缀 */
+    if (peek(scanner) == '\'' || peek(scanner) == '"') {
+      switch (*scanner->start) {
+      case 'b':
+        return TOKEN_PREFIX_B;
       case 'f':
-        return checkKeyword(scanner, 2, "", TOKEN_IF);
-      case 'n':
-        return checkKeyword(scanner, 2, "", TOKEN_IN);
-      case 'm':
-        return checkKeyword(scanner, 2, "port", TOKEN_IMPORT);
-      case 's':
-        return checkKeyword(scanner, 2, "", TOKEN_IS);
-      }
-      break;
-    }
-  case 'g':
-    return checkKeyword(scanner, 1, "lobal", TOKEN_GLOBAL);
-  case 'l':
-    return checkKeyword(scanner, 1, "ambda", TOKEN_LAMBDA);
-  case 'n':
-    if (scanner->cur - scanner->start > 1) {
-      switch (scanner->start[1]) {
-      case 'o':
-        if (scanner->cur - scanner->start > 2) {
-          switch (scanner->start[2]) {
-          case 't':
-            return checkKeyword(scanner, 3, "", TOKEN_NOT);
-          case 'n':
-            return checkKeyword(scanner, 3, "local", TOKEN_NONLOCAL);
-          }
-        }
-        break;
-      }
-      break;
-    }
-    return checkKeyword(scanner, 1, "ot", TOKEN_NOT);
-  case 'N':
-    return checkKeyword(scanner, 1, "one", TOKEN_NONE);
-  case 'o':
-    return checkKeyword(scanner, 1, "r", TOKEN_OR);
-  case 'p':
-    return checkKeyword(scanner, 1, "ass", TOKEN_PASS);
-  case 'r':
-    if (scanner->cur - scanner->start > 1) {
-      switch (scanner->start[1]) {
-      case 'e':
-        return checkKeyword(scanner, 2, "turn", TOKEN_RETURN);
-      case 'a':
-        return checkKeyword(scanner, 2, "ise", TOKEN_RAISE);
-      }
-    } else if (scanner->start[1] == '\'' || scanner->start[1] == '"') {
-      return TOKEN_PREFIX_R;
-    }
-  case 's':
-    return checkKeyword(scanner, 1, "uper", TOKEN_SUPER);
-  case 't':
-    return checkKeyword(scanner, 1, "ry", TOKEN_TRY);
-  case 'T':
-    return checkKeyword(scanner, 1, "rue", TOKEN_TRUE);
-  case 'w':
-    if (scanner->cur - scanner->start > 1) {
-      switch (scanner->start[1]) {
-      case 'h':
-        return checkKeyword(scanner, 2, "ile", TOKEN_WHILE);
-      case 'i':
-        return checkKeyword(scanner, 2, "th", TOKEN_WITH);
+        return TOKEN_PREFIX_F;
+      case 'r':
+        return TOKEN_PREFIX_R;
       }
     }
-    break;
-  case 'y':
-    return checkKeyword(scanner, 1, "ield", TOKEN_YIELD);
+    return TOKEN_IDENTIFIER;
   }
+  if (length > 8)
+    return TOKEN_IDENTIFIER;
 
-  return TOKEN_IDENTIFIER;
+  uint64_t key = keywordKey(scanner, length);
+  const Keyword *keyword =
+      &keywordTable[(key * KEYWORD_HASH_MULTIPLIER) >> (64 - KEYWORD_HASH_BITS)];
+  return keyword->key == key ? keyword->type : TOKEN_IDENTIFIER;
+}
+
+/* 标识符中的非 ASCII 字符：逐个解码，直到遇到不是 XID_Continue 的字符 */
+static __attribute__((noinline)) void skipUnicodeIdentifier(ZyScanner *scanner) {
+  uint32_t c;
+  do {
+    size_t length = zy_decodeUtf8(scanner->cur, scanner->end, &c);
+    if (length == 0 || !zy_isXidContinue(c))
+      return;
+    scanner->cur += length;
+    skipClass(scanner, CC_IDENT);
+  } while (hasClass(peek(scanner), CC_UTF8));
 }
 
 static ZyToken identifier(ZyScanner *scanner) {
-  while (isAlpha(peek(scanner)) || isDigit(peek(scanner)) ||
-         (unsigned char)peek(scanner) > 0x7F)
-    advance(scanner);
+  skipClass(scanner, CC_IDENT);
+  if (hasClass(peek(scanner), CC_UTF8))
+    skipUnicodeIdentifier(scanner);
+
+  ZyTokenType type = identifierType(scanner);
+  if (scanner->symbols != NULL && type == TOKEN_IDENTIFIER)
+    return internedToken(scanner, type, scanner->start,
+                         (size_t)(scanner->cur - scanner->start));
+  return makeToken(scanner, type);
+}
 
-  return makeToken(scanner, identifierType(scanner));
+/* 以非 ASCII 字符开头的 token 只能是标识符，不能解码的字节单独报错 */
+static __attribute__((noinline)) ZyToken unicodeIdentifier(ZyScanner *scanner) {
+  uint32_t c;
+  size_t length = zy_decodeUtf8(scanner->start, scanner->end, &c);
+  if (length == 0) {
+    /* 不合法的字节一次跳过一个 */
+    return errorToken(scanner, ZY_ERROR_INVALID_UTF8);
+  }
+  if (!zy_isXidStart(c)) {
+    scanner->cur = scanner->start + length;
+    return errorToken(scanner, ZY_ERROR_UNEXPECTED_CHARACTER);
+  }
+  scanner->cur = scanner->start + length;
+  skipClass(scanner, CC_IDENT);
+  if (hasClass(peek(scanner), CC_UTF8))
+    skipUnicodeIdentifier(scanner);
+
+  /* 关键字和字符串前缀都是 ASCII */
+  if (scanner->symbols != NULL)
+    return internedToken(scanner, TOKEN_IDENTIFIER, scanner->start,
+                         (size_t)(scanner->cur - scanner->start));
+  return makeToken(scanner, TOKEN_IDENTIFIER);
+}
+
+/* 由 tools/gen_operators.py 生成 */
+#define OP_NUM_SYMBOLS 25
+#define OP_NUM_STATES 50
+#define OP_REJECT 0xFF
+
+static const uint8_t opSymbol[256] = {
+    ['('] = 1,
+    [')'] = 2,
+    ['{'] = 3,
+    ['}'] = 4,
+    ['['] = 5,
+    [']'] = 6,
+    [','] = 7,
+    [';'] = 8,
+    ['~'] = 9,
+    ['.'] = 10,
+    [':'] = 11,
+    ['='] = 12,
+    ['^'] = 13,
+    ['<'] = 14,
+    ['>'] = 15,
+    ['!'] = 16,
+    ['|'] = 17,
+    ['&'] = 18,
+    ['-'] = 19,
+    ['+'] = 20,
+    ['/'] = 21,
+    ['*'] = 22,
+    ['%'] = 23,
+    ['@'] = 24,
+};
+
+static const uint8_t opNext[OP_NUM_STATES][OP_NUM_SYMBOLS] = {
+    {0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 13, 25, 15, 17, 21, 27, 29, 31, 33, 36, 38, 42, 46, 48}, /* start */
+    {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0}, /* ( */
+    {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0}, /* ) */
+    {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0}, /* { */
+    {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0}, /* } */
+    {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0}, /* [ */
+    {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0}, /* ] */
+    {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0}, /* , */
+    {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0}, /* ; */
+    {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0}, /* ~ */
+    {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 11, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0}, /* . */
+    {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 12, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0}, /* .. */
+    {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0}, /* ... */
+    {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 14, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0}, /* : */
+    {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0}, /* := */
+    {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 16, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0}, /* ^ */
+    {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0}, /* ^= */
+    {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 18, 0, 19, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0}, /* < */
+    {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0}, /* <= */
+    {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 20, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0}, /* << */
+    {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0}, /* <<= */
+    {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 22, 0, 0, 23, 0, 0, 0, 0, 0, 0, 0, 0, 0}, /* > */
+    {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0}, /* >= */
+    {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 24, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0}, /* >> */
+    {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0}, /* >>= */
+    {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 26, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0}, /* = */
+    {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0}, /* == */
+    {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 28, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0}, /* ! */
+    {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0}, /* != */
+    {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 30, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0}, /* | */
+    {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0}, /* |= */
+    {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 32, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0}, /* & */
+    {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0}, /* &= */
+    {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 34, 0, 0, 35, 0, 0, 0, 0, 0, 0, 0, 0, 0}, /* - */
+    {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0}, /* -= */
+    {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0}, /* -> */
+    {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 37, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0}, /* + */
+    {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0}, /* += */
+    {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 39, 0, 0, 0, 0, 0, 0, 0, 0, 40, 0, 0, 0}, /* / */
+    {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0}, /* /= */
+    {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 41, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0}, /* // */
+    {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0}, /* //= */
+    {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 43, 0, 0, 0, 0, 0, 0, 0, 0, 0, 44, 0, 0}, /* * */
+    {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0}, /* *= */
+    {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 45, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0}, /* ** */
+    {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0}, /* **= */
+    {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 47, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0}, /* % */
+    {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0}, /* %= */
+    {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 49, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0}, /* @ */
+    {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0}, /* @= */
+};
+
+static const uint8_t opAccept[OP_NUM_STATES] = {
+    OP_REJECT,
+    TOKEN_LEFT_PAREN,
+    TOKEN_RIGHT_PAREN,
+    TOKEN_LEFT_BRACE,
+    TOKEN_RIGHT_BRACE,
+    TOKEN_LEFT_SQUARE,
+    TOKEN_RIGHT_SQUARE,
+    TOKEN_COMMA,
+    TOKEN_SEMICOLON,
+    TOKEN_TILDE,
+    TOKEN_DOT,
+    OP_REJECT,
+    TOKEN_ELLIPSIS,
+    TOKEN_COLON,
+    TOKEN_WALRUS,
+    TOKEN_CARET,
+    TOKEN_CARET_EQUAL,
+    TOKEN_LESS,
+    TOKEN_LESS_EQUAL,
+    TOKEN_LEFT_SHIFT,
+    TOKEN_LSHIFT_EQUAL,
+    TOKEN_GREATER,
+    TOKEN_GREATER_EQUAL,
+    TOKEN_RIGHT_SHIFT,
+    TOKEN_RSHIFT_EQUAL,
+    TOKEN_EQUAL,
+    TOKEN_EQUAL_EQUAL,
+    TOKEN_BANG,
+    TOKEN_BANG_EQUAL,
+    TOKEN_PIPE,
+    TOKEN_PIPE_EQUAL,
+    TOKEN_AMPERSAND,
+    TOKEN_AMP_EQUAL,
+    TOKEN_MINUS,
+    TOKEN_MINUS_EQUAL,
+    TOKEN_ARROW,
+    TOKEN_PLUS,
+    TOKEN_PLUS_EQUAL,
+    TOKEN_SOLIDUS,
+    TOKEN_SOLIDUS_EQUAL,
+    TOKEN_DOUBLE_SOLIDUS,
+    TOKEN_DSOLIDUS_EQUAL,
+    TOKEN_ASTERISK,
+    TOKEN_ASTERISK_EQUAL,
+    TOKEN_POW,
+    TOKEN_POW_EQUAL,
+    TOKEN_MODULO,
+    TOKEN_MODULO_EQUAL,
+    TOKEN_AT,
+    TOKEN_AT_EQUAL,
+};
+
+/* 按最长匹配原则识别运算符，c 是已经读入的第一个字符 */
+static ZyToken operator(ZyScanner *scanner, char c) {
+  int state = opNext[0][opSymbol[(unsigned char)c]];
+  int accept = opAccept[state];
+  const char *p = scanner->cur;
+  const char *acceptEnd = p;
+  while (p < scanner->end &&
+         (state = opNext[state][opSymbol[(unsigned char)*p]]) != 0) {
+    p++;
+    if (opAccept[state] != OP_REJECT) {
+      accept = opAccept[state];
+      acceptEnd = p;
+    }
+  }
+  scanner->cur = acceptEnd;
+  return makeToken(scanner, (ZyTokenType)accept);
 }
 
 void zy_ungetToken(ZyScanner *scanner, ZyToken token) {
@@ -439,9 +638,9 @@ ZyToken zy_scanToken(ZyScanner *scanner) {
   skipWhitespace(scanner);
 
   /* 跳过注释 */
-  if (peek(scanner) == '#')
-    while (peek(scanner) != '\n' && !isAtEnd(scanner))
-      advance(scanner);
+  /* 注释不属于任何 token，里面的错误单独报告，范围到注释结尾 */
+  if (peek(scanner) == '#' && skipComment(scanner))
+    return errorToken(scanner, ZY_ERROR_INVALID_UTF8);
 
   scanner->start = scanner->cur;
 
@@ -459,149 +658,51 @@ ZyToken zy_scanToken(ZyScanner *scanner) {
       scanner->startOfLine = 1;
       out = makeToken(scanner, TOKEN_EOL);
     }
-    nextLine(scanner);
     return out;
   }
 
   if (c == '\\' && peek(scanner) == '\n') {
     advance(scanner);
-    nextLine(scanner);
     return makeToken(scanner, TOKEN_RETRY);
   }
 
   scanner->startOfLine = 0;
 
-  if (isAlpha(c) || (unsigned char)c > 0x7F)
+  if (hasClass(c, CC_ALPHA))
     return identifier(scanner);
-  if (isDigit(c))
+  if (hasClass(c, CC_DIGIT))
     return number(scanner, c);
+  if (c == '"' || c == '\'')
+    return string(scanner, c);
+  if (opSymbol[(unsigned char)c])
+    return operator(scanner, c);
+  if (hasClass(c, CC_UTF8))
+    return unicodeIdentifier(scanner);
+
+  return errorToken(scanner, ZY_ERROR_UNEXPECTED_CHARACTER);
+}
 
-  switch (c) {
-  case '(':
-    return makeToken(scanner, TOKEN_LEFT_PAREN);
-  case ')':
-    return makeToken(scanner, TOKEN_RIGHT_PAREN);
-  case '{':
-    return makeToken(scanner, TOKEN_LEFT_BRACE);
-  case '}':
-    return makeToken(scanner, TOKEN_RIGHT_BRACE);
-  case '[':
-    return makeToken(scanner, TOKEN_LEFT_SQUARE);
-  case ']':
-    return makeToken(scanner, TOKEN_RIGHT_SQUARE);
-  case ',':
-    return makeToken(scanner, TOKEN_COMMA);
-  case ';':
-    return makeToken(scanner, TOKEN_SEMICOLON);
-  case '~':
-    return makeToken(scanner, TOKEN_TILDE);
-  case '.':
-    if (peek(scanner) == '.') {
-      if (peekNext(scanner, 1) == '.') {
-        advance(scanner);
-        advance(scanner);
-        return makeToken(scanner, TOKEN_ELLIPSIS);
-      } else {
-        return makeToken(scanner, TOKEN_DOT);
-      }
-    } else {
-      return makeToken(scanner, TOKEN_DOT);
-    }
-  case ':':
-    if (match(scanner, '=')) {
-      return makeToken(scanner, TOKEN_WALRUS);
-    } else {
-      return makeToken(scanner, TOKEN_COLON);
-    }
-  case '^':
-    if (match(scanner, '=')) {
-      return makeToken(scanner, TOKEN_CARET_EQUAL);
-    } else {
-      return makeToken(scanner, TOKEN_CARET);
-    }
-  case '<':
-    if (match(scanner, '=')) {
-      return makeToken(scanner, TOKEN_LESS_EQUAL);
-    } else {
-      return makeToken(scanner, TOKEN_LESS);
-    }
-  case '>':
-    if (match(scanner, '=')) {
-      return makeToken(scanner, TOKEN_GREATER_EQUAL);
-    } else {
-      return makeToken(scanner, TOKEN_GREATER);
-    }
-  case '=':
-    if (match(scanner, '=')) {
-      return makeToken(scanner, TOKEN_EQUAL_EQUAL);
-    } else {
-      return makeToken(scanner, TOKEN_EQUAL);
-    }
-  case '!':
-    if (match(scanner, '=')) {
-      return makeToken(scanner, TOKEN_BANG_EQUAL);
-    } else {
-      return makeToken(scanner, TOKEN_BANG);
-    }
-  case '|':
-    if (match(scanner, '=')) {
-      return makeToken(scanner, TOKEN_PIPE_EQUAL);
-    } else {
-      return makeToken(scanner, TOKEN_PIPE);
-    }
-  case '&':
-    if (match(scanner, '=')) {
-      return makeToken(scanner, TOKEN_AMP_EQUAL);
-    } else {
-      return makeToken(scanner, TOKEN_AMPERSAND);
-    }
-  case '-':
-    if (match(scanner, '=')) {
-      return makeToken(scanner, TOKEN_MINUS_EQUAL);
-    } else {
-      return makeToken(scanner, TOKEN_MINUS);
-    }
-  case '+':
-    if (match(scanner, '=')) {
-      return makeToken(scanner, TOKEN_PLUS_EQUAL);
-    } else {
-      return makeToken(scanner, TOKEN_PLUS);
-    }
-  case '/':
-    if (match(scanner, '=')) {
-      return makeToken(scanner, TOKEN_SOLIDUS_EQUAL);
-    } else {
-      return makeToken(scanner, TOKEN_SOLIDUS);
-    }
-  case '*':
-    if (match(scanner, '=')) {
-      return makeToken(scanner, TOKEN_ASTERISK_EQUAL);
-    } else {
-      return makeToken(scanner, TOKEN_ASTERISK);
-    }
-  case '%':
-    if (match(scanner, '=')) {
-      return makeToken(scanner, TOKEN_MODULO_EQUAL);
-    } else {
-      return makeToken(scanner, TOKEN_MODULO);
-    }
-  case '@':
-    if (match(scanner, '=')) {
-      return makeToken(scanner, TOKEN_AT_EQUAL);
-    } else {
-      return makeToken(scanner, TOKEN_AT);
-    }
-  case '"':
-    return string(scanner, '"');
-  case '\'':
-    return string(scanner, '\'');
+const char *zy_errorMessage(ZyScanError error) {
+  switch (error) {
+  case ZY_ERROR_UNEXPECTED_CHARACTER:
+    return "Unexpected character.";
+  case ZY_ERROR_UNTERMINATED_STRING:
+    return "Unterminated string.";
+  case ZY_ERROR_MIXED_INDENTATION:
+    return "Invalid mix of indentation.";
+  case ZY_ERROR_INVALID_UTF8:
+    return "Invalid UTF-8.";
+  case ZY_ERROR_INCONSISTENT_DEDENT:
+    return "Unindent does not match any outer indentation level.";
+  case ZY_ERROR_TOO_DEEP:
+    return "Too many levels of indentation.";
   }
-
-  return errorToken(scanner, "Unexpected character.");
+  return "Unknown error.";
 }
 
-void printToken(ZyToken t) {
-  switch (t.type) {
+/* --verbose-lex 在每个 token 前面打印的标签 */
+const char *zy_tokenLabel(ZyTokenType type) {
+  switch (type) {
   case TOKEN_YIELD:
   case TOKEN_AND:
   case TOKEN_OR:
@@ -639,8 +740,7 @@ void printToken(ZyToken t) {
   case TOKEN_RAISE:
   case TOKEN_LAMBDA:
   case TOKEN_NONLOCAL:
-    printf("\033[38;5;214m关键字\033[0m：");
-    break;
+    return "\033[38;5;214m关键字\033[0m：";
   case TOKEN_LEFT_PAREN:
   case TOKEN_RIGHT_PAREN:
   case TOKEN_LEFT_BRACE:
@@ -690,38 +790,147 @@ void printToken(ZyToken t) {
   case TOKEN_AT_EQUAL:
   case TOKEN_MODULO_EQUAL:
   case TOKEN_ELLIPSIS:
-    printf("\033[34m运算符\033[0m：");
-    break;
+    return "\033[34m运算符\033[0m：";
   case TOKEN_STRING:
-    printf("\033[33m字符串\033[0m：");
-    break;
+    return "\033[33m字符串\033[0m：";
   case TOKEN_BIG_STRING:
-    printf("大字符串：");
-    break;
+    return "大字符串：";
   case TOKEN_NUMBER:
-    printf("\033[32m数值\033[0m：");
-    break;
+    return "\033[32m数值\033[0m：";
   case TOKEN_IDENTIFIER:
-    printf("\033[31m标识符\033[0m：");
-    break;
+    return "\033[31m标识符\033[0m：";
   case TOKEN_PREFIX_B:
   case TOKEN_PREFIX_F:
   case TOKEN_PREFIX_R:
   case TOKEN_INDENTATION:
-    printf("缩进：");
-    break;
+    return "缩进：";
+  case TOKEN_INDENT:
+    return "缩进";
+  case TOKEN_DEDENT:
+    return "反缩进";
   case TOKEN_ERROR:
-    printf("错误：");
-    break;
+    return "错误：";
   case TOKEN_EOL:
-    printf("end of line");
-    break;
+    return "end of line";
   case TOKEN_RETRY:
-    printf("retry");
-    break;
+    return "retry";
   case TOKEN_EOF:
-    printf("\033[35mEnd Of File\033[0m");
-    break;
+    return "\033[35mEnd Of File\033[0m";
+  }
+  return "";
+}
+
+void printToken(ZyToken t) {
+  if (t.type == TOKEN_ERROR) {
+    printf("错误：%s\r\n", zy_errorMessage((ZyScanError)t.symbol));
+    return;
   }
-  printf("%.*s\r\n", (int)(t.length), t.start);
-}
\ No newline at end of file
+  printf("%s%.*s\r\n", zy_tokenLabel(t.type), (int)(t.length), t.start);
+}
+
+/* 每次为这么多字节预留最坏情况（全是换行）所需的空间 */
+#define LINE_INDEX_BLOCK ((size_t)64 << 10)
+
+void zy_initLineIndex(ZyLineIndex *index, const char *src, const char *end) {
+  size_t capacity = 64;
+  index->starts = (uint32_t *)malloc(sizeof(uint32_t) * capacity);
+  if (index->starts == NULL) {
+    fprintf(stderr, "Not enough memory to index source lines.");
+    exit(1);
+  }
+  index->starts[0] = 0;
+  index->count = 1;
+  for (const char *p = src; p < end; p += LINE_INDEX_BLOCK) {
+    const char *blockEnd =
+        (size_t)(end - p) > LINE_INDEX_BLOCK ? p + LINE_INDEX_BLOCK : end;
+    if (index->count + (size_t)(blockEnd - p) > capacity) {
+      while (index->count + (size_t)(blockEnd - p) > capacity)
+        capacity *= 2;
+      uint32_t *starts =
+          (uint32_t *)realloc(index->starts, sizeof(uint32_t) * capacity);
+      if (starts == NULL) {
+        fprintf(stderr, "Not enough memory to index source lines.");
+        exit(1);
+      }
+      index->starts = starts;
+    }
+    index->count +=
+        zy_collectLineStarts(src, p, blockEnd, index->starts + index->count);
+  }
+}
+
+void zy_freeLineIndex(ZyLineIndex *index) {
+  free(index->starts);
+  index->starts = NULL;
+  index->count = 0;
+}
+
+size_t zy_lineOfOffset(const ZyLineIndex *index, size_t offset) {
+  /* 找到最后一个不大于 offset 的行首 */
+  size_t lo = 0, hi = index->count;
+  while (hi - lo > 1) {
+    size_t mid = lo + (hi - lo) / 2;
+    if (index->starts[mid] <= offset)
+      lo = mid;
+    else
+      hi = mid;
+  }
+  return lo + 1;
+}
+
+ZyPosition zy_positionOf(const ZyLineIndex *index, size_t offset) {
+  ZyPosition position;
+  position.line = zy_lineOfOffset(index, offset);
+  position.col = offset - index->starts[position.line - 1] + 1;
+  return position;
+}
+
+static size_t firstLineAfter(const ZyLineIndex *index, size_t offset) {
+  size_t lo = 0, hi = index->count;
+  while (lo < hi) {
+    size_t mid = lo + (hi - lo) / 2;
+    if (index->starts[mid] <= offset)
+      lo = mid + 1;
+    else
+      hi = mid;
+  }
+  return lo;
+}
+
+/*
+ * 源码中 offset 处的 removed 个字节被替换成了 inserted 个新字节，
+ * src 是修改之后的源码。edit 之前的行首不变，之后的整体平移，
+ * 只有被替换的那一段需要重新找换行。
+ */
+void zy_editLineIndex(ZyLineIndex *index, const char *src, size_t offset,
+                      size_t removed, size_t inserted) {
+  size_t lo = firstLineAfter(index, offset);
+  size_t hi = firstLineAfter(index, offset + removed);
+
+  size_t added = 0;
+  const char *end = src + offset + inserted;
+  for (const char *p = zy_findNewline(src + offset, end); p < end;
+       p = zy_findNewline(p + 1, end))
+    added++;
+
+  size_t count = lo + added + (index->count - hi);
+  if (count > index->count) {
+    uint32_t *starts =
+        (uint32_t *)realloc(index->starts, sizeof(uint32_t) * count);
+    if (starts == NULL) {
+      fprintf(stderr, "Not enough memory to index source lines.");
+      exit(1);
+    }
+    index->starts = starts;
+  }
+  memmove(index->starts + lo + added, index->starts + hi,
+          sizeof(uint32_t) * (index->count - hi));
+  for (size_t i = lo + added; i < count; i++)
+    index->starts[i] = (uint32_t)(index->starts[i] + inserted - removed);
+
+  size_t i = lo;
+  for (const char *p = zy_findNewline(src + offset, end); p < end;
+       p = zy_findNewline(p + 1, end))
+    index->starts[i++] = (uint32_t)(p + 1 - src);
+  index->count = count;
+}
@@ -1,6 +1,11 @@
 #pragma once
 
 #include <stddef.h>
+#include <stdint.h>
+
+#include "literals.h"
+#include "symbols.h"
+
 typedef enum {
   TOKEN_LEFT_PAREN,     /* `(` */
   TOKEN_RIGHT_PAREN,    /* `)` */
@@ -114,31 +119,115 @@ typedef enum {
   TOKEN_EOF,
 
   TOKEN_ELLIPSIS, /* ... */
+
+  /* 只由 ZyLayout 产生，原始的 token 流里没有 */
+  TOKEN_INDENT,
+  TOKEN_DEDENT,
 } ZyTokenType;
 
+/**
+ * @brief Why the scanner produced a TOKEN_ERROR.
+ */
+typedef enum {
+  ZY_ERROR_UNEXPECTED_CHARACTER = 1,
+  ZY_ERROR_UNTERMINATED_STRING,
+  ZY_ERROR_MIXED_INDENTATION,
+  ZY_ERROR_INVALID_UTF8,
+  ZY_ERROR_INCONSISTENT_DEDENT,
+  ZY_ERROR_TOO_DEEP,
+} ZyScanError;
+
+/**
+ * @brief One token, located by its first byte.
+ *
+ * Lines and columns are not tracked while scanning; resolve them
+ * with a @ref ZyLineIndex when a diagnostic needs them.
+ */
 typedef struct {
   ZyTokenType type;
+  /**
+   * @brief Interned name, or @ref ZY_NO_SYMBOL. For TOKEN_ERROR this
+   * is the @ref ZyScanError instead, and for a decoded TOKEN_NUMBER
+   * the index of its value in the @ref ZyLiteralTable.
+   */
+  uint32_t symbol;
   const char *start;
+  /**
+   * @brief Bytes covered by the token, except that EOL has length 0
+   * and tab indentation counts 8 per tab.
+   */
   size_t length;
-  size_t line;
-  const char *linePtr;
-  size_t col;
-  size_t literalWidth;
 } ZyToken;
 
 typedef struct {
   const char *start;
   const char *cur;
-  const char *linePtr;
-  size_t line;
+  const char *end;
   int startOfLine;
   int hasUnget;
   ZyToken unget;
+  /**
+   * @brief When not NULL, identifiers and string literals without
+   * escapes are interned here and carry their ID in `symbol`.
+   */
+  ZySymbolTable *symbols;
+  /** @brief When not NULL, numbers are decoded into this table. */
+  ZyLiteralTable *literals;
+  /**
+   * @brief Input before this has been checked to be valid UTF-8.
+   *
+   * Validation runs a block ahead of the scanner, so it costs one
+   * comparison per token. Code that moves the input (a stream
+   * refill) must reset it to the new `cur`.
+   */
+  const char *utf8End;
 } ZyScanner;
 
-extern ZyScanner zy_initScanner(const char *src);
+/**
+ * @brief Byte offsets of the first character of every line.
+ *
+ * Used to turn a source position back into a line and column
+ * without having tracked them while scanning.
+ */
+typedef struct {
+  uint32_t *starts; /**< @brief starts[i] is the offset of line i + 1. */
+  size_t count;
+} ZyLineIndex;
+
+/**
+ * @brief 1-based line and byte column of a source position.
+ */
+typedef struct {
+  size_t line;
+  size_t col;
+} ZyPosition;
+
+extern ZyScanner zy_initScanner(const char *begin, const char *end);
 extern ZyToken zy_scanToken(ZyScanner *);
 extern void zy_ungetToken(ZyScanner *, ZyToken token);
 extern void zy_rewindScanner(ZyScanner *, ZyScanner to);
 extern ZyScanner zy_tellScanner(ZyScanner *);
-extern void printToken(ZyToken t);
\ No newline at end of file
+extern void printToken(ZyToken t);
+extern const char *zy_tokenLabel(ZyTokenType type);
+extern const char *zy_errorMessage(ZyScanError error);
+
+extern void zy_initLineIndex(ZyLineIndex *index, const char *src,
+                             const char *end);
+extern void zy_freeLineIndex(ZyLineIndex *index);
+extern size_t zy_lineOfOffset(const ZyLineIndex *index, size_t offset);
+extern ZyPosition zy_positionOf(const ZyLineIndex *index, size_t offset);
+extern void zy_editLineIndex(ZyLineIndex *index, const char *src,
+                             size_t offset, size_t removed, size_t inserted);
+/* 字符串前面的前缀 token（没有前缀时随便什么 token）对应的解码标志 */
+static inline int zy_stringFlags(ZyTokenType prefix) {
+  switch (prefix) {
+  case TOKEN_PREFIX_B:
+    return ZY_STRING_BYTES;
+  case TOKEN_PREFIX_F:
+    return ZY_STRING_FORMAT;
+  case TOKEN_PREFIX_R:
+    return ZY_STRING_RAW;
+  default:
+    return 0;
+  }
+}
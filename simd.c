@@ -0,0 +1,571 @@
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define ZY_SIMD_X86 1
+#endif
+
+#include "simd.h"
+#include "unicode.h"
+
+typedef const char *(*SkipFn)(const char *, const char *);
+typedef const char *(*StopFn)(const char *, const char *, char);
+typedef const char *(*CopyFn)(char *, const char *, const char *, char);
+typedef size_t (*CollectFn)(const char *, const char *, const char *,
+                            uint32_t *);
+
+/**
+ * @brief Kernel table for the selected @ref ZySimdLevel.
+ *
+ * Filled once before main by @ref simdInit, so scanning threads only
+ * ever read it.
+ */
+typedef struct {
+  ZySimdLevel level;
+  SkipFn skipBlanks;
+  SkipFn findNewline;
+  StopFn findByte;
+  CopyFn copyUntilByte;
+  StopFn findStringStop;
+  SkipFn findInvalidUtf8;
+  CollectFn collectLineStarts;
+} SimdDispatch;
+
+static SimdDispatch simd;
+
+static const char *skipBlanksScalar(const char *p, const char *end) {
+  while (p < end && (*p == ' ' || *p == '\t'))
+    p++;
+  return p;
+}
+
+static const char *findNewlineScalar(const char *p, const char *end) {
+  while (p < end && *p != '\n')
+    p++;
+  return p;
+}
+
+static const char *findByteScalar(const char *p, const char *end, char c) {
+  while (p < end && *p != c)
+    p++;
+  return p;
+}
+
+static const char *copyUntilByteScalar(char *dst, const char *p,
+                                       const char *end, char c) {
+  while (p < end && *p != c)
+    *dst++ = *p++;
+  return p;
+}
+
+static const char *findStringStopScalar(const char *p, const char *end,
+                                        char quoteMark) {
+  while (p < end && *p != quoteMark && *p != '\\' && *p != '\n')
+    p++;
+  return p;
+}
+
+static const char *findInvalidUtf8Scalar(const char *p, const char *end) {
+  uint32_t codePoint;
+  while (p < end) {
+    /* 一次跳过 8 个 ASCII 字节 */
+    if (end - p >= 8) {
+      uint64_t word;
+      memcpy(&word, p, 8);
+      if ((word & UINT64_C(0x8080808080808080)) == 0) {
+        p += 8;
+        continue;
+      }
+    }
+    size_t length = zy_decodeUtf8(p, end, &codePoint);
+    if (length == 0)
+      return p;
+    p += length;
+  }
+  return p;
+}
+
+/*
+ * 向量化的版本发现错误之后，从这里开始逐字节找出确切的位置。
+ * p 之前的内容都检查过了，但可能有一个序列跨过 p，所以往回
+ * 最多退 3 个字节找到它的首字节。
+ */
+static const char *locateInvalidUtf8(const char *begin, const char *p,
+                                     const char *end) {
+  for (const char *q = p; q > begin && q > p - 3; q--) {
+    if ((unsigned char)q[-1] >= 0xC0)
+      return findInvalidUtf8Scalar(q - 1, end);
+  }
+  return findInvalidUtf8Scalar(p, end);
+}
+
+static size_t collectLineStartsScalar(const char *src, const char *p,
+                                     const char *end, uint32_t *out) {
+  size_t count = 0;
+  for (; p < end; p++) {
+    if (*p == '\n')
+      out[count++] = (uint32_t)(p + 1 - src);
+  }
+  return count;
+}
+
+#ifdef ZY_SIMD_X86
+__attribute__((target("sse2"))) static const char *
+skipBlanksSse2(const char *p, const char *end) {
+  const __m128i space = _mm_set1_epi8(' ');
+  const __m128i tab = _mm_set1_epi8('\t');
+  while (end - p >= 16) {
+    __m128i chunk = _mm_loadu_si128((const __m128i *)p);
+    __m128i blank = _mm_or_si128(_mm_cmpeq_epi8(chunk, space),
+                                 _mm_cmpeq_epi8(chunk, tab));
+    unsigned int mask = ~(unsigned int)_mm_movemask_epi8(blank) & 0xFFFF;
+    if (mask != 0)
+      return p + __builtin_ctz(mask);
+    p += 16;
+  }
+  return skipBlanksScalar(p, end);
+}
+
+__attribute__((target("sse2"))) static const char *
+findNewlineSse2(const char *p, const char *end) {
+  const __m128i newline = _mm_set1_epi8('\n');
+  while (end - p >= 16) {
+    __m128i chunk = _mm_loadu_si128((const __m128i *)p);
+    unsigned int mask =
+        (unsigned int)_mm_movemask_epi8(_mm_cmpeq_epi8(chunk, newline));
+    if (mask != 0)
+      return p + __builtin_ctz(mask);
+    p += 16;
+  }
+  return findNewlineScalar(p, end);
+}
+
+__attribute__((target("sse2"))) static const char *
+findByteSse2(const char *p, const char *end, char c) {
+  const __m128i needle = _mm_set1_epi8(c);
+  while (end - p >= 16) {
+    __m128i chunk = _mm_loadu_si128((const __m128i *)p);
+    unsigned int mask =
+        (unsigned int)_mm_movemask_epi8(_mm_cmpeq_epi8(chunk, needle));
+    if (mask != 0)
+      return p + __builtin_ctz(mask);
+    p += 16;
+  }
+  return findByteScalar(p, end, c);
+}
+
+/* 整块复制过去再看有没有 c，所以 dst 后面要多留 16 个字节 */
+__attribute__((target("sse2"))) static const char *
+copyUntilByteSse2(char *dst, const char *p, const char *end, char c) {
+  const __m128i needle = _mm_set1_epi8(c);
+  while (end - p >= 16) {
+    __m128i chunk = _mm_loadu_si128((const __m128i *)p);
+    _mm_storeu_si128((__m128i *)dst, chunk);
+    unsigned int mask =
+        (unsigned int)_mm_movemask_epi8(_mm_cmpeq_epi8(chunk, needle));
+    if (mask != 0)
+      return p + __builtin_ctz(mask);
+    p += 16;
+    dst += 16;
+  }
+  return copyUntilByteScalar(dst, p, end, c);
+}
+
+__attribute__((target("sse2"))) static const char *
+findStringStopSse2(const char *p, const char *end, char quoteMark) {
+  const __m128i quote = _mm_set1_epi8(quoteMark);
+  const __m128i backslash = _mm_set1_epi8('\\');
+  const __m128i newline = _mm_set1_epi8('\n');
+  while (end - p >= 16) {
+    __m128i chunk = _mm_loadu_si128((const __m128i *)p);
+    __m128i stop = _mm_or_si128(
+        _mm_or_si128(_mm_cmpeq_epi8(chunk, quote),
+                     _mm_cmpeq_epi8(chunk, backslash)),
+        _mm_cmpeq_epi8(chunk, newline));
+    unsigned int mask = (unsigned int)_mm_movemask_epi8(stop);
+    if (mask != 0)
+      return p + __builtin_ctz(mask);
+    p += 16;
+  }
+  return findStringStopScalar(p, end, quoteMark);
+}
+
+__attribute__((target("sse2"))) static size_t
+collectLineStartsSse2(const char *src, const char *p, const char *end,
+                      uint32_t *out) {
+  const __m128i newline = _mm_set1_epi8('\n');
+  size_t count = 0;
+  while (end - p >= 16) {
+    __m128i chunk = _mm_loadu_si128((const __m128i *)p);
+    unsigned int mask =
+        (unsigned int)_mm_movemask_epi8(_mm_cmpeq_epi8(chunk, newline));
+    uint32_t base = (uint32_t)(p + 1 - src);
+    /* 逐个取出掩码中的位 */
+    while (mask != 0) {
+      out[count++] = base + (uint32_t)__builtin_ctz(mask);
+      mask &= mask - 1;
+    }
+    p += 16;
+  }
+  return count + collectLineStartsScalar(src, p, end, out + count);
+}
+
+/*
+ * SSE2 没有 pshufb，做不了查表式的校验：只把 ASCII 的部分成块跳过，
+ * 遇到非 ASCII 字节时逐个解码。
+ */
+__attribute__((target("sse2"))) static const char *
+findInvalidUtf8Sse2(const char *p, const char *end) {
+  uint32_t codePoint;
+  while (end - p >= 16) {
+    __m128i chunk = _mm_loadu_si128((const __m128i *)p);
+    unsigned int mask = (unsigned int)_mm_movemask_epi8(chunk);
+    if (mask == 0) {
+      p += 16;
+      continue;
+    }
+    p += __builtin_ctz(mask);
+    do {
+      size_t length = zy_decodeUtf8(p, end, &codePoint);
+      if (length == 0)
+        return p;
+      p += length;
+    } while (p < end && (unsigned char)*p >= 0x80);
+  }
+  return findInvalidUtf8Scalar(p, end);
+}
+
+__attribute__((target("avx2"))) static const char *
+skipBlanksAvx2(const char *p, const char *end) {
+  const __m256i space = _mm256_set1_epi8(' ');
+  const __m256i tab = _mm256_set1_epi8('\t');
+  while (end - p >= 32) {
+    __m256i chunk = _mm256_loadu_si256((const __m256i *)p);
+    __m256i blank = _mm256_or_si256(_mm256_cmpeq_epi8(chunk, space),
+                                    _mm256_cmpeq_epi8(chunk, tab));
+    unsigned int mask = ~(unsigned int)_mm256_movemask_epi8(blank);
+    if (mask != 0)
+      return p + __builtin_ctz(mask);
+    p += 32;
+  }
+  return skipBlanksSse2(p, end);
+}
+
+__attribute__((target("avx2"))) static const char *
+findNewlineAvx2(const char *p, const char *end) {
+  const __m256i newline = _mm256_set1_epi8('\n');
+  while (end - p >= 32) {
+    __m256i chunk = _mm256_loadu_si256((const __m256i *)p);
+    unsigned int mask =
+        (unsigned int)_mm256_movemask_epi8(_mm256_cmpeq_epi8(chunk, newline));
+    if (mask != 0)
+      return p + __builtin_ctz(mask);
+    p += 32;
+  }
+  return findNewlineSse2(p, end);
+}
+
+__attribute__((target("avx2"))) static const char *
+findByteAvx2(const char *p, const char *end, char c) {
+  const __m256i needle = _mm256_set1_epi8(c);
+  while (end - p >= 32) {
+    __m256i chunk = _mm256_loadu_si256((const __m256i *)p);
+    unsigned int mask =
+        (unsigned int)_mm256_movemask_epi8(_mm256_cmpeq_epi8(chunk, needle));
+    if (mask != 0)
+      return p + __builtin_ctz(mask);
+    p += 32;
+  }
+  return findByteSse2(p, end, c);
+}
+
+__attribute__((target("avx2"))) static const char *
+copyUntilByteAvx2(char *dst, const char *p, const char *end, char c) {
+  const __m256i needle = _mm256_set1_epi8(c);
+  while (end - p >= 32) {
+    __m256i chunk = _mm256_loadu_si256((const __m256i *)p);
+    _mm256_storeu_si256((__m256i *)dst, chunk);
+    unsigned int mask =
+        (unsigned int)_mm256_movemask_epi8(_mm256_cmpeq_epi8(chunk, needle));
+    if (mask != 0)
+      return p + __builtin_ctz(mask);
+    p += 32;
+    dst += 32;
+  }
+  return copyUntilByteSse2(dst, p, end, c);
+}
+
+__attribute__((target("avx2"))) static const char *
+findStringStopAvx2(const char *p, const char *end, char quoteMark) {
+  const __m256i quote = _mm256_set1_epi8(quoteMark);
+  const __m256i backslash = _mm256_set1_epi8('\\');
+  const __m256i newline = _mm256_set1_epi8('\n');
+  while (end - p >= 32) {
+    __m256i chunk = _mm256_loadu_si256((const __m256i *)p);
+    __m256i stop = _mm256_or_si256(
+        _mm256_or_si256(_mm256_cmpeq_epi8(chunk, quote),
+                        _mm256_cmpeq_epi8(chunk, backslash)),
+        _mm256_cmpeq_epi8(chunk, newline));
+    unsigned int mask = (unsigned int)_mm256_movemask_epi8(stop);
+    if (mask != 0)
+      return p + __builtin_ctz(mask);
+    p += 32;
+  }
+  return findStringStopSse2(p, end, quoteMark);
+}
+
+__attribute__((target("avx2"))) static size_t
+collectLineStartsAvx2(const char *src, const char *p, const char *end,
+                      uint32_t *out) {
+  const __m256i newline = _mm256_set1_epi8('\n');
+  size_t count = 0;
+  while (end - p >= 32) {
+    __m256i chunk = _mm256_loadu_si256((const __m256i *)p);
+    unsigned int mask =
+        (unsigned int)_mm256_movemask_epi8(_mm256_cmpeq_epi8(chunk, newline));
+    uint32_t base = (uint32_t)(p + 1 - src);
+    while (mask != 0) {
+      out[count++] = base + (uint32_t)__builtin_ctz(mask);
+      mask &= mask - 1;
+    }
+    p += 32;
+  }
+  return count + collectLineStartsSse2(src, p, end, out + count);
+}
+
+/*
+ * Keiser 和 Lemire 的查表法：每个字节和它前面的一个字节各取高低
+ * 4 位查三张表，三个结果按位与之后不为 0 就是错误；再单独检查
+ * 3、4 字节序列的第 3、4 个字节必须是后续字节。
+ */
+#define UTF8_TOO_SHORT (1 << 0)  /* 11______ 0_______ 或 11______ 11______ */
+#define UTF8_TOO_LONG (1 << 1)   /* 0_______ 10______ */
+#define UTF8_OVERLONG_3 (1 << 2) /* 11100000 100_____ */
+#define UTF8_TOO_LARGE (1 << 3)  /* 11110100 1001____ 等 */
+#define UTF8_SURROGATE (1 << 4)  /* 11101101 101_____ */
+#define UTF8_OVERLONG_2 (1 << 5) /* 1100000_ 10______ */
+#define UTF8_TOO_LARGE_1000 (1 << 6) /* 11110101 1000____ 等 */
+#define UTF8_OVERLONG_4 (1 << 6) /* 11110000 1000____ */
+#define UTF8_TWO_CONTS (1 << 7)  /* 10______ 10______ */
+#define UTF8_CARRY (UTF8_TOO_SHORT | UTF8_TOO_LONG | UTF8_TWO_CONTS)
+
+/* 每个字节的前 n 个字节，跨过 128 位的两半，最前面的从 previous 补上 */
+#define AVX2_PREVIOUS(input, previous, n)                                      \
+  _mm256_alignr_epi8(                                                          \
+      (input), _mm256_permute2x128_si256((previous), (input), 0x21), 16 - (n))
+
+__attribute__((target("avx2"))) static inline __m256i
+utf8Errors(__m256i input, __m256i previous) {
+  const __m256i lowNibble = _mm256_set1_epi8(0x0F);
+  const __m256i byte1High = _mm256_setr_epi8(
+      UTF8_TOO_LONG, UTF8_TOO_LONG, UTF8_TOO_LONG, UTF8_TOO_LONG,
+      UTF8_TOO_LONG, UTF8_TOO_LONG, UTF8_TOO_LONG, UTF8_TOO_LONG,
+      UTF8_TWO_CONTS, UTF8_TWO_CONTS, UTF8_TWO_CONTS, UTF8_TWO_CONTS,
+      UTF8_TOO_SHORT | UTF8_OVERLONG_2, UTF8_TOO_SHORT,
+      UTF8_TOO_SHORT | UTF8_OVERLONG_3 | UTF8_SURROGATE,
+      UTF8_TOO_SHORT | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000 | UTF8_OVERLONG_4,
+      UTF8_TOO_LONG, UTF8_TOO_LONG, UTF8_TOO_LONG, UTF8_TOO_LONG,
+      UTF8_TOO_LONG, UTF8_TOO_LONG, UTF8_TOO_LONG, UTF8_TOO_LONG,
+      UTF8_TWO_CONTS, UTF8_TWO_CONTS, UTF8_TWO_CONTS, UTF8_TWO_CONTS,
+      UTF8_TOO_SHORT | UTF8_OVERLONG_2, UTF8_TOO_SHORT,
+      UTF8_TOO_SHORT | UTF8_OVERLONG_3 | UTF8_SURROGATE,
+      UTF8_TOO_SHORT | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000 | UTF8_OVERLONG_4);
+#define UTF8_LARGE (UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000)
+  const __m256i byte1Low = _mm256_setr_epi8(
+      UTF8_CARRY | UTF8_OVERLONG_3 | UTF8_OVERLONG_2 | UTF8_OVERLONG_4,
+      UTF8_CARRY | UTF8_OVERLONG_2, UTF8_CARRY, UTF8_CARRY,
+      UTF8_CARRY | UTF8_TOO_LARGE, UTF8_LARGE, UTF8_LARGE, UTF8_LARGE,
+      UTF8_LARGE, UTF8_LARGE, UTF8_LARGE, UTF8_LARGE, UTF8_LARGE,
+      UTF8_LARGE | UTF8_SURROGATE, UTF8_LARGE, UTF8_LARGE,
+      UTF8_CARRY | UTF8_OVERLONG_3 | UTF8_OVERLONG_2 | UTF8_OVERLONG_4,
+      UTF8_CARRY | UTF8_OVERLONG_2, UTF8_CARRY, UTF8_CARRY,
+      UTF8_CARRY | UTF8_TOO_LARGE, UTF8_LARGE, UTF8_LARGE, UTF8_LARGE,
+      UTF8_LARGE, UTF8_LARGE, UTF8_LARGE, UTF8_LARGE, UTF8_LARGE,
+      UTF8_LARGE | UTF8_SURROGATE, UTF8_LARGE, UTF8_LARGE);
+#undef UTF8_LARGE
+#define UTF8_CONT (UTF8_TOO_LONG | UTF8_OVERLONG_2 | UTF8_TWO_CONTS)
+  const __m256i byte2High = _mm256_setr_epi8(
+      UTF8_TOO_SHORT, UTF8_TOO_SHORT, UTF8_TOO_SHORT, UTF8_TOO_SHORT,
+      UTF8_TOO_SHORT, UTF8_TOO_SHORT, UTF8_TOO_SHORT, UTF8_TOO_SHORT,
+      UTF8_CONT | UTF8_OVERLONG_3 | UTF8_TOO_LARGE_1000 | UTF8_OVERLONG_4,
+      UTF8_CONT | UTF8_OVERLONG_3 | UTF8_TOO_LARGE,
+      UTF8_CONT | UTF8_SURROGATE | UTF8_TOO_LARGE,
+      UTF8_CONT | UTF8_SURROGATE | UTF8_TOO_LARGE,
+      UTF8_TOO_SHORT, UTF8_TOO_SHORT, UTF8_TOO_SHORT, UTF8_TOO_SHORT,
+      UTF8_TOO_SHORT, UTF8_TOO_SHORT, UTF8_TOO_SHORT, UTF8_TOO_SHORT,
+      UTF8_TOO_SHORT, UTF8_TOO_SHORT, UTF8_TOO_SHORT, UTF8_TOO_SHORT,
+      UTF8_CONT | UTF8_OVERLONG_3 | UTF8_TOO_LARGE_1000 | UTF8_OVERLONG_4,
+      UTF8_CONT | UTF8_OVERLONG_3 | UTF8_TOO_LARGE,
+      UTF8_CONT | UTF8_SURROGATE | UTF8_TOO_LARGE,
+      UTF8_CONT | UTF8_SURROGATE | UTF8_TOO_LARGE,
+      UTF8_TOO_SHORT, UTF8_TOO_SHORT, UTF8_TOO_SHORT, UTF8_TOO_SHORT);
+#undef UTF8_CONT
+
+  __m256i prev1 = AVX2_PREVIOUS(input, previous, 1);
+  __m256i special = _mm256_and_si256(
+      _mm256_and_si256(
+          _mm256_shuffle_epi8(
+              byte1High,
+              _mm256_and_si256(_mm256_srli_epi16(prev1, 4), lowNibble)),
+          _mm256_shuffle_epi8(byte1Low, _mm256_and_si256(prev1, lowNibble))),
+      _mm256_shuffle_epi8(
+          byte2High,
+          _mm256_and_si256(_mm256_srli_epi16(input, 4), lowNibble)));
+
+  /* 前面第 2 个字节是 111_____ 或第 3 个字节是 1111____ 时必须是后续字节 */
+  __m256i prev2 = AVX2_PREVIOUS(input, previous, 2);
+  __m256i prev3 = AVX2_PREVIOUS(input, previous, 3);
+  __m256i must23 = _mm256_or_si256(
+      _mm256_subs_epu8(prev2, _mm256_set1_epi8((char)(0xE0 - 0x80))),
+      _mm256_subs_epu8(prev3, _mm256_set1_epi8((char)(0xF0 - 0x80))));
+  __m256i must23As80 = _mm256_and_si256(must23, _mm256_set1_epi8((char)0x80));
+  return _mm256_xor_si256(must23As80, special);
+}
+
+__attribute__((target("avx2"))) static const char *
+findInvalidUtf8Avx2(const char *p, const char *end) {
+  /* 最后 3 个字节里还没结束的多字节序列，要到下一块才能检查 */
+  const __m256i incompleteMax = _mm256_setr_epi8(
+      -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+      -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, (char)(0xF0 - 1),
+      (char)(0xE0 - 1), (char)(0xC0 - 1));
+  const char *begin = p;
+  __m256i previous = _mm256_setzero_si256();
+  __m256i incomplete = _mm256_setzero_si256();
+  while (end - p >= 32) {
+    /* 源码大多是 ASCII，先按 64 字节一步跳过 */
+    if (end - p >= 64) {
+      __m256i second = _mm256_loadu_si256((const __m256i *)(p + 32));
+      __m256i both =
+          _mm256_or_si256(_mm256_loadu_si256((const __m256i *)p), second);
+      if (_mm256_movemask_epi8(both) == 0) {
+        if (!_mm256_testz_si256(incomplete, incomplete))
+          return locateInvalidUtf8(begin, p, end);
+        incomplete = _mm256_setzero_si256();
+        previous = second;
+        p += 64;
+        continue;
+      }
+    }
+    __m256i input = _mm256_loadu_si256((const __m256i *)p);
+    if (_mm256_movemask_epi8(input) == 0) {
+      /* 整块都是 ASCII，只要上一块结尾没有没结束的序列 */
+      if (!_mm256_testz_si256(incomplete, incomplete))
+        return locateInvalidUtf8(begin, p, end);
+      incomplete = _mm256_setzero_si256();
+    } else {
+      __m256i error = utf8Errors(input, previous);
+      if (!_mm256_testz_si256(error, error))
+        return locateInvalidUtf8(begin, p, end);
+      incomplete = _mm256_subs_epu8(input, incompleteMax);
+    }
+    previous = input;
+    p += 32;
+  }
+  return locateInvalidUtf8(begin, p, end);
+}
+#endif
+
+static ZySimdLevel bestSupportedLevel(void) {
+#ifdef ZY_SIMD_X86
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx2"))
+    return ZY_SIMD_AVX2;
+  if (__builtin_cpu_supports("sse2"))
+    return ZY_SIMD_SSE2;
+#endif
+  return ZY_SIMD_SCALAR;
+}
+
+/*
+ * 换一套内核。表不加锁，只能在开始扫描之前、还只有一个线程时调用，
+ * 不能和正在扫描的线程同时调用。
+ */
+ZySimdLevel zy_setSimdLevel(ZySimdLevel level) {
+  ZySimdLevel best = bestSupportedLevel();
+  if (level > best)
+    level = best;
+
+  simd.level = level;
+  simd.skipBlanks = skipBlanksScalar;
+  simd.findNewline = findNewlineScalar;
+  simd.findByte = findByteScalar;
+  simd.copyUntilByte = copyUntilByteScalar;
+  simd.findStringStop = findStringStopScalar;
+  simd.findInvalidUtf8 = findInvalidUtf8Scalar;
+  simd.collectLineStarts = collectLineStartsScalar;
+#ifdef ZY_SIMD_X86
+  if (level == ZY_SIMD_SSE2) {
+    simd.skipBlanks = skipBlanksSse2;
+    simd.findNewline = findNewlineSse2;
+    simd.findByte = findByteSse2;
+    simd.copyUntilByte = copyUntilByteSse2;
+    simd.findStringStop = findStringStopSse2;
+    simd.findInvalidUtf8 = findInvalidUtf8Sse2;
+    simd.collectLineStarts = collectLineStartsSse2;
+  } else if (level == ZY_SIMD_AVX2) {
+    simd.skipBlanks = skipBlanksAvx2;
+    simd.findNewline = findNewlineAvx2;
+    simd.findByte = findByteAvx2;
+    simd.copyUntilByte = copyUntilByteAvx2;
+    simd.findStringStop = findStringStopAvx2;
+    simd.findInvalidUtf8 = findInvalidUtf8Avx2;
+    simd.collectLineStarts = collectLineStartsAvx2;
+  }
+#endif
+  return level;
+}
+
+/* 程序启动时就选好内核，之后多个线程同时扫描也只是读这张表 */
+__attribute__((constructor)) static void simdInit(void) {
+  zy_setSimdLevel(ZY_SIMD_AVX2);
+}
+
+ZySimdLevel zy_simdLevel(void) {
+  return simd.level;
+}
+
+const char *zy_simdLevelName(ZySimdLevel level) {
+  switch (level) {
+  case ZY_SIMD_SCALAR:
+    return "scalar";
+  case ZY_SIMD_SSE2:
+    return "sse2";
+  case ZY_SIMD_AVX2:
+    return "avx2";
+  }
+  return "unknown";
+}
+
+const char *zy_skipBlanks(const char *p, const char *end) {
+  return simd.skipBlanks(p, end);
+}
+
+const char *zy_findNewline(const char *p, const char *end) {
+  return simd.findNewline(p, end);
+}
+
+const char *zy_findByte(const char *p, const char *end, char c) {
+  return simd.findByte(p, end, c);
+}
+
+const char *zy_copyUntilByte(char *dst, const char *p, const char *end,
+                             char c) {
+  return simd.copyUntilByte(dst, p, end, c);
+}
+
+const char *zy_findStringStop(const char *p, const char *end,
+                              char quoteMark) {
+  return simd.findStringStop(p, end, quoteMark);
+}
+
+const char *zy_findInvalidUtf8(const char *p, const char *end) {
+  return simd.findInvalidUtf8(p, end);
+}
+
+size_t zy_collectLineStarts(const char *src, const char *p, const char *end,
+                            uint32_t *out) {
+  return simd.collectLineStarts(src, p, end, out);
+}
@@ -0,0 +1,48 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * @brief Instruction set used by the vectorized scanning kernels.
+ *
+ * The best level supported by the running CPU is picked at program
+ * startup; @ref zy_setSimdLevel can force a lower one before any
+ * scanning starts.
+ */
+typedef enum {
+  ZY_SIMD_SCALAR, /**< Plain byte-at-a-time loops. */
+  ZY_SIMD_SSE2,   /**< 16 bytes per step. */
+  ZY_SIMD_AVX2,   /**< 32 bytes per step. */
+} ZySimdLevel;
+
+extern ZySimdLevel zy_simdLevel(void);
+extern ZySimdLevel zy_setSimdLevel(ZySimdLevel level);
+extern const char *zy_simdLevelName(ZySimdLevel level);
+
+/* 返回 [p, end) 中第一个不是空格或`\t`的位置，没有则返回 end */
+extern const char *zy_skipBlanks(const char *p, const char *end);
+/* 返回 [p, end) 中第一个`\n`的位置，没有则返回 end */
+extern const char *zy_findNewline(const char *p, const char *end);
+/* 返回 [p, end) 中第一个 c 的位置，没有则返回 end */
+extern const char *zy_findByte(const char *p, const char *end, char c);
+/*
+ * 把 [p, end) 中第一个 c 之前的字节复制到 dst，返回 c 的位置（没有
+ * 则返回 end）。dst 可能被多写最多 32 个字节，要留出余量。
+ */
+extern const char *zy_copyUntilByte(char *dst, const char *p,
+                                    const char *end, char c);
+/* 返回 [p, end) 中第一个引号、`\\`或`\n`的位置，没有则返回 end */
+extern const char *zy_findStringStop(const char *p, const char *end,
+                                     char quoteMark);
+/*
+ * 返回 [p, end) 中第一个不合法的 UTF-8 序列的起始位置，全部合法则
+ * 返回 end。结尾被截断的序列也算不合法。
+ */
+extern const char *zy_findInvalidUtf8(const char *p, const char *end);
+/*
+ * 把 [p, end) 中每个`\n`之后的位置（相对 src 的偏移量）依次写入
+ * out，返回写入的个数。out 至少要能放下 end - p 个元素。
+ */
+extern size_t zy_collectLineStarts(const char *src, const char *p,
+                                   const char *end, uint32_t *out);
@@ -0,0 +1,114 @@
+#include <errno.h>
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "scanner.h"
+#include "stream.h"
+
+/*
+ * 扫描一个 token 时最多会越过它的结尾看这么多个字节（运算符的
+ * 最长匹配、三引号的判断等）。token 结束得离缓冲区末尾这么近，
+ * 说明它可能被缓冲区截断了，要读入更多内容后重新扫描。
+ */
+#define STREAM_LOOKAHEAD 8
+
+void zy_openStream(ZyStream *stream, int fd) {
+  stream->fd = fd;
+  stream->capacity = ZY_STREAM_CHUNK;
+  stream->buffer = (char *)malloc(stream->capacity);
+  if (stream->buffer == NULL) {
+    fprintf(stderr, "Not enough memory for the input buffer.");
+    exit(1);
+  }
+  stream->consumed = 0;
+  stream->eof = 0;
+  stream->error = 0;
+  stream->onWait = NULL;
+  stream->waitContext = NULL;
+  /* 缓冲区里还没有内容，不能把它传给 zy_initScanner，直接设指针 */
+  stream->scanner = zy_initScanner("", "");
+  stream->scanner.start = stream->scanner.cur = stream->scanner.end =
+      stream->scanner.utf8End = stream->buffer;
+}
+
+void zy_closeStream(ZyStream *stream) {
+  free(stream->buffer);
+  stream->buffer = NULL;
+  stream->capacity = 0;
+}
+
+/* 马上读会阻塞时先告诉调用方，让它把攒着的输出写出去 */
+static void notifyWait(ZyStream *stream) {
+  if (stream->onWait == NULL)
+    return;
+  struct pollfd ready = {stream->fd, POLLIN, 0};
+  if (poll(&ready, 1, 0) == 0)
+    stream->onWait(stream->waitContext);
+}
+
+/*
+ * 在 resume 之后读入新内容，resume 中的指针随之更新。新内容接着
+ * 写在缓冲区末尾；末尾的空间不到四分之一时，要保留的内容（从
+ * resume 开始）不多就把它移到缓冲区开头，否则把缓冲区扩大一倍，
+ * 这样每个字节平均只移动常数次。读到的内容够看 STREAM_LOOKAHEAD
+ * 个字节就返回，不等缓冲区读满，慢慢产出代码的管道也能马上扫描。
+ */
+static void refill(ZyStream *stream, ZyScanner *resume) {
+  size_t offset = (size_t)(resume->cur - stream->buffer);
+  size_t length = (size_t)(resume->end - stream->buffer);
+  if (stream->capacity - length < stream->capacity / 4) {
+    if (length - offset <= stream->capacity / 4) {
+      memmove(stream->buffer, stream->buffer + offset, length - offset);
+      stream->consumed += offset;
+      length -= offset;
+      offset = 0;
+    } else {
+      stream->capacity *= 2;
+      stream->buffer = (char *)realloc(stream->buffer, stream->capacity);
+      if (stream->buffer == NULL) {
+        fprintf(stderr, "Not enough memory for the input buffer.");
+        exit(1);
+      }
+    }
+  }
+
+  while (length < stream->capacity) {
+    notifyWait(stream);
+    ssize_t n = read(stream->fd, stream->buffer + length,
+                     stream->capacity - length);
+    if (n < 0 && errno == EINTR)
+      continue;
+    if (n < 0)
+      stream->error = errno;
+    if (n <= 0) {
+      stream->eof = 1;
+      break;
+    }
+    length += (size_t)n;
+    if (length - offset > STREAM_LOOKAHEAD)
+      break;
+  }
+
+  resume->start = resume->cur = resume->utf8End = stream->buffer + offset;
+  resume->end = stream->buffer + length;
+}
+
+ZyToken zy_streamToken(ZyStream *stream) {
+  if (stream->scanner.hasUnget)
+    return zy_scanToken(&stream->scanner);
+
+  while (1) {
+    ZyScanner resume = zy_tellScanner(&stream->scanner);
+    ZyToken t = zy_scanToken(&stream->scanner);
+    if (stream->eof ||
+        stream->scanner.end - stream->scanner.cur >= STREAM_LOOKAHEAD)
+      return t;
+
+    /* token 可能被缓冲区截断了：读入更多内容，从 token 之前重新扫描 */
+    refill(stream, &resume);
+    zy_rewindScanner(&stream->scanner, resume);
+  }
+}
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "scanner.h"
+
+/* 第一次分配的缓冲区大小，之后按需要翻倍 */
+#ifndef ZY_STREAM_CHUNK
+#define ZY_STREAM_CHUNK ((size_t)64 << 10)
+#endif
+
+/**
+ * @brief A scanner that pulls its input from a file descriptor.
+ *
+ * Only the token being scanned and the bytes read after it are
+ * kept in memory, so pipes and files of any size can be lexed in
+ * bounded space. Tokens point
+ * into the buffer and stay valid until the next call to
+ * @ref zy_streamToken.
+ */
+typedef struct {
+  int fd;
+  char *buffer;
+  size_t capacity;
+  uint64_t consumed; /**< @brief Input bytes dropped from before `buffer`. */
+  int eof;   /**< @brief Nothing more to read from `fd`. */
+  int error; /**< @brief errno of a failed read, 0 otherwise. */
+  /**
+   * @brief Called before a read that would block, or NULL.
+   *
+   * Lets a caller with buffered output hand it on while the producer
+   * is still writing.
+   */
+  void (*onWait)(void *context);
+  void *waitContext;
+  ZyScanner scanner;
+} ZyStream;
+
+extern void zy_openStream(ZyStream *stream, int fd);
+extern void zy_closeStream(ZyStream *stream);
+extern ZyToken zy_streamToken(ZyStream *stream);
@@ -0,0 +1,128 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "arena.h"
+#include "symbols.h"
+
+static void *allocTable(size_t size) {
+  void *table = calloc(1, size);
+  if (table == NULL) {
+    fprintf(stderr, "Not enough memory to grow the symbol table.");
+    exit(1);
+  }
+  return table;
+}
+
+void zy_initSymbolTable(ZySymbolTable *table) {
+  zy_initArena(&table->arena);
+  table->capacity = 256;
+  table->symbols = (ZySymbol *)allocTable(sizeof(ZySymbol) * table->capacity);
+  table->count = 1;
+  table->mask = 511;
+  table->slots = (uint64_t *)allocTable(sizeof(uint64_t) * (table->mask + 1));
+}
+
+void zy_freeSymbolTable(ZySymbolTable *table) {
+  zy_freeArena(&table->arena);
+  free(table->symbols);
+  free(table->slots);
+  table->symbols = NULL;
+  table->slots = NULL;
+  table->count = table->capacity = table->mask = 0;
+}
+
+static inline uint64_t load64(const char *p) {
+  uint64_t v;
+  memcpy(&v, p, 8);
+  return v;
+}
+
+static inline uint64_t load32(const char *p) {
+  uint32_t v;
+  memcpy(&v, p, 4);
+  return v;
+}
+
+/*
+ * 每次处理 8 个字节的乘法散列。结尾不足 8 个字节时用两次
+ * 可能重叠的定长读取代替逐字节拼接，名字一般都很短。
+ */
+static inline uint32_t hashBytes(const char *text, size_t length) {
+  uint64_t h = UINT64_C(0x9e3779b97f4a7c15) ^ length;
+  uint64_t word;
+  if (length >= 8) {
+    const char *last = text + length - 8;
+    for (; text < last; text += 8) {
+      h = (h ^ load64(text)) * UINT64_C(0xbf58476d1ce4e5b9);
+      h ^= h >> 31;
+    }
+    word = load64(last);
+  } else if (length >= 4) {
+    word = load32(text) | load32(text + length - 4) << 32;
+  } else if (length > 0) {
+    word = (uint64_t)(unsigned char)text[0] |
+           (uint64_t)(unsigned char)text[length / 2] << 8 |
+           (uint64_t)(unsigned char)text[length - 1] << 16;
+  } else {
+    word = 0;
+  }
+  h = (h ^ word) * UINT64_C(0x94d049bb133111eb);
+  h ^= h >> 29;
+  return (uint32_t)(h ^ (h >> 32));
+}
+
+static inline uint64_t makeSlot(uint32_t hash, uint32_t id) {
+  return (uint64_t)hash << 32 | id;
+}
+
+static void growSlots(ZySymbolTable *table) {
+  uint32_t mask = table->mask * 2 + 1;
+  uint64_t *slots = (uint64_t *)allocTable(sizeof(uint64_t) * (mask + 1));
+  for (uint32_t id = 1; id < table->count; id++) {
+    uint32_t hash = table->symbols[id].hash;
+    uint32_t i = hash & mask;
+    while (slots[i] != 0)
+      i = (i + 1) & mask;
+    slots[i] = makeSlot(hash, id);
+  }
+  free(table->slots);
+  table->slots = slots;
+  table->mask = mask;
+}
+
+uint32_t zy_intern(ZySymbolTable *table, const char *text, size_t length) {
+  uint32_t hash = hashBytes(text, length);
+  uint32_t i = hash & table->mask;
+  for (uint64_t slot; (slot = table->slots[i]) != 0;
+       i = (i + 1) & table->mask) {
+    if ((uint32_t)(slot >> 32) != hash)
+      continue;
+    const ZySymbol *symbol = &table->symbols[(uint32_t)slot];
+    if (symbol->length == length && memcmp(symbol->name, text, length) == 0)
+      return (uint32_t)slot;
+  }
+
+  if (table->count == table->capacity) {
+    table->capacity *= 2;
+    table->symbols = (ZySymbol *)realloc(table->symbols,
+                                         sizeof(ZySymbol) * table->capacity);
+    if (table->symbols == NULL) {
+      fprintf(stderr, "Not enough memory to grow the symbol table.");
+      exit(1);
+    }
+  }
+  char *name = (char *)zy_arenaAlloc(&table->arena, length + 1);
+  memcpy(name, text, length);
+  name[length] = '\0';
+
+  uint32_t id = table->count++;
+  table->symbols[id].name = name;
+  table->symbols[id].length = (uint32_t)length;
+  table->symbols[id].hash = hash;
+  table->slots[i] = makeSlot(hash, id);
+  /* 装载因子超过一半就扩容 */
+  if ((size_t)table->count * 2 > (size_t)table->mask + 1)
+    growSlots(table);
+  return id;
+}
@@ -0,0 +1,46 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "arena.h"
+
+/* 0 不是任何符号 */
+#define ZY_NO_SYMBOL 0
+
+/**
+ * @brief Interned name: the bytes live in the table's arena.
+ */
+typedef struct {
+  const char *name; /**< @brief NUL-terminated copy of the text. */
+  uint32_t length;
+  uint32_t hash;
+} ZySymbol;
+
+/**
+ * @brief Maps names to dense 32-bit IDs.
+ *
+ * Equal byte strings always get the same ID, so names can be
+ * compared as integers once interned. IDs start at 1 and index
+ * `symbols`; the hash table is open addressing with linear probing
+ * over a power-of-two number of slots. Each slot keeps the hash next
+ * to the ID so a probe only touches the name on a likely match.
+ */
+typedef struct {
+  ZyArena arena;
+  ZySymbol *symbols; /**< @brief symbols[id]; entry 0 is unused. */
+  uint32_t count;    /**< @brief Number of IDs handed out, plus one. */
+  uint32_t capacity;
+  uint64_t *slots; /**< @brief Hash << 32 | ID, 0 when empty. */
+  uint32_t mask;   /**< @brief Number of slots minus one. */
+} ZySymbolTable;
+
+extern void zy_initSymbolTable(ZySymbolTable *table);
+extern void zy_freeSymbolTable(ZySymbolTable *table);
+extern uint32_t zy_intern(ZySymbolTable *table, const char *text,
+                          size_t length);
+
+static inline const ZySymbol *zy_symbol(const ZySymbolTable *table,
+                                        uint32_t id) {
+  return &table->symbols[id];
+}
@@ -0,0 +1,435 @@
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "layout.h"
+#include "scanner.h"
+#include "simd.h"
+#include "tokens.h"
+
+static inline size_t bufferGrowCapacity(size_t capacity) {
+  return capacity < 256 ? 256 : capacity * 2;
+}
+
+static void *growArray(void *array, size_t elementSize, size_t capacity) {
+  void *grown = realloc(array, elementSize * capacity);
+  if (grown == NULL) {
+    fprintf(stderr, "Not enough memory to grow the token buffer.");
+    exit(1);
+  }
+  return grown;
+}
+
+void zy_initTokenBuffer(ZyTokenBuffer *buffer, const char *src,
+                        const char *end) {
+  buffer->src = src;
+  buffer->end = end;
+  buffer->count = 0;
+  buffer->capacity = 0;
+  buffer->types = NULL;
+  buffer->offsets = NULL;
+  buffer->lengths = NULL;
+  buffer->errors = NULL;
+  buffer->errorCount = 0;
+  buffer->errorCapacity = 0;
+  buffer->lines.starts = NULL;
+  buffer->lines.count = 0;
+}
+
+void zy_freeTokenBuffer(ZyTokenBuffer *buffer) {
+  free(buffer->types);
+  free(buffer->offsets);
+  free(buffer->lengths);
+  free(buffer->errors);
+  zy_freeLineIndex(&buffer->lines);
+  zy_initTokenBuffer(buffer, NULL, NULL);
+}
+
+static void reserveTokens(ZyTokenBuffer *buffer, size_t capacity) {
+  if (capacity <= buffer->capacity)
+    return;
+  buffer->types =
+      (uint8_t *)growArray(buffer->types, sizeof(uint8_t), capacity);
+  buffer->offsets =
+      (uint32_t *)growArray(buffer->offsets, sizeof(uint32_t), capacity);
+  buffer->lengths =
+      (uint32_t *)growArray(buffer->lengths, sizeof(uint32_t), capacity);
+  buffer->capacity = capacity;
+}
+
+static void pushError(ZyTokenBuffer *buffer, uint32_t index,
+                      uint32_t error) {
+  if (buffer->errorCount == buffer->errorCapacity) {
+    buffer->errorCapacity = buffer->errorCapacity < 8
+                                ? 8
+                                : buffer->errorCapacity * 2;
+    buffer->errors = (ZyTokenError *)growArray(
+        buffer->errors, sizeof(ZyTokenError), buffer->errorCapacity);
+  }
+  buffer->errors[buffer->errorCount].index = index;
+  buffer->errors[buffer->errorCount].error = error;
+  buffer->errorCount++;
+}
+
+static inline void pushToken(ZyTokenBuffer *buffer, const ZyScanner *scanner,
+                             ZyToken t) {
+  if (buffer->count == buffer->capacity)
+    reserveTokens(buffer, bufferGrowCapacity(buffer->capacity));
+
+  size_t i = buffer->count++;
+  buffer->types[i] = (uint8_t)t.type;
+  buffer->offsets[i] = (uint32_t)(scanner->start - buffer->src);
+  buffer->lengths[i] = (uint32_t)(scanner->cur - scanner->start);
+  if (t.type == TOKEN_ERROR)
+    pushError(buffer, (uint32_t)i, t.symbol);
+}
+
+/**
+ * @brief Where a range scan stopped.
+ *
+ * Scanning resumes at `cur` with the given start-of-line flag; this
+ * is all the scanner state that carries from one token to the next.
+ */
+typedef struct {
+  const char *cur;
+  int startOfLine;
+} ResumePoint;
+
+/*
+ * 扫描 token 并追加到 buffer，直到遇到 EOF，或者（stopAt 不为 NULL 时）
+ * 遇到第一个起始位置不小于 stopAt 的 token，这个 token 不会被追加。
+ */
+static ResumePoint scanRange(ZyScanner *scanner, const char *stopAt,
+                             ZyTokenBuffer *buffer) {
+  ResumePoint resume;
+  while (1) {
+    resume.cur = scanner->cur;
+    resume.startOfLine = scanner->startOfLine;
+    ZyToken t = zy_scanToken(scanner);
+    if (stopAt != NULL && scanner->start >= stopAt)
+      return resume;
+    pushToken(buffer, scanner, t);
+    if (t.type == TOKEN_EOF) {
+      resume.cur = NULL;
+      return resume;
+    }
+  }
+}
+
+int zy_scanTokens(const char *begin, const char *end,
+                  ZyTokenBuffer *buffer) {
+  /* 偏移量只有 32 位 */
+  if ((size_t)(end - begin) > UINT32_MAX)
+    return 0;
+
+  ZyScanner scanner = zy_initScanner(begin, end);
+  zy_initTokenBuffer(buffer, begin, end);
+  /* 粗略估计每 4 个字节一个 token，避免反复扩容 */
+  reserveTokens(buffer, (size_t)(end - begin) / 4 + 16);
+  scanRange(&scanner, NULL, buffer);
+  return 1;
+}
+
+/* 整理过缩进的 token：补上的 EOL、INDENT 和 DEDENT 长度为 0 */
+static inline void pushLaidOut(ZyTokenBuffer *buffer, ZyToken t) {
+  if (buffer->count == buffer->capacity)
+    reserveTokens(buffer, bufferGrowCapacity(buffer->capacity));
+
+  size_t i = buffer->count++;
+  buffer->types[i] = (uint8_t)t.type;
+  buffer->offsets[i] = (uint32_t)(t.start - buffer->src);
+  buffer->lengths[i] = (uint32_t)t.length;
+  if (t.type == TOKEN_ERROR)
+    pushError(buffer, (uint32_t)i, t.symbol);
+}
+
+/*
+ * 与 zy_scanTokens 相同，但 token 先经过 ZyLayout：结果里没有
+ * RETRY 和 INDENTATION，有 INDENT、DEDENT，最后一个是 EOF。
+ */
+int zy_scanLayoutTokens(const char *begin, const char *end,
+                        ZyTokenBuffer *buffer) {
+  if ((size_t)(end - begin) > UINT32_MAX)
+    return 0;
+
+  ZyScanner scanner = zy_initScanner(begin, end);
+  ZyLayout layout;
+  zy_initLayout(&layout);
+  zy_initTokenBuffer(buffer, begin, end);
+  reserveTokens(buffer, (size_t)(end - begin) / 4 + 16);
+  while (1) {
+    ZyToken t = zy_layoutToken(&layout, &scanner);
+    pushLaidOut(buffer, t);
+    if (t.type == TOKEN_EOF)
+      return 1;
+  }
+}
+
+/**
+ * @brief One slice of a parallel scan.
+ *
+ * The worker lexes from `begin`, assuming it is the start of a line,
+ * and stops at the first token that starts at or after `end`. Tokens
+ * may run past `end` (a triple-quoted string, for instance); the
+ * merge step checks whether the guess about `begin` was right.
+ */
+typedef struct {
+  const char *src;
+  const char *srcEnd;
+  const char *begin;
+  const char *end; /**< @brief NULL for the last chunk. */
+  ZyTokenBuffer tokens;
+  ResumePoint resume;
+} ScanChunk;
+
+static void *scanChunk(void *arg) {
+  ScanChunk *chunk = (ScanChunk *)arg;
+  ZyScanner scanner = zy_initScanner(chunk->begin, chunk->srcEnd);
+  zy_initTokenBuffer(&chunk->tokens, chunk->src, chunk->srcEnd);
+  reserveTokens(&chunk->tokens,
+                (size_t)((chunk->end ? chunk->end : chunk->srcEnd) -
+                         chunk->begin) / 4 + 16);
+  chunk->resume = scanRange(&scanner, chunk->end, &chunk->tokens);
+  return NULL;
+}
+
+static void appendTokens(ZyTokenBuffer *to, const ZyTokenBuffer *from) {
+  reserveTokens(to, to->count + from->count);
+  memcpy(to->types + to->count, from->types, from->count * sizeof(uint8_t));
+  memcpy(to->offsets + to->count, from->offsets,
+         from->count * sizeof(uint32_t));
+  memcpy(to->lengths + to->count, from->lengths,
+         from->count * sizeof(uint32_t));
+  for (size_t i = 0; i < from->errorCount; i++)
+    pushError(to, (uint32_t)(to->count + from->errors[i].index),
+              from->errors[i].error);
+  to->count += from->count;
+}
+
+int zy_scanTokensParallel(const char *begin, const char *end, int numThreads,
+                          ZyTokenBuffer *buffer) {
+  size_t length = (size_t)(end - begin);
+  if (numThreads > ZY_MAX_SCAN_THREADS)
+    numThreads = ZY_MAX_SCAN_THREADS;
+  if ((size_t)numThreads > length / ZY_MIN_SCAN_CHUNK)
+    numThreads = (int)(length / ZY_MIN_SCAN_CHUNK);
+  if (numThreads <= 1 || length > UINT32_MAX)
+    return zy_scanTokens(begin, end, buffer);
+
+  /* 在行边界处切分 */
+  ScanChunk chunks[ZY_MAX_SCAN_THREADS];
+  int numChunks = 0;
+  const char *chunkBegin = begin;
+  for (int i = 1; i <= numThreads; i++) {
+    const char *chunkEnd = NULL;
+    if (i < numThreads) {
+      const char *newline = zy_findNewline(begin + length / numThreads * i, end);
+      if (newline + 1 >= end)
+        i = numThreads;
+      else
+        chunkEnd = newline + 1;
+    }
+    if (chunkEnd != NULL && chunkEnd <= chunkBegin)
+      continue;
+    ScanChunk *chunk = &chunks[numChunks++];
+    chunk->src = begin;
+    chunk->srcEnd = end;
+    chunk->begin = chunkBegin;
+    chunk->end = chunkEnd;
+    chunkBegin = chunkEnd;
+  }
+
+  pthread_t threads[ZY_MAX_SCAN_THREADS];
+  for (int i = 1; i < numChunks; i++) {
+    if (pthread_create(&threads[i], NULL, scanChunk, &chunks[i]) != 0) {
+      fprintf(stderr, "Failed to start a scanner thread.");
+      exit(1);
+    }
+  }
+  scanChunk(&chunks[0]);
+
+  /* 第一块的结果直接作为输出，后面的块追加在它后面 */
+  *buffer = chunks[0].tokens;
+  ResumePoint resume = chunks[0].resume;
+  for (int i = 1; i < numChunks; i++) {
+    pthread_join(threads[i], NULL);
+    ScanChunk *chunk = &chunks[i];
+    if (resume.cur == chunk->begin && resume.startOfLine) {
+      /* 猜对了：前一块恰好在行首结束 */
+      appendTokens(buffer, &chunk->tokens);
+      resume = chunk->resume;
+    } else if (resume.cur != NULL) {
+      /*
+       * 前一块的最后一个 token 越过了边界（比如跨行的三引号字符串
+       * 或者续行符），这一块的结果作废，从真正的位置串行重新扫描。
+       */
+      ZyScanner scanner = zy_initScanner(resume.cur, end);
+      scanner.startOfLine = resume.startOfLine;
+      resume = scanRange(&scanner, chunk->end, buffer);
+    }
+    zy_freeTokenBuffer(&chunk->tokens);
+  }
+  return 1;
+}
+
+/*
+ * 找到 offset 之前最后一个安全的重启点：某个 EOL 之后的位置。
+ * 扫描器在那里的状态只有“位于行首”，而且 EOL 之前的 token
+ * 都不会读到换行符之后的字节，所以 edit 不会影响它们。
+ * 返回重启点之前保留的 token 个数。
+ */
+static size_t restartIndex(const ZyTokenBuffer *buffer, uint32_t offset) {
+  size_t lo = 0, hi = buffer->count;
+  while (lo < hi) {
+    size_t mid = lo + (hi - lo) / 2;
+    if (buffer->offsets[mid] < offset)
+      lo = mid + 1;
+    else
+      hi = mid;
+  }
+  while (lo > 0 && zy_tokenType(buffer, lo - 1) != TOKEN_EOL)
+    lo--;
+  return lo;
+}
+
+/*
+ * 用 fresh 替换 buffer 中 [from, to) 的 token，to 之后的 token
+ * 偏移量加上 delta。错误表按新的下标重建。
+ */
+static void spliceTokens(ZyTokenBuffer *buffer, size_t from, size_t to,
+                         const ZyTokenBuffer *fresh, int64_t delta) {
+  size_t tail = buffer->count - to;
+  size_t count = from + fresh->count + tail;
+  reserveTokens(buffer, count);
+
+  size_t moved = from + fresh->count;
+  memmove(buffer->types + moved, buffer->types + to, tail * sizeof(uint8_t));
+  memmove(buffer->offsets + moved, buffer->offsets + to,
+          tail * sizeof(uint32_t));
+  memmove(buffer->lengths + moved, buffer->lengths + to,
+          tail * sizeof(uint32_t));
+  for (size_t i = moved; i < count; i++)
+    buffer->offsets[i] = (uint32_t)(buffer->offsets[i] + delta);
+
+  memcpy(buffer->types + from, fresh->types, fresh->count * sizeof(uint8_t));
+  memcpy(buffer->offsets + from, fresh->offsets,
+         fresh->count * sizeof(uint32_t));
+  memcpy(buffer->lengths + from, fresh->lengths,
+         fresh->count * sizeof(uint32_t));
+
+  ZyTokenError *errors = buffer->errors;
+  size_t errorCount = buffer->errorCount;
+  buffer->errors = NULL;
+  buffer->errorCount = buffer->errorCapacity = 0;
+  size_t e = 0;
+  for (; e < errorCount && errors[e].index < from; e++)
+    pushError(buffer, errors[e].index, errors[e].error);
+  for (size_t i = 0; i < fresh->errorCount; i++)
+    pushError(buffer, (uint32_t)(from + fresh->errors[i].index),
+              fresh->errors[i].error);
+  for (; e < errorCount; e++) {
+    if (errors[e].index >= to)
+      pushError(buffer, (uint32_t)(errors[e].index - to + moved),
+                errors[e].error);
+  }
+  free(errors);
+  buffer->count = count;
+}
+
+/**
+ * @brief Update a token table after an edit instead of rescanning.
+ *
+ * `buffer` holds the tokens of the source before the edit, and
+ * [begin, end) is the source after it. Scanning restarts at the last
+ * line end before the edit and stops as soon as it reaches, past the
+ * edited bytes, a line end that the old table also had: from there
+ * on the old tokens are still right and are only shifted. The old
+ * source is never read, so the caller may edit it in place.
+ *
+ * Returns 0, leaving the buffer untouched, if the edit does not fit
+ * the buffer or the new source is too large.
+ */
+int zy_relexTokens(ZyTokenBuffer *buffer, const char *begin, const char *end,
+                   ZyEdit edit) {
+  size_t oldLength = (size_t)(buffer->end - buffer->src);
+  size_t newLength = (size_t)(end - begin);
+  if ((size_t)edit.offset + edit.removed > oldLength ||
+      newLength != oldLength - edit.removed + edit.inserted ||
+      newLength > UINT32_MAX)
+    return 0;
+
+  int64_t delta = (int64_t)edit.inserted - (int64_t)edit.removed;
+  size_t from = restartIndex(buffer, edit.offset);
+  uint32_t restart = from == 0 ? 0 : buffer->offsets[from - 1] + 1;
+  size_t editEnd = (size_t)edit.offset + edit.inserted;
+
+  ZyScanner scanner = zy_initScanner(begin + restart, end);
+  ZyTokenBuffer fresh;
+  zy_initTokenBuffer(&fresh, begin, end);
+  size_t to = buffer->count;
+  size_t old = from;
+  while (1) {
+    ZyToken t = zy_scanToken(&scanner);
+    pushToken(&fresh, &scanner, t);
+    if (t.type == TOKEN_EOF)
+      break;
+    if (t.type != TOKEN_EOL || (size_t)(scanner.cur - begin) < editEnd)
+      continue;
+
+    /* 新旧两边在同一个行尾之后处于相同状态，剩下的 token 不变 */
+    int64_t oldEnd = (int64_t)(scanner.cur - begin) - delta;
+    while (old < buffer->count &&
+           (int64_t)buffer->offsets[old] + buffer->lengths[old] < oldEnd)
+      old++;
+    if (old < buffer->count && zy_tokenType(buffer, old) == TOKEN_EOL &&
+        (int64_t)buffer->offsets[old] + 1 == oldEnd) {
+      to = old + 1;
+      break;
+    }
+  }
+
+  spliceTokens(buffer, from, to, &fresh, delta);
+  zy_freeTokenBuffer(&fresh);
+  if (buffer->lines.starts != NULL)
+    zy_editLineIndex(&buffer->lines, begin, edit.offset, edit.removed,
+                     edit.inserted);
+  buffer->src = begin;
+  buffer->end = end;
+  return 1;
+}
+
+static uint32_t errorOf(const ZyTokenBuffer *buffer, size_t index) {
+  size_t lo = 0, hi = buffer->errorCount;
+  while (lo < hi) {
+    size_t mid = lo + (hi - lo) / 2;
+    if (buffer->errors[mid].index < index)
+      lo = mid + 1;
+    else
+      hi = mid;
+  }
+  return buffer->errors[lo].error;
+}
+
+ZyToken zy_tokenAt(const ZyTokenBuffer *buffer, size_t index) {
+  ZyToken t = {};
+  t.type = zy_tokenType(buffer, index);
+  t.start = buffer->src + buffer->offsets[index];
+  t.length = buffer->lengths[index];
+  if (t.type == TOKEN_EOL) {
+    t.length = 0;
+  } else if (t.type == TOKEN_INDENTATION && *t.start == '\t') {
+    /* 与 makeIndentation 一致：制表符按 8 列计 */
+    t.length *= 8;
+  } else if (t.type == TOKEN_ERROR) {
+    t.symbol = errorOf(buffer, index);
+  }
+  return t;
+}
+
+/* 行列号只在需要时才计算，行索引在第一次用到时建立 */
+ZyPosition zy_tokenPosition(ZyTokenBuffer *buffer, size_t index) {
+  if (buffer->lines.starts == NULL)
+    zy_initLineIndex(&buffer->lines, buffer->src, buffer->end);
+  return zy_positionOf(&buffer->lines, buffer->offsets[index]);
+}
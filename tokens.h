@@ -0,0 +1,72 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "scanner.h"
+
+/* 并行扫描最多使用的线程数 */
+#define ZY_MAX_SCAN_THREADS 64
+/* 每个线程至少要分到这么多字节，否则不值得切分 */
+#ifndef ZY_MIN_SCAN_CHUNK
+#define ZY_MIN_SCAN_CHUNK ((size_t)1 << 20)
+#endif
+
+/**
+ * @brief Reason attached to a TOKEN_ERROR entry of a @ref ZyTokenBuffer.
+ */
+typedef struct {
+  uint32_t index; /**< @brief Index of the error token. */
+  uint32_t error; /**< @brief @ref ZyScanError reported by the scanner. */
+} ZyTokenError;
+
+/**
+ * @brief A whole source buffer lexed into a compact token table.
+ *
+ * Tokens are stored as a struct of arrays: one byte of type, plus
+ * the offset and the number of source bytes the token covers.
+ * That is 9 bytes per token instead of a 24-byte @ref ZyToken;
+ * @ref zy_tokenAt rebuilds the full token when one is needed.
+ */
+typedef struct {
+  const char *src; /**< @brief Source that offsets are relative to. */
+  const char *end; /**< @brief End of the source, exclusive. */
+  size_t count;
+  size_t capacity;
+  uint8_t *types;    /**< @brief @ref ZyTokenType of each token. */
+  uint32_t *offsets; /**< @brief Offset of the first byte of each token. */
+  uint32_t *lengths; /**< @brief Source bytes covered by each token. */
+  ZyTokenError *errors;
+  size_t errorCount;
+  size_t errorCapacity;
+  ZyLineIndex lines; /**< @brief Built the first time a position is needed. */
+} ZyTokenBuffer;
+
+/**
+ * @brief One text edit: `removed` bytes at `offset` were replaced by
+ * `inserted` new bytes.
+ */
+typedef struct {
+  uint32_t offset;
+  uint32_t removed;
+  uint32_t inserted;
+} ZyEdit;
+
+extern void zy_initTokenBuffer(ZyTokenBuffer *buffer, const char *src,
+                               const char *end);
+extern void zy_freeTokenBuffer(ZyTokenBuffer *buffer);
+extern int zy_scanTokens(const char *begin, const char *end,
+                         ZyTokenBuffer *buffer);
+extern int zy_scanLayoutTokens(const char *begin, const char *end,
+                               ZyTokenBuffer *buffer);
+extern int zy_scanTokensParallel(const char *begin, const char *end,
+                                 int numThreads, ZyTokenBuffer *buffer);
+extern int zy_relexTokens(ZyTokenBuffer *buffer, const char *begin,
+                          const char *end, ZyEdit edit);
+extern ZyToken zy_tokenAt(const ZyTokenBuffer *buffer, size_t index);
+extern ZyPosition zy_tokenPosition(ZyTokenBuffer *buffer, size_t index);
+
+static inline ZyTokenType zy_tokenType(const ZyTokenBuffer *buffer,
+                                       size_t index) {
+  return (ZyTokenType)buffer->types[index];
+}
@@ -0,0 +1,65 @@
+#!/usr/bin/env python3
+"""
+生成 scanner.c 中的关键字完美哈希表。
+
+每个关键字（2 到 8 个字节）按小端序装入一个 uint64_t，高位补零，
+然后用 (key * MULTIPLIER) >> (64 - BITS) 映射到 2^BITS 个槽位之一。
+这里搜索一个让所有关键字都落在不同槽位的乘数，
+这样查找只需要一次乘法、一次访存和一次比较。
+
+用法: python3 tools/gen_keywords.py > keywords.inc 然后替换 scanner.c 中的表
+"""
+import random
+
+KEYWORDS = [
+    ("and", "TOKEN_AND"), ("class", "TOKEN_CLASS"), ("def", "TOKEN_DEF"),
+    ("del", "TOKEN_DEL"), ("else", "TOKEN_ELSE"), ("False", "TOKEN_FALSE"),
+    ("finally", "TOKEN_FINALLY"), ("for", "TOKEN_FOR"), ("if", "TOKEN_IF"),
+    ("import", "TOKEN_IMPORT"), ("in", "TOKEN_IN"), ("is", "TOKEN_IS"),
+    ("None", "TOKEN_NONE"), ("not", "TOKEN_NOT"), ("or", "TOKEN_OR"),
+    ("elif", "TOKEN_ELIF"), ("pass", "TOKEN_PASS"),
+    ("return", "TOKEN_RETURN"), ("super", "TOKEN_SUPER"),
+    ("True", "TOKEN_TRUE"), ("while", "TOKEN_WHILE"), ("try", "TOKEN_TRY"),
+    ("except", "TOKEN_EXCEPT"), ("raise", "TOKEN_RAISE"),
+    ("break", "TOKEN_BREAK"), ("continue", "TOKEN_CONTINUE"),
+    ("as", "TOKEN_AS"), ("from", "TOKEN_FROM"), ("lambda", "TOKEN_LAMBDA"),
+    ("assert", "TOKEN_ASSERT"), ("yield", "TOKEN_YIELD"),
+    ("async", "TOKEN_ASYNC"), ("await", "TOKEN_AWAIT"), ("with", "TOKEN_WITH"),
+    ("global", "TOKEN_GLOBAL"), ("nonlocal", "TOKEN_NONLOCAL"),
+]
+BITS = 6
+MASK64 = (1 << 64) - 1
+
+
+def key(word):
+    return int.from_bytes(word.encode().ljust(8, b"\0"), "little")
+
+
+def slots(multiplier):
+    return [((key(w) * multiplier) & MASK64) >> (64 - BITS) for w, _ in KEYWORDS]
+
+
+def main():
+    rng = random.Random(0)
+    while True:
+        multiplier = rng.getrandbits(64) | 1
+        s = slots(multiplier)
+        if len(set(s)) == len(s):
+            break
+    table = [None] * (1 << BITS)
+    for (word, token), slot in zip(KEYWORDS, s):
+        table[slot] = (word, token)
+    print("#define KEYWORD_HASH_BITS %d" % BITS)
+    print("#define KEYWORD_HASH_MULTIPLIER UINT64_C(0x%016x)" % multiplier)
+    print()
+    print("static const Keyword keywordTable[1 << KEYWORD_HASH_BITS] = {")
+    for slot, entry in enumerate(table):
+        if entry is not None:
+            word, token = entry
+            print("    [%d] = {UINT64_C(0x%016x), %s}, /* %s */"
+                  % (slot, key(word), token, word))
+    print("};")
+
+
+if __name__ == "__main__":
+    main()
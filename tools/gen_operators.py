@@ -0,0 +1,89 @@
+#!/usr/bin/env python3
+"""
+生成 scanner.c 中识别运算符的状态机。
+
+状态 0 是起始状态。opNext[state][opSymbol[c]] 给出读入字符 c 后的
+状态，0 表示无法继续；opAccept[state] 是停在该状态时得到的 token，
+OP_REJECT 表示这个状态本身不是完整的运算符（例如 `..`），
+此时要退回到上一个可以接受的状态。
+
+用法: python3 tools/gen_operators.py 然后替换 scanner.c 中的表
+"""
+
+OPERATORS = [
+    ("(", "TOKEN_LEFT_PAREN"), (")", "TOKEN_RIGHT_PAREN"),
+    ("{", "TOKEN_LEFT_BRACE"), ("}", "TOKEN_RIGHT_BRACE"),
+    ("[", "TOKEN_LEFT_SQUARE"), ("]", "TOKEN_RIGHT_SQUARE"),
+    (",", "TOKEN_COMMA"), (";", "TOKEN_SEMICOLON"), ("~", "TOKEN_TILDE"),
+    (".", "TOKEN_DOT"), ("...", "TOKEN_ELLIPSIS"),
+    (":", "TOKEN_COLON"), (":=", "TOKEN_WALRUS"),
+    ("^", "TOKEN_CARET"), ("^=", "TOKEN_CARET_EQUAL"),
+    ("<", "TOKEN_LESS"), ("<=", "TOKEN_LESS_EQUAL"),
+    ("<<", "TOKEN_LEFT_SHIFT"), ("<<=", "TOKEN_LSHIFT_EQUAL"),
+    (">", "TOKEN_GREATER"), (">=", "TOKEN_GREATER_EQUAL"),
+    (">>", "TOKEN_RIGHT_SHIFT"), (">>=", "TOKEN_RSHIFT_EQUAL"),
+    ("=", "TOKEN_EQUAL"), ("==", "TOKEN_EQUAL_EQUAL"),
+    ("!", "TOKEN_BANG"), ("!=", "TOKEN_BANG_EQUAL"),
+    ("|", "TOKEN_PIPE"), ("|=", "TOKEN_PIPE_EQUAL"),
+    ("&", "TOKEN_AMPERSAND"), ("&=", "TOKEN_AMP_EQUAL"),
+    # Python 没有 `--` 和 `++`，`a--b` 是 a - (-b)，要扫描成两个 token
+    ("-", "TOKEN_MINUS"), ("-=", "TOKEN_MINUS_EQUAL"), ("->", "TOKEN_ARROW"),
+    ("+", "TOKEN_PLUS"), ("+=", "TOKEN_PLUS_EQUAL"),
+    ("/", "TOKEN_SOLIDUS"), ("/=", "TOKEN_SOLIDUS_EQUAL"),
+    ("//", "TOKEN_DOUBLE_SOLIDUS"), ("//=", "TOKEN_DSOLIDUS_EQUAL"),
+    ("*", "TOKEN_ASTERISK"), ("*=", "TOKEN_ASTERISK_EQUAL"),
+    ("**", "TOKEN_POW"), ("**=", "TOKEN_POW_EQUAL"),
+    ("%", "TOKEN_MODULO"), ("%=", "TOKEN_MODULO_EQUAL"),
+    ("@", "TOKEN_AT"), ("@=", "TOKEN_AT_EQUAL"),
+]
+
+
+def c_char(ch):
+    return "'\\''" if ch == "'" else "'%s'" % ch
+
+
+def main():
+    symbols = []
+    for text, _ in OPERATORS:
+        for ch in text:
+            if ch not in symbols:
+                symbols.append(ch)
+    symbol_index = {ch: i + 1 for i, ch in enumerate(symbols)}
+
+    # 先建出前缀树，每个节点就是一个状态
+    prefixes = [""]
+    for text, _ in OPERATORS:
+        for i in range(1, len(text) + 1):
+            if text[:i] not in prefixes:
+                prefixes.append(text[:i])
+    state_of = {p: i for i, p in enumerate(prefixes)}
+    accept = {text: token for text, token in OPERATORS}
+
+    print("/* 由 tools/gen_operators.py 生成 */")
+    print("#define OP_NUM_SYMBOLS %d" % (len(symbols) + 1))
+    print("#define OP_NUM_STATES %d" % len(prefixes))
+    print("#define OP_REJECT 0xFF")
+    print()
+    print("static const uint8_t opSymbol[256] = {")
+    for ch in symbols:
+        print("    [%s] = %d," % (c_char(ch), symbol_index[ch]))
+    print("};")
+    print()
+    print("static const uint8_t opNext[OP_NUM_STATES][OP_NUM_SYMBOLS] = {")
+    for prefix in prefixes:
+        row = [0] * (len(symbols) + 1)
+        for ch in symbols:
+            if prefix + ch in state_of:
+                row[symbol_index[ch]] = state_of[prefix + ch]
+        print("    {%s}, /* %s */" % (", ".join(str(x) for x in row),
+                                      prefix.replace("*/", "* /") or "start"))
+    print("};")
+    print()
+    print("static const uint8_t opAccept[OP_NUM_STATES] = {")
+    for prefix in prefixes:
+        print("    %s," % accept.get(prefix, "OP_REJECT"))
+    print("};")
+
+
+if __name__ == "__main__":
+    main()
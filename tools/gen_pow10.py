@@ -0,0 +1,46 @@
+#!/usr/bin/env python3
+"""
+生成 literals.c 中 Eisel-Lemire 算法使用的 10 的幂次表。
+
+每一项是 10^e 的 128 位尾数（最高位为 1，向下取整），分成低 64 位
+和高 64 位两个 uint64_t。对应的二进制指数不存进表里，而是由
+(217706 * e) >> 16 ≈ floor(e * log2(10)) 算出，这里顺便检查这个
+近似在整个范围内都是精确的。
+
+用法: python3 tools/gen_pow10.py > pow10.inc 然后替换 literals.c 中的表
+"""
+
+MIN_EXP10 = -348
+MAX_EXP10 = 347
+
+
+def mantissa(e):
+    if e >= 0:
+        v = 10 ** e
+        shift = v.bit_length() - 128
+        m = v >> shift if shift > 0 else v << -shift
+        binary = v.bit_length() - 1
+    else:
+        v = 10 ** -e
+        k = 127 + v.bit_length()
+        m = (1 << k) // v
+        binary = 127 - k
+    assert (1 << 127) <= m < (1 << 128)
+    assert (217706 * e) >> 16 == binary, e
+    return m
+
+
+def main():
+    print("/* 由 tools/gen_pow10.py 生成 */")
+    print("#define POW10_MIN_EXP10 (%d)" % MIN_EXP10)
+    print("#define POW10_MAX_EXP10 %d" % MAX_EXP10)
+    print()
+    print("static const uint64_t pow10Mantissa[][2] = {")
+    for e in range(MIN_EXP10, MAX_EXP10 + 1):
+        m = mantissa(e)
+        print("    {0x%016X, 0x%016X}, /* 1e%d */" % (m & ((1 << 64) - 1), m >> 64, e))
+    print("};")
+
+
+if __name__ == "__main__":
+    main()
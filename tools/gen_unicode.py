@@ -0,0 +1,79 @@
+#!/usr/bin/env python3
+"""
+生成 unicode.c 中的 XID_Start / XID_Continue 两级查找表。
+
+码位按 256 个一块切分，每块是两张 256 位的位图（XID_Start 和
+XID_Continue 各一张，合起来正好 64 字节）。内容相同的块只存一份，
+第一级表记录每块对应的位图下标；超出第一级表范围的码位都不是
+标识符字符。
+
+属性取自运行这个脚本的 Python：ch.isidentifier() 就是 XID_Start
+（再加上`_`），('a' + ch).isidentifier() 就是 XID_Continue，
+所以结果与该版本 Python 的标识符规则一致（NFKC 规范化除外）。
+
+用法: python3 tools/gen_unicode.py > xid.inc 然后替换 unicode.c 中的表
+"""
+import unicodedata
+
+BLOCK_BITS = 8
+BLOCK = 1 << BLOCK_BITS
+
+
+def is_start(c):
+    return c != ord("_") and chr(c).isidentifier()
+
+
+def is_continue(c):
+    return ("a" + chr(c)).isidentifier()
+
+
+def bitmap(pred, base):
+    words = []
+    for w in range(BLOCK // 32):
+        word = 0
+        for b in range(32):
+            c = base + w * 32 + b
+            if not 0xD800 <= c < 0xE000 and pred(c):
+                word |= 1 << b
+        words.append(word)
+    return words
+
+
+def main():
+    blocks = []
+    for base in range(0, 0x110000, BLOCK):
+        blocks.append(tuple(bitmap(is_start, base) + bitmap(is_continue, base)))
+    last = max(i for i, b in enumerate(blocks) if any(b)) + 1
+
+    unique = {tuple([0] * (BLOCK // 16)): 0}
+    index = []
+    for b in blocks[:last]:
+        index.append(unique.setdefault(b, len(unique)))
+    assert len(unique) <= 256
+    # 每个 XID_Start 字符也是 XID_Continue
+    for b in unique:
+        for w in range(BLOCK // 32):
+            assert b[w] & ~b[BLOCK // 32 + w] == 0
+
+    print("/* 由 tools/gen_unicode.py 生成，Unicode %s */"
+          % unicodedata.unidata_version)
+    print("#define XID_BLOCK_BITS %d" % BLOCK_BITS)
+    print("#define XID_NUM_BLOCKS %d" % last)
+    print()
+    print("static const uint8_t xidIndex[XID_NUM_BLOCKS] = {")
+    for i in range(0, last, 16):
+        print("    " + " ".join("%d," % v for v in index[i:i + 16]))
+    print("};")
+    print()
+    print("/* [块][0] 是 XID_Start，[块][1] 是 XID_Continue */")
+    print("static const uint32_t xidBits[%d][2][%d] = {"
+          % (len(unique), BLOCK // 32))
+    for b in sorted(unique, key=unique.get):
+        half = BLOCK // 32
+        print("    {{%s}," % ", ".join("0x%08x" % w for w in b[:half]))
+        print("     {%s}}," % ", ".join("0x%08x" % w for w in b[half:]))
+    print("};")
+
+
+if __name__ == "__main__":
+    main()
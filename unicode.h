@@ -0,0 +1,56 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * 解码 [p, end) 开头的一个 UTF-8 字符，返回它占的字节数。
+ * 不合法（过长编码、代理区、超过 U+10FFFF 或者被截断）时返回 0。
+ */
+static inline size_t zy_decodeUtf8(const char *p, const char *end,
+                                   uint32_t *codePoint) {
+  const unsigned char *s = (const unsigned char *)p;
+  size_t available = (size_t)(end - p);
+  if (available == 0)
+    return 0;
+  if (s[0] < 0x80) {
+    *codePoint = s[0];
+    return 1;
+  }
+  if (s[0] < 0xC2)
+    return 0;
+  if (s[0] < 0xE0) {
+    if (available < 2 || (s[1] & 0xC0) != 0x80)
+      return 0;
+    *codePoint = (uint32_t)(s[0] & 0x1F) << 6 | (s[1] & 0x3F);
+    return 2;
+  }
+  if (s[0] < 0xF0) {
+    if (available < 3 || (s[1] & 0xC0) != 0x80 || (s[2] & 0xC0) != 0x80)
+      return 0;
+    uint32_t c = (uint32_t)(s[0] & 0x0F) << 12 | (uint32_t)(s[1] & 0x3F) << 6 |
+                 (s[2] & 0x3F);
+    if (c < 0x800 || (c >= 0xD800 && c < 0xE000))
+      return 0;
+    *codePoint = c;
+    return 3;
+  }
+  if (s[0] < 0xF5) {
+    if (available < 4 || (s[1] & 0xC0) != 0x80 || (s[2] & 0xC0) != 0x80 ||
+        (s[3] & 0xC0) != 0x80)
+      return 0;
+    uint32_t c = (uint32_t)(s[0] & 0x07) << 18 |
+                 (uint32_t)(s[1] & 0x3F) << 12 | (uint32_t)(s[2] & 0x3F) << 6 |
+                 (s[3] & 0x3F);
+    if (c < 0x10000 || c > 0x10FFFF)
+      return 0;
+    *codePoint = c;
+    return 4;
+  }
+  return 0;
+}
+
+/* 能否作为标识符的第一个字符（不含`_`），即 Unicode 的 XID_Start */
+extern int zy_isXidStart(uint32_t codePoint);
+/* 能否出现在标识符的后续位置，即 Unicode 的 XID_Continue */
+extern int zy_isXidContinue(uint32_t codePoint);
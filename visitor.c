@@ -0,0 +1,234 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "visitor.h"
+
+/* 这么深以内的栈放在 C 栈上，更深时换到堆上 */
+#define VISIT_STACK_INLINE 256
+
+/* 栈上的一层，指针树用 ast，扁平树用 node */
+typedef struct {
+  union {
+    Ast *ast;
+    uint32_t node;
+  };
+  uint32_t next;     /* 下一个要进入的子节点 */
+  uint32_t numChild; /* 要进入的子节点个数，跳过时是 0 */
+} VisitFrame;
+
+/* 两种遍历共用的栈，top 是栈顶那一层的深度 */
+typedef struct {
+  VisitFrame *frames;
+  int top;
+  int capacity;
+  VisitFrame inlineFrames[VISIT_STACK_INLINE];
+} VisitStack;
+
+static void initVisitStack(VisitStack *stack) {
+  stack->frames = stack->inlineFrames;
+  stack->top = -1;
+  stack->capacity = VISIT_STACK_INLINE;
+}
+
+static void freeVisitStack(VisitStack *stack) {
+  if (stack->frames != stack->inlineFrames)
+    free(stack->frames);
+}
+
+/* 栈满了：换到堆上，或者把堆上的栈扩大一倍 */
+static __attribute__((noinline)) void growVisitStack(VisitStack *stack) {
+  stack->capacity *= 2;
+  VisitFrame *grown =
+      stack->frames == stack->inlineFrames
+          ? (VisitFrame *)malloc(sizeof(VisitFrame) * stack->capacity)
+          : (VisitFrame *)realloc(stack->frames,
+                                  sizeof(VisitFrame) * stack->capacity);
+  if (grown == NULL) {
+    fprintf(stderr, "Not enough memory to grow the visitor stack.");
+    exit(1);
+  }
+  if (stack->frames == stack->inlineFrames)
+    memcpy(grown, stack->inlineFrames, sizeof(stack->inlineFrames));
+  stack->frames = grown;
+}
+
+/* 压入一层并返回它 */
+static inline VisitFrame *pushFrame(VisitStack *stack) {
+  if (stack->top + 1 == stack->capacity)
+    growVisitStack(stack);
+  VisitFrame *frame = &stack->frames[++stack->top];
+  frame->next = 0;
+  return frame;
+}
+
+/*
+ * 合并遍历时每个访问者自己的状态：skipDepth 是它跳过的节点的深度，
+ * 比它深的节点都不回调它，-1 表示没有跳过。
+ */
+typedef struct {
+  AstVisitor *visitor;
+  int skipDepth;
+  bool stopped;
+} VisitState;
+
+void astInitVisitor(AstVisitor *visitor, void *context) {
+  memset(visitor->enter, 0, sizeof(visitor->enter));
+  memset(visitor->leave, 0, sizeof(visitor->leave));
+  visitor->context = context;
+}
+
+/* 所有种类的节点都用同一对回调，之后可以再按种类覆盖 */
+void astVisitEvery(AstVisitor *visitor, AstVisitFn enter, AstVisitFn leave) {
+  for (int kind = 0; kind <= AST_KIND_ERROR; kind++) {
+    visitor->enter[kind] = enter;
+    visitor->leave[kind] = leave;
+  }
+}
+
+void astVisit(Ast *ast, AstVisitor *visitor) {
+  astVisitFused(ast, &visitor, 1);
+}
+
+/* 进入节点，返回还要进入它的子节点的访问者个数 */
+static int enterNode(Ast *ast, int depth, VisitState *states, int count,
+                     int *live) {
+  int descending = 0;
+  for (int i = 0; i < count; i++) {
+    VisitState *state = &states[i];
+    if (state->stopped || state->skipDepth >= 0)
+      continue;
+    AstVisitFn enter = state->visitor->enter[ast->kind];
+    AstVisitResult result =
+        enter == NULL ? AST_VISIT_CONTINUE
+                      : enter(ast, depth, state->visitor->context);
+    if (result == AST_VISIT_STOP) {
+      state->stopped = true;
+      (*live)--;
+    } else if (result == AST_VISIT_SKIP) {
+      state->skipDepth = depth;
+    } else {
+      descending++;
+    }
+  }
+  return descending;
+}
+
+static void leaveNode(Ast *ast, int depth, VisitState *states, int count,
+                      int *live) {
+  for (int i = 0; i < count; i++) {
+    VisitState *state = &states[i];
+    if (state->stopped || (state->skipDepth >= 0 && state->skipDepth < depth))
+      continue;
+    state->skipDepth = -1;
+    AstVisitFn leave = state->visitor->leave[ast->kind];
+    if (leave != NULL &&
+        leave(ast, depth, state->visitor->context) == AST_VISIT_STOP) {
+      state->stopped = true;
+      (*live)--;
+    }
+  }
+}
+
+/*
+ * 用一次遍历完成几个互不相干的访问：每个节点按顺序回调各个访问者，
+ * 顺序与分别调用 astVisit 时每个访问者看到的相同。用显式的栈，
+ * 再深的树也不会耗尽 C 栈；所有访问者都跳过的子树不会进入。
+ */
+void astVisitFused(Ast *ast, AstVisitor **visitors, int count) {
+  if (ast == NULL || count <= 0)
+    return;
+  if (count > AST_MAX_FUSED_VISITORS) {
+    fprintf(stderr, "Cannot fuse more than %d visitors.",
+            AST_MAX_FUSED_VISITORS);
+    exit(1);
+  }
+  VisitState states[AST_MAX_FUSED_VISITORS];
+  for (int i = 0; i < count; i++) {
+    states[i].visitor = visitors[i];
+    states[i].skipDepth = -1;
+    states[i].stopped = false;
+  }
+  int live = count;
+
+  VisitStack stack;
+  initVisitStack(&stack);
+  VisitFrame *root = pushFrame(&stack);
+  root->ast = ast;
+  root->numChild =
+      enterNode(ast, 0, states, count, &live) > 0 ? ast->children.count : 0;
+  while (stack.top >= 0 && live > 0) {
+    VisitFrame *frame = &stack.frames[stack.top];
+    if (frame->next < frame->numChild) {
+      Ast *child = frame->ast->children.elements[frame->next++];
+      if (child == NULL)
+        continue;
+      frame = pushFrame(&stack);
+      frame->ast = child;
+      frame->numChild =
+          enterNode(child, stack.top, states, count, &live) > 0
+              ? child->children.count
+              : 0;
+    } else {
+      leaveNode(frame->ast, stack.top, states, count, &live);
+      stack.top--;
+    }
+  }
+  freeVisitStack(&stack);
+}
+
+void astInitFlatVisitor(AstFlatVisitor *visitor, void *context) {
+  memset(visitor->enter, 0, sizeof(visitor->enter));
+  memset(visitor->leave, 0, sizeof(visitor->leave));
+  visitor->context = context;
+}
+
+void astVisitFlatEvery(AstFlatVisitor *visitor, AstFlatVisitFn enter,
+                       AstFlatVisitFn leave) {
+  for (int kind = 0; kind <= AST_KIND_ERROR; kind++) {
+    visitor->enter[kind] = enter;
+    visitor->leave[kind] = leave;
+  }
+}
+
+/* 进入节点，返回要进入的子节点个数，停下时返回 UINT32_MAX */
+static uint32_t enterFlatNode(const ZyFlatAst *tree, uint32_t node, int depth,
+                              AstFlatVisitor *visitor) {
+  AstFlatVisitFn enter = visitor->enter[tree->nodes[node].kind];
+  AstVisitResult result = enter == NULL
+                              ? AST_VISIT_CONTINUE
+                              : enter(tree, node, depth, visitor->context);
+  if (result == AST_VISIT_STOP)
+    return UINT32_MAX;
+  return result == AST_VISIT_SKIP ? 0 : zy_flatNumChild(tree, node);
+}
+
+/* 与 astVisit 相同的顺序和返回值的含义，子节点按下标找到 */
+void astVisitFlat(const ZyFlatAst *tree, uint32_t node,
+                  AstFlatVisitor *visitor) {
+  if (node == ZY_FLAT_NONE)
+    return;
+  VisitStack stack;
+  initVisitStack(&stack);
+  VisitFrame *root = pushFrame(&stack);
+  root->node = node;
+  root->numChild = enterFlatNode(tree, node, 0, visitor);
+  while (stack.top >= 0 && stack.frames[stack.top].numChild != UINT32_MAX) {
+    VisitFrame *frame = &stack.frames[stack.top];
+    if (frame->next < frame->numChild) {
+      uint32_t child = zy_flatChild(tree, frame->node, frame->next++);
+      if (child == ZY_FLAT_NONE)
+        continue;
+      frame = pushFrame(&stack);
+      frame->node = child;
+      frame->numChild = enterFlatNode(tree, child, stack.top, visitor);
+    } else {
+      AstFlatVisitFn leave = visitor->leave[tree->nodes[frame->node].kind];
+      if (leave != NULL && leave(tree, frame->node, stack.top,
+                                 visitor->context) == AST_VISIT_STOP)
+        break;
+      stack.top--;
+    }
+  }
+  freeVisitStack(&stack);
+}
@@ -0,0 +1,56 @@
+#pragma once
+
+#include "ast.h"
+#include "flatast.h"
+
+/* 一次遍历最多合并这么多个访问者 */
+#define AST_MAX_FUSED_VISITORS 16
+
+typedef enum {
+  AST_VISIT_CONTINUE, /* 接着访问子节点 */
+  AST_VISIT_SKIP,     /* 不进入子节点，离开时仍然回调 */
+  AST_VISIT_STOP      /* 这个访问者不再收到回调 */
+} AstVisitResult;
+
+/* depth 从开始遍历的节点算起，那个节点是 0 */
+typedef AstVisitResult (*AstVisitFn)(Ast *ast, int depth, void *context);
+
+/**
+ * @brief One pass over a tree, as callbacks looked up by node kind.
+ *
+ * enter is called before a node's children and leave after them;
+ * a kind without a callback is walked through. What leave returns
+ * only matters when it is AST_VISIT_STOP.
+ */
+typedef struct {
+  AstVisitFn enter[AST_KIND_ERROR + 1];
+  AstVisitFn leave[AST_KIND_ERROR + 1];
+  void *context; /**< @brief Passed to every callback. */
+} AstVisitor;
+
+void astInitVisitor(AstVisitor *visitor, void *context);
+void astVisitEvery(AstVisitor *visitor, AstVisitFn enter, AstVisitFn leave);
+void astVisit(Ast *ast, AstVisitor *visitor);
+void astVisitFused(Ast *ast, AstVisitor **visitors, int count);
+
+/* 扁平语法树上的回调，node 是节点在 tree 里的下标 */
+typedef AstVisitResult (*AstFlatVisitFn)(const ZyFlatAst *tree, uint32_t node,
+                                         int depth, void *context);
+
+/**
+ * @brief The same pass as an @ref AstVisitor, over a @ref ZyFlatAst.
+ *
+ * Children are walked by index, so a mapped tree is visited in place
+ * without building any Ast nodes.
+ */
+typedef struct {
+  AstFlatVisitFn enter[AST_KIND_ERROR + 1];
+  AstFlatVisitFn leave[AST_KIND_ERROR + 1];
+  void *context; /**< @brief Passed to every callback. */
+} AstFlatVisitor;
+
+void astInitFlatVisitor(AstFlatVisitor *visitor, void *context);
+void astVisitFlatEvery(AstFlatVisitor *visitor, AstFlatVisitFn enter,
+                       AstFlatVisitFn leave);
+void astVisitFlat(const ZyFlatAst *tree, uint32_t node,
+                  AstFlatVisitor *visitor);
@@ -1,77 +1,425 @@
 #include "zython.h"
+#include "flatast.h"
+#include "layout.h"
+#include "output.h"
+#include "parser.h"
 #include "scanner.h"
+#include "stream.h"
+#include "tokens.h"
 #include "stdio.h"
 #include "stdlib.h"
 #include "string.h"
 
-int main(int argc, char *argv[]) {
-  // 检查命令行参数的数量
-  if (argc < 3) {
-    printf("用法: %s --verbose-lex <filename>\n", argv[0]);
-    printf("      %s --verbose-ast <filename>\n", argv[0]);
+#include <errno.h>
+#include <fcntl.h>
+#include <inttypes.h>
+#include <limits.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/* 词法分析走过这么多字节后，把已经用完的页还给内核 */
+#define RELEASE_GRANULE ((size_t)64 << 20)
+
+/**
+ * @brief Read-only view of an input file.
+ *
+ * Regular files are mapped rather than read, so the scanner works
+ * directly on the page cache without a private copy. Pipes and
+ * standard input (`-`) cannot be mapped and are streamed instead.
+ */
+typedef struct {
+  const char *begin;
+  const char *end;
+  size_t mappedLength; /**< @brief 0 when nothing is mapped (empty file). */
+  const char *released; /**< @brief Pages before this were dropped. */
+  int streamFd; /**< @brief Descriptor to stream from, -1 when mapped. */
+} SourceFile;
+
+static int openSource(const char *filename, SourceFile *source) {
+  source->streamFd = -1;
+  if (strcmp(filename, "-") == 0) {
+    source->streamFd = STDIN_FILENO;
     return 1;
   }
 
-  char *filename = NULL;
-  // 检查参数
-  if (strcmp(argv[1], "--verbose-lex") == 0) {
-    // 获取文件名
-    filename = argv[2];
-    printf("Verbose lex mode enabled. Filename: %s\n", filename);
-  } else {
-    printf("未知参数: %s\n", argv[1]);
+  int fd = open(filename, O_RDONLY);
+  if (fd < 0) {
+    perror("Error opening file");
+    return 0;
   }
 
-  FILE *file;
-  char *buffer;
-  long file_size;
+  struct stat st;
+  if (fstat(fd, &st) != 0) {
+    perror("Error reading file");
+    close(fd);
+    return 0;
+  }
 
-  // Open the file in binary read mode
-  file = fopen(filename, "rb");
-  if (file == NULL) {
-    perror("Error opening file");
+  if (!S_ISREG(st.st_mode)) {
+    source->streamFd = fd;
     return 1;
   }
 
-  // Get the file size
-  fseek(file, 0, SEEK_END);
-  file_size = ftell(file);
-  rewind(file);
+  source->mappedLength = (size_t)st.st_size;
+  if (source->mappedLength == 0) {
+    /* 空文件不能 mmap */
+    source->begin = source->end = source->released = "";
+    close(fd);
+    return 1;
+  }
+
+  void *data =
+      mmap(NULL, source->mappedLength, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (data == MAP_FAILED) {
+    perror("Error mapping file");
+    return 0;
+  }
+  madvise(data, source->mappedLength, MADV_SEQUENTIAL);
+
+  source->begin = (const char *)data;
+  source->end = source->begin + source->mappedLength;
+  source->released = source->begin;
+  return 1;
+}
+
+/*
+ * 告诉内核 upTo 之前的内容已经不再需要。映射是只读的文件页，
+ * 丢弃之后再访问会重新从文件读入，所以这样做总是安全的；
+ * 它让常驻内存不再随文件大小增长。
+ */
+static void releaseSource(SourceFile *source, const char *upTo) {
+  if (source->mappedLength == 0 ||
+      (size_t)(upTo - source->released) < RELEASE_GRANULE)
+    return;
+  size_t pageSize = (size_t)sysconf(_SC_PAGESIZE);
+  size_t length = (size_t)(upTo - source->released) & ~(pageSize - 1);
+  madvise((void *)source->released, length, MADV_DONTNEED);
+  source->released += length;
+}
 
-  // Allocate memory for the buffer
-  buffer = (char *)malloc(file_size * sizeof(char));
-  if (buffer == NULL) {
-    perror("Error allocating memory");
-    fclose(file);
+static void closeSource(SourceFile *source) {
+  if (source->streamFd > STDIN_FILENO)
+    close(source->streamFd);
+  else if (source->streamFd < 0 && source->mappedLength != 0)
+    munmap((void *)source->begin, source->mappedLength);
+}
+
+/*
+ * 写出一个原始 token，位置相对于 base 再加上 consumed。
+ * 有 layout 时先交给它整理，写出它放行的所有 token。
+ */
+static void emitToken(ZyOutput *out, ZyLayout *layout, ZyToken t,
+                      const char *base, uint64_t consumed) {
+  if (layout == NULL) {
+    zy_writeToken(out, &t, consumed + (uint64_t)(t.start - base));
+    return;
+  }
+  zy_layoutFeed(layout, t);
+  while (zy_layoutNext(layout, &t))
+    zy_writeToken(out, &t, consumed + (uint64_t)(t.start - base));
+}
+
+/* 边读边扫描，内存占用与输入大小无关 */
+static void flushOutput(void *out) { zy_flushOutput((ZyOutput *)out); }
+
+static int lexStream(SourceFile *source, ZyOutput *out, ZyLayout *layout) {
+  ZyStream stream;
+  zy_openStream(&stream, source->streamFd);
+  /* 等输入时先把已经扫描出的 token 写出去 */
+  stream.onWait = flushOutput;
+  stream.waitContext = out;
+  ZyToken t = {};
+  do {
+    t = zy_streamToken(&stream);
+    emitToken(out, layout, t, stream.buffer, stream.consumed);
+  } while (t.type != TOKEN_EOF);
+
+  int error = stream.error;
+  zy_closeStream(&stream);
+  closeSource(source);
+  if (error != 0) {
+    errno = error;
+    perror("Error reading file");
+    return 1;
+  }
+  return 0;
+}
+
+/* 写出剩下的内容，写失败时报告错误 */
+static int finishOutput(ZyOutput *out) {
+  int error = zy_closeOutput(out);
+  if (error != 0) {
+    errno = error;
+    perror("Error writing output");
     return 1;
   }
+  return 0;
+}
+
+/* 读出管道里的全部内容 */
+static int readAll(int fd, char **data, size_t *length) {
+  size_t capacity = (size_t)64 << 10;
+  *data = (char *)malloc(capacity);
+  *length = 0;
+  while (1) {
+    if (*data == NULL) {
+      fprintf(stderr, "Not enough memory to read input.\n");
+      exit(1);
+    }
+    if (*length == capacity) {
+      capacity *= 2;
+      *data = (char *)realloc(*data, capacity);
+      continue;
+    }
+    ssize_t n = read(fd, *data + *length, capacity - *length);
+    if (n < 0 && errno == EINTR)
+      continue;
+    if (n <= 0)
+      return n == 0;
+    *length += (size_t)n;
+  }
+}
+
+static int cachePath(char *path, const char *cacheDir, uint64_t hash) {
+  return snprintf(path, PATH_MAX, "%s/%016" PRIx64 ".zyast", cacheDir, hash) <
+         PATH_MAX;
+}
+
+/* 先写到临时文件再改名，别的进程不会映射到写了一半的缓存 */
+static void storeCachedAst(const char *path, const SourceFile *source,
+                           Ast *script, uint64_t hash) {
+  char temp[PATH_MAX];
+  if (snprintf(temp, sizeof(temp), "%s.%ld.tmp", path, (long)getpid()) >=
+      (int)sizeof(temp))
+    return;
+  int fd = open(temp, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  if (fd < 0) {
+    perror("Error writing AST cache");
+    return;
+  }
+  ZyFlatAst tree;
+  zy_initFlatAst(&tree, source->begin);
+  uint32_t root = zy_flattenAst(&tree, script);
+  int written = zy_writeFlatAst(fd, &tree, root, source->end, hash);
+  zy_freeFlatAst(&tree);
+  if (close(fd) != 0)
+    written = 0;
+  if (!written || rename(temp, path) != 0) {
+    perror("Error writing AST cache");
+    unlink(temp);
+  }
+}
+
+/*
+ * 缓存里有这份源码的语法树时直接从映射的文件输出，不解析，也不
+ * 还原成 Ast，返回 1。
+ */
+static int writeCachedAst(ZyOutput *out, const char *path,
+                          const SourceFile *source, uint64_t hash) {
+  int fd = open(path, O_RDONLY);
+  if (fd < 0)
+    return 0;
+  ZyMappedAst mapped;
+  int hit = zy_mapFlatAst(fd, source->begin, source->end, hash, &mapped);
+  close(fd);
+  if (!hit)
+    return 0;
+  astWriteFlat(out, &mapped.tree, mapped.root);
+  zy_unmapFlatAst(&mapped);
+  return 1;
+}
 
-  // Read the file into the buffer
-  size_t bytes_read = fread(buffer, sizeof(char), file_size, file);
-  if (bytes_read != file_size) {
-    if (feof(file)) {
-      printf("End of file reached, read %zu bytes\n", bytes_read);
-    } else if (ferror(file)) {
+/*
+ * 解析后输出。path 不是 NULL 时把树存进缓存，有语法错误的树不存，
+ * 下次照常解析，错误才会再报告一遍。
+ */
+static int parseAndWrite(ZyOutput *out, const SourceFile *source, int jobs,
+                         const char *path, uint64_t hash) {
+  /* 整棵树随 arena 一起释放 */
+  AstArena arena;
+  astInitArena(&arena);
+  astUseArena(&arena);
+  int hadError;
+  Ast *script =
+      (jobs > 1)
+          ? zy_parseParallel(source->begin, source->end, jobs, &hadError)
+          : zy_parse(source->begin, source->end, &hadError);
+  astWrite(out, script, source->begin);
+  if (path != NULL && !hadError)
+    storeCachedAst(path, source, script, hash);
+  astUseArena(NULL);
+  astFreeArena(&arena);
+  return hadError;
+}
+
+/*
+ * 解析整个文件并按 format 打印语法树，有语法错误或写失败时返回 1。
+ * lazy 时只做预解析，函数体不展开；有 cacheDir 时先找缓存的语法树。
+ */
+static int printAst(const char *filename, int jobs, int lazy,
+                    const char *cacheDir, ZyOutputFormat format) {
+  if (format == ZY_FORMAT_HUMAN) {
+    printf("Verbose AST mode enabled. Filename: %s\n", filename);
+    fflush(stdout);
+  }
+  SourceFile source;
+  if (!openSource(filename, &source))
+    return 1;
+  char *buffer = NULL;
+  if (source.streamFd >= 0) {
+    /* 语法树引用源码，不能映射的输入只好整个读进来 */
+    size_t length;
+    if (!readAll(source.streamFd, &buffer, &length)) {
       perror("Error reading file");
+      free(buffer);
+      closeSource(&source);
+      return 1;
     }
-    free(buffer);
-    fclose(file);
+    source.begin = buffer;
+    source.end = buffer + length;
+  }
+
+  int hadError;
+  ZyOutput out;
+  zy_openOutput(&out, STDOUT_FILENO, format);
+  if (lazy) {
+    ZyModule module;
+    zy_parseLazy(source.begin, source.end, &module);
+    astWrite(&out, module.script, source.begin);
+    hadError = module.hadError;
+    zy_freeModule(&module);
+  } else if (cacheDir == NULL) {
+    hadError = parseAndWrite(&out, &source, jobs, NULL, 0);
+  } else {
+    uint64_t hash = zy_hashSource(source.begin, source.end);
+    char path[PATH_MAX];
+    int named = cachePath(path, cacheDir, hash);
+    if (named && writeCachedAst(&out, path, &source, hash))
+      hadError = 0;
+    else
+      hadError = parseAndWrite(&out, &source, jobs, named ? path : NULL, hash);
+  }
+  free(buffer);
+  closeSource(&source);
+  return finishOutput(&out) || hadError;
+}
+
+static void printUsage(const char *program) {
+  printf("用法: %s [--jobs N] [--format human|binary|jsonl] [--layout] "
+         "--verbose-lex <filename|->\n",
+         program);
+  printf("      %s [--jobs N [--cache-dir DIR] | --lazy] "
+         "[--format human|json|sexp] --verbose-ast <filename|->\n",
+         program);
+}
+
+int main(int argc, char *argv[]) {
+  // 检查命令行参数的数量
+  if (argc < 3) {
+    printUsage(argv[0]);
     return 1;
   }
 
-  // Close the file
-  fclose(file);
+  char *filename = NULL;
+  int ast = 0;
+  int lazy = 0;
+  int jobs = 1;
+  const char *cacheDir = NULL;
+  ZyOutputFormat format = ZY_FORMAT_HUMAN;
+  ZyLayout layout;
+  ZyLayout *useLayout = NULL;
+  // 检查参数
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "--verbose-lex") == 0 && i + 1 < argc) {
+      // 获取文件名
+      filename = argv[++i];
+    } else if (strcmp(argv[i], "--verbose-ast") == 0 && i + 1 < argc) {
+      filename = argv[++i];
+      ast = 1;
+    } else if (strcmp(argv[i], "--lazy") == 0) {
+      /* 只预解析，不展开函数体 */
+      lazy = 1;
+    } else if (strcmp(argv[i], "--cache-dir") == 0 && i + 1 < argc) {
+      /* 按源码内容缓存解析好的语法树 */
+      cacheDir = argv[++i];
+    } else if (strcmp(argv[i], "--jobs") == 0 && i + 1 < argc) {
+      jobs = atoi(argv[++i]);
+    } else if (strcmp(argv[i], "--format") == 0 && i + 1 < argc) {
+      if (!zy_parseOutputFormat(argv[++i], &format)) {
+        printf("未知的输出格式: %s\n", argv[i]);
+        return 1;
+      }
+    } else if (strcmp(argv[i], "--layout") == 0) {
+      /* 输出 INDENT/DEDENT，去掉空行和 RETRY */
+      zy_initLayout(&layout);
+      useLayout = &layout;
+    } else {
+      printf("未知参数: %s\n", argv[i]);
+      return 1;
+    }
+  }
+  if (filename == NULL) {
+    printUsage(argv[0]);
+    return 1;
+  }
+  /* json 和 sexp 只用于语法树，binary 和 jsonl 只用于 token */
+  int treeFormat = format == ZY_FORMAT_JSON || format == ZY_FORMAT_SEXP;
+  if (ast ? !treeFormat && format != ZY_FORMAT_HUMAN : treeFormat) {
+    printf("这种输出格式不能用于 %s\n", ast ? "--verbose-ast" : "--verbose-lex");
+    return 1;
+  }
+  if (cacheDir != NULL && (!ast || lazy)) {
+    printf("--cache-dir 只能用于 --verbose-ast，不能和 --lazy 一起用\n");
+    return 1;
+  }
+  if (ast)
+    return printAst(filename, jobs, lazy, cacheDir, format);
+
+  /* 其它格式通常交给别的程序处理，不要混进提示信息 */
+  if (format == ZY_FORMAT_HUMAN) {
+    printf("Verbose lex mode enabled. Filename: %s\n", filename);
+    fflush(stdout);
+  }
 
-  ZyScanner scanner = zy_initScanner(buffer);
+  SourceFile source;
+  if (!openSource(filename, &source))
+    return 1;
+  ZyOutput out;
+  zy_openOutput(&out, STDOUT_FILENO, format);
+  if (source.streamFd >= 0) {
+    int status = lexStream(&source, &out, useLayout);
+    return finishOutput(&out) || status;
+  }
+
+  if (jobs > 1) {
+    /* 多线程扫描出整个 token 表，再逐个还原打印 */
+    ZyTokenBuffer tokens;
+    if (!zy_scanTokensParallel(source.begin, source.end, jobs, &tokens)) {
+      fprintf(stderr, "File is too large to lex in parallel.\n");
+      closeSource(&source);
+      zy_closeOutput(&out);
+      return 1;
+    }
+    for (size_t i = 0; i < tokens.count; i++)
+      emitToken(&out, useLayout, zy_tokenAt(&tokens, i), source.begin, 0);
+    zy_freeTokenBuffer(&tokens);
+    closeSource(&source);
+    return finishOutput(&out);
+  }
+
+  ZyScanner scanner = zy_initScanner(source.begin, source.end);
   ZyToken t = {};
   while (1) {
     t = zy_scanToken(&scanner);
-    printToken(t);
+    emitToken(&out, useLayout, t, source.begin, 0);
     if (t.type == TOKEN_EOF) {
       break;
     }
+    releaseSource(&source, scanner.cur);
   }
 
-  free(buffer);
-  return 0;
-}
\ No newline at end of file
+  closeSource(&source);
+  return finishOutput(&out);
+}